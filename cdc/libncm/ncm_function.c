@@ -0,0 +1,326 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include "ncm_function.h"
+#include <stddef.h>
+#include <errno.h>
+
+#define NCM_NTB_MAX_SIZE (0xFFFF)
+
+enum
+{
+    NOTIFY_IDLE,
+    NOTIFY_SPEED,
+    NOTIFY_CONNECTION,
+};
+
+static inline uint32_t get_le32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+        ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+static inline void put_le16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+}
+
+static inline void put_le32(uint8_t *buffer, uint32_t value)
+{
+    put_le16(buffer, value & 0xFFFF);
+    put_le16(buffer + 2, (value >> 16) & 0xFFFF);
+}
+
+static inline void lock(struct ncm_function *f)
+{
+    if (f->ops->lock)
+        f->ops->lock(f->ctx);
+}
+
+static inline void unlock(struct ncm_function *f)
+{
+    if (f->ops->unlock)
+        f->ops->unlock(f->ctx);
+}
+
+static void start_ntb(struct ncm_function *f)
+{
+    ncm_ntb_init(&f->ntb, f->buf.tx[f->tx_fill], f->ntb_input_size,
+            NCM_NDP_IN_DIVISOR, NCM_NDP_IN_REMAINDER, f->sequence++);
+}
+
+/* Hands aggregated NTB to transport and continues on the other buffer */
+static void flush(struct ncm_function *f)
+{
+    uint8_t *buffer = f->buf.tx[f->tx_fill];
+    uint16_t count = ncm_ntb_count(&f->ntb);
+    uint32_t length = ncm_ntb_finalize(&f->ntb);
+
+    if (length == 0)
+        return;
+
+    f->tx_fill ^= 1;
+    start_ntb(f);
+
+    f->tx_busy = 1;
+    if (f->ops->send(f->ctx, buffer, length)) {
+        f->tx_busy = 0;
+        f->stats.tx_dropped += count;
+        f->stats.tx_datagrams -= count;
+        return;
+    }
+    f->stats.tx_ntbs++;
+}
+
+static void send_notification(struct ncm_function *f)
+{
+    uint8_t *n = f->buf.notify;
+    uint32_t length = 8;
+
+    n[0] = NCM_NOTIFY_REQUEST_TYPE;
+    put_le16(&n[2], 0);
+    put_le16(&n[4], f->comm_interface);
+    put_le16(&n[6], 0);
+
+    switch (f->notify_state) {
+        case NOTIFY_SPEED:
+            n[1] = NCM_NOTIFY_CONNECTION_SPEED_CHANGE;
+            put_le16(&n[6], 8);
+            put_le32(&n[8], f->bitrate);  /* DLBitRate */
+            put_le32(&n[12], f->bitrate); /* ULBitRate */
+            length = 16;
+            break;
+        case NOTIFY_CONNECTION:
+            n[1] = NCM_NOTIFY_NETWORK_CONNECTION;
+            put_le16(&n[2], f->active);
+            break;
+        default:
+            return;
+    }
+
+    if (f->ops->notify(f->ctx, n, length))
+        f->notify_state = NOTIFY_IDLE;
+}
+
+static void deliver(void *arg, const uint8_t *datagram, uint16_t length)
+{
+    struct ncm_function *f = arg;
+    f->ops->datagram(f->ctx, datagram, length);
+}
+
+static void set_defaults(struct ncm_function *f)
+{
+    f->ntb_input_size = (f->buf.tx_size > NCM_NTB_MAX_SIZE) ? NCM_NTB_MAX_SIZE : f->buf.tx_size;
+    f->packet_filter = 0;
+    f->sequence = 0;
+    f->tx_busy = 0;
+    f->tx_fill = 0;
+    f->notify_state = NOTIFY_IDLE;
+    start_ntb(f);
+}
+
+int ncm_function_init(struct ncm_function *f, const struct ncm_function_ops *ops, void *ctx,
+        const struct ncm_function_buffers *buffers, uint8_t comm_interface)
+{
+    if (!ops || !ops->send || !ops->recv || !ops->notify || !ops->datagram)
+        return -EINVAL;
+    if (!buffers->tx[0] || !buffers->tx[1] || !buffers->rx ||
+        !buffers->control || !buffers->notify)
+        return -EINVAL;
+    if ((buffers->tx_size < NCM_NTB_MIN_INPUT_SIZE) || (buffers->rx_size < NCM_NTB_MIN_INPUT_SIZE))
+        return -EINVAL;
+
+    f->ops = ops;
+    f->ctx = ctx;
+    f->buf = *buffers;
+    f->comm_interface = comm_interface;
+    f->active = 0;
+    f->bitrate = 0;
+    f->stats = (struct ncm_function_stats){ 0 };
+    set_defaults(f);
+    return 0;
+}
+
+static int get_ntb_parameters(struct ncm_function *f, uint8_t *p)
+{
+    uint32_t out_size = (f->buf.rx_size > NCM_NTB_MAX_SIZE) ? NCM_NTB_MAX_SIZE : f->buf.rx_size;
+    uint32_t in_size = (f->buf.tx_size > NCM_NTB_MAX_SIZE) ? NCM_NTB_MAX_SIZE : f->buf.tx_size;
+
+    put_le16(&p[0], NCM_NTB_PARAMETERS_LENGTH);
+    put_le16(&p[2], NCM_NTB_FORMATS_SUPPORTED);
+    put_le32(&p[4], in_size);
+    put_le16(&p[8], NCM_NDP_IN_DIVISOR);
+    put_le16(&p[10], NCM_NDP_IN_REMAINDER);
+    put_le16(&p[12], NCM_NDP16_ALIGNMENT);
+    put_le16(&p[14], 0);
+    put_le32(&p[16], out_size);
+    put_le16(&p[20], NCM_NDP_OUT_DIVISOR);
+    put_le16(&p[22], NCM_NDP_OUT_REMAINDER);
+    put_le16(&p[24], NCM_NDP16_ALIGNMENT);
+    put_le16(&p[26], 0); /* wNtbOutMaxDatagrams, no limit */
+    return NCM_NTB_PARAMETERS_LENGTH;
+}
+
+static int set_ntb_input_size(struct ncm_function *f, const uint8_t *data, uint32_t length)
+{
+    uint32_t size;
+
+    if (length < 4)
+        return -EINVAL;
+
+    size = get_le32(data);
+    if ((size < NCM_NTB_MIN_INPUT_SIZE) || (size > f->buf.tx_size) || (size > NCM_NTB_MAX_SIZE))
+        return -EINVAL;
+
+    lock(f);
+    f->ntb_input_size = size;
+    /* Current NTB may be already partially filled, new size applies to the next one */
+    if (ncm_ntb_count(&f->ntb) == 0)
+        f->ntb.size = size;
+    unlock(f);
+    return 0;
+}
+
+int ncm_function_request(struct ncm_function *f, uint8_t request, uint16_t value,
+        uint8_t **buffer, uint32_t *length, int is_setup)
+{
+    uint32_t reply;
+
+    switch (request) {
+        case NCM_REQUEST_GET_NTB_PARAMETERS:
+            reply = get_ntb_parameters(f, f->buf.control);
+            break;
+        case NCM_REQUEST_GET_NTB_FORMAT:
+            put_le16(f->buf.control, NCM_NTB_FORMAT_16);
+            reply = 2;
+            break;
+        case NCM_REQUEST_GET_NTB_INPUT_SIZE:
+            put_le32(f->buf.control, f->ntb_input_size);
+            reply = 4;
+            break;
+        case NCM_REQUEST_SET_NTB_FORMAT:
+            return (value == NCM_NTB_FORMAT_16) ? 0 : -EINVAL;
+        case NCM_REQUEST_SET_ETHERNET_PACKET_FILTER:
+            f->packet_filter = value;
+            return 0;
+        case NCM_REQUEST_SET_NTB_INPUT_SIZE:
+            if (is_setup) {
+                if ((*length < 4) || (*length > NCM_CONTROL_BUFFER_SIZE))
+                    return -EINVAL;
+                *buffer = f->buf.control;
+                return 0;
+            }
+            return set_ntb_input_size(f, *buffer, *length);
+        default:
+            return -EINVAL;
+    }
+
+    *buffer = f->buf.control;
+    if (*length > reply)
+        *length = reply;
+    return 0;
+}
+
+void ncm_function_activate(struct ncm_function *f, uint32_t bitrate)
+{
+    lock(f);
+    f->active = 1;
+    f->bitrate = bitrate;
+    unlock(f);
+
+    if (f->ops->recv(f->ctx, f->buf.rx, f->buf.rx_size))
+        f->stats.rx_errors++;
+
+    lock(f);
+    f->notify_state = NOTIFY_SPEED;
+    send_notification(f);
+    unlock(f);
+}
+
+void ncm_function_deactivate(struct ncm_function *f)
+{
+    lock(f);
+    f->stats.tx_dropped += ncm_ntb_count(&f->ntb);
+    f->active = 0;
+    set_defaults(f);
+    unlock(f);
+}
+
+int ncm_function_send(struct ncm_function *f, const void *datagram, uint16_t length)
+{
+    int ret;
+
+    lock(f);
+    if (!f->active) {
+        ret = -ENOTCONN;
+        goto out;
+    }
+
+    ret = ncm_ntb_add(&f->ntb, datagram, length);
+    if ((ret == -ENOSPC) && !f->tx_busy && ncm_ntb_count(&f->ntb)) {
+        flush(f);
+        ret = ncm_ntb_add(&f->ntb, datagram, length);
+    }
+    if (ret) {
+        f->stats.tx_dropped++;
+        goto out;
+    }
+    f->stats.tx_datagrams++;
+
+    /* Idle endpoint sends right away, otherwise datagrams are aggregated
+     * until the NTB in flight completes */
+    if (!f->tx_busy)
+        flush(f);
+out:
+    unlock(f);
+    return ret;
+}
+
+void ncm_function_tx_complete(struct ncm_function *f)
+{
+    /* Senders may be in the middle of ncm_function_send() */
+    lock(f);
+    f->tx_busy = 0;
+    if (f->active && ncm_ntb_count(&f->ntb))
+        flush(f);
+    unlock(f);
+}
+
+void ncm_function_rx_complete(struct ncm_function *f, uint32_t length)
+{
+    int ret;
+
+    if (!f->active || (length > f->buf.rx_size))
+        return;
+
+    /* Receive state is only touched from USB context, datagrams are
+     * delivered outside of lock as consumer may block */
+    ret = ncm_ntb_parse(f->buf.rx, length, deliver, f);
+    if (ret < 0) {
+        f->stats.rx_errors++;
+    } else {
+        f->stats.rx_ntbs++;
+        f->stats.rx_datagrams += ret;
+    }
+
+    if (f->ops->recv(f->ctx, f->buf.rx, f->buf.rx_size))
+        f->stats.rx_errors++;
+}
+
+void ncm_function_notify_complete(struct ncm_function *f)
+{
+    lock(f);
+    switch (f->notify_state) {
+        case NOTIFY_SPEED:
+            f->notify_state = NOTIFY_CONNECTION;
+            break;
+        default:
+            f->notify_state = NOTIFY_IDLE;
+            break;
+    }
+    send_notification(f);
+    unlock(f);
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _NCM_FUNCTION_H
+#define _NCM_FUNCTION_H
+
+#include <stdint.h>
+#include "ncm_ntb.h"
+
+/* NCM 1.0, 6.2: class specific requests handled by function */
+#define NCM_REQUEST_SET_ETHERNET_PACKET_FILTER (0x43)
+#define NCM_REQUEST_GET_NTB_PARAMETERS (0x80)
+#define NCM_REQUEST_GET_NTB_FORMAT (0x83)
+#define NCM_REQUEST_SET_NTB_FORMAT (0x84)
+#define NCM_REQUEST_GET_NTB_INPUT_SIZE (0x85)
+#define NCM_REQUEST_SET_NTB_INPUT_SIZE (0x86)
+
+/* NCM 1.0, 6.3: notifications sent over interrupt endpoint */
+#define NCM_NOTIFY_NETWORK_CONNECTION (0x00)
+#define NCM_NOTIFY_CONNECTION_SPEED_CHANGE (0x2A)
+#define NCM_NOTIFY_REQUEST_TYPE (0xA1)
+
+#define NCM_NTB_PARAMETERS_LENGTH (28)
+#define NCM_NTB_FORMAT_16 (0x0000)
+#define NCM_NTB_FORMATS_SUPPORTED (0x0001) /* 16 bit NTB only */
+/* Smallest NTB size host is allowed to negotiate, NCM 1.0, 6.2.7 */
+#define NCM_NTB_MIN_INPUT_SIZE (2048)
+/* Datagram alignment announced to host and used for transmitted NTBs */
+#define NCM_NDP_IN_DIVISOR (4)
+#define NCM_NDP_IN_REMAINDER (0)
+#define NCM_NDP_OUT_DIVISOR (4)
+#define NCM_NDP_OUT_REMAINDER (0)
+
+/* Minimal sizes of buffers passed in struct ncm_function_buffers */
+#define NCM_CONTROL_BUFFER_SIZE (NCM_NTB_PARAMETERS_LENGTH)
+#define NCM_NOTIFY_BUFFER_SIZE (16)
+
+/* Transport operations, called with function lock held or from USB context */
+struct ncm_function_ops
+{
+    /* Arm bulk IN with complete NTB, completion reported by ncm_function_tx_complete */
+    int (*send)(void *ctx, uint8_t *buffer, uint32_t length);
+    /* Arm bulk OUT, completion reported by ncm_function_rx_complete */
+    int (*recv)(void *ctx, uint8_t *buffer, uint32_t length);
+    /* Arm interrupt IN, completion reported by ncm_function_notify_complete */
+    int (*notify)(void *ctx, uint8_t *buffer, uint32_t length);
+    /* Deliver datagram extracted from received NTB */
+    void (*datagram)(void *ctx, const uint8_t *datagram, uint16_t length);
+    /* Optional, serialize ncm_function_send against USB context */
+    void (*lock)(void *ctx);
+    void (*unlock)(void *ctx);
+};
+
+/* Memory owned by transport, has to be reachable by USB controller */
+struct ncm_function_buffers
+{
+    uint8_t *tx[2];     /* One NTB is sent while the other one aggregates datagrams */
+    uint32_t tx_size;   /* Size of each tx buffer, upper bound of NTB input size */
+    uint8_t *rx;
+    uint32_t rx_size;   /* Announced to host as dwNtbOutMaxSize */
+    uint8_t *control;   /* NCM_CONTROL_BUFFER_SIZE bytes */
+    uint8_t *notify;    /* NCM_NOTIFY_BUFFER_SIZE bytes */
+};
+
+struct ncm_function_stats
+{
+    uint32_t tx_datagrams;
+    uint32_t tx_ntbs;
+    uint32_t tx_dropped;    /* Datagrams not sent due to full NTBs or transport error */
+    uint32_t rx_datagrams;
+    uint32_t rx_ntbs;
+    uint32_t rx_errors;     /* Malformed NTBs */
+};
+
+struct ncm_function
+{
+    const struct ncm_function_ops *ops;
+    void *ctx;
+    struct ncm_function_buffers buf;
+    uint8_t comm_interface;
+    uint8_t active;         /* Data interface alternate setting 1 selected */
+    uint8_t tx_busy;        /* NTB armed on bulk IN */
+    uint8_t tx_fill;        /* Index of tx buffer aggregating datagrams */
+    uint8_t notify_state;
+    uint16_t packet_filter;
+    uint16_t sequence;
+    uint32_t ntb_input_size;
+    uint32_t bitrate;
+    ncm_ntb_builder_t ntb;
+    struct ncm_function_stats stats;
+};
+
+/*
+ * @brief Binds transport and buffers to function and sets default parameters
+ * @param comm_interface number of communication interface, used in notifications
+ * @return 0 on success, -EINVAL if buffers are missing or too small
+ */
+int ncm_function_init(struct ncm_function *f, const struct ncm_function_ops *ops, void *ctx,
+        const struct ncm_function_buffers *buffers, uint8_t comm_interface);
+
+/*
+ * @brief Handles class specific request addressed to communication interface
+ * @param buffer on setup stage points to data for IN requests or storage for OUT data stage
+ * @param length wLength on input, number of bytes to send back for IN requests
+ * @param is_setup nonzero for setup stage, zero when OUT data stage is received
+ * @return 0 on success, -EINVAL for unsupported request or invalid value
+ */
+int ncm_function_request(struct ncm_function *f, uint8_t request, uint16_t value,
+        uint8_t **buffer, uint32_t *length, int is_setup);
+
+/*
+ * @brief Data interface alternate setting 1 selected, starts data transfers
+ *        and notifies host about connection
+ * @param bitrate link speed reported to host in bits per second
+ */
+void ncm_function_activate(struct ncm_function *f, uint32_t bitrate);
+
+/*
+ * @brief Data interface alternate setting 0 selected or bus reset,
+ *        pending datagrams are dropped and NTB parameters reset to defaults
+ */
+void ncm_function_deactivate(struct ncm_function *f);
+
+/*
+ * @brief Queues datagram for host. It's aggregated with other datagrams
+ *        as long as previous NTB is in flight.
+ * @return 0 on success, -ENOTCONN if not active, -ENOSPC if there is no room,
+ *         -EINVAL for empty datagram
+ */
+int ncm_function_send(struct ncm_function *f, const void *datagram, uint16_t length);
+
+/* Transfer completions, called from USB context */
+void ncm_function_tx_complete(struct ncm_function *f);
+void ncm_function_rx_complete(struct ncm_function *f, uint32_t length);
+void ncm_function_notify_complete(struct ncm_function *f);
+
+#endif /* _NCM_FUNCTION_H */
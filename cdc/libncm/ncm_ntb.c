@@ -0,0 +1,193 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include "ncm_ntb.h"
+#include <string.h>
+#include <errno.h>
+
+/* Bound for NDP chain walk, so crafted wNextNdpIndex loop can't hang receiver */
+#define NCM_NDP_CHAIN_MAX (16)
+
+static inline uint16_t get_le16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+        ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+static inline void put_le16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+}
+
+static inline void put_le32(uint8_t *buffer, uint32_t value)
+{
+    put_le16(buffer, value & 0xFFFF);
+    put_le16(buffer + 2, (value >> 16) & 0xFFFF);
+}
+
+static inline uint32_t align_4(uint32_t offset)
+{
+    return (offset + (NCM_NDP16_ALIGNMENT - 1)) & ~(uint32_t)(NCM_NDP16_ALIGNMENT - 1);
+}
+
+static uint32_t align_datagram(const ncm_ntb_builder_t *ntb, uint32_t offset)
+{
+    if (ntb->divisor <= 1)
+        return offset;
+
+    return offset + (ntb->remainder + ntb->divisor - (offset % ntb->divisor)) % ntb->divisor;
+}
+
+void ncm_ntb_init(ncm_ntb_builder_t *ntb, uint8_t *buffer, uint32_t size,
+        uint16_t divisor, uint16_t remainder, uint16_t sequence)
+{
+    ntb->buffer = buffer;
+    ntb->size = (size > 0xFFFF) ? 0xFFFF : size;
+    ntb->divisor = divisor;
+    ntb->remainder = (divisor > 1) ? (remainder % divisor) : 0;
+    ntb->sequence = sequence;
+    ntb->count = 0;
+    ntb->offset = NCM_NTH16_LENGTH;
+}
+
+uint8_t *ncm_ntb_alloc(ncm_ntb_builder_t *ntb, uint16_t length)
+{
+    uint32_t start, end, ndp_length;
+
+    if ((length == 0) || (ntb->count >= NCM_NTB_MAX_DATAGRAMS))
+        return NULL;
+
+    start = align_datagram(ntb, ntb->offset);
+    end = start + length;
+    /* New entry and null terminator have to fit as well */
+    ndp_length = NCM_NDP16_HEADER_LENGTH + (ntb->count + 2) * NCM_NDP16_ENTRY_LENGTH;
+
+    if (align_4(end) + ndp_length > ntb->size)
+        return NULL;
+
+    memset(&ntb->buffer[ntb->offset], 0, start - ntb->offset);
+    ntb->index[ntb->count] = (uint16_t)start;
+    ntb->length[ntb->count] = length;
+    ntb->count++;
+    ntb->offset = end;
+
+    return &ntb->buffer[start];
+}
+
+int ncm_ntb_add(ncm_ntb_builder_t *ntb, const void *datagram, uint16_t length)
+{
+    uint8_t *payload;
+
+    if (length == 0)
+        return -EINVAL;
+
+    payload = ncm_ntb_alloc(ntb, length);
+    if (!payload)
+        return -ENOSPC;
+
+    memcpy(payload, datagram, length);
+    return 0;
+}
+
+uint32_t ncm_ntb_finalize(ncm_ntb_builder_t *ntb)
+{
+    uint8_t *ndp;
+    uint32_t ndp_index;
+    uint16_t ndp_length;
+    uint16_t i;
+
+    if (ntb->count == 0)
+        return 0;
+
+    ndp_index = align_4(ntb->offset);
+    ndp_length = NCM_NDP16_HEADER_LENGTH + (ntb->count + 1) * NCM_NDP16_ENTRY_LENGTH;
+    memset(&ntb->buffer[ntb->offset], 0, ndp_index - ntb->offset);
+
+    ndp = &ntb->buffer[ndp_index];
+    put_le32(&ndp[0], NCM_NDP16_SIGNATURE);
+    put_le16(&ndp[4], ndp_length);
+    put_le16(&ndp[6], 0); /* wNextNdpIndex */
+    ndp += NCM_NDP16_HEADER_LENGTH;
+    for (i = 0; i < ntb->count; i++) {
+        put_le16(&ndp[0], ntb->index[i]);
+        put_le16(&ndp[2], ntb->length[i]);
+        ndp += NCM_NDP16_ENTRY_LENGTH;
+    }
+    put_le32(ndp, 0);
+
+    put_le32(&ntb->buffer[0], NCM_NTH16_SIGNATURE);
+    put_le16(&ntb->buffer[4], NCM_NTH16_LENGTH);
+    put_le16(&ntb->buffer[6], ntb->sequence);
+    put_le16(&ntb->buffer[8], (uint16_t)(ndp_index + ndp_length));
+    put_le16(&ntb->buffer[10], (uint16_t)ndp_index);
+
+    return ndp_index + ndp_length;
+}
+
+int ncm_ntb_parse(const uint8_t *buffer, uint32_t length, ncm_datagram_cb_t cb, void *arg)
+{
+    uint32_t block_length;
+    uint32_t ndp_index;
+    uint16_t ndp_length;
+    uint32_t entry;
+    int chain;
+    int count = 0;
+
+    if (length < NCM_NTH16_LENGTH)
+        return -EBADMSG;
+
+    if ((get_le32(&buffer[0]) != NCM_NTH16_SIGNATURE) ||
+        (get_le16(&buffer[4]) != NCM_NTH16_LENGTH))
+        return -EBADMSG;
+
+    /* Zero block length means NTB is delimited by short packet */
+    block_length = get_le16(&buffer[8]);
+    if (block_length == 0)
+        block_length = length;
+    if (block_length > length)
+        return -EBADMSG;
+
+    ndp_index = get_le16(&buffer[10]);
+    for (chain = 0; chain < NCM_NDP_CHAIN_MAX; chain++) {
+        const uint8_t *ndp = &buffer[ndp_index];
+
+        if ((ndp_index < NCM_NTH16_LENGTH) || (ndp_index % NCM_NDP16_ALIGNMENT) ||
+            (ndp_index + NCM_NDP16_HEADER_LENGTH > block_length))
+            return -EBADMSG;
+
+        ndp_length = get_le16(&ndp[4]);
+        if ((get_le32(&ndp[0]) != NCM_NDP16_SIGNATURE) ||
+            (ndp_length < NCM_NDP16_HEADER_LENGTH + 2 * NCM_NDP16_ENTRY_LENGTH) ||
+            (ndp_length % NCM_NDP16_ALIGNMENT) ||
+            (ndp_index + ndp_length > block_length))
+            return -EBADMSG;
+
+        for (entry = NCM_NDP16_HEADER_LENGTH; entry + NCM_NDP16_ENTRY_LENGTH <= ndp_length;
+                entry += NCM_NDP16_ENTRY_LENGTH) {
+            const uint32_t index = get_le16(&ndp[entry]);
+            const uint16_t size = get_le16(&ndp[entry + 2]);
+
+            if ((index == 0) || (size == 0))
+                break;
+            if ((index < NCM_NTH16_LENGTH) || (index + size > block_length))
+                return -EBADMSG;
+
+            cb(arg, &buffer[index], size);
+            count++;
+        }
+
+        ndp_index = get_le16(&ndp[6]);
+        if (ndp_index == 0)
+            return count;
+    }
+
+    return -EBADMSG;
+}
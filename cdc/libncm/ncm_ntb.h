@@ -0,0 +1,83 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _NCM_NTB_H
+#define _NCM_NTB_H
+
+#include <stdint.h>
+
+/* NCM 1.0, 3.2.1 and 3.3.1: 16 bit NTB header and datagram pointer table */
+#define NCM_NTH16_SIGNATURE (0x484D434EU) /* "NCMH" */
+#define NCM_NDP16_SIGNATURE (0x304D434EU) /* "NCM0", datagrams without CRC */
+#define NCM_NTH16_LENGTH (12)
+#define NCM_NDP16_HEADER_LENGTH (8)
+#define NCM_NDP16_ENTRY_LENGTH (4)
+#define NCM_NDP16_ALIGNMENT (4)
+
+/* Upper bound of datagrams aggregated in single transmitted NTB */
+#ifndef NCM_NTB_MAX_DATAGRAMS
+#define NCM_NTB_MAX_DATAGRAMS (32)
+#endif
+
+/* Aggregates datagrams into single NTB16. Datagrams are placed right after
+ * header and datagram pointer table is appended by ncm_ntb_finalize. */
+struct ncm_ntb_builder
+{
+    uint8_t *buffer;
+    uint32_t size;          /* Usable bytes of buffer, host NTB input size at most */
+    uint16_t divisor;       /* wNdpInDivisor: datagram alignment modulus */
+    uint16_t remainder;     /* wNdpInPayloadRemainder */
+    uint16_t sequence;
+    uint16_t count;
+    uint32_t offset;        /* First free byte after last datagram */
+    uint16_t index[NCM_NTB_MAX_DATAGRAMS];
+    uint16_t length[NCM_NTB_MAX_DATAGRAMS];
+};
+
+typedef struct ncm_ntb_builder ncm_ntb_builder_t;
+
+/* Called for every datagram found by ncm_ntb_parse */
+typedef void (*ncm_datagram_cb_t)(void *arg, const uint8_t *datagram, uint16_t length);
+
+/*
+ * @brief Starts new NTB in buffer
+ * @param size usable bytes, up to 65535 for 16 bit NTB
+ * @param divisor datagram alignment modulus, 0 or 1 for no alignment
+ */
+void ncm_ntb_init(ncm_ntb_builder_t *ntb, uint8_t *buffer, uint32_t size,
+        uint16_t divisor, uint16_t remainder, uint16_t sequence);
+
+/*
+ * @brief Reserves place for datagram, so it can be written in place
+ * @return pointer to datagram storage, NULL if it doesn't fit into NTB
+ */
+uint8_t *ncm_ntb_alloc(ncm_ntb_builder_t *ntb, uint16_t length);
+
+/*
+ * @brief Copies datagram into NTB
+ * @return 0 on success, -ENOSPC if NTB is full, -EINVAL for empty datagram
+ */
+int ncm_ntb_add(ncm_ntb_builder_t *ntb, const void *datagram, uint16_t length);
+
+/*
+ * @brief Writes NTB header and datagram pointer table
+ * @return length of the NTB to be sent, 0 if there is no datagram
+ */
+uint32_t ncm_ntb_finalize(ncm_ntb_builder_t *ntb);
+
+static inline uint16_t ncm_ntb_count(const ncm_ntb_builder_t *ntb)
+{
+    return ntb->count;
+}
+
+/*
+ * @brief Validates received NTB16 and passes every datagram to callback
+ * @param length number of bytes received in transfer
+ * @return number of datagrams, -EBADMSG if NTB is malformed. Datagrams
+ *         preceding malformed entry are already delivered.
+ */
+int ncm_ntb_parse(const uint8_t *buffer, uint32_t length, ncm_datagram_cb_t cb, void *arg);
+
+#endif /* _NCM_NTB_H */
@@ -0,0 +1,380 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <string.h>
+#include <errno.h>
+#include "ncm_function.h"
+
+#define NTB_SIZE (4096)
+
+/* Simulated endpoints: record what function armed, completions are
+ * triggered explicitly by test */
+struct endpoint
+{
+    uint8_t *buffer;
+    uint32_t length;
+    int armed;
+    int fail;
+};
+
+static struct endpoint bulk_in, bulk_out, intr_in;
+static int datagrams;
+static uint16_t last_datagram_length;
+
+static uint8_t tx[2][NTB_SIZE];
+static uint8_t rx[NTB_SIZE];
+static uint8_t control[NCM_CONTROL_BUFFER_SIZE];
+static uint8_t notify[NCM_NOTIFY_BUFFER_SIZE];
+static struct ncm_function ncm;
+
+/* Test lock runs the other context right before it is taken, which is the
+ * only interleaving a real lock allows */
+static int lock_depth;
+static int unlocked_transfers;
+static void (*preempt)(void);
+
+static int arm(struct endpoint *ep, uint8_t *buffer, uint32_t length)
+{
+    if (ep->fail || ep->armed)
+        return -EBUSY;
+    ep->buffer = buffer;
+    ep->length = length;
+    ep->armed++;
+    return 0;
+}
+
+static int ep_send(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    (void)ctx;
+    if (!lock_depth)
+        unlocked_transfers++;
+    return arm(&bulk_in, buffer, length);
+}
+
+static int ep_recv(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    (void)ctx;
+    return arm(&bulk_out, buffer, length);
+}
+
+static int ep_notify(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    (void)ctx;
+    if (!lock_depth)
+        unlocked_transfers++;
+    return arm(&intr_in, buffer, length);
+}
+
+static void on_datagram(void *ctx, const uint8_t *datagram, uint16_t length)
+{
+    (void)ctx;
+    (void)datagram;
+    datagrams++;
+    last_datagram_length = length;
+}
+
+static void op_lock(void *ctx)
+{
+    void (*other)(void) = preempt;
+
+    (void)ctx;
+    if (other && !lock_depth) {
+        preempt = NULL;
+        other();
+    }
+    lock_depth++;
+}
+
+static void op_unlock(void *ctx)
+{
+    (void)ctx;
+    lock_depth--;
+}
+
+static const struct ncm_function_ops ops = {
+    .send = ep_send,
+    .recv = ep_recv,
+    .notify = ep_notify,
+    .datagram = on_datagram,
+    .lock = op_lock,
+    .unlock = op_unlock,
+};
+
+
+static int sent;
+static void count(void *arg, const uint8_t *datagram, uint16_t length)
+{
+    (void)arg;
+    (void)datagram;
+    (void)length;
+    sent++;
+}
+
+/* Completes bulk IN transfer and returns number of datagrams it carried */
+static int complete_bulk_in(void)
+{
+    int ret;
+
+    sent = 0;
+    ret = ncm_ntb_parse(bulk_in.buffer, bulk_in.length, count, NULL);
+    bulk_in.armed = 0;
+    ncm_function_tx_complete(&ncm);
+    return (ret < 0) ? ret : sent;
+}
+
+static int preempted_with;
+static void complete_in_flight(void)
+{
+    preempted_with = complete_bulk_in();
+}
+
+Describe(ncm_function);
+
+BeforeEach(ncm_function)
+{
+    struct ncm_function_buffers buffers = {
+        .tx = { tx[0], tx[1] },
+        .tx_size = NTB_SIZE,
+        .rx = rx,
+        .rx_size = NTB_SIZE,
+        .control = control,
+        .notify = notify,
+    };
+
+    memset(&bulk_in, 0, sizeof(bulk_in));
+    memset(&bulk_out, 0, sizeof(bulk_out));
+    memset(&intr_in, 0, sizeof(intr_in));
+    datagrams = 0;
+    lock_depth = 0;
+    unlocked_transfers = 0;
+    preempt = NULL;
+    preempted_with = 0;
+    assert_that(ncm_function_init(&ncm, &ops, NULL, &buffers, 2), is_equal_to(0));
+}
+
+AfterEach(ncm_function)
+{
+    assert_that(lock_depth, is_equal_to(0));
+    assert_that(unlocked_transfers, is_equal_to(0));
+}
+
+Ensure(ncm_function, init_rejects_small_buffers)
+{
+    struct ncm_function_buffers buffers = {
+        .tx = { tx[0], tx[1] },
+        .tx_size = 1024,
+        .rx = rx,
+        .rx_size = NTB_SIZE,
+        .control = control,
+        .notify = notify,
+    };
+
+    assert_that(ncm_function_init(&ncm, &ops, NULL, &buffers, 2), is_equal_to(-EINVAL));
+}
+
+Ensure(ncm_function, get_ntb_parameters)
+{
+    uint8_t *buffer = NULL;
+    uint32_t length = 255;
+
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_GET_NTB_PARAMETERS, 0, &buffer, &length, 1),
+            is_equal_to(0));
+    assert_that(length, is_equal_to(NCM_NTB_PARAMETERS_LENGTH));
+    assert_that(buffer[0], is_equal_to(NCM_NTB_PARAMETERS_LENGTH));
+    assert_that(buffer[2], is_equal_to(NCM_NTB_FORMATS_SUPPORTED));
+    assert_that(buffer[4] | (buffer[5] << 8), is_equal_to(NTB_SIZE));
+    assert_that(buffer[16] | (buffer[17] << 8), is_equal_to(NTB_SIZE));
+}
+
+Ensure(ncm_function, reply_is_trimmed_to_requested_length)
+{
+    uint8_t *buffer = NULL;
+    uint32_t length = 8;
+
+    ncm_function_request(&ncm, NCM_REQUEST_GET_NTB_PARAMETERS, 0, &buffer, &length, 1);
+    assert_that(length, is_equal_to(8));
+}
+
+Ensure(ncm_function, only_16bit_ntb_format_is_accepted)
+{
+    uint8_t *buffer = NULL;
+    uint32_t length = 0;
+
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_FORMAT, 0, &buffer, &length, 1),
+            is_equal_to(0));
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_FORMAT, 1, &buffer, &length, 1),
+            is_equal_to(-EINVAL));
+}
+
+Ensure(ncm_function, set_ntb_input_size)
+{
+    uint8_t *buffer = NULL;
+    uint32_t length = 4;
+
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_INPUT_SIZE, 0, &buffer, &length, 1),
+            is_equal_to(0));
+    assert_that(buffer, is_equal_to(control));
+    memcpy(buffer, (uint8_t[]){ 0x00, 0x08, 0x00, 0x00 }, 4);
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_INPUT_SIZE, 0, &buffer, &length, 0),
+            is_equal_to(0));
+
+    length = 4;
+    ncm_function_request(&ncm, NCM_REQUEST_GET_NTB_INPUT_SIZE, 0, &buffer, &length, 1);
+    assert_that(buffer[0] | (buffer[1] << 8), is_equal_to(2048));
+}
+
+Ensure(ncm_function, set_ntb_input_size_out_of_range_is_rejected)
+{
+    uint8_t *buffer = control;
+    uint32_t length = 4;
+
+    memcpy(buffer, (uint8_t[]){ 0x00, 0x04, 0x00, 0x00 }, 4);
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_INPUT_SIZE, 0, &buffer, &length, 0),
+            is_equal_to(-EINVAL));
+    memcpy(buffer, (uint8_t[]){ 0x00, 0x00, 0x01, 0x00 }, 4);
+    assert_that(ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_INPUT_SIZE, 0, &buffer, &length, 0),
+            is_equal_to(-EINVAL));
+}
+
+Ensure(ncm_function, unknown_request_is_rejected)
+{
+    uint8_t *buffer = NULL;
+    uint32_t length = 0;
+
+    assert_that(ncm_function_request(&ncm, 0x87, 0, &buffer, &length, 1), is_equal_to(-EINVAL));
+}
+
+Ensure(ncm_function, activate_arms_rx_and_notifies_host)
+{
+    ncm_function_activate(&ncm, 480000000);
+
+    assert_that(bulk_out.armed, is_equal_to(1));
+    assert_that(bulk_out.length, is_equal_to(NTB_SIZE));
+    assert_that(intr_in.length, is_equal_to(16));
+    assert_that(intr_in.buffer[1], is_equal_to(NCM_NOTIFY_CONNECTION_SPEED_CHANGE));
+    assert_that(intr_in.buffer[4], is_equal_to(2));
+
+    intr_in.armed = 0;
+    ncm_function_notify_complete(&ncm);
+    assert_that(intr_in.length, is_equal_to(8));
+    assert_that(intr_in.buffer[1], is_equal_to(NCM_NOTIFY_NETWORK_CONNECTION));
+    assert_that(intr_in.buffer[2], is_equal_to(1));
+
+    intr_in.armed = 0;
+    ncm_function_notify_complete(&ncm);
+    assert_that(intr_in.armed, is_equal_to(0));
+}
+
+Ensure(ncm_function, send_before_activation_fails)
+{
+    assert_that(ncm_function_send(&ncm, "abc", 3), is_equal_to(-ENOTCONN));
+    assert_that(bulk_in.armed, is_equal_to(0));
+}
+
+Ensure(ncm_function, datagram_is_sent_right_away_on_idle_endpoint)
+{
+    ncm_function_activate(&ncm, 480000000);
+
+    assert_that(ncm_function_send(&ncm, "abc", 3), is_equal_to(0));
+    assert_that(bulk_in.armed, is_equal_to(1));
+    assert_that(complete_bulk_in(), is_equal_to(1));
+    assert_that(bulk_in.armed, is_equal_to(0));
+}
+
+Ensure(ncm_function, datagrams_are_aggregated_while_endpoint_is_busy)
+{
+    uint8_t *first;
+    int i;
+
+    ncm_function_activate(&ncm, 480000000);
+    ncm_function_send(&ncm, "abc", 3);
+    first = bulk_in.buffer;
+
+    for (i = 0; i < 5; i++)
+        assert_that(ncm_function_send(&ncm, "abcdef", 6), is_equal_to(0));
+
+    assert_that(complete_bulk_in(), is_equal_to(1));
+    assert_that(bulk_in.armed, is_equal_to(1));
+    assert_that(bulk_in.buffer, is_not_equal_to(first));
+    assert_that(complete_bulk_in(), is_equal_to(5));
+    assert_that(ncm.stats.tx_ntbs, is_equal_to(2));
+    assert_that(ncm.stats.tx_datagrams, is_equal_to(6));
+}
+
+Ensure(ncm_function, completion_racing_sender_is_serialized)
+{
+    ncm_function_activate(&ncm, 480000000);
+    ncm_function_send(&ncm, "abc", 3);
+    ncm_function_send(&ncm, "abcdef", 6);
+
+    /* NTB in flight completes while next datagram is being sent */
+    preempt = complete_in_flight;
+    assert_that(ncm_function_send(&ncm, "abcdefgh", 8), is_equal_to(0));
+    assert_that(preempted_with, is_equal_to(1));
+    assert_that(bulk_in.armed, is_equal_to(1));
+
+    assert_that(complete_bulk_in(), is_equal_to(1));
+    assert_that(complete_bulk_in(), is_equal_to(1));
+    assert_that(bulk_in.armed, is_equal_to(0));
+    assert_that(ncm.stats.tx_ntbs, is_equal_to(3));
+    assert_that(ncm.stats.tx_datagrams, is_equal_to(3));
+    assert_that(ncm.stats.tx_dropped, is_equal_to(0));
+}
+
+Ensure(ncm_function, full_ntb_with_busy_endpoint_drops_datagram)
+{
+    uint8_t datagram[1514] = { 0 };
+
+    ncm_function_activate(&ncm, 480000000);
+    ncm_function_send(&ncm, datagram, sizeof(datagram));
+    assert_that(ncm_function_send(&ncm, datagram, sizeof(datagram)), is_equal_to(0));
+    assert_that(ncm_function_send(&ncm, datagram, sizeof(datagram)), is_equal_to(0));
+    assert_that(ncm_function_send(&ncm, datagram, sizeof(datagram)), is_equal_to(-ENOSPC));
+    assert_that(ncm.stats.tx_dropped, is_equal_to(1));
+}
+
+Ensure(ncm_function, received_ntb_is_delivered_and_rx_rearmed)
+{
+    ncm_ntb_builder_t ntb;
+    uint32_t length;
+
+    ncm_function_activate(&ncm, 480000000);
+    ncm_ntb_init(&ntb, rx, sizeof(rx), 4, 0, 0);
+    ncm_ntb_add(&ntb, "hello", 5);
+    ncm_ntb_add(&ntb, "world!", 6);
+    length = ncm_ntb_finalize(&ntb);
+
+    bulk_out.armed = 0;
+    ncm_function_rx_complete(&ncm, length);
+    assert_that(datagrams, is_equal_to(2));
+    assert_that(last_datagram_length, is_equal_to(6));
+    assert_that(bulk_out.armed, is_equal_to(1));
+}
+
+Ensure(ncm_function, malformed_ntb_is_counted)
+{
+    ncm_function_activate(&ncm, 480000000);
+    memset(rx, 0, 64);
+
+    bulk_out.armed = 0;
+    ncm_function_rx_complete(&ncm, 64);
+    assert_that(datagrams, is_equal_to(0));
+    assert_that(ncm.stats.rx_errors, is_equal_to(1));
+    assert_that(bulk_out.armed, is_equal_to(1));
+}
+
+Ensure(ncm_function, deactivate_restores_defaults)
+{
+    uint8_t *buffer = control;
+    uint32_t length = 4;
+
+    memcpy(buffer, (uint8_t[]){ 0x00, 0x08, 0x00, 0x00 }, 4);
+    ncm_function_request(&ncm, NCM_REQUEST_SET_NTB_INPUT_SIZE, 0, &buffer, &length, 0);
+    ncm_function_activate(&ncm, 480000000);
+    ncm_function_deactivate(&ncm);
+
+    length = 4;
+    ncm_function_request(&ncm, NCM_REQUEST_GET_NTB_INPUT_SIZE, 0, &buffer, &length, 1);
+    assert_that(buffer[0] | (buffer[1] << 8), is_equal_to(NTB_SIZE));
+    assert_that(ncm_function_send(&ncm, "abc", 3), is_equal_to(-ENOTCONN));
+}
@@ -0,0 +1,171 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <string.h>
+#include <errno.h>
+#include "ncm_ntb.h"
+
+#define NTB_SIZE (2048)
+
+static uint8_t buffer[NTB_SIZE];
+static ncm_ntb_builder_t ntb;
+
+static const uint8_t received[] = {
+    /* NTH16, block length 44, NDP at 24 */
+    0x4e, 0x43, 0x4d, 0x48, 0x0c, 0x00, 0x07, 0x00, 0x2c, 0x00, 0x18, 0x00,
+    /* datagrams */
+    0x01, 0x02, 0x03, 0x00, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x00, 0x00, 0x00,
+    /* NDP16 */
+    0x4e, 0x43, 0x4d, 0x30, 0x14, 0x00, 0x00, 0x00,
+    0x0c, 0x00, 0x03, 0x00, 0x10, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static int delivered;
+static uint16_t delivered_length[4];
+static const uint8_t *delivered_data[4];
+
+static void collect(void *arg, const uint8_t *datagram, uint16_t length)
+{
+    (void)arg;
+    if (delivered < 4) {
+        delivered_data[delivered] = datagram;
+        delivered_length[delivered] = length;
+    }
+    delivered++;
+}
+
+Describe(ncm_ntb);
+
+BeforeEach(ncm_ntb)
+{
+    memset(buffer, 0xA5, sizeof(buffer));
+    ncm_ntb_init(&ntb, buffer, sizeof(buffer), 4, 0, 7);
+    delivered = 0;
+}
+
+AfterEach(ncm_ntb)
+{
+}
+
+Ensure(ncm_ntb, empty_ntb_is_not_finalized)
+{
+    assert_that(ncm_ntb_finalize(&ntb), is_equal_to(0));
+}
+
+Ensure(ncm_ntb, empty_datagram_is_rejected)
+{
+    assert_that(ncm_ntb_add(&ntb, "", 0), is_equal_to(-EINVAL));
+}
+
+Ensure(ncm_ntb, builds_same_ntb_as_received_one)
+{
+    const uint8_t first[] = { 0x01, 0x02, 0x03 };
+    const uint8_t second[] = { 0x0a, 0x0b, 0x0c, 0x0d, 0x0e };
+
+    assert_that(ncm_ntb_add(&ntb, first, sizeof(first)), is_equal_to(0));
+    assert_that(ncm_ntb_add(&ntb, second, sizeof(second)), is_equal_to(0));
+    assert_that(ncm_ntb_count(&ntb), is_equal_to(2));
+    assert_that(ncm_ntb_finalize(&ntb), is_equal_to(sizeof(received)));
+    assert_that(buffer, is_equal_to_contents_of(received, sizeof(received)));
+}
+
+Ensure(ncm_ntb, datagrams_are_aligned_to_divisor_and_remainder)
+{
+    ncm_ntb_init(&ntb, buffer, sizeof(buffer), 4, 2, 0);
+
+    assert_that(ncm_ntb_alloc(&ntb, 1) - buffer, is_equal_to(14));
+    assert_that(ncm_ntb_alloc(&ntb, 1) - buffer, is_equal_to(18));
+}
+
+Ensure(ncm_ntb, full_ntb_reports_no_space)
+{
+    uint8_t datagram[1514] = { 0 };
+
+    assert_that(ncm_ntb_add(&ntb, datagram, sizeof(datagram)), is_equal_to(0));
+    assert_that(ncm_ntb_add(&ntb, datagram, sizeof(datagram)), is_equal_to(-ENOSPC));
+    assert_that(ncm_ntb_count(&ntb), is_equal_to(1));
+    assert_that(ncm_ntb_finalize(&ntb), is_less_than(NTB_SIZE + 1));
+}
+
+Ensure(ncm_ntb, datagram_count_is_limited)
+{
+    int i;
+
+    for (i = 0; i < NCM_NTB_MAX_DATAGRAMS; i++)
+        assert_that(ncm_ntb_add(&ntb, "x", 1), is_equal_to(0));
+    assert_that(ncm_ntb_add(&ntb, "x", 1), is_equal_to(-ENOSPC));
+}
+
+Ensure(ncm_ntb, parse_delivers_datagrams)
+{
+    assert_that(ncm_ntb_parse(received, sizeof(received), collect, NULL), is_equal_to(2));
+    assert_that(delivered_length[0], is_equal_to(3));
+    assert_that(delivered_data[0], is_equal_to(&received[12]));
+    assert_that(delivered_length[1], is_equal_to(5));
+    assert_that(delivered_data[1], is_equal_to(&received[16]));
+}
+
+Ensure(ncm_ntb, parse_roundtrip)
+{
+    uint8_t datagram[100];
+    uint32_t length;
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        memset(datagram, i, sizeof(datagram));
+        assert_that(ncm_ntb_add(&ntb, datagram, 60 + i), is_equal_to(0));
+    }
+    length = ncm_ntb_finalize(&ntb);
+
+    assert_that(ncm_ntb_parse(buffer, length, collect, NULL), is_equal_to(10));
+    assert_that(delivered_length[3], is_equal_to(63));
+    assert_that(delivered_data[3][0], is_equal_to(3));
+}
+
+Ensure(ncm_ntb, parse_rejects_bad_signature)
+{
+    uint8_t ntb_copy[sizeof(received)];
+
+    memcpy(ntb_copy, received, sizeof(received));
+    ntb_copy[3] = 'X';
+    assert_that(ncm_ntb_parse(ntb_copy, sizeof(ntb_copy), collect, NULL), is_equal_to(-EBADMSG));
+
+    memcpy(ntb_copy, received, sizeof(received));
+    ntb_copy[27] = '1';
+    assert_that(ncm_ntb_parse(ntb_copy, sizeof(ntb_copy), collect, NULL), is_equal_to(-EBADMSG));
+    assert_that(delivered, is_equal_to(0));
+}
+
+Ensure(ncm_ntb, parse_rejects_truncated_transfer)
+{
+    assert_that(ncm_ntb_parse(received, sizeof(received) - 1, collect, NULL), is_equal_to(-EBADMSG));
+    assert_that(ncm_ntb_parse(received, 8, collect, NULL), is_equal_to(-EBADMSG));
+}
+
+Ensure(ncm_ntb, parse_rejects_datagram_out_of_block)
+{
+    uint8_t ntb_copy[sizeof(received)];
+
+    memcpy(ntb_copy, received, sizeof(received));
+    ntb_copy[38] = 0x20; /* second datagram length */
+    assert_that(ncm_ntb_parse(ntb_copy, sizeof(ntb_copy), collect, NULL), is_equal_to(-EBADMSG));
+    assert_that(delivered, is_equal_to(1));
+}
+
+Ensure(ncm_ntb, parse_rejects_ndp_loop)
+{
+    uint8_t ntb_copy[sizeof(received)];
+
+    memcpy(ntb_copy, received, sizeof(received));
+    ntb_copy[30] = 0x18; /* wNextNdpIndex points to itself */
+    assert_that(ncm_ntb_parse(ntb_copy, sizeof(ntb_copy), collect, NULL), is_equal_to(-EBADMSG));
+}
+
+Ensure(ncm_ntb, zero_block_length_uses_transfer_length)
+{
+    uint8_t ntb_copy[sizeof(received)];
+
+    memcpy(ntb_copy, received, sizeof(received));
+    ntb_copy[8] = 0;
+    assert_that(ncm_ntb_parse(ntb_copy, sizeof(ntb_copy), collect, NULL), is_equal_to(2));
+}
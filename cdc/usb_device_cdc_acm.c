@@ -23,10 +23,10 @@
  * Definitions
  ******************************************************************************/
 #define USB_CDC_ACM_ENTER_CRITICAL() \
-    OSA_SR_ALLOC();              \
-    OSA_ENTER_CRITICAL()
+    USB_OSA_SR_ALLOC();              \
+    USB_OSA_ENTER_CRITICAL()
 
-#define USB_CDC_ACM_EXIT_CRITICAL() OSA_EXIT_CRITICAL()
+#define USB_CDC_ACM_EXIT_CRITICAL() USB_OSA_EXIT_CRITICAL()
 
 #include "log.hpp"
 /*******************************************************************************
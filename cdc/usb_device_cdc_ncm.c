@@ -0,0 +1,690 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "usb_device_config.h"
+#include "usb.h"
+#include "usb_device.h"
+
+#include "usb_device_class.h"
+
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+#include "usb_device_cdc_ncm.h"
+
+/*******************************************************************************
+ * Variables
+ ******************************************************************************/
+/* CDC NCM device instance */
+
+USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE)
+    usb_device_cdc_ncm_struct_t g_cdcNcmHandle[USB_DEVICE_CONFIG_CDC_NCM_MAX_INSTANCE];
+
+/*******************************************************************************
+ * Code
+ ******************************************************************************/
+
+/*!
+ * @brief Allocates the CDC NCM device handle.
+ *
+ * @param handle The class handle of the CDC NCM class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmAllocateHandle(usb_device_cdc_ncm_struct_t **handle)
+{
+    uint32_t count;
+    for (count = 0; count < USB_DEVICE_CONFIG_CDC_NCM_MAX_INSTANCE; count++)
+    {
+        if (NULL == g_cdcNcmHandle[count].handle)
+        {
+            *handle = &g_cdcNcmHandle[count];
+            return kStatus_USB_Success;
+        }
+    }
+
+    return kStatus_USB_Busy;
+}
+
+/*!
+ * @brief Frees the CDC NCM device handle.
+ *
+ * @param handle The class handle of the CDC NCM class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmFreeHandle(usb_device_cdc_ncm_struct_t *handle)
+{
+    handle->handle        = NULL;
+    handle->configStruct  = NULL;
+    handle->configuration = 0;
+    handle->dataAlternate = 0;
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Passes endpoint event to the class callback.
+ *
+ * @param cdcNcmHandle The class handle of the CDC NCM class.
+ * @param pipe The pipe which completed the transfer.
+ * @param event The CDC NCM class event reported to the application.
+ * @param message The pointer to the message of the endpoint callback.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmPipeDone(usb_device_cdc_ncm_struct_t *cdcNcmHandle,
+                                             usb_device_cdc_ncm_pipe_t *pipe,
+                                             uint32_t event,
+                                             usb_device_endpoint_callback_message_struct_t *message)
+{
+    usb_status_t error = kStatus_USB_Error;
+
+    pipe->isBusy = 0;
+
+    if ((NULL != cdcNcmHandle->configStruct) && (cdcNcmHandle->configStruct->classCallback))
+    {
+        /*classCallback is initialized in classInit of s_UsbDeviceClassInterfaceMap,
+        it is from the second parameter of classInit */
+        error = cdcNcmHandle->configStruct->classCallback(event, message,
+                                                          cdcNcmHandle->configStruct->classCalbackArg);
+    }
+    return error;
+}
+
+/*!
+ * @brief Responds to the interrupt in endpoint event.
+ */
+static usb_status_t USB_DeviceCdcNcmInterruptIn(usb_device_handle handle,
+                                                usb_device_endpoint_callback_message_struct_t *message,
+                                                void *callbackParam)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)callbackParam;
+
+    if (!cdcNcmHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    return USB_DeviceCdcNcmPipeDone(cdcNcmHandle, &cdcNcmHandle->interruptIn, kUSB_DeviceCdcNcmEventNotifyResponse,
+                                    message);
+}
+
+/*!
+ * @brief Responds to the bulk in endpoint event.
+ */
+static usb_status_t USB_DeviceCdcNcmBulkIn(usb_device_handle handle,
+                                           usb_device_endpoint_callback_message_struct_t *message,
+                                           void *callbackParam)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)callbackParam;
+
+    if (!cdcNcmHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    return USB_DeviceCdcNcmPipeDone(cdcNcmHandle, &cdcNcmHandle->bulkIn, kUSB_DeviceCdcNcmEventSendResponse, message);
+}
+
+/*!
+ * @brief Responds to the bulk out endpoint event.
+ */
+static usb_status_t USB_DeviceCdcNcmBulkOut(usb_device_handle handle,
+                                            usb_device_endpoint_callback_message_struct_t *message,
+                                            void *callbackParam)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)callbackParam;
+
+    if (!cdcNcmHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    return USB_DeviceCdcNcmPipeDone(cdcNcmHandle, &cdcNcmHandle->bulkOut, kUSB_DeviceCdcNcmEventRecvResponse, message);
+}
+
+/*!
+ * @brief Finds interface of given class with given alternate setting in current configuration.
+ *
+ * @param cdcNcmHandle The class handle of the CDC NCM class.
+ * @param classCode Communication or data class code.
+ * @param alternate The alternate setting.
+ * @param interfaceNumber Out parameter, number of the interface.
+ * @return Interface structure, NULL if not found.
+ */
+static usb_device_interface_struct_t *USB_DeviceCdcNcmFindInterface(usb_device_cdc_ncm_struct_t *cdcNcmHandle,
+                                                                    uint8_t classCode,
+                                                                    uint8_t alternate,
+                                                                    uint8_t *interfaceNumber)
+{
+    usb_device_interface_list_t *interfaceList;
+    uint32_t count;
+    uint32_t index;
+
+    /* return error when configuration is invalid (0 or more than the configuration number) */
+    if ((cdcNcmHandle->configuration == 0U) ||
+        (cdcNcmHandle->configuration > cdcNcmHandle->configStruct->classInfomation->configurations))
+    {
+        return NULL;
+    }
+
+    interfaceList = &cdcNcmHandle->configStruct->classInfomation->interfaceList[cdcNcmHandle->configuration - 1];
+
+    for (count = 0; count < interfaceList->count; count++)
+    {
+        if (classCode == interfaceList->interfaces[count].classCode)
+        {
+            *interfaceNumber = interfaceList->interfaces[count].interfaceNumber;
+            for (index = 0; index < interfaceList->interfaces[count].count; index++)
+            {
+                if (interfaceList->interfaces[count].interface[index].alternateSetting == alternate)
+                {
+                    return &interfaceList->interfaces[count].interface[index];
+                }
+            }
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Initializes all endpoints of the interface.
+ *
+ * Bulk in endpoint has automatic zero length packet enabled, NTB which ends on packet boundary would not be
+ * terminated otherwise.
+ *
+ * @param cdcNcmHandle The class handle of the CDC NCM class.
+ * @param interface The interface which endpoints are initialized.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmInterfaceEndpointsInit(usb_device_cdc_ncm_struct_t *cdcNcmHandle,
+                                                           usb_device_interface_struct_t *interface)
+{
+    usb_status_t error = kStatus_USB_Success;
+    uint32_t count;
+
+    for (count = 0; count < interface->endpointList.count; count++)
+    {
+        usb_device_endpoint_init_struct_t epInitStruct;
+        usb_device_endpoint_callback_struct_t epCallback;
+        usb_device_cdc_ncm_pipe_t *pipe;
+        uint8_t direction;
+
+        epInitStruct.zlt             = 0;
+        epInitStruct.interval        = interface->endpointList.endpoint[count].interval;
+        epInitStruct.endpointAddress = interface->endpointList.endpoint[count].endpointAddress;
+        epInitStruct.maxPacketSize   = interface->endpointList.endpoint[count].maxPacketSize;
+        epInitStruct.transferType    = interface->endpointList.endpoint[count].transferType;
+
+        direction = (epInitStruct.endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                    USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
+
+        if ((USB_IN == direction) && (USB_ENDPOINT_INTERRUPT == epInitStruct.transferType))
+        {
+            pipe                  = &cdcNcmHandle->interruptIn;
+            epCallback.callbackFn = USB_DeviceCdcNcmInterruptIn;
+        }
+        else if ((USB_IN == direction) && (USB_ENDPOINT_BULK == epInitStruct.transferType))
+        {
+            pipe                  = &cdcNcmHandle->bulkIn;
+            epCallback.callbackFn = USB_DeviceCdcNcmBulkIn;
+            epInitStruct.zlt      = 1;
+        }
+        else if ((USB_OUT == direction) && (USB_ENDPOINT_BULK == epInitStruct.transferType))
+        {
+            pipe                  = &cdcNcmHandle->bulkOut;
+            epCallback.callbackFn = USB_DeviceCdcNcmBulkOut;
+        }
+        else
+        {
+            continue;
+        }
+        pipe->ep                 = (epInitStruct.endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_NUMBER_MASK);
+        pipe->isBusy             = 0;
+        epCallback.callbackParam = cdcNcmHandle;
+
+        error = USB_DeviceInitEndpoint(cdcNcmHandle->handle, &epInitStruct, &epCallback);
+        if (kStatus_USB_Success != error)
+        {
+            return error;
+        }
+    }
+    return error;
+}
+
+/*!
+ * @brief De-initializes all endpoints of the interface.
+ */
+static usb_status_t USB_DeviceCdcNcmInterfaceEndpointsDeinit(usb_device_cdc_ncm_struct_t *cdcNcmHandle,
+                                                             usb_device_interface_struct_t *interface)
+{
+    usb_status_t error = kStatus_USB_Success;
+    uint32_t count;
+
+    for (count = 0; count < interface->endpointList.count; count++)
+    {
+        error = USB_DeviceDeinitEndpoint(cdcNcmHandle->handle, interface->endpointList.endpoint[count].endpointAddress);
+    }
+    return error;
+}
+
+/*!
+ * @brief Selects data interface alternate setting.
+ *
+ * Alternate setting 0 has no endpoints, selecting it resets the function. Alternate setting 1 enables data
+ * endpoints.
+ *
+ * @param cdcNcmHandle The class handle of the CDC NCM class.
+ * @param alternate The alternate setting of the data interface.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmSetDataAlternate(usb_device_cdc_ncm_struct_t *cdcNcmHandle, uint8_t alternate)
+{
+    usb_device_interface_struct_t *interface;
+    usb_status_t error = kStatus_USB_Success;
+
+    if (cdcNcmHandle->dataInterfaceHandle)
+    {
+        USB_DeviceCdcNcmInterfaceEndpointsDeinit(cdcNcmHandle, cdcNcmHandle->dataInterfaceHandle);
+        cdcNcmHandle->dataInterfaceHandle = NULL;
+    }
+
+    interface = USB_DeviceCdcNcmFindInterface(cdcNcmHandle, USB_DEVICE_CDC_NCM_DATA_CLASS_CODE, alternate,
+                                              &cdcNcmHandle->dataInterfaceNumber);
+    if (!interface)
+    {
+        return kStatus_USB_InvalidRequest;
+    }
+    cdcNcmHandle->dataAlternate = alternate;
+    if (interface->endpointList.count)
+    {
+        cdcNcmHandle->dataInterfaceHandle = interface;
+        error                             = USB_DeviceCdcNcmInterfaceEndpointsInit(cdcNcmHandle, interface);
+    }
+
+    if ((kStatus_USB_Success == error) && (cdcNcmHandle->configStruct->classCallback))
+    {
+        error = cdcNcmHandle->configStruct->classCallback(kUSB_DeviceCdcNcmEventDataInterfaceChanged, &alternate,
+                                                          cdcNcmHandle->configStruct->classCalbackArg);
+    }
+    return error;
+}
+
+/*!
+ * @brief Initializes communication interface endpoints and data interface in alternate setting 0.
+ *
+ * @param cdcNcmHandle The class handle of the CDC NCM class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmEndpointsInit(usb_device_cdc_ncm_struct_t *cdcNcmHandle)
+{
+    usb_device_interface_struct_t *interface;
+    usb_status_t error;
+
+    interface = USB_DeviceCdcNcmFindInterface(cdcNcmHandle, USB_DEVICE_CDC_NCM_COMM_CLASS_CODE, 0,
+                                              &cdcNcmHandle->commInterfaceNumber);
+    if (!interface)
+    {
+        return kStatus_USB_Error;
+    }
+    cdcNcmHandle->commInterfaceHandle = interface;
+    error                             = USB_DeviceCdcNcmInterfaceEndpointsInit(cdcNcmHandle, interface);
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+    return USB_DeviceCdcNcmSetDataAlternate(cdcNcmHandle, 0);
+}
+
+/*!
+ * @brief De-initializes the endpoints in CDC NCM class.
+ *
+ * @param cdcNcmHandle The class handle of the CDC NCM class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceCdcNcmEndpointsDeinit(usb_device_cdc_ncm_struct_t *cdcNcmHandle)
+{
+    usb_status_t error = kStatus_USB_Error;
+
+    if (cdcNcmHandle->commInterfaceHandle)
+    {
+        error = USB_DeviceCdcNcmInterfaceEndpointsDeinit(cdcNcmHandle, cdcNcmHandle->commInterfaceHandle);
+    }
+    if (cdcNcmHandle->dataInterfaceHandle)
+    {
+        error = USB_DeviceCdcNcmInterfaceEndpointsDeinit(cdcNcmHandle, cdcNcmHandle->dataInterfaceHandle);
+    }
+    cdcNcmHandle->commInterfaceHandle = NULL;
+    cdcNcmHandle->dataInterfaceHandle = NULL;
+
+    return error;
+}
+
+/*!
+ * @brief Checks whether endpoint belongs to CDC NCM function.
+ */
+static uint8_t USB_DeviceCdcNcmOwnsEndpoint(usb_device_cdc_ncm_struct_t *cdcNcmHandle, uint8_t endpointAddress)
+{
+    usb_device_interface_struct_t *interfaces[] = {cdcNcmHandle->commInterfaceHandle,
+                                                   cdcNcmHandle->dataInterfaceHandle};
+    uint32_t count;
+
+    for (uint32_t i = 0; i < sizeof(interfaces) / sizeof(interfaces[0]); i++)
+    {
+        if (!interfaces[i])
+        {
+            continue;
+        }
+        for (count = 0; count < interfaces[i]->endpointList.count; count++)
+        {
+            if (endpointAddress == interfaces[i]->endpointList.endpoint[count].endpointAddress)
+            {
+                return 1U;
+            }
+        }
+    }
+    return 0U;
+}
+
+/*!
+ * @brief Handles the CDC NCM class event.
+ *
+ * This function responses to various events including the common device events and the class specific events.
+ * Class specific requests are passed to the application, NCM function logic lives above the class driver.
+ *
+ * @param handle The class handle of the CDC NCM class.
+ * @param event The event type.
+ * @param param The parameter of the event.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceCdcNcmEvent(void *handle, uint32_t event, void *param)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle;
+    usb_device_cdc_ncm_request_param_struct_t reqParam;
+    usb_status_t error = kStatus_USB_Error;
+    uint16_t interfaceAlternate;
+    uint8_t *temp8;
+
+    if ((!param) || (!handle))
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)handle;
+
+    switch (event)
+    {
+        case kUSB_DeviceClassEventDeviceReset:
+            /* Bus reset, clear the configuration. */
+            cdcNcmHandle->configuration = 0;
+            cdcNcmHandle->dataAlternate = 0;
+            break;
+        case kUSB_DeviceClassEventSetConfiguration:
+            temp8 = ((uint8_t *)param);
+            if (!cdcNcmHandle->configStruct)
+            {
+                break;
+            }
+            if (*temp8 == cdcNcmHandle->configuration)
+            {
+                break;
+            }
+
+            error                       = USB_DeviceCdcNcmEndpointsDeinit(cdcNcmHandle);
+            cdcNcmHandle->configuration = *temp8;
+            error                       = USB_DeviceCdcNcmEndpointsInit(cdcNcmHandle);
+            if (kStatus_USB_Success != error)
+            {
+#ifdef DEBUG
+                usb_echo("kUSB_DeviceClassEventSetConfiguration, USB_DeviceInitEndpoint fail\r\n");
+#endif
+            }
+            break;
+        case kUSB_DeviceClassEventSetInterface:
+            if ((!cdcNcmHandle->configStruct) || (!cdcNcmHandle->commInterfaceHandle))
+            {
+                break;
+            }
+
+            interfaceAlternate = *((uint16_t *)param);
+            if (cdcNcmHandle->dataInterfaceNumber != ((uint8_t)(interfaceAlternate >> 8U)))
+            {
+                break;
+            }
+            /* Selecting the same setting again resets the function as well, NCM 1.0, 7.2 */
+            error = USB_DeviceCdcNcmSetDataAlternate(cdcNcmHandle, (uint8_t)(interfaceAlternate & 0xFFU));
+            if (kStatus_USB_Success != error)
+            {
+#ifdef DEBUG
+                usb_echo("kUSB_DeviceClassEventSetInterface, USB_DeviceInitEndpoint fail\r\n");
+#endif
+            }
+            break;
+        case kUSB_DeviceClassEventSetEndpointHalt:
+            if ((!cdcNcmHandle->configStruct) || (!USB_DeviceCdcNcmOwnsEndpoint(cdcNcmHandle, *((uint8_t *)param))))
+            {
+                break;
+            }
+            error = USB_DeviceStallEndpoint(cdcNcmHandle->handle, *((uint8_t *)param));
+            break;
+        case kUSB_DeviceClassEventClearEndpointHalt:
+            if ((!cdcNcmHandle->configStruct) || (!USB_DeviceCdcNcmOwnsEndpoint(cdcNcmHandle, *((uint8_t *)param))))
+            {
+                break;
+            }
+            error = USB_DeviceUnstallEndpoint(cdcNcmHandle->handle, *((uint8_t *)param));
+            break;
+        case kUSB_DeviceClassEventClassRequest:
+        {
+            usb_device_control_request_struct_t *controlRequest = (usb_device_control_request_struct_t *)param;
+
+            if ((controlRequest->setup->wIndex & 0xFFU) != cdcNcmHandle->commInterfaceNumber)
+            {
+                break;
+            }
+            if ((USB_REQUEST_TYPE_TYPE_CLASS != (controlRequest->setup->bmRequestType & USB_REQUEST_TYPE_TYPE_MASK)) ||
+                (!cdcNcmHandle->configStruct) || (!cdcNcmHandle->configStruct->classCallback))
+            {
+                break;
+            }
+            reqParam.buffer         = &(controlRequest->buffer);
+            reqParam.length         = &(controlRequest->length);
+            reqParam.interfaceIndex = controlRequest->setup->wIndex;
+            reqParam.setupValue     = controlRequest->setup->wValue;
+            reqParam.request        = controlRequest->setup->bRequest;
+            reqParam.isSetup        = controlRequest->isSetup;
+            /* classCallback is initialized in classInit of s_UsbDeviceClassInterfaceMap,
+            it is from the second parameter of classInit */
+            error = cdcNcmHandle->configStruct->classCallback(kUSB_DeviceCdcNcmEventClassRequest, &reqParam,
+                                                              cdcNcmHandle->configStruct->classCalbackArg);
+        }
+        break;
+        default:
+            break;
+    }
+    return error;
+}
+
+/*!
+ * @brief Initializes the USB CDC NCM class.
+ *
+ * @param controllerId The id of the controller.
+ * @param config The user configuration structure of type usb_device_class_config_struct_t.
+ * @param handle It is out parameter. The class handle of the CDC NCM class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceCdcNcmInit(uint8_t controllerId,
+                                  usb_device_class_config_struct_t *config,
+                                  class_handle_t *handle)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle;
+    usb_status_t error = kStatus_USB_Error;
+
+    error = USB_DeviceCdcNcmAllocateHandle(&cdcNcmHandle);
+
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+
+    error = USB_DeviceClassGetDeviceHandle(controllerId, &cdcNcmHandle->handle);
+
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+
+    if (!cdcNcmHandle->handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    cdcNcmHandle->configStruct        = config;
+    cdcNcmHandle->configuration       = 0;
+    cdcNcmHandle->dataAlternate       = 0;
+    cdcNcmHandle->commInterfaceHandle = NULL;
+    cdcNcmHandle->dataInterfaceHandle = NULL;
+    cdcNcmHandle->bulkIn.isBusy       = 0;
+    cdcNcmHandle->bulkOut.isBusy      = 0;
+    cdcNcmHandle->interruptIn.isBusy  = 0;
+
+    *handle = (class_handle_t)cdcNcmHandle;
+    return error;
+}
+
+/*!
+ * @brief De-Initializes the USB CDC NCM class.
+ *
+ * @param handle The class handle of the CDC NCM class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceCdcNcmDeinit(class_handle_t handle)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle;
+    usb_status_t error = kStatus_USB_Error;
+
+    cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)handle;
+
+    if (!cdcNcmHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    error = USB_DeviceCdcNcmEndpointsDeinit(cdcNcmHandle);
+    USB_DeviceCdcNcmFreeHandle(cdcNcmHandle);
+    return error;
+}
+
+/*!
+ * @brief Prime the endpoint to send packet to host.
+ *
+ * @param handle The class handle of the CDC NCM class.
+ * @param ep The endpoint number of the transfer.
+ * @param buffer The pointer to the buffer to be transferred.
+ * @param length The length of the buffer to be transferred.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceCdcNcmSend(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle;
+    usb_device_cdc_ncm_pipe_t *pipe = NULL;
+    usb_status_t error              = kStatus_USB_Error;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)handle;
+
+    if ((cdcNcmHandle->dataInterfaceHandle) && (cdcNcmHandle->bulkIn.ep == ep))
+    {
+        pipe = &(cdcNcmHandle->bulkIn);
+    }
+    else if ((cdcNcmHandle->commInterfaceHandle) && (cdcNcmHandle->interruptIn.ep == ep))
+    {
+        pipe = &(cdcNcmHandle->interruptIn);
+    }
+    else
+    {
+    }
+
+    if (NULL != pipe)
+    {
+        if (1U == pipe->isBusy)
+        {
+            return kStatus_USB_Busy;
+        }
+        pipe->isBusy = 1U;
+
+        error = USB_DeviceSendRequest(cdcNcmHandle->handle, ep, buffer, length);
+        if (kStatus_USB_Success != error)
+        {
+            pipe->isBusy = 0U;
+        }
+    }
+    return error;
+}
+
+/*!
+ * @brief Prime the endpoint to receive packet from host.
+ *
+ * @param handle The class handle of the CDC NCM class.
+ * @param ep The endpoint number of the transfer.
+ * @param buffer The pointer to the buffer to be transferred.
+ * @param length The length of the buffer to be transferred.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceCdcNcmRecv(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle;
+    usb_status_t error = kStatus_USB_Error;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)handle;
+
+    if ((!cdcNcmHandle->dataInterfaceHandle) || (cdcNcmHandle->bulkOut.ep != ep))
+    {
+        return error;
+    }
+    if (1U == cdcNcmHandle->bulkOut.isBusy)
+    {
+        return kStatus_USB_Busy;
+    }
+    cdcNcmHandle->bulkOut.isBusy = 1U;
+
+    error = USB_DeviceRecvRequest(cdcNcmHandle->handle, ep, buffer, length);
+    if (kStatus_USB_Success != error)
+    {
+        cdcNcmHandle->bulkOut.isBusy = 0U;
+    }
+    return error;
+}
+
+/*
+ * @brief Checks if any transfer is pending or in progress for endpont.
+ *
+ * @param handle The class handle for the CDC NCM class
+ * @param ep The endpoint number
+ * @retval FALSE(0) no transfer scheduled
+ * @retval TRUE(1) transfer is pending or in progress
+ */
+int USB_DeviceCdcNcmIsBusy(class_handle_t handle, uint8_t ep)
+{
+    usb_device_cdc_ncm_struct_t *cdcNcmHandle;
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    cdcNcmHandle = (usb_device_cdc_ncm_struct_t *)handle;
+
+    if (ep == (cdcNcmHandle->bulkIn.ep))
+        return cdcNcmHandle->bulkIn.isBusy;
+    if (ep == (cdcNcmHandle->bulkOut.ep))
+        return cdcNcmHandle->bulkOut.isBusy;
+    if (ep == (cdcNcmHandle->interruptIn.ep))
+        return cdcNcmHandle->interruptIn.isBusy;
+    return 1;
+}
+
+#endif /* USB_DEVICE_CONFIG_CDC_NCM */
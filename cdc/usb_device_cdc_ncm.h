@@ -0,0 +1,127 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _USB_DEVICE_CDC_NCM_H_
+#define _USB_DEVICE_CDC_NCM_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define USB_DEVICE_CONFIG_CDC_NCM_MAX_INSTANCE (1) /*!< The maximum number of CDC NCM device instance. */
+#define USB_DEVICE_CDC_NCM_COMM_CLASS_CODE (0x02)   /*!< The CDC communication class code. */
+#define USB_DEVICE_CDC_NCM_DATA_CLASS_CODE (0x0A)   /*!< The CDC data class code. */
+
+/*! @brief Definition of CDC NCM class event. */
+typedef enum _usb_device_cdc_ncm_event
+{
+    kUSB_DeviceCdcNcmEventSendResponse = 0x01, /*!< The bulk send transfer is complete or cancelled. */
+    kUSB_DeviceCdcNcmEventRecvResponse,        /*!< The bulk receive transfer is complete or cancelled. */
+    kUSB_DeviceCdcNcmEventNotifyResponse,      /*!< The notification has been sent to the host. */
+    kUSB_DeviceCdcNcmEventClassRequest,        /*!< Class request addressed to communication interface. */
+    kUSB_DeviceCdcNcmEventDataInterfaceChanged, /*!< Data interface alternate setting selected, param points to
+                                                   alternate setting. 1 means data transfers may start. */
+} usb_device_cdc_ncm_event_t;
+
+/*! @brief Definition of parameters for CDC NCM request. */
+typedef struct _usb_device_cdc_ncm_request_param_struct
+{
+    uint8_t **buffer;        /*!< The pointer to the address of the buffer for CDC class request. */
+    uint32_t *length;        /*!< The pointer to the length of the buffer for CDC class request. */
+    uint16_t interfaceIndex; /*!< The interface index of the setup packet. */
+    uint16_t setupValue;     /*!< The wValue field of the setup packet. */
+    uint8_t request;         /*!< The bRequest field of the setup packet. */
+    uint8_t isSetup;         /*!< The flag indicates if it is a setup packet, 1: yes, 0: no. */
+} usb_device_cdc_ncm_request_param_struct_t;
+
+/*! @brief Definition of pipe structure. */
+typedef struct _usb_device_cdc_ncm_pipe
+{
+    uint8_t ep;     /*!< The endpoint number of the pipe. */
+    uint8_t isBusy; /*!< 1: The pipe is transferring packet, 0: The pipe is idle. */
+} usb_device_cdc_ncm_pipe_t;
+
+/*! @brief Definition of structure for CDC NCM device. */
+typedef struct _usb_device_cdc_ncm_struct
+{
+    usb_device_handle handle;                           /*!< The handle of the USB device. */
+    usb_device_class_config_struct_t *configStruct;     /*!< The class configure structure. */
+    usb_device_interface_struct_t *commInterfaceHandle; /*!< The CDC communication interface handle. */
+    usb_device_interface_struct_t *dataInterfaceHandle; /*!< The CDC data interface handle, NULL in alternate 0. */
+    usb_device_cdc_ncm_pipe_t bulkIn;                   /*!< The bulk in pipe for sending NTBs to host. */
+    usb_device_cdc_ncm_pipe_t bulkOut;                  /*!< The bulk out pipe for receiving NTBs from host. */
+    usb_device_cdc_ncm_pipe_t interruptIn;              /*!< The interrupt in pipe for notifications. */
+    uint8_t configuration;                              /*!< The current configuration value. */
+    uint8_t commInterfaceNumber;                        /*!< The communication interface number. */
+    uint8_t dataInterfaceNumber;                        /*!< The data interface number. */
+    uint8_t dataAlternate;                              /*!< The alternate setting of the data interface. */
+} usb_device_cdc_ncm_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*!
+ * @brief Initializes the USB CDC NCM class.
+ *
+ * @param controllerId The controller ID of the USB IP.
+ * @param config The class configuration information.
+ * @param handle An parameter used to return pointer of the CDC NCM class handle to the caller.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceCdcNcmInit(uint8_t controllerId,
+                                         usb_device_class_config_struct_t *config,
+                                         class_handle_t *handle);
+
+/*!
+ * @brief Deinitializes the USB CDC NCM class.
+ *
+ * @param handle The CDC NCM class handle got from usb_device_class_config_struct_t::classHandle.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceCdcNcmDeinit(class_handle_t handle);
+
+/*!
+ * @brief Handles the CDC NCM class event.
+ *
+ * @param handle The CDC NCM class handle.
+ * @param event The event type.
+ * @param param The parameter of the event.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceCdcNcmEvent(void *handle, uint32_t event, void *param);
+
+/*!
+ * @brief Primes the bulk in or interrupt in endpoint.
+ *
+ * Bulk in endpoint sends zero length packet on its own when NTB ends on packet boundary.
+ *
+ * @return A USB error code or kStatus_USB_Success, kStatus_USB_Busy if the pipe is transferring.
+ */
+extern usb_status_t USB_DeviceCdcNcmSend(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length);
+
+/*!
+ * @brief Primes the bulk out endpoint.
+ *
+ * @return A USB error code or kStatus_USB_Success, kStatus_USB_Busy if the pipe is transferring.
+ */
+extern usb_status_t USB_DeviceCdcNcmRecv(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length);
+
+/*
+ * @brief Checks if any transfer is pending or in progress for endpont.
+ *
+ * @retval FALSE(0) no transfer scheduled
+ * @retval TRUE(1) transfer is pending or in progress
+ */
+extern int USB_DeviceCdcNcmIsBusy(class_handle_t handle, uint8_t ep);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* _USB_DEVICE_CDC_NCM_H_ */
@@ -19,6 +19,21 @@
 #error "VCOM stream size has to be greater than single USB packet length"
 #endif
 
+#if (VCOM_RECV_TRANSFER_SIZE < HS_CDC_VCOM_BULK_OUT_PACKET_SIZE) ||                                                    \
+    ((VCOM_RECV_TRANSFER_SIZE % HS_CDC_VCOM_BULK_OUT_PACKET_SIZE) != 0) ||                                             \
+    (VCOM_INPUT_STREAM_SIZE < VCOM_RECV_TRANSFER_SIZE)
+#error "VCOM receive transfer size has to be a multiple of USB packet length and fit into input stream"
+#endif
+
+#if defined(VCOM_RECV_DOUBLE_BUFFER) && (VCOM_RECV_DOUBLE_BUFFER > 0U)
+#if !(defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+#error "VCOM_RECV_DOUBLE_BUFFER queues both receive buffers, enable USB_DEVICE_CONFIG_REQUEST_QUEUE"
+#endif
+#define VCOM_RECV_BUFFER_COUNT (2U)
+#else
+#define VCOM_RECV_BUFFER_COUNT (1U)
+#endif
+
 #define UNUSED(x) do { (void)(x); } while (0)
 
 #define call_user_cb(handle, id)                                                                                       \
@@ -40,8 +55,7 @@ typedef struct _usb_cdc_acm_info
 } usb_cdc_acm_info_t;
 
 /* Line coding of cdc device */
-USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-static uint8_t s_lineCoding[] = {
+static const uint8_t s_defaultLineCoding[] = {
     /* E.g. 0x00,0xC2,0x01,0x00 : 0x0001C200 is 115200 bits per second */
     (LINE_CODING_DTERATE >> 0U) & 0x000000FFU,
     (LINE_CODING_DTERATE >> 8U) & 0x000000FFU,
@@ -52,74 +66,186 @@ static uint8_t s_lineCoding[] = {
     LINE_CODING_DATABITS};
 
 /* Abstract state of cdc device */
-USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-static uint8_t s_abstractState[COMM_FEATURE_DATA_SIZE] = {(STATUS_ABSTRACT_STATE >> 0U) & 0x00FFU,
-                                                          (STATUS_ABSTRACT_STATE >> 8U) & 0x00FFU};
+static const uint8_t s_defaultAbstractState[COMM_FEATURE_DATA_SIZE] = {(STATUS_ABSTRACT_STATE >> 0U) & 0x00FFU,
+                                                                       (STATUS_ABSTRACT_STATE >> 8U) & 0x00FFU};
 
 /* Country code of cdc device */
-USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-static uint8_t s_countryCode[COMM_FEATURE_DATA_SIZE] = {(COUNTRY_SETTING >> 0U) & 0x00FFU,
-                                                        (COUNTRY_SETTING >> 8U) & 0x00FFU};
+static const uint8_t s_defaultCountryCode[COMM_FEATURE_DATA_SIZE] = {(COUNTRY_SETTING >> 0U) & 0x00FFU,
+                                                                     (COUNTRY_SETTING >> 8U) & 0x00FFU};
+
+/* Per instance copies, host may change them independently for every port */
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_lineCoding[USB_DEVICE_CONFIG_CDC_ACM][USB_DATA_ALIGN_SIZE_MULTIPLE(sizeof(s_defaultLineCoding))];
+
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_abstractState[USB_DEVICE_CONFIG_CDC_ACM][USB_DATA_ALIGN_SIZE_MULTIPLE(COMM_FEATURE_DATA_SIZE)];
+
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_countryCode[USB_DEVICE_CONFIG_CDC_ACM][USB_DATA_ALIGN_SIZE_MULTIPLE(COMM_FEATURE_DATA_SIZE)];
 
 /* CDC ACM information */
 USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-static usb_cdc_acm_info_t s_usbCdcAcmInfo;
+static usb_cdc_acm_info_t s_usbCdcAcmInfo[USB_DEVICE_CONFIG_CDC_ACM];
 
 /* Data buffer for receiving and sending*/
 USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-static uint8_t s_currRecvBuf[HS_CDC_VCOM_BULK_IN_PACKET_SIZE];
+static uint8_t
+    s_currRecvBuf[USB_DEVICE_CONFIG_CDC_ACM][VCOM_RECV_BUFFER_COUNT][USB_DATA_ALIGN_SIZE_MULTIPLE(VCOM_RECV_TRANSFER_SIZE)];
 
 USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-static uint8_t s_currSendBuf[HS_CDC_VCOM_BULK_OUT_PACKET_SIZE];
+static uint8_t s_currSendBuf[USB_DEVICE_CONFIG_CDC_ACM][USB_DATA_ALIGN_SIZE_MULTIPLE(HS_CDC_VCOM_BULK_OUT_PACKET_SIZE)];
+
+/* Endpoints of every instance, as laid out in configuration descriptor */
+static const struct
+{
+    uint8_t interruptIn;
+    uint8_t bulkIn;
+    uint8_t bulkOut;
+} s_vcomEndpoints[USB_DEVICE_CONFIG_CDC_ACM] = {
+    {USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT, USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT, USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    {USB_CDC_VCOM1_CIC_INTERRUPT_IN_ENDPOINT, USB_CDC_VCOM1_DIC_BULK_IN_ENDPOINT, USB_CDC_VCOM1_DIC_BULK_OUT_ENDPOINT},
+#endif
+};
+
+static inline void UpdateHighWaterMark(size_t *mark, size_t level)
+{
+    if (level > *mark) {
+        *mark = level;
+    }
+}
+
+static void StoreReceived(usb_cdc_vcom_struct_t *cdcVcom, const uint8_t *buffer, size_t received)
+{
+    size_t length;
+
+    if (received == 0) {
+        return;
+    }
+    length = xStreamBufferSendFromISR(cdcVcom->inputStream, buffer, received, NULL);
+    UpdateHighWaterMark(&cdcVcom->stats.inputHighWaterMark, xStreamBufferBytesAvailable(cdcVcom->inputStream));
+    if (length < received) {
+        log_debug("[VCOM] Error: dropped %lu received bytes", received - length);
+        cdcVcom->stats.rxOverflowCount++;
+        cdcVcom->stats.rxDroppedBytes += received - length;
+        call_user_cb(cdcVcom, USB_EVENT_ERROR_RX_BUFFER_OVERFLOW);
+    }
+}
 
+#if (VCOM_RECV_BUFFER_COUNT > 1U)
+static usb_status_t OnRecvRequestDone(usb_device_handle handle, usb_device_request_struct_t *request);
+
+/* Queues every idle receive buffer the input stream has room for. Called from the USB callback task and application
+ * tasks, so a buffer is reserved in the armed mask under the USB lock and queued outside of it. */
 static usb_status_t RescheduleRecv(usb_cdc_vcom_struct_t *cdcVcom)
 {
-    size_t stream_space;
-    size_t endpoint_size;
+    usb_device_request_struct_t *request;
+    size_t armed;
     usb_status_t error = kStatus_USB_Busy;
+    uint8_t i;
+    USB_OSA_SR_ALLOC();
 
     if (!cdcVcom || !cdcVcom->configured || !cdcVcom->cdcAcmHandle) {
         return kStatus_USB_InvalidHandle;
     }
 
-    stream_space  = xStreamBufferSpacesAvailable(cdcVcom->inputStream);
-    endpoint_size = sizeof(s_currRecvBuf);
-
-    if (stream_space >= endpoint_size) {
-        if ((error = USB_DeviceCdcAcmRecv(
-                 cdcVcom->cdcAcmHandle, USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT, s_currRecvBuf, endpoint_size)) !=
-            kStatus_USB_Success) {
+    for (;;) {
+        USB_OSA_ENTER_CRITICAL();
+        armed = 0;
+        for (i = 0; i < VCOM_RECV_BUFFER_COUNT; i++) {
+            armed += (cdcVcom->recvArmed >> i) & 1U;
+        }
+        for (i = 0; (i < VCOM_RECV_BUFFER_COUNT) && (cdcVcom->recvArmed & (1U << i)); i++) {
+        }
+        /* Every queued buffer may come back full, all of them have to fit into the stream */
+        if ((i == VCOM_RECV_BUFFER_COUNT) ||
+            (xStreamBufferSpacesAvailable(cdcVcom->inputStream) < (armed + 1U) * cdcVcom->recvTransferSize)) {
+            USB_OSA_EXIT_CRITICAL();
+            return error;
+        }
+        cdcVcom->recvArmed |= (uint8_t)(1U << i);
+        USB_OSA_EXIT_CRITICAL();
+
+        request                = &cdcVcom->recvRequest[i];
+        request->buffer        = s_currRecvBuf[cdcVcom->instance][i];
+        request->length        = cdcVcom->recvTransferSize;
+        request->callbackFn    = OnRecvRequestDone;
+        request->callbackParam = cdcVcom;
+        error = USB_DeviceQueueRequest(((usb_device_cdc_acm_struct_t *)cdcVcom->cdcAcmHandle)->handle,
+                                       cdcVcom->bulkOutEndpoint,
+                                       request);
+        if (error != kStatus_USB_Success) {
+            USB_OSA_ENTER_CRITICAL();
+            cdcVcom->recvArmed &= (uint8_t) ~(1U << i);
+            USB_OSA_EXIT_CRITICAL();
             log_debug("[VCOM]: Error: RescheduleRecv FAILED: %u\n", error);
             call_user_cb(cdcVcom, USB_EVENT_WARNING_RESCHEDULE_BUSY);
+            return error;
         }
     }
+}
+#else
+/* Arms the receive buffer if idle and the input stream has room for it. Called from the USB callback task and
+ * application tasks, so the check and the arm are done under the USB lock, the failure is reported outside of it. */
+static usb_status_t RescheduleRecv(usb_cdc_vcom_struct_t *cdcVcom)
+{
+    size_t endpoint_size;
+    bool armed         = false;
+    usb_status_t error = kStatus_USB_Busy;
+    USB_OSA_SR_ALLOC();
+
+    if (!cdcVcom || !cdcVcom->configured || !cdcVcom->cdcAcmHandle) {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    endpoint_size = cdcVcom->recvTransferSize;
+
+    USB_OSA_ENTER_CRITICAL();
+    if (cdcVcom->configured && !USB_DeviceClassCdcAcmIsBusy(cdcVcom->cdcAcmHandle, cdcVcom->bulkOutEndpoint) &&
+        (xStreamBufferSpacesAvailable(cdcVcom->inputStream) >= endpoint_size)) {
+        armed = true;
+        error = USB_DeviceCdcAcmRecv(
+            cdcVcom->cdcAcmHandle, cdcVcom->bulkOutEndpoint, s_currRecvBuf[cdcVcom->instance][0], endpoint_size);
+    }
+    USB_OSA_EXIT_CRITICAL();
+
+    if (armed && (error != kStatus_USB_Success)) {
+        log_debug("[VCOM]: Error: RescheduleRecv FAILED: %u\n", error);
+        call_user_cb(cdcVcom, USB_EVENT_WARNING_RESCHEDULE_BUSY);
+    }
     return error;
 }
+#endif
 
 static usb_status_t OnSendCompleted(usb_cdc_vcom_struct_t *cdcVcom,
                                     usb_device_endpoint_callback_message_struct_t *param)
 {
     usb_status_t error = kStatus_USB_Success;
     size_t to_send;
+    USB_OSA_SR_ALLOC();
 
     if (!cdcVcom || !cdcVcom->cdcAcmHandle) {
         return kStatus_USB_InvalidHandle;
     }
 
     if (cdcVcom->configured) {
-        to_send = xStreamBufferReceiveFromISR(cdcVcom->outputStream, s_currSendBuf, sizeof(s_currSendBuf), 0);
+        uint8_t *sendBuf = s_currSendBuf[cdcVcom->instance];
 
+        /* Drained under the USB lock like VirtualComSend() fills it, the callback may run in a task */
+        USB_OSA_ENTER_CRITICAL();
+        to_send = xStreamBufferReceiveFromISR(cdcVcom->outputStream, sendBuf, sizeof(s_currSendBuf[0]), 0);
         if (to_send) {
-            if ((error = USB_DeviceCdcAcmSend(
-                     cdcVcom->cdcAcmHandle, USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT, s_currSendBuf, to_send))) {
-                log_debug("[VCOM] Error: dropped %u sending bytes", to_send);
-                call_user_cb(cdcVcom, USB_EVENT_ERROR_TX_BUFFER_OVERFLOW);
-            }
+            error = USB_DeviceCdcAcmSend(cdcVcom->cdcAcmHandle, cdcVcom->bulkInEndpoint, sendBuf, to_send);
         }
-        else {
-            if (param->length > 0) {
-                error = USB_DeviceCdcAcmSend(cdcVcom->cdcAcmHandle, USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT, NULL, 0);
-            }
+        else if (param->length > 0) {
+            error = USB_DeviceCdcAcmSend(cdcVcom->cdcAcmHandle, cdcVcom->bulkInEndpoint, NULL, 0);
+        }
+        USB_OSA_EXIT_CRITICAL();
+
+        if (to_send && error) {
+            log_debug("[VCOM] Error: dropped %u sending bytes", to_send);
+            cdcVcom->stats.txDroppedBytes += to_send;
+            call_user_cb(cdcVcom, USB_EVENT_ERROR_TX_BUFFER_OVERFLOW);
         }
     }
     else {
@@ -143,14 +269,7 @@ static usb_status_t OnRecvCompleted(usb_cdc_vcom_struct_t *cdcVcom,
 
     if (cdcVcom->configured) {
         if (cdcVcom->startTransactions) {
-            if (param->length) {
-                size_t length = 0;
-                length        = xStreamBufferSendFromISR(cdcVcom->inputStream, param->buffer, param->length, NULL);
-                if (length < param->length) {
-                    log_debug("[VCOM] Error: dropped %lu received bytes", param->length - length);
-                    call_user_cb(cdcVcom, USB_EVENT_ERROR_RX_BUFFER_OVERFLOW);
-                }
-            }
+            StoreReceived(cdcVcom, param->buffer, param->length);
             error = RescheduleRecv(cdcVcom);
             call_user_cb(cdcVcom, USB_EVENT_DATA_RECEIVED);
         }
@@ -174,12 +293,38 @@ static usb_status_t OnRecvCompleted(usb_cdc_vcom_struct_t *cdcVcom,
     return error;
 }
 
+#if (VCOM_RECV_BUFFER_COUNT > 1U)
+/* Queued bulk OUT buffers bypass the class endpoint callback, they are done here in queue order */
+static usb_status_t OnRecvRequestDone(usb_device_handle handle, usb_device_request_struct_t *request)
+{
+    usb_cdc_vcom_struct_t *cdcVcom = (usb_cdc_vcom_struct_t *)request->callbackParam;
+    usb_device_endpoint_callback_message_struct_t message;
+    USB_OSA_SR_ALLOC();
+
+    UNUSED(handle);
+    USB_OSA_ENTER_CRITICAL();
+    cdcVcom->recvArmed &= (uint8_t)~(1U << (uint8_t)(request - cdcVcom->recvRequest));
+    USB_OSA_EXIT_CRITICAL();
+
+    if (request->actualLength == USB_UNINITIALIZED_VAL_32) {
+        /* Cancelled by endpoint de-init or bus reset, armed again on next configuration */
+        log_debug("[VCOM] Rx request cancelled");
+        return kStatus_USB_Success;
+    }
+
+    message.buffer  = request->buffer;
+    message.length  = request->actualLength;
+    message.isSetup = 0U;
+    return OnRecvCompleted(cdcVcom, &message);
+}
+#endif
+
 usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
 {
     usb_status_t error = kStatus_USB_Error;
     uint8_t *uartBitmap;
     usb_cdc_vcom_struct_t *cdcVcom = (usb_cdc_vcom_struct_t *)userArg;
-    usb_cdc_acm_info_t *acmInfo    = &s_usbCdcAcmInfo;
+    usb_cdc_acm_info_t *acmInfo;
     usb_device_cdc_acm_request_param_struct_t *acmReqParam;
     usb_device_endpoint_callback_message_struct_t *epCbParam;
 
@@ -187,6 +332,7 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
         return kStatus_USB_InvalidHandle;
     }
 
+    acmInfo     = &s_usbCdcAcmInfo[cdcVcom->instance];
     acmReqParam = (usb_device_cdc_acm_request_param_struct_t *)param;
     epCbParam   = (usb_device_endpoint_callback_message_struct_t *)param;
 
@@ -208,7 +354,7 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
     case kUSB_DeviceCdcEventSetCommFeature:
         if (USB_DEVICE_CDC_FEATURE_ABSTRACT_STATE == acmReqParam->setupValue) {
             if (1 == acmReqParam->isSetup) {
-                *(acmReqParam->buffer) = s_abstractState;
+                *(acmReqParam->buffer) = s_abstractState[cdcVcom->instance];
             }
             else {
                 *(acmReqParam->length) = 0;
@@ -216,7 +362,7 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
         }
         else if (USB_DEVICE_CDC_FEATURE_COUNTRY_SETTING == acmReqParam->setupValue) {
             if (1 == acmReqParam->isSetup) {
-                *(acmReqParam->buffer) = s_countryCode;
+                *(acmReqParam->buffer) = s_countryCode[cdcVcom->instance];
             }
             else {
                 *(acmReqParam->length) = 0;
@@ -226,11 +372,11 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
         break;
     case kUSB_DeviceCdcEventGetCommFeature:
         if (USB_DEVICE_CDC_FEATURE_ABSTRACT_STATE == acmReqParam->setupValue) {
-            *(acmReqParam->buffer) = s_abstractState;
+            *(acmReqParam->buffer) = s_abstractState[cdcVcom->instance];
             *(acmReqParam->length) = COMM_FEATURE_DATA_SIZE;
         }
         else if (USB_DEVICE_CDC_FEATURE_COUNTRY_SETTING == acmReqParam->setupValue) {
-            *(acmReqParam->buffer) = s_countryCode;
+            *(acmReqParam->buffer) = s_countryCode[cdcVcom->instance];
             *(acmReqParam->length) = COMM_FEATURE_DATA_SIZE;
         }
         error = kStatus_USB_Success;
@@ -238,13 +384,13 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
     case kUSB_DeviceCdcEventClearCommFeature:
         break;
     case kUSB_DeviceCdcEventGetLineCoding:
-        *(acmReqParam->buffer) = s_lineCoding;
-        *(acmReqParam->length) = sizeof(s_lineCoding);
+        *(acmReqParam->buffer) = s_lineCoding[cdcVcom->instance];
+        *(acmReqParam->length) = sizeof(s_defaultLineCoding);
         error                  = kStatus_USB_Success;
         break;
     case kUSB_DeviceCdcEventSetLineCoding: {
         if (1 == acmReqParam->isSetup) {
-            *(acmReqParam->buffer) = s_lineCoding;
+            *(acmReqParam->buffer) = s_lineCoding[cdcVcom->instance];
         }
         else {
             *(acmReqParam->length) = 0;
@@ -253,7 +399,7 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
         error = kStatus_USB_Success;
         break;
     case kUSB_DeviceCdcEventSetControlLineState: {
-        s_usbCdcAcmInfo.dteStatus = acmReqParam->setupValue;
+        acmInfo->dteStatus = acmReqParam->setupValue;
         /* activate/deactivate Tx carrier */
         if (acmInfo->dteStatus & USB_DEVICE_CDC_CONTROL_SIG_BITMAP_CARRIER_ACTIVATION) {
             acmInfo->uartState |= USB_DEVICE_CDC_UART_STATE_TX_CARRIER;
@@ -291,7 +437,7 @@ usb_status_t VirtualComUSBCallback(uint32_t event, void *param, void *userArg)
         uartBitmap[1] = (acmInfo->uartState >> 8) & 0xFFu;
         if (0 == ((usb_device_cdc_acm_struct_t *)cdcVcom->cdcAcmHandle)->hasSentState) {
             error = USB_DeviceCdcAcmSend(cdcVcom->cdcAcmHandle,
-                                         USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT,
+                                         cdcVcom->interruptInEndpoint,
                                          acmInfo->serialStateBuf,
                                          sizeof(acmInfo->serialStateBuf));
             if (kStatus_USB_Success != error) {
@@ -337,14 +483,21 @@ void VirtualComAttached(usb_cdc_vcom_struct_t *cdcVcom)
 
 void VirtualComDetached(usb_cdc_vcom_struct_t *cdcVcom)
 {
+    USB_OSA_SR_ALLOC();
+
     log_debug("[VCOM] Info: detached");
     cdcVcom->configured = false;
 
-    xStreamBufferReceiveFromISR(cdcVcom->outputStream, s_currSendBuf, sizeof(s_currSendBuf), 0);
+    USB_OSA_ENTER_CRITICAL();
+    xStreamBufferReceiveFromISR(
+        cdcVcom->outputStream, s_currSendBuf[cdcVcom->instance], sizeof(s_currSendBuf[0]), 0);
+    USB_OSA_EXIT_CRITICAL();
 }
 
 void VirtualComReset(usb_cdc_vcom_struct_t *cdcVcom, uint8_t speed)
 {
+    USB_OSA_SR_ALLOC();
+
     log_debug("[VCOM] Info: bus reset");
     cdcVcom->configured = false;
 
@@ -354,7 +507,10 @@ void VirtualComReset(usb_cdc_vcom_struct_t *cdcVcom, uint8_t speed)
     else {
         cdcVcom->usbBufferSize = HS_CDC_VCOM_BULK_OUT_PACKET_SIZE;
     }
-    xStreamBufferReceiveFromISR(cdcVcom->outputStream, s_currSendBuf, sizeof(s_currSendBuf), 0);
+    USB_OSA_ENTER_CRITICAL();
+    xStreamBufferReceiveFromISR(
+        cdcVcom->outputStream, s_currSendBuf[cdcVcom->instance], sizeof(s_currSendBuf[0]), 0);
+    USB_OSA_EXIT_CRITICAL();
 }
 
 /*!
@@ -386,27 +542,67 @@ usb_status_t VirtualComUSBSetConfiguration(usb_cdc_vcom_struct_t *cdcVcom, uint8
  * This function initializes the device with the composite device class information.
  *
  * @param deviceComposite The pointer to the composite device structure.
+ * @param instance Index of CDC ACM function in configuration descriptor.
+ * @param config Optional buffer sizing, NULL to use build time defaults.
  *
  * @return A USB error code or kStatus_USB_Success.
  */
 usb_status_t VirtualComInit(usb_cdc_vcom_struct_t *cdcVcom,
+                            uint8_t instance,
                             class_handle_t classHandle,
                             usb_event_callback_t callback,
-                            void *userArg)
+                            void *userArg,
+                            const usb_cdc_vcom_config_t *config)
 {
-    if (cdcVcom == NULL) {
+    size_t inputStreamSize  = VCOM_INPUT_STREAM_SIZE;
+    size_t outputStreamSize = VCOM_OUTPUT_STREAM_SIZE;
+    size_t recvTransferSize = VCOM_RECV_TRANSFER_SIZE;
+
+    if ((cdcVcom == NULL) || (instance >= USB_DEVICE_CONFIG_CDC_ACM)) {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    if (config != NULL) {
+        inputStreamSize  = config->inputStreamSize ? config->inputStreamSize : inputStreamSize;
+        outputStreamSize = config->outputStreamSize ? config->outputStreamSize : outputStreamSize;
+        recvTransferSize = config->recvTransferSize ? config->recvTransferSize : recvTransferSize;
+    }
+
+    /* Transfer has to end on packet boundary, otherwise host data would be split by short packet detection */
+    recvTransferSize -= recvTransferSize % HS_CDC_VCOM_BULK_OUT_PACKET_SIZE;
+    if ((recvTransferSize == 0) || (recvTransferSize > sizeof(s_currRecvBuf[0][0])) ||
+        (inputStreamSize < recvTransferSize) || (outputStreamSize < HS_CDC_VCOM_BULK_IN_PACKET_SIZE)) {
+        log_error("[VCOM] Invalid buffer sizing: in %u out %u recv %u",
+                  (unsigned int)inputStreamSize,
+                  (unsigned int)outputStreamSize,
+                  (unsigned int)recvTransferSize);
         return kStatus_USB_InvalidParameter;
     }
-    cdcVcom->cdcAcmHandle = classHandle;
-    cdcVcom->userCb       = callback;
-    cdcVcom->userCbArg    = userArg;
 
-    cdcVcom->inputStream = xStreamBufferCreate(VCOM_INPUT_STREAM_SIZE, 0);
+    cdcVcom->cdcAcmHandle        = classHandle;
+    cdcVcom->instance            = instance;
+    cdcVcom->interruptInEndpoint = s_vcomEndpoints[instance].interruptIn;
+    cdcVcom->bulkInEndpoint      = s_vcomEndpoints[instance].bulkIn;
+    cdcVcom->bulkOutEndpoint     = s_vcomEndpoints[instance].bulkOut;
+    cdcVcom->userCb              = callback;
+    cdcVcom->userCbArg           = userArg;
+    cdcVcom->recvTransferSize    = recvTransferSize;
+#if (VCOM_RECV_BUFFER_COUNT > 1U)
+    cdcVcom->recvArmed = 0U;
+#endif
+    memset(&cdcVcom->stats, 0, sizeof(cdcVcom->stats));
+
+    memset(&s_usbCdcAcmInfo[instance], 0, sizeof(s_usbCdcAcmInfo[instance]));
+    memcpy(s_lineCoding[instance], s_defaultLineCoding, sizeof(s_defaultLineCoding));
+    memcpy(s_abstractState[instance], s_defaultAbstractState, sizeof(s_defaultAbstractState));
+    memcpy(s_countryCode[instance], s_defaultCountryCode, sizeof(s_defaultCountryCode));
+
+    cdcVcom->inputStream = xStreamBufferCreate(inputStreamSize, 0);
     if (cdcVcom->inputStream == NULL) {
         return kStatus_USB_AllocFail;
     }
 
-    cdcVcom->outputStream = xStreamBufferCreate(VCOM_OUTPUT_STREAM_SIZE, 0);
+    cdcVcom->outputStream = xStreamBufferCreate(outputStreamSize, 0);
     if (cdcVcom->outputStream == NULL) {
         vStreamBufferDelete(cdcVcom->inputStream);
         return kStatus_USB_AllocFail;
@@ -444,29 +640,42 @@ ssize_t VirtualComSend(usb_cdc_vcom_struct_t *cdcVcom, const void *data, size_t
     const uint8_t *payload = (const uint8_t *)data;
     usb_status_t status;
     size_t bytesSent;
+    USB_OSA_SR_ALLOC();
 
-    taskENTER_CRITICAL();
-    const bool isBusy = USB_DeviceClassCdcAcmIsBusy(cdcVcom->cdcAcmHandle, USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT);
+    /* The output stream is drained by the send completion callback, which runs in the USB interrupt, the deferred
+     * callback task or the device task depending on the configuration. Both sides hold the USB lock, so neither
+     * depends on the priority of the task the other runs in. The stream is used with the FromISR calls, task level
+     * ones would drop the lock. */
+    USB_OSA_ENTER_CRITICAL();
+    const bool isBusy = USB_DeviceClassCdcAcmIsBusy(cdcVcom->cdcAcmHandle, cdcVcom->bulkInEndpoint);
 
     if (isBusy) {
-        bytesSent = xStreamBufferSend(cdcVcom->outputStream, payload, length, 0);
+        bytesSent = xStreamBufferSendFromISR(cdcVcom->outputStream, payload, length, NULL);
+        UpdateHighWaterMark(&cdcVcom->stats.outputHighWaterMark, xStreamBufferBytesAvailable(cdcVcom->outputStream));
     }
     else {
         const size_t bytesToSend = MIN(length, endpointSize);
-        memcpy(s_currSendBuf, payload, bytesToSend);
-        status = USB_DeviceCdcAcmSend(cdcVcom->cdcAcmHandle, USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT, s_currSendBuf, bytesToSend);
+        uint8_t *sendBuf         = s_currSendBuf[cdcVcom->instance];
+        memcpy(sendBuf, payload, bytesToSend);
+        status = USB_DeviceCdcAcmSend(cdcVcom->cdcAcmHandle, cdcVcom->bulkInEndpoint, sendBuf, bytesToSend);
         if (status == kStatus_USB_Success) {
             bytesSent = bytesToSend;
             const size_t bytesRemaining = length - bytesSent;
             if (bytesRemaining > 0) {
-                bytesSent += xStreamBufferSend(cdcVcom->outputStream, &payload[bytesToSend], bytesRemaining, 0);
+                bytesSent +=
+                    xStreamBufferSendFromISR(cdcVcom->outputStream, &payload[bytesToSend], bytesRemaining, NULL);
+                UpdateHighWaterMark(&cdcVcom->stats.outputHighWaterMark,
+                                    xStreamBufferBytesAvailable(cdcVcom->outputStream));
             }
         }
         else {
             bytesSent = 0;
         }
     }
-    taskEXIT_CRITICAL();
+    if (bytesSent < length) {
+        cdcVcom->stats.txOverflowCount++;
+    }
+    USB_OSA_EXIT_CRITICAL();
 
     return bytesSent;
 }
@@ -480,12 +689,34 @@ ssize_t VirtualComRecv(usb_cdc_vcom_struct_t *cdcVcom, void *data, size_t length
     const size_t bytesReceived = xStreamBufferReceive(cdcVcom->inputStream, data, length, 0);
 
     // don't care about error code. If pipe is busy, then it will rescheduled in ISR
-    taskENTER_CRITICAL();
-    const bool isBusy = USB_DeviceClassCdcAcmIsBusy(cdcVcom->cdcAcmHandle, USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT);
-    if (cdcVcom->configured && !isBusy) {
-        RescheduleRecv(cdcVcom);
-    }
-    taskEXIT_CRITICAL();
+    RescheduleRecv(cdcVcom);
 
     return bytesReceived;
 }
+
+void VirtualComGetStats(usb_cdc_vcom_struct_t *cdcVcom, usb_cdc_vcom_stats_t *stats)
+{
+    if ((cdcVcom == NULL) || (stats == NULL)) {
+        return;
+    }
+
+    USB_OSA_SR_ALLOC();
+
+    /* Counters are updated from USB ISR, take consistent snapshot */
+    USB_OSA_ENTER_CRITICAL();
+    *stats = cdcVcom->stats;
+    USB_OSA_EXIT_CRITICAL();
+}
+
+void VirtualComResetStats(usb_cdc_vcom_struct_t *cdcVcom)
+{
+    if (cdcVcom == NULL) {
+        return;
+    }
+
+    USB_OSA_SR_ALLOC();
+
+    USB_OSA_ENTER_CRITICAL();
+    memset(&cdcVcom->stats, 0, sizeof(cdcVcom->stats));
+    USB_OSA_EXIT_CRITICAL();
+}
@@ -28,8 +28,40 @@
 #define UART_BITMAP_SIZE   (0x02)
 #define NOTIF_REQUEST_TYPE (0xA1)
 
-#define VCOM_INPUT_STREAM_SIZE  (512)
+/*! @brief Queue two bulk OUT buffers, so the controller moves to the second one while the first is drained to input
+ * stream. Meant for multi packet transfers: a transfer completes on short packet or when the buffer is full, so data
+ * sent by host in exact multiples of packet size without ZLP is delivered once the buffer fills up or with the next
+ * short packet. Requires USB_DEVICE_CONFIG_REQUEST_QUEUE, enabled by default whenever the request queue is. */
+#ifndef VCOM_RECV_DOUBLE_BUFFER
+#if defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U)
+#define VCOM_RECV_DOUBLE_BUFFER (1U)
+#else
+#define VCOM_RECV_DOUBLE_BUFFER (0U)
+#endif
+#endif
+
+/*! @brief Size of the buffer armed on bulk OUT endpoint. Upper bound for runtime recvTransferSize. */
+#ifndef VCOM_RECV_TRANSFER_SIZE
+#if defined(VCOM_RECV_DOUBLE_BUFFER) && (VCOM_RECV_DOUBLE_BUFFER > 0U)
+#define VCOM_RECV_TRANSFER_SIZE (8U * HS_CDC_VCOM_BULK_OUT_PACKET_SIZE)
+#else
+#define VCOM_RECV_TRANSFER_SIZE (HS_CDC_VCOM_BULK_OUT_PACKET_SIZE)
+#endif
+#endif
+
+/*! @brief Default size of the stream holding data received from host, may be overridden per build or at init. */
+#ifndef VCOM_INPUT_STREAM_SIZE
+#if defined(VCOM_RECV_DOUBLE_BUFFER) && (VCOM_RECV_DOUBLE_BUFFER > 0U)
+#define VCOM_INPUT_STREAM_SIZE (2U * VCOM_RECV_TRANSFER_SIZE)
+#else
+#define VCOM_INPUT_STREAM_SIZE (512)
+#endif
+#endif
+
+/*! @brief Default size of the stream holding data queued for host, may be overridden per build or at init. */
+#ifndef VCOM_OUTPUT_STREAM_SIZE
 #define VCOM_OUTPUT_STREAM_SIZE (512)
+#endif
 
 /* Events */
 enum vcomEvent
@@ -52,17 +84,46 @@ enum vcomEvent
  * @NOTE: function may be called from ISR context. */
 typedef void (*userCbFunc)(void *userArg, enum vcomEvent);
 
+/* Runtime sizing of virtual com buffers. Zeroed fields fall back to build time defaults. */
+typedef struct _usb_cdc_vcom_config
+{
+    size_t inputStreamSize;  /* Size of the stream for data received from host. */
+    size_t outputStreamSize; /* Size of the stream for data queued for host. */
+    size_t recvTransferSize; /* Bytes armed on bulk OUT per transfer, up to VCOM_RECV_TRANSFER_SIZE. */
+} usb_cdc_vcom_config_t;
+
+/* Counters used to size the streams from field data */
+typedef struct _usb_cdc_vcom_stats
+{
+    size_t inputHighWaterMark;  /* Max number of bytes seen waiting in input stream. */
+    size_t outputHighWaterMark; /* Max number of bytes seen waiting in output stream. */
+    uint32_t rxOverflowCount;   /* Number of received transfers which did not fit into input stream. */
+    uint32_t rxDroppedBytes;    /* Total number of received bytes dropped on overflow. */
+    uint32_t txOverflowCount;   /* Number of VirtualComSend calls which did not fit into output stream. */
+    uint32_t txDroppedBytes;    /* Total number of bytes dropped while scheduling transmission from ISR. */
+} usb_cdc_vcom_stats_t;
+
 /* Define the types for application */
 typedef struct _usb_cdc_vcom_struct
 {
     class_handle_t cdcAcmHandle;  /* USB CDC ACM class handle. */
+    uint8_t instance;             /* Index of CDC ACM function in configuration descriptor. */
+    uint8_t interruptInEndpoint;  /* Endpoint numbers taken by this instance. */
+    uint8_t bulkInEndpoint;
+    uint8_t bulkOutEndpoint;
     uint8_t configured;           /* Host is connected and interface is configured */
     uint8_t startTransactions;    /* A flag to indicate whether a CDC device is ready to transmit and receive data. */
     uint8_t currentConfiguration; /* Current configuration value. */
 
     size_t usbBufferSize;
+    size_t recvTransferSize;
+#if defined(VCOM_RECV_DOUBLE_BUFFER) && (VCOM_RECV_DOUBLE_BUFFER > 0U)
+    usb_device_request_struct_t recvRequest[2]; /* Bulk OUT buffers queued on the endpoint. */
+    uint8_t recvArmed;                          /* Bitmask of recvRequest owned by the stack. */
+#endif
     StreamBufferHandle_t inputStream;
     StreamBufferHandle_t outputStream;
+    usb_cdc_vcom_stats_t stats;
 
     usb_event_callback_t userCb;
     void *userCbArg;
@@ -74,16 +135,20 @@ typedef struct _usb_cdc_vcom_struct
  * This function initializes the device with the composite device class information.
  *
  * @param cdcVcom The pointer to the structure of CDC Virtual Com
+ * @param instance index of CDC ACM function, 0 to USB_DEVICE_CONFIG_CDC_ACM - 1
  * @param classHandle handle to lower layer USB class representation
  * @param callback optional function for notifications
  * @param userArg optional argument for user callback
+ * @param config optional buffer sizing, NULL to use build time defaults
  *
  * @return A USB error code or kStatus_USB_Success.
  */
 usb_status_t VirtualComInit(usb_cdc_vcom_struct_t *cdcVcom,
+                            uint8_t instance,
                             class_handle_t classHandle,
                             usb_event_callback_t callback,
-                            void *userArg);
+                            void *userArg,
+                            const usb_cdc_vcom_config_t *config);
 
 /**
  * @brief Deinit and cleanup virtual port resources
@@ -121,6 +186,17 @@ ssize_t VirtualComSend(usb_cdc_vcom_struct_t *cdcVcom, const void *data, size_t
  */
 ssize_t VirtualComRecv(usb_cdc_vcom_struct_t *cdcVcom, void *data, size_t length);
 
+/**
+ * @brief Take a snapshot of stream usage counters
+ * @param stats where counters would be copied
+ */
+void VirtualComGetStats(usb_cdc_vcom_struct_t *cdcVcom, usb_cdc_vcom_stats_t *stats);
+
+/**
+ * @brief Clear stream usage counters
+ */
+void VirtualComResetStats(usb_cdc_vcom_struct_t *cdcVcom);
+
 /*!
  * @brief Handles events comming from USB sub system
  *
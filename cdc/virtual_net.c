@@ -0,0 +1,345 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include "usb.h"
+#include "usb_device.h"
+#include "usb_device_class.h"
+#include "usb_device_cdc_ncm.h"
+#include "usb_device_descriptor.h"
+#include "usb_string_descriptor.h"
+#include "fsl_common.h"
+#include "fsl_os_abstraction.h"
+#include "virtual_net.h"
+
+#include "log.hpp"
+#include <errno.h>
+
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+
+#if (VNET_NTB_IN_MAX_SIZE < NCM_NTB_MIN_INPUT_SIZE) || (VNET_NTB_OUT_MAX_SIZE < NCM_NTB_MIN_INPUT_SIZE) ||              \
+    (VNET_NTB_IN_MAX_SIZE > 0xFFFFU) || (VNET_NTB_OUT_MAX_SIZE > 0xFFFFU)
+#error "VNET NTB sizes have to be between 2048 and 65535 bytes"
+#endif
+
+#define VNET_BITRATE_HS (480000000U)
+#define VNET_BITRATE_FS (12000000U)
+
+/* FNV-1a, spreads serial numbers differing in single digit over whole address */
+#define FNV_OFFSET_BASIS (2166136261U)
+#define FNV_PRIME        (16777619U)
+
+#define UNUSED(x) do { (void)(x); } while (0)
+
+#define call_user_cb(handle, id)                                                                                       \
+    do {                                                                                                               \
+        if ((handle)->userCb)                                                                                          \
+            (handle)->userCb((handle)->userCbArg, id);                                                                 \
+    } while (0)
+
+/* NTB buffers, one is transmitted while the other aggregates frames */
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_ntbInBuf[2][USB_DATA_ALIGN_SIZE_MULTIPLE(VNET_NTB_IN_MAX_SIZE)];
+
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_ntbOutBuf[USB_DATA_ALIGN_SIZE_MULTIPLE(VNET_NTB_OUT_MAX_SIZE)];
+
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_controlBuf[USB_DATA_ALIGN_SIZE_MULTIPLE(NCM_CONTROL_BUFFER_SIZE)];
+
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_notifyBuf[USB_DATA_ALIGN_SIZE_MULTIPLE(NCM_NOTIFY_BUFFER_SIZE)];
+
+static int OpSend(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)ctx;
+    return USB_DeviceCdcNcmSend(cdcVnet->cdcNcmHandle, USB_CDC_NCM_DIC_BULK_IN_ENDPOINT, buffer, length);
+}
+
+static int OpRecv(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)ctx;
+    return USB_DeviceCdcNcmRecv(cdcVnet->cdcNcmHandle, USB_CDC_NCM_DIC_BULK_OUT_ENDPOINT, buffer, length);
+}
+
+static int OpNotify(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)ctx;
+    return USB_DeviceCdcNcmSend(cdcVnet->cdcNcmHandle, USB_CDC_NCM_CIC_INTERRUPT_IN_ENDPOINT, buffer, length);
+}
+
+static void OpDatagram(void *ctx, const uint8_t *datagram, uint16_t length)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)ctx;
+    size_t sent;
+
+    if (cdcVnet->frameHook) {
+        cdcVnet->frameHook(cdcVnet->frameHookArg, datagram, length);
+        return;
+    }
+
+    if (__get_IPSR()) {
+        sent = xMessageBufferSendFromISR(cdcVnet->inputBuffer, datagram, length, NULL);
+    }
+    else {
+        sent = xMessageBufferSend(cdcVnet->inputBuffer, datagram, length, 0);
+    }
+
+    if (sent == 0) {
+        cdcVnet->rxDroppedFrames++;
+        call_user_cb(cdcVnet, USB_EVENT_ERROR_RX_BUFFER_OVERFLOW);
+    }
+}
+
+/* Function state is shared between USB context (ISR or USB task) and senders. Locked sections only update the
+ * function state and queue transfers, so the USB lock covers them. */
+static void OpLock(void *ctx)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)ctx;
+    uint32_t sr;
+
+    USB_OSA_ENTER_CRITICAL_SR(sr);
+    cdcVnet->lockState = sr;
+}
+
+static void OpUnlock(void *ctx)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)ctx;
+    USB_OSA_EXIT_CRITICAL_SR(cdcVnet->lockState);
+}
+
+static const struct ncm_function_ops s_ncmOps = {
+    .send     = OpSend,
+    .recv     = OpRecv,
+    .notify   = OpNotify,
+    .datagram = OpDatagram,
+    .lock     = OpLock,
+    .unlock   = OpUnlock,
+};
+
+/* Derive stable, locally administered unicast address, so host keeps interface settings between connections */
+static void SetMacAddress(usb_cdc_vnet_struct_t *cdcVnet, const char *serialNumber)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    char macString[2 * sizeof(cdcVnet->macAddress) + 1];
+    uint32_t hash = FNV_OFFSET_BASIS;
+
+    if (serialNumber == NULL) {
+        return;
+    }
+
+    while (*serialNumber) {
+        hash ^= (uint8_t)*serialNumber++;
+        hash *= FNV_PRIME;
+    }
+
+    cdcVnet->macAddress[0] = 0x02;
+    cdcVnet->macAddress[1] = 0x00;
+    cdcVnet->macAddress[2] = (hash >> 24) & 0xFF;
+    cdcVnet->macAddress[3] = (hash >> 16) & 0xFF;
+    cdcVnet->macAddress[4] = (hash >> 8) & 0xFF;
+    cdcVnet->macAddress[5] = hash & 0xFF;
+
+    for (size_t i = 0; i < sizeof(cdcVnet->macAddress); i++) {
+        macString[2 * i]     = hex[cdcVnet->macAddress[i] >> 4];
+        macString[2 * i + 1] = hex[cdcVnet->macAddress[i] & 0x0F];
+    }
+    macString[sizeof(macString) - 1] = '\0';
+
+    USB_SetDescriptorString(macString, USB_STRING_CDC_NCM_MAC_ADDRESS);
+}
+
+static usb_status_t OnClassRequest(usb_cdc_vnet_struct_t *cdcVnet, usb_device_cdc_ncm_request_param_struct_t *req)
+{
+    if (ncm_function_request(
+            &cdcVnet->function, req->request, req->setupValue, req->buffer, req->length, req->isSetup)) {
+        log_debug("[VNET] Unsupported request 0x%x", req->request);
+        return kStatus_USB_InvalidRequest;
+    }
+    return kStatus_USB_Success;
+}
+
+static usb_status_t OnDataInterfaceChanged(usb_cdc_vnet_struct_t *cdcVnet, uint8_t alternate)
+{
+    if (alternate) {
+        log_debug("[VNET] Info: link up");
+        ncm_function_activate(&cdcVnet->function, cdcVnet->bitrate);
+    }
+    else {
+        log_debug("[VNET] Info: link down");
+        ncm_function_deactivate(&cdcVnet->function);
+    }
+    return kStatus_USB_Success;
+}
+
+usb_status_t VirtualNetUSBCallback(uint32_t event, void *param, void *userArg)
+{
+    usb_cdc_vnet_struct_t *cdcVnet = (usb_cdc_vnet_struct_t *)userArg;
+    usb_device_endpoint_callback_message_struct_t *epCbParam;
+
+    if (!cdcVnet || !cdcVnet->cdcNcmHandle) {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    epCbParam = (usb_device_endpoint_callback_message_struct_t *)param;
+
+    switch (event) {
+    case kUSB_DeviceCdcNcmEventSendResponse:
+    case kUSB_DeviceCdcNcmEventRecvResponse:
+    case kUSB_DeviceCdcNcmEventNotifyResponse:
+        if (epCbParam->length == 0xFFFFFFFF) {
+            /* EHCI controller has mechanism to notify about endpoint de-init, the function
+             * is deactivated right after, so there is nothing to re-arm */
+            log_debug("[VNET] Notification from controller: 0x%x", (unsigned int)epCbParam->length);
+            call_user_cb(cdcVnet, USB_EVENT_WARNING_NOT_CONFIGURED);
+            return kStatus_USB_Success;
+        }
+        if (event == kUSB_DeviceCdcNcmEventSendResponse) {
+            ncm_function_tx_complete(&cdcVnet->function);
+        }
+        else if (event == kUSB_DeviceCdcNcmEventRecvResponse) {
+            ncm_function_rx_complete(&cdcVnet->function, epCbParam->length);
+        }
+        else {
+            ncm_function_notify_complete(&cdcVnet->function);
+        }
+        return kStatus_USB_Success;
+    case kUSB_DeviceCdcNcmEventClassRequest:
+        return OnClassRequest(cdcVnet, (usb_device_cdc_ncm_request_param_struct_t *)param);
+    case kUSB_DeviceCdcNcmEventDataInterfaceChanged:
+        return OnDataInterfaceChanged(cdcVnet, *(uint8_t *)param);
+    default:
+        break;
+    }
+
+    return kStatus_USB_Error;
+}
+
+void VirtualNetAttached(usb_cdc_vnet_struct_t *cdcVnet)
+{
+    UNUSED(cdcVnet);
+    log_debug("[VNET] Info: attached");
+}
+
+void VirtualNetDetached(usb_cdc_vnet_struct_t *cdcVnet)
+{
+    log_debug("[VNET] Info: detached");
+    ncm_function_deactivate(&cdcVnet->function);
+}
+
+void VirtualNetReset(usb_cdc_vnet_struct_t *cdcVnet, uint8_t speed)
+{
+    log_debug("[VNET] Info: bus reset");
+    ncm_function_deactivate(&cdcVnet->function);
+    cdcVnet->bitrate = (speed == USB_SPEED_HIGH) ? VNET_BITRATE_HS : VNET_BITRATE_FS;
+}
+
+usb_status_t VirtualNetInit(usb_cdc_vnet_struct_t *cdcVnet,
+                            class_handle_t classHandle,
+                            usb_event_callback_t callback,
+                            void *userArg,
+                            const char *serialNumber)
+{
+    const struct ncm_function_buffers buffers = {
+        .tx      = {s_ntbInBuf[0], s_ntbInBuf[1]},
+        .tx_size = VNET_NTB_IN_MAX_SIZE,
+        .rx      = s_ntbOutBuf,
+        .rx_size = VNET_NTB_OUT_MAX_SIZE,
+        .control = s_controlBuf,
+        .notify  = s_notifyBuf,
+    };
+
+    if (cdcVnet == NULL) {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    cdcVnet->cdcNcmHandle    = classHandle;
+    cdcVnet->userCb          = callback;
+    cdcVnet->userCbArg       = userArg;
+    cdcVnet->frameHook       = NULL;
+    cdcVnet->frameHookArg    = NULL;
+    cdcVnet->rxDroppedFrames = 0;
+    cdcVnet->bitrate         = VNET_BITRATE_HS;
+    SetMacAddress(cdcVnet, serialNumber);
+
+    if (ncm_function_init(&cdcVnet->function,
+                          &s_ncmOps,
+                          cdcVnet,
+                          &buffers,
+                          USB_CDC_NCM_CIC_INTERFACE_INDEX)) {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    cdcVnet->inputBuffer = xMessageBufferCreate(VNET_INPUT_BUFFER_SIZE);
+    if (cdcVnet->inputBuffer == NULL) {
+        return kStatus_USB_AllocFail;
+    }
+    return kStatus_USB_Success;
+}
+
+void VirtualNetDeinit(usb_cdc_vnet_struct_t *cdcVnet)
+{
+    if (cdcVnet == NULL) {
+        log_debug("[VNET] CDC VNET struct pointer is NULL!");
+        return;
+    }
+
+    ncm_function_deactivate(&cdcVnet->function);
+    if (cdcVnet->inputBuffer != NULL) {
+        vMessageBufferDelete(cdcVnet->inputBuffer);
+        cdcVnet->inputBuffer = NULL;
+    }
+
+    log_debug("[VNET] Deinitialized");
+}
+
+int VirtualNetSend(usb_cdc_vnet_struct_t *cdcVnet, const void *frame, size_t length)
+{
+    if ((cdcVnet == NULL) || !cdcVnet->cdcNcmHandle || (frame == NULL) || (length == 0) ||
+        (length > USB_CDC_NCM_MAX_SEGMENT_SIZE)) {
+        return -EINVAL;
+    }
+
+    return ncm_function_send(&cdcVnet->function, frame, (uint16_t)length);
+}
+
+ssize_t VirtualNetRecv(usb_cdc_vnet_struct_t *cdcVnet, void *frame, size_t length)
+{
+    if ((cdcVnet == NULL) || (cdcVnet->inputBuffer == NULL) || (frame == NULL) || (length == 0)) {
+        return -EINVAL;
+    }
+
+    /* Frame longer than caller's buffer stays in message buffer */
+    return xMessageBufferReceive(cdcVnet->inputBuffer, frame, length, 0);
+}
+
+void VirtualNetSetFrameHook(usb_cdc_vnet_struct_t *cdcVnet, vnetFrameHook hook, void *userArg)
+{
+    USB_OSA_SR_ALLOC();
+
+    if (cdcVnet == NULL) {
+        return;
+    }
+
+    USB_OSA_ENTER_CRITICAL();
+    cdcVnet->frameHook    = hook;
+    cdcVnet->frameHookArg = userArg;
+    USB_OSA_EXIT_CRITICAL();
+}
+
+void VirtualNetGetStats(usb_cdc_vnet_struct_t *cdcVnet, struct ncm_function_stats *stats)
+{
+    USB_OSA_SR_ALLOC();
+
+    if ((cdcVnet == NULL) || (stats == NULL)) {
+        return;
+    }
+
+    USB_OSA_ENTER_CRITICAL();
+    *stats = cdcVnet->function.stats;
+    USB_OSA_EXIT_CRITICAL();
+}
+
+#endif /* USB_DEVICE_CONFIG_CDC_NCM */
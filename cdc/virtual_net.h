@@ -0,0 +1,129 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _USB_CDC_VNET_H_
+#define _USB_CDC_VNET_H_
+
+#include "device/usb.h"
+#include <device/usb_device.h>
+#include "device/usb_device_class.h"
+#include "usb_device_descriptor.h"
+#include "usb_device_cdc_ncm.h"
+#include "ncm_function.h"
+#include "events.h"
+#include "message_buffer.h"
+
+/*! @brief Size of each of two NTB buffers for device to host direction, announced as dwNtbInMaxSize. */
+#ifndef VNET_NTB_IN_MAX_SIZE
+#define VNET_NTB_IN_MAX_SIZE (8192U)
+#endif
+
+/*! @brief Size of NTB buffer for host to device direction, announced as dwNtbOutMaxSize. */
+#ifndef VNET_NTB_OUT_MAX_SIZE
+#define VNET_NTB_OUT_MAX_SIZE (8192U)
+#endif
+
+/*! @brief Size of the message buffer queueing received frames, used when no frame hook is installed. */
+#ifndef VNET_INPUT_BUFFER_SIZE
+#define VNET_INPUT_BUFFER_SIZE (4U * (USB_CDC_NCM_MAX_SEGMENT_SIZE + sizeof(size_t)))
+#endif
+
+/* @brief Function called for every Ethernet frame received from host.
+ * @NOTE: function may be called from ISR context, frame is valid only
+ *        for the duration of the call. */
+typedef void (*vnetFrameHook)(void *userArg, const uint8_t *frame, uint16_t length);
+
+/* Define the types for application */
+typedef struct _usb_cdc_vnet_struct
+{
+    class_handle_t cdcNcmHandle; /* USB CDC NCM class handle. */
+    struct ncm_function function;
+    uint32_t bitrate;            /* Reported to host, depends on bus speed */
+    uint32_t lockState;
+    uint8_t macAddress[6];       /* Address of host side of the link, as announced in iMACAddress */
+    uint32_t rxDroppedFrames;    /* Frames which did not fit into input buffer */
+
+    MessageBufferHandle_t inputBuffer;
+    vnetFrameHook frameHook;
+    void *frameHookArg;
+
+    usb_event_callback_t userCb;
+    void *userCbArg;
+} usb_cdc_vnet_struct_t;
+
+/*!
+ * @brief Virtual network device initialization function.
+ *
+ * @param cdcVnet The pointer to the structure of CDC virtual network
+ * @param classHandle handle to lower layer USB class representation
+ * @param callback optional function for notifications
+ * @param userArg optional argument for user callback
+ * @param serialNumber optional device serial number, locally administered MAC address is derived from it
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t VirtualNetInit(usb_cdc_vnet_struct_t *cdcVnet,
+                            class_handle_t classHandle,
+                            usb_event_callback_t callback,
+                            void *userArg,
+                            const char *serialNumber);
+
+/**
+ * @brief Deinit and cleanup virtual network resources
+ */
+void VirtualNetDeinit(usb_cdc_vnet_struct_t *cdcVnet);
+
+/**
+ * @brief Notify VirtualNet that USB cable is plugged
+ */
+void VirtualNetAttached(usb_cdc_vnet_struct_t *cdcVnet);
+
+/**
+ * @brief Notify VirtualNet that USB cable is unplugged
+ */
+void VirtualNetDetached(usb_cdc_vnet_struct_t *cdcVnet);
+
+/**
+ * @brief Notify VirtualNet that bus reset event occured
+ */
+void VirtualNetReset(usb_cdc_vnet_struct_t *cdcVnet, uint8_t speed);
+
+/**
+ * @brief Queue Ethernet frame for host. Frames are aggregated into single
+ *        transfer while previous one is in flight.
+ * @return 0 on success, -ENOTCONN if host didn't enable the interface,
+ *         -ENOSPC if there is no room, -EINVAL on invalid arguments
+ */
+int VirtualNetSend(usb_cdc_vnet_struct_t *cdcVnet, const void *frame, size_t length);
+
+/**
+ * @brief Pick single received frame, not available when frame hook is installed
+ * @return length of frame, 0 if no frame is waiting, -EINVAL on invalid arguments
+ */
+ssize_t VirtualNetRecv(usb_cdc_vnet_struct_t *cdcVnet, void *frame, size_t length);
+
+/**
+ * @brief Deliver received frames directly to hook instead of input buffer
+ * @param hook function to be called, NULL to restore buffering
+ */
+void VirtualNetSetFrameHook(usb_cdc_vnet_struct_t *cdcVnet, vnetFrameHook hook, void *userArg);
+
+/**
+ * @brief Take a snapshot of transfer counters
+ */
+void VirtualNetGetStats(usb_cdc_vnet_struct_t *cdcVnet, struct ncm_function_stats *stats);
+
+/*!
+ * @brief Handles events comming from USB sub system
+ *
+ * @param event           The CDC NCM class event type.
+ * @param param           The parameter of the class event.
+ * @param userArg         The pointer to the structure of CDC virtual network.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t VirtualNetUSBCallback(uint32_t event, void *param, void *userArg);
+
+#endif /* _USB_CDC_VNET_H_ */
@@ -22,10 +22,19 @@
 #include "usb_charger_detect.h"
 #endif
 
-extern usb_device_class_struct_t g_UsbDeviceCdcVcomConfig;
+extern usb_device_class_struct_t g_UsbDeviceCdcVcomConfig[USB_DEVICE_CONFIG_CDC_ACM];
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
 extern usb_device_class_struct_t g_MtpClass;
 #endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+extern usb_device_class_struct_t g_MscClass;
+#endif
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+extern usb_device_class_struct_t g_UsbDeviceCdcNcmConfig;
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+extern usb_device_class_struct_t g_DfuClass;
+#endif
 
 /* Composite device structure. */
 static usb_device_composite_struct_t composite;
@@ -40,18 +49,59 @@ static usb_device_class_config_struct_t g_CompositeClassConfig[] = {
         (class_handle_t)NULL,
         &g_MtpClass,
     },
+#elif defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+    {
+        MscUSBCallback,
+        &composite.mscApp,
+        (class_handle_t)NULL,
+        &g_MscClass,
+    },
 #endif
     {
         VirtualComUSBCallback,
-        &composite.cdcVcom,
+        &composite.cdcVcom[0],
         (class_handle_t)NULL,
-        &g_UsbDeviceCdcVcomConfig,
-    }};
+        &g_UsbDeviceCdcVcomConfig[0],
+    },
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    {
+        VirtualComUSBCallback,
+        &composite.cdcVcom[1],
+        (class_handle_t)NULL,
+        &g_UsbDeviceCdcVcomConfig[1],
+    },
+#endif
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+    {
+        VirtualNetUSBCallback,
+        &composite.cdcVnet,
+        (class_handle_t)NULL,
+        &g_UsbDeviceCdcNcmConfig,
+    },
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+    {
+        DfuUSBCallback,
+        &composite.dfuApp,
+        (class_handle_t)NULL,
+        &g_DfuClass,
+    },
+#endif
+};
+
+/* Index of the first virtual com entry in g_CompositeClassConfig */
+#if (defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)) ||                                                \
+    (defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U))
+#define COMPOSITE_VCOM_CLASS_INDEX (1U)
+#else
+#define COMPOSITE_VCOM_CLASS_INDEX (0U)
+#endif
+#define COMPOSITE_VNET_CLASS_INDEX (COMPOSITE_VCOM_CLASS_INDEX + USB_DEVICE_CONFIG_CDC_ACM)
+#define COMPOSITE_DFU_CLASS_INDEX  (COMPOSITE_VNET_CLASS_INDEX + USB_DEVICE_CONFIG_CDC_NCM)
 
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
 static class_handle_t g_MtpClassHandle = (class_handle_t)NULL;
 #endif
-static class_handle_t g_VComClassHandle = (class_handle_t)NULL;
 
 #if (defined(USB_DEVICE_CONFIG_CHARGER_DETECT) && (USB_DEVICE_CONFIG_CHARGER_DETECT > 0U)) &&                          \
     (defined(FSL_FEATURE_SOC_USB_ANALOG_COUNT) && (FSL_FEATURE_SOC_USB_ANALOG_COUNT > 0U))
@@ -186,6 +236,26 @@ void USB_DeviceTask(void *handle)
 }
 #endif
 
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+static void USB_DeviceDeferredTask(void *handle)
+{
+    while (1U) {
+        USB_DeviceDeferredTaskFunction(handle);
+    }
+}
+
+/* Serial state notifications are a few bytes and complete rarely, they are not worth a task switch */
+static void USB_DeviceKeepInIsr(usb_device_handle handle)
+{
+    USB_DeviceSetEndpointCallbackInIsr(
+        handle, USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT | (USB_IN << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT), 1U);
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    USB_DeviceSetEndpointCallbackInIsr(
+        handle, USB_CDC_VCOM1_CIC_INTERRUPT_IN_ENDPOINT | (USB_IN << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT), 1U);
+#endif
+}
+#endif
+
 #if (defined(USB_DEVICE_CONFIG_CHARGER_DETECT) && (USB_DEVICE_CONFIG_CHARGER_DETECT > 0U)) &&                          \
     (defined(FSL_FEATURE_SOC_USB_ANALOG_COUNT) && (FSL_FEATURE_SOC_USB_ANALOG_COUNT > 0U))
 
@@ -220,10 +290,21 @@ static usb_status_t USB_DeviceCallback(usb_device_handle handle, uint32_t event,
             USB_DeviceSetSpeed(handle, composite.speed);
         }
 #endif
-        VirtualComReset(&composite.cdcVcom, composite.speed);
+        for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+            VirtualComReset(&composite.cdcVcom[i], composite.speed);
+        }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+        VirtualNetReset(&composite.cdcVnet, composite.speed);
+#endif
 
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
         MtpReset(&composite.mtpApp, composite.speed);
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+        MscReset(&composite.mscApp, composite.speed);
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+        DfuReset(&composite.dfuApp);
 #endif
         composite.userDefinedEventCallback(composite.userDefinedEventCallbackArg, USB_EVENT_RESET);
     } break;
@@ -235,7 +316,9 @@ static usb_status_t USB_DeviceCallback(usb_device_handle handle, uint32_t event,
         else if (USB_COMPOSITE_CONFIGURE_INDEX == (*temp8)) {
             composite.attach               = 1;
             composite.currentConfiguration = *temp8;
-            VirtualComUSBSetConfiguration(&composite.cdcVcom, *temp8);
+            for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+                VirtualComUSBSetConfiguration(&composite.cdcVcom[i], *temp8);
+            }
             error = kStatus_USB_Success;
         }
         else {
@@ -293,17 +376,51 @@ static usb_status_t USB_DeviceCallback(usb_device_handle handle, uint32_t event,
                 handle, (usb_device_get_device_qualifier_descriptor_struct_t *)param);
         }
         break;
+    case kUSB_DeviceEventGetOtherSpeedConfigurationDescriptor:
+        if (param) {
+            error = USB_DeviceGetOtherSpeedConfigurationDescriptor(
+                handle, (usb_device_get_configuration_descriptor_struct_t *)param);
+        }
+        break;
+#endif
+#if (defined(USB_DEVICE_CONFIG_MS_OS_20) && (USB_DEVICE_CONFIG_MS_OS_20 > 0U))
+    case kUSB_DeviceEventGetBOSDescriptor:
+        if (param) {
+            error = USB_DeviceGetBosDescriptor(handle, (usb_device_get_bos_descriptor_struct_t *)param);
+        }
+        break;
+    case kUSB_DeviceEventVendorRequest:
+        if (param) {
+            error = USB_DeviceGetMsOs20DescriptorSet(handle, (usb_device_control_request_struct_t *)param);
+        }
+        break;
 #endif
 
     case kUSB_DeviceEventAttach:
-        VirtualComAttached(&composite.cdcVcom);
+        for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+            VirtualComAttached(&composite.cdcVcom[i]);
+        }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+        VirtualNetAttached(&composite.cdcVnet);
+#endif
         composite.userDefinedEventCallback(composite.userDefinedEventCallbackArg, USB_EVENT_ATTACHED);
         break;
 
     case kUSB_DeviceEventDetach:
-        VirtualComDetached(&composite.cdcVcom);
+        for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+            VirtualComDetached(&composite.cdcVcom[i]);
+        }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+        VirtualNetDetached(&composite.cdcVnet);
+#endif
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
         MtpDetached(&composite.mtpApp);
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+        MscDetached(&composite.mscApp);
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+        DfuDetached(&composite.dfuApp);
 #endif
         composite.userDefinedEventCallback(composite.userDefinedEventCallbackArg, USB_EVENT_DETACHED);
         break;
@@ -326,7 +443,10 @@ usb_device_composite_struct_t *composite_init(usb_event_callback_t userEventCall
                                               const char *serialNumber,
                                               const uint16_t bcdDeviceVersion,
                                               const char *mtpRoot,
-                                              bool mtpLockedAtInit)
+                                              bool mtpLockedAtInit,
+                                              const usb_cdc_vcom_config_t *vcomConfig,
+                                              const struct _usb_msc_config *mscConfig,
+                                              const struct _usb_dfu_config *dfuConfig)
 {
     if (USB_DeviceClockInit() != kStatus_USB_Success) {
         log_error("[Composite] USB Device Clock init failed");
@@ -337,7 +457,7 @@ usb_device_composite_struct_t *composite_init(usb_event_callback_t userEventCall
     composite.deviceHandle                = NULL;
     composite.userDefinedEventCallback    = userEventCallback;
     composite.userDefinedEventCallbackArg = NULL; // not used
-    memset(&composite.cdcVcom, 0, sizeof(composite.cdcVcom));
+    memset(composite.cdcVcom, 0, sizeof(composite.cdcVcom));
 
     if ((serialNumber != NULL) && (serialNumber[0] != '\0')) {
         USB_DeviceSetSerialNumberString(serialNumber);
@@ -357,8 +477,7 @@ usb_device_composite_struct_t *composite_init(usb_event_callback_t userEventCall
     }
     else {
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-        g_MtpClassHandle  = g_CompositeClassConfig[0].classHandle;
-        g_VComClassHandle = g_CompositeClassConfig[1].classHandle;
+        g_MtpClassHandle = g_CompositeClassConfig[0].classHandle;
 
         if (MtpInit(&composite.mtpApp, g_MtpClassHandle, mtpRoot, mtpLockedAtInit) != kStatus_USB_Success) {
             log_error("[Composite] MTP initialization failed");
@@ -367,17 +486,75 @@ usb_device_composite_struct_t *composite_init(usb_event_callback_t userEventCall
 #else
         UNUSED(mtpRoot);
         UNUSED(mtpLockedAtInit);
-        g_VComClassHandle = g_CompositeClassConfig[0].classHandle;
 #endif
-        if (VirtualComInit(
-                &composite.cdcVcom, g_VComClassHandle, composite.userDefinedEventCallback, (void *)serialNumber) !=
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+        if (MscInit(&composite.mscApp, g_CompositeClassConfig[0].classHandle, mscConfig) != kStatus_USB_Success) {
+            log_error("[Composite] MSC initialization failed");
+            goto error;
+        }
+#else
+        UNUSED(mscConfig);
+#endif
+        for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+            if (VirtualComInit(&composite.cdcVcom[i],
+                               i,
+                               g_CompositeClassConfig[COMPOSITE_VCOM_CLASS_INDEX + i].classHandle,
+                               composite.userDefinedEventCallback,
+                               &composite.cdcVcom[i],
+                               (vcomConfig != NULL) ? &vcomConfig[i] : NULL) != kStatus_USB_Success) {
+                log_error("[Composite] VirtualCom %u initialization failed", (unsigned int)i);
+                while (i-- > 0U) {
+                    VirtualComDeinit(&composite.cdcVcom[i]);
+                }
+#if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
+                MtpDeinit(&composite.mtpApp);
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+                MscDeinit(&composite.mscApp);
+#endif
+                goto error;
+            }
+        }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+        if (VirtualNetInit(&composite.cdcVnet,
+                           g_CompositeClassConfig[COMPOSITE_VNET_CLASS_INDEX].classHandle,
+                           composite.userDefinedEventCallback,
+                           NULL,
+                           serialNumber) != kStatus_USB_Success) {
+            log_error("[Composite] VirtualNet initialization failed");
+            for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+                VirtualComDeinit(&composite.cdcVcom[i]);
+            }
+#if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
+            MtpDeinit(&composite.mtpApp);
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+            MscDeinit(&composite.mscApp);
+#endif
+            goto error;
+        }
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+        if (DfuInit(&composite.dfuApp, g_CompositeClassConfig[COMPOSITE_DFU_CLASS_INDEX].classHandle, dfuConfig) !=
             kStatus_USB_Success) {
-            log_error("[Composite] VirtualCom initialization failed");
+            log_error("[Composite] DFU initialization failed");
+            for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+                VirtualComDeinit(&composite.cdcVcom[i]);
+            }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+            VirtualNetDeinit(&composite.cdcVnet);
+#endif
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
             MtpDeinit(&composite.mtpApp);
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+            MscDeinit(&composite.mscApp);
 #endif
             goto error;
         }
+#else
+        UNUSED(dfuConfig);
+#endif
     }
 
 #if defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U)
@@ -392,6 +569,19 @@ usb_device_composite_struct_t *composite_init(usb_event_callback_t userEventCall
         return NULL;
     }
 #endif
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+    USB_DeviceKeepInIsr(composite.deviceHandle);
+    if (xTaskCreate(USB_DeviceDeferredTask,               /* pointer to the task */
+                    (char const *)"usb deferred task",    /* task name for kernel awareness debugging */
+                    3072L / sizeof(portSTACK_TYPE),       /* task stack size */
+                    composite.deviceHandle,               /* optional task startup argument */
+                    USB_DEVICE_DEFERRED_TASK_PRIORITY,    /* initial priority */
+                    &composite.deferred_task_handle       /* optional task handle to create */
+                    ) != pdPASS) {
+        log_error("[Composite] Failed to create usb deferred task!");
+        return NULL;
+    }
+#endif
 
     USB_DeviceSetIsr(true);
 
@@ -420,12 +610,27 @@ void composite_deinit(usb_device_composite_struct_t *instance)
         log_error("[Composite] Device stop failed: 0x%x", err);
     }
     USB_DeviceSetIsr(false);
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+    /* Interrupt is off, nothing queues completions anymore */
+    vTaskDelete(instance->deferred_task_handle);
+#endif
 
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
     MtpDeinit(&instance->mtpApp);
 #endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+    MscDeinit(&instance->mscApp);
+#endif
 
-    VirtualComDeinit(&instance->cdcVcom);
+    for (uint8_t i = 0U; i < USB_DEVICE_CONFIG_CDC_ACM; i++) {
+        VirtualComDeinit(&instance->cdcVcom[i]);
+    }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+    VirtualNetDeinit(&instance->cdcVnet);
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+    DfuDeinit(&instance->dfuApp);
+#endif
 
     if ((err = USB_DeviceClassDeinit(CONTROLLER_ID)) != kStatus_USB_Success) {
         log_error("[Composite] Device class deinit failed: 0x%x", err);
@@ -438,3 +643,26 @@ void composite_deinit(usb_device_composite_struct_t *instance)
     instance->initialized = false;
     log_debug("[Composite] USB deinitialized");
 }
+
+usb_status_t composite_set_profile(usb_device_composite_struct_t *instance, usb_composite_profile_t profile)
+{
+    uint8_t threshold;
+
+    if (!instance || !instance->initialized) {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    switch (profile) {
+    case USB_COMPOSITE_PROFILE_LOW_LATENCY:
+        threshold = 0U;
+        break;
+    case USB_COMPOSITE_PROFILE_THROUGHPUT:
+        threshold = USB_COMPOSITE_THROUGHPUT_INTERRUPT_THRESHOLD;
+        break;
+    default:
+        return kStatus_USB_InvalidParameter;
+    }
+
+    log_debug("[Composite] Interrupt threshold %u micro-frames", threshold);
+    return USB_DeviceSetStatus(instance->deviceHandle, kUSB_DeviceStatusInterruptThreshold, &threshold);
+}
@@ -15,12 +15,38 @@
 #include "usb_device_config.h"
 #include "MIMXRT1051_features.h"
 #include "virtual_com.h"
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+#include "virtual_net.h"
+#endif
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
 #include "mtp.h"
 #endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+#include "msc.h"
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+#include "dfu.h"
+#endif
 
 #define CONTROLLER_ID                 kUSB_ControllerEhci0
-#define USB_DEVICE_INTERRUPT_PRIORITY (3U)
+
+/* Deferred callback task runs the class callbacks taken out of the ISR, ahead of the class tasks */
+#ifndef USB_DEVICE_DEFERRED_TASK_PRIORITY
+#define USB_DEVICE_DEFERRED_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#endif
+
+/*! @brief Interrupt threshold of throughput profile in micro-frames, see usb_composite_profile_t. */
+#ifndef USB_COMPOSITE_THROUGHPUT_INTERRUPT_THRESHOLD
+#define USB_COMPOSITE_THROUGHPUT_INTERRUPT_THRESHOLD (8U)
+#endif
+
+/* Pacing of transfer completion interrupts, shared by all functions of the device */
+typedef enum
+{
+    USB_COMPOSITE_PROFILE_LOW_LATENCY = 0, /* Interrupt on every completion, CDC console and control messages */
+    USB_COMPOSITE_PROFILE_THROUGHPUT,      /* Retire completions in batches, bulk streams keeping several
+                                              requests queued, see USB_DeviceQueueRequest() */
+} usb_composite_profile_t;
 
 typedef struct _usb_device_composite_struct
 {
@@ -29,9 +55,21 @@ typedef struct _usb_device_composite_struct
 #if defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U)
     TaskHandle_t device_task_handle; /* USB device task handle */
 #endif
-    usb_cdc_vcom_struct_t cdcVcom;   /* CDC virtual com device structure. */
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+    TaskHandle_t deferred_task_handle; /* USB deferred callback task handle */
+#endif
+    usb_cdc_vcom_struct_t cdcVcom[USB_DEVICE_CONFIG_CDC_ACM]; /* CDC virtual com device structures. */
 #if defined(USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
     usb_mtp_struct_t mtpApp;
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+    usb_msc_struct_t mscApp;
+#endif
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+    usb_cdc_vnet_struct_t cdcVnet; /* CDC NCM virtual network device structure. */
+#endif
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+    usb_dfu_struct_t dfuApp;
 #endif
     uint8_t speed;  /* Speed of USB device. USB_SPEED_FULL/USB_SPEED_LOW/USB_SPEED_HIGH.                 */
     uint8_t attach; /* A flag to indicate whether a usb device is attached. 1: attached, 0: not attached */
@@ -42,13 +80,40 @@ typedef struct _usb_device_composite_struct
     void *userDefinedEventCallbackArg;
 } usb_device_composite_struct_t;
 
+struct _usb_msc_config;
+struct _usb_dfu_config;
+
+/*!
+ * @brief Initialize composite device
+ *
+ * @param userEventCallback called with the usb_cdc_vcom_struct_t of the raising port as userArg for
+ *                          virtual com events, with NULL for device events.
+ * @param vcomConfig optional array of USB_DEVICE_CONFIG_CDC_ACM buffer configurations, one per
+ *                   virtual com instance. NULL to use build time defaults for all of them.
+ * @param mscConfig disk image and cache setup of mass storage function, ignored when the function
+ *                  is not built in. NULL presents the drive without medium.
+ * @param dfuConfig update image of firmware upgrade function, ignored when the function is not
+ *                  built in. NULL stalls every download.
+ */
 usb_device_composite_struct_t *composite_init(usb_event_callback_t userEventCallback,
                                               const char *serialNumber,
                                               const uint16_t bcdDeviceVersion,
                                               const char *mtpRoot,
-                                              bool mtpLockedAtInit);
+                                              bool mtpLockedAtInit,
+                                              const usb_cdc_vcom_config_t *vcomConfig,
+                                              const struct _usb_msc_config *mscConfig,
+                                              const struct _usb_dfu_config *dfuConfig);
 void composite_deinit(usb_device_composite_struct_t *composite);
 
+/*!
+ * @brief Select completion interrupt pacing of the device
+ *
+ * Throughput profile delays completions up to USB_COMPOSITE_THROUGHPUT_INTERRUPT_THRESHOLD
+ * micro-frames, so it only pays off while endpoints have further requests queued. A function
+ * keeping a single transfer in flight (MTP, MSC, virtual com) is slowed down by it.
+ */
+usb_status_t composite_set_profile(usb_device_composite_struct_t *composite, usb_composite_profile_t profile);
+
 #if (defined(USB_DEVICE_CONFIG_CHARGER_DETECT) && (USB_DEVICE_CONFIG_CHARGER_DETECT > 0U)) &&                          \
     (defined(FSL_FEATURE_SOC_USB_ANALOG_COUNT) && (FSL_FEATURE_SOC_USB_ANALOG_COUNT > 0U))
 void USB_UpdateHwTick(void);
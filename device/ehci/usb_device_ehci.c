@@ -35,6 +35,40 @@
 
 #endif
 
+/* The idle DTD counters are int8_t */
+#if (USB_DEVICE_CONFIG_EHCI_MAX_DTD > 127U)
+#error "USB_DEVICE_CONFIG_EHCI_MAX_DTD has to be 127 or less."
+#endif
+
+/*! @brief The transfer done bits of the endpoints in use, OUT endpoints in the low half word and IN in the high one */
+#define USB_DEVICE_EHCI_EPCOMPLETE_MASK (((1U << USB_DEVICE_CONFIG_ENDPOINTS) - 1U) * 0x00010001U)
+
+/*! @brief Count the trailing zero bits of a non-zero word */
+#if defined(__GNUC__)
+#define USB_DEVICE_EHCI_CTZ(x) ((uint32_t)__builtin_ctz(x))
+#else
+#define USB_DEVICE_EHCI_CTZ(x) ((uint32_t)__CLZ(__RBIT(x)))
+#endif
+
+/*! @brief Mask interrupts in the transfer path, the masked cycles are measured when the statistics are enabled */
+#if (defined(USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS) && (USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS > 0U))
+#define USB_DEVICE_EHCI_ENTER_CRITICAL(ehciState) \
+    do                                            \
+    {                                             \
+        USB_OSA_ENTER_CRITICAL();                 \
+        (ehciState)->criticalStart = DWT->CYCCNT; \
+    } while (0)
+#define USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState)      \
+    do                                                \
+    {                                                 \
+        USB_DeviceEhciCriticalSectionDone(ehciState); \
+        USB_OSA_EXIT_CRITICAL();                      \
+    } while (0)
+#else
+#define USB_DEVICE_EHCI_ENTER_CRITICAL(ehciState) USB_OSA_ENTER_CRITICAL()
+#define USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState) USB_OSA_EXIT_CRITICAL()
+#endif
+
 /*******************************************************************************
  * Prototypes
  ******************************************************************************/
@@ -49,6 +83,7 @@ static void USB_DeviceEhciFillSetupBuffer(usb_device_ehci_state_struct_t *ehciSt
 static void USB_DeviceEhciCancelControlPipe(usb_device_ehci_state_struct_t *ehciState,
                                             uint8_t endpoint,
                                             uint8_t direction);
+static void USB_DeviceEhciTransferDone(usb_device_ehci_state_struct_t *ehciState, uint8_t endpoint, uint8_t direction);
 static void USB_DeviceEhciInterruptTokenDone(usb_device_ehci_state_struct_t *ehciState);
 static void USB_DeviceEhciInterruptPortChange(usb_device_ehci_state_struct_t *ehciState);
 static void USB_DeviceEhciInterruptReset(usb_device_ehci_state_struct_t *ehciState);
@@ -60,6 +95,10 @@ static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciS
                                            uint8_t endpointAddress,
                                            uint8_t *buffer,
                                            uint32_t length);
+static usb_status_t USB_DeviceEhciTransferV(usb_device_ehci_state_struct_t *ehciState,
+                                            uint8_t endpointAddress,
+                                            const usb_device_transfer_segment_struct_t *segments,
+                                            uint32_t segmentCount);
 
 extern usb_status_t USB_DeviceNotificationTrigger(void *handle, void *msg);
 
@@ -77,6 +116,10 @@ USB_RAM_ADDRESS_ALIGNMENT(32)
 USB_CONTROLLER_DATA static usb_device_ehci_dtd_struct_t
     s_UsbDeviceEhciDtd[USB_DEVICE_CONFIG_EHCI][USB_DEVICE_CONFIG_EHCI_MAX_DTD];
 
+/* DTDs reserved for each endpoint, the rest of the DTD buffer is shared */
+static const uint8_t s_UsbDeviceEhciDtdReservation[USB_DEVICE_CONFIG_ENDPOINTS * 2] =
+    USB_DEVICE_CONFIG_EHCI_DTD_RESERVATION;
+
 /* Apply for ehci device state structure */
 static usb_device_ehci_state_struct_t g_UsbDeviceEhciState[USB_DEVICE_CONFIG_EHCI];
 
@@ -135,20 +178,168 @@ void *USB_EhciNCGetBase(uint8_t controllerId)
 #endif
 
 /*!
- * @brief Set device controller state to default state.
+ * @brief Get the DTD count of all endpoint reservations.
  *
- * The function is used to set device controller state to default state.
- * The function will be called when USB_DeviceEhciInit called or the control type kUSB_DeviceControlGetEndpointStatus
- * received in USB_DeviceEhciControl.
+ * @retval The reserved DTD count.
+ */
+static uint32_t USB_DeviceEhciDtdReservedCount(void)
+{
+    uint32_t count = 0U;
+
+    for (uint32_t i = 0U; i < (USB_DEVICE_CONFIG_ENDPOINTS * 2U); i++)
+    {
+        count += s_UsbDeviceEhciDtdReservation[i];
+    }
+    return count;
+}
+
+/*!
+ * @brief Get the count of DTDs an endpoint may still take.
+ *
+ * The endpoint takes its unused reservation first, then the shared DTDs.
  *
  * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
  *
+ * @retval The available DTD count.
  */
-static void USB_DeviceEhciSetDefaultState(usb_device_ehci_state_struct_t *ehciState)
+static uint32_t USB_DeviceEhciDtdAvailable(usb_device_ehci_state_struct_t *ehciState, uint32_t index)
+{
+    uint32_t available = (uint32_t)ehciState->dtdSharedCount;
+
+    if (ehciState->dtdUsed[index] < s_UsbDeviceEhciDtdReservation[index])
+    {
+        available += s_UsbDeviceEhciDtdReservation[index] - ehciState->dtdUsed[index];
+    }
+    return available;
+}
+
+/*!
+ * @brief Take a DTD from the free queue for the endpoint.
+ *
+ * The caller has to check USB_DeviceEhciDtdAvailable first.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
+ *
+ * @retval The DTD.
+ */
+static usb_device_ehci_dtd_struct_t *USB_DeviceEhciDtdAlloc(usb_device_ehci_state_struct_t *ehciState, uint32_t index)
+{
+    usb_device_ehci_dtd_struct_t *dtd = ehciState->dtdFree;
+
+    ehciState->dtdFree = (usb_device_ehci_dtd_struct_t *)dtd->nextDtdPointer;
+    ehciState->dtdCount--;
+    if (ehciState->dtdUsed[index] >= s_UsbDeviceEhciDtdReservation[index])
+    {
+        ehciState->dtdSharedCount--;
+    }
+    ehciState->dtdUsed[index]++;
+    return dtd;
+}
+
+/*!
+ * @brief Return a DTD of the endpoint to the free queue.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
+ * @param dtd             The DTD.
+ */
+static void USB_DeviceEhciDtdFree(usb_device_ehci_state_struct_t *ehciState,
+                                  uint32_t index,
+                                  usb_device_ehci_dtd_struct_t *dtd)
+{
+    dtd->nextDtdPointer = (uint32_t)ehciState->dtdFree;
+    ehciState->dtdFree = dtd;
+    ehciState->dtdCount++;
+    if (ehciState->dtdUsed[index] > s_UsbDeviceEhciDtdReservation[index])
+    {
+        ehciState->dtdSharedCount++;
+    }
+    ehciState->dtdUsed[index]--;
+}
+
+/*!
+ * @brief Return a DTD taken off the transferring queue of the endpoint to the free queue.
+ *
+ * The DTDs leave the queue in the order they were linked, USB_DeviceEhciTransfer compares dtdRetired with the
+ * dtdLinked it saw when linking to know whether its DTDs are gone without touching them.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
+ * @param dtd             The DTD.
+ */
+static void USB_DeviceEhciDtdRetire(usb_device_ehci_state_struct_t *ehciState,
+                                    uint32_t index,
+                                    usb_device_ehci_dtd_struct_t *dtd)
+{
+    dtd->dtdTokenUnion.dtdToken = 0U;
+    USB_DeviceEhciDtdFree(ehciState, index, dtd);
+    ehciState->dtdRetired[index]++;
+}
+
+/*!
+ * @brief Take DTDs from the free queue for a transfer of the endpoint.
+ *
+ * The DTDs are linked by nextDtdPointer in the returned order, the last one is not terminated. The caller has to be
+ * in critical section and check USB_DeviceEhciDtdAvailable first.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
+ * @param count           The DTD count, not zero.
+ *
+ * @retval The first DTD.
+ */
+static usb_device_ehci_dtd_struct_t *USB_DeviceEhciDtdAllocChain(usb_device_ehci_state_struct_t *ehciState,
+                                                                 uint32_t index,
+                                                                 uint32_t count)
+{
+    usb_device_ehci_dtd_struct_t *head = USB_DeviceEhciDtdAlloc(ehciState, index);
+    usb_device_ehci_dtd_struct_t *dtd = head;
+
+    while (--count)
+    {
+        dtd->nextDtdPointer = (uint32_t)USB_DeviceEhciDtdAlloc(ehciState, index);
+        dtd = (usb_device_ehci_dtd_struct_t *)dtd->nextDtdPointer;
+    }
+    return head;
+}
+
+/*!
+ * @brief Return a terminated DTD chain of the endpoint to the free queue.
+ *
+ * The caller has to be in critical section.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
+ * @param dtd             The first DTD of the chain.
+ */
+static void USB_DeviceEhciDtdFreeChain(usb_device_ehci_state_struct_t *ehciState,
+                                       uint32_t index,
+                                       usb_device_ehci_dtd_struct_t *dtd)
+{
+    usb_device_ehci_dtd_struct_t *next;
+
+    while (dtd)
+    {
+        next = (dtd->nextDtdPointer & USB_DEVICE_ECHI_DTD_TERMINATE_MASK) ?
+                   NULL :
+                   (usb_device_ehci_dtd_struct_t *)(dtd->nextDtdPointer & USB_DEVICE_ECHI_DTD_POINTER_MASK);
+        dtd->dtdTokenUnion.dtdToken = 0U;
+        USB_DeviceEhciDtdFree(ehciState, index, dtd);
+        dtd = next;
+    }
+}
+
+/*!
+ * @brief Build the DTD free queue from the whole DTD buffer.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ */
+static void USB_DeviceEhciDtdPoolInit(usb_device_ehci_state_struct_t *ehciState)
 {
     usb_device_ehci_dtd_struct_t *p;
 
-    /* Initialize the dtd free queue */
     ehciState->dtdFree = ehciState->dtd;
     p = ehciState->dtdFree;
     for (uint32_t i = 1U; i < USB_DEVICE_CONFIG_EHCI_MAX_DTD; i++)
@@ -158,10 +349,82 @@ static void USB_DeviceEhciSetDefaultState(usb_device_ehci_state_struct_t *ehciSt
     }
     p->nextDtdPointer = 0U;
     ehciState->dtdCount = USB_DEVICE_CONFIG_EHCI_MAX_DTD;
+    ehciState->dtdSharedCount = (int8_t)(USB_DEVICE_CONFIG_EHCI_MAX_DTD - USB_DeviceEhciDtdReservedCount());
+    for (uint32_t i = 0U; i < (USB_DEVICE_CONFIG_ENDPOINTS * 2U); i++)
+    {
+        ehciState->dtdHard[i] = NULL;
+        ehciState->dtdTail[i] = NULL;
+        ehciState->dtdUsed[i] = 0U;
+        ehciState->dtdLinked[i] = 0U;
+        ehciState->dtdRetired[i] = 0U;
+    }
+}
+
+#if (defined(USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS) && (USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS > 0U))
+/*!
+ * @brief Account the cycles of the masked section entered by USB_DEVICE_EHCI_ENTER_CRITICAL.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ */
+static void USB_DeviceEhciCriticalSectionDone(usb_device_ehci_state_struct_t *ehciState)
+{
+    uint32_t cycles = DWT->CYCCNT - ehciState->criticalStart;
+
+    ehciState->criticalLastCycles = cycles;
+    if (cycles > ehciState->criticalMaxCycles)
+    {
+        ehciState->criticalMaxCycles = cycles;
+    }
+}
+#endif
+
+/*!
+ * @brief Check an interrupt threshold is supported by the controller.
+ *
+ * @param threshold       The interrupt threshold in micro-frames.
+ *
+ * @retval 1U if USBCMD ITC accepts the threshold, 0U otherwise.
+ */
+static uint8_t USB_DeviceEhciInterruptThresholdValid(uint32_t threshold)
+{
+    /* ITC takes 0 or a power of two up to 64 micro-frames */
+    return (uint8_t)((threshold <= 64U) && (0U == (threshold & (threshold - 1U))));
+}
 
-    /* Not use interrupt threshold. */
+/*!
+ * @brief Set device controller state to default state.
+ *
+ * The function is used to set device controller state to default state.
+ * The function will be called when USB_DeviceEhciInit called or the control type kUSB_DeviceControlGetEndpointStatus
+ * received in USB_DeviceEhciControl.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ *
+ */
+static void USB_DeviceEhciSetDefaultState(usb_device_ehci_state_struct_t *ehciState)
+{
+    usb_device_ehci_dtd_struct_t *p;
+    usb_device_ehci_dtd_struct_t *next;
+
+    /* Return the queued dtds to the free queue. The dtds taken by a transfer still being prepared stay with it, the
+     * transfer sees the new epoch and returns them itself. */
+    for (uint32_t i = 0U; i < (USB_DEVICE_CONFIG_ENDPOINTS * 2U); i++)
+    {
+        p = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[i] & USB_DEVICE_ECHI_DTD_POINTER_MASK);
+        while (p)
+        {
+            next = (p == ehciState->dtdTail[i]) ?
+                       NULL :
+                       (usb_device_ehci_dtd_struct_t *)(p->nextDtdPointer & USB_DEVICE_ECHI_DTD_POINTER_MASK);
+            USB_DeviceEhciDtdRetire(ehciState, i, p);
+            p = next;
+        }
+    }
+    ehciState->resetEpoch++;
+
+    /* Set the interrupt threshold. */
     ehciState->registerBase->USBCMD &= ~USBHS_USBCMD_ITC_MASK;
-    ehciState->registerBase->USBCMD |= USBHS_USBCMD_ITC(0U);
+    ehciState->registerBase->USBCMD |= USBHS_USBCMD_ITC(ehciState->interruptThreshold);
 
     /* Disable setup lockout, please refer to "Control Endpoint Operation" section in RM. */
     ehciState->registerBase->USBMODE |= USBHS_USBMODE_SLOM_MASK;
@@ -527,12 +790,8 @@ static void USB_DeviceEhciCancelControlPipe(usb_device_ehci_state_struct_t *ehci
             message.length = 0U;
         }
 
-        /* Clear the token field of the dtd. */
-        currentDtd->dtdTokenUnion.dtdToken = 0U;
-        /* Add the dtd to the free dtd queue. */
-        currentDtd->nextDtdPointer = (uint32_t)ehciState->dtdFree;
-        ehciState->dtdFree = currentDtd;
-        ehciState->dtdCount++;
+        /* Clear the token field of the dtd and add it to the free dtd queue. */
+        USB_DeviceEhciDtdRetire(ehciState, index, currentDtd);
 
         /* Get the next in-used dtd. */
         currentDtd =
@@ -540,6 +799,153 @@ static void USB_DeviceEhciCancelControlPipe(usb_device_ehci_state_struct_t *ehci
     }
 }
 
+/*!
+ * @brief Retire the finished DTDs of an endpoint.
+ *
+ * The function walks the DTD queue of the endpoint, notifies the up layer of each finished transfer and primes the
+ * remaining DTDs.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param endpoint        The endpoint number.
+ * @param direction       The endpoint direction, USB_IN or USB_OUT.
+ *
+ */
+static void USB_DeviceEhciTransferDone(usb_device_ehci_state_struct_t *ehciState, uint8_t endpoint, uint8_t direction)
+{
+    uint32_t primeBit;
+    usb_device_ehci_dtd_struct_t *currentDtd;
+    usb_device_callback_message_struct_t message;
+    uint8_t index = (endpoint << 1U) + direction;
+
+    message.buffer = NULL;
+    message.length = 0U;
+    if ((USB_CONTROL_ENDPOINT == endpoint) && (USB_IN == direction))
+    {
+        if (1U == ehciState->qh[index].endpointStatusUnion.endpointStatusBitmap.zlt)
+        {
+            if(!ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.zlt)
+            {
+                /*disable zlt after send zlt*/
+                ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.zlt = 1U;
+            }
+        }
+    }
+    /* Get the in-used dtd of the specified endpoint. */
+    currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
+                                                  USB_DEVICE_ECHI_DTD_POINTER_MASK);
+    while (currentDtd)
+    {
+        uint8_t isTokenDone = 0;
+        /* Get the in-used dtd of the specified endpoint. */
+        currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
+                                                      USB_DEVICE_ECHI_DTD_POINTER_MASK);
+
+        while (currentDtd)
+        {
+            /* Don't handle the active dtd. */
+            if ((currentDtd->dtdTokenUnion.dtdTokenBitmap.status & USB_DEVICE_ECHI_DTD_STATUS_ACTIVE) ||
+                (currentDtd->dtdTokenUnion.dtdTokenBitmap.ioc))
+            {
+                if ((!(currentDtd->dtdTokenUnion.dtdTokenBitmap.status &
+                       USB_DEVICE_ECHI_DTD_STATUS_ACTIVE)) &&
+                    (currentDtd->dtdTokenUnion.dtdTokenBitmap.ioc))
+                {
+                    isTokenDone = 1U;
+                }
+                break;
+            }
+            currentDtd = (usb_device_ehci_dtd_struct_t *)(currentDtd->nextDtdPointer &
+                                                          USB_DEVICE_ECHI_DTD_POINTER_MASK);
+        }
+
+        if ((0 == isTokenDone) && (currentDtd))
+        {
+            break;
+        }
+
+        /* Get the in-used dtd of the specified endpoint. */
+        currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
+                                                      USB_DEVICE_ECHI_DTD_POINTER_MASK);
+        while (currentDtd)
+        {
+            /* Don't handle the active dtd. */
+            if (currentDtd->dtdTokenUnion.dtdTokenBitmap.status & USB_DEVICE_ECHI_DTD_STATUS_ACTIVE)
+            {
+                break;
+            }
+
+            /* Save the transfer buffer address */
+            if (NULL == message.buffer)
+            {
+                message.buffer =
+                    (uint8_t *)((currentDtd->bufferPointerPage[0] & USB_DEVICE_ECHI_DTD_PAGE_MASK) |
+                                (currentDtd->reservedUnion.originalBufferInfo.originalBufferOffest));
+            }
+            /* Save the transferred data length */
+            message.length += (currentDtd->reservedUnion.originalBufferInfo.originalBufferLength -
+                               currentDtd->dtdTokenUnion.dtdTokenBitmap.totalBytes);
+
+            /* Move the dtd queue head pointer to next */
+            if (ehciState->dtdHard[index] == ehciState->dtdTail[index])
+            {
+                ehciState->dtdHard[index] = NULL;
+                ehciState->dtdTail[index] = NULL;
+                ehciState->qh[index].nextDtdPointer = USB_DEVICE_ECHI_DTD_TERMINATE_MASK;
+                ehciState->qh[index].dtdTokenUnion.dtdToken = 0U;
+            }
+            else
+            {
+                ehciState->dtdHard[index] =
+                    (usb_device_ehci_dtd_struct_t *)ehciState->dtdHard[index]->nextDtdPointer;
+            }
+
+            /* When the ioc is set or the dtd queue is empty, the up layer will be notified. */
+            if ((currentDtd->dtdTokenUnion.dtdTokenBitmap.ioc) ||
+                (0 == ((uint32_t)ehciState->dtdHard[index] & USB_DEVICE_ECHI_DTD_POINTER_MASK)))
+            {
+                message.code = endpoint | (uint8_t)((uint32_t)direction << 0x07U);
+                message.isSetup = 0U;
+                USB_DeviceNotificationTrigger(ehciState->deviceHandle, &message);
+                message.buffer = NULL;
+                message.length = 0U;
+            }
+            /* Clear the token field of the dtd and add it to the free dtd queue */
+            USB_DeviceEhciDtdRetire(ehciState, index, currentDtd);
+            /* Get the next in-used dtd */
+            currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
+                                                          USB_DEVICE_ECHI_DTD_POINTER_MASK);
+
+            if ((NULL != currentDtd) &&
+                (currentDtd->dtdTokenUnion.dtdTokenBitmap.status & USB_DEVICE_ECHI_DTD_STATUS_ACTIVE))
+            {
+                primeBit = 1U << (endpoint + 16U * direction);
+
+                /* Try to prime the next dtd. */
+                ehciState->registerBase->EPPRIME = primeBit;
+
+                /* Whether the endpoint transmit/receive buffer is ready or not. If not, wait for prime bit
+                 * cleared and prime the next dtd. */
+                if (!(ehciState->registerBase->EPSR & primeBit))
+                {
+                    /* Wait for the endpoint prime bit cleared by HW */
+                    while (ehciState->registerBase->EPPRIME & primeBit)
+                    {
+                    }
+
+                    /* If the endpoint transmit/receive buffer is not ready */
+                    if (!(ehciState->registerBase->EPSR & primeBit))
+                    {
+                        /* Prime next dtd and prime the transfer */
+                        ehciState->qh[index].nextDtdPointer = (uint32_t)currentDtd;
+                        ehciState->qh[index].dtdTokenUnion.dtdToken = 0U;
+                        ehciState->registerBase->EPPRIME = primeBit;
+                    }
+                }
+            }
+        }
+    }
+}
+
 /*!
  * @brief Handle the endpoint token done interrupt.
  *
@@ -551,13 +957,10 @@ static void USB_DeviceEhciCancelControlPipe(usb_device_ehci_state_struct_t *ehci
 static void USB_DeviceEhciInterruptTokenDone(usb_device_ehci_state_struct_t *ehciState)
 {
     uint32_t status;
-    uint32_t primeBit;
-    usb_device_ehci_dtd_struct_t *currentDtd;
     usb_device_callback_message_struct_t message;
     uint8_t endpoint;
     uint8_t direction;
     uint8_t count;
-    uint8_t index;
 
     /* Get the EPSETUPSR to check the setup packect received in which one endpoint. */
     status = ehciState->registerBase->EPSETUPSR;
@@ -590,163 +993,24 @@ static void USB_DeviceEhciInterruptTokenDone(usb_device_ehci_state_struct_t *ehc
             }
         }
     }
-    /* Read the USBHS_EPCOMPLETE_REG to get the endpoint transfer done status */
-    status = ehciState->registerBase->EPCOMPLETE;
-    /* Clear the endpoint transfer done status */
-    ehciState->registerBase->EPCOMPLETE = status;
-
-    if (status)
+    /* Retire the transfers of all endpoints marked in USBHS_EPCOMPLETE_REG, and read it again so the transfers done
+     * in the meantime are handled in the same pass instead of taking another interrupt. */
+    while (0U != (status = ehciState->registerBase->EPCOMPLETE))
     {
-        for (count = 0U; count < 32U; count++)
+        /* Clear the endpoint transfer done status */
+        ehciState->registerBase->EPCOMPLETE = status;
+        status &= USB_DEVICE_EHCI_EPCOMPLETE_MASK;
+        while (status)
         {
-            /* Check the transfer is done or not in the specified endpoint. */
-            if (status & ((uint32_t)(1U << count)))
+            count = (uint8_t)USB_DEVICE_EHCI_CTZ(status);
+            status &= status - 1U;
+            if (count > 15U)
             {
-                if (count > 15U)
-                {
-                    endpoint = count - 16U;
-                    direction = USB_IN;
-                }
-                else
-                {
-                    endpoint = count;
-                    direction = USB_OUT;
-                }
-                if (endpoint >= USB_DEVICE_CONFIG_ENDPOINTS)
-                {
-                    continue;
-                }
-                index = (endpoint << 1U) + direction;
-                message.buffer = NULL;
-                message.length = 0U;
-                if ((USB_CONTROL_ENDPOINT == endpoint) && (USB_IN == direction))
-                {
-                    if (1U == ehciState->qh[index].endpointStatusUnion.endpointStatusBitmap.zlt)
-                    {
-                        if(!ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.zlt)
-                        {
-                            /*disable zlt after send zlt*/
-                            ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.zlt = 1U;
-                        }
-                    }
-                }
-                /* Get the in-used dtd of the specified endpoint. */
-                currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
-                                                              USB_DEVICE_ECHI_DTD_POINTER_MASK);
-                while (currentDtd)
-                {
-                    uint8_t isTokenDone = 0;
-                    /* Get the in-used dtd of the specified endpoint. */
-                    currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
-                                                                  USB_DEVICE_ECHI_DTD_POINTER_MASK);
-
-                    while (currentDtd)
-                    {
-                        /* Don't handle the active dtd. */
-                        if ((currentDtd->dtdTokenUnion.dtdTokenBitmap.status & USB_DEVICE_ECHI_DTD_STATUS_ACTIVE) ||
-                            (currentDtd->dtdTokenUnion.dtdTokenBitmap.ioc))
-                        {
-                            if ((!(currentDtd->dtdTokenUnion.dtdTokenBitmap.status &
-                                   USB_DEVICE_ECHI_DTD_STATUS_ACTIVE)) &&
-                                (currentDtd->dtdTokenUnion.dtdTokenBitmap.ioc))
-                            {
-                                isTokenDone = 1U;
-                            }
-                            break;
-                        }
-                        currentDtd = (usb_device_ehci_dtd_struct_t *)(currentDtd->nextDtdPointer &
-                                                                      USB_DEVICE_ECHI_DTD_POINTER_MASK);
-                    }
-
-                    if ((0 == isTokenDone) && (currentDtd))
-                    {
-                        break;
-                    }
-
-                    /* Get the in-used dtd of the specified endpoint. */
-                    currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
-                                                                  USB_DEVICE_ECHI_DTD_POINTER_MASK);
-                    while (currentDtd)
-                    {
-                        /* Don't handle the active dtd. */
-                        if (currentDtd->dtdTokenUnion.dtdTokenBitmap.status & USB_DEVICE_ECHI_DTD_STATUS_ACTIVE)
-                        {
-                            break;
-                        }
-
-                        /* Save the transfer buffer address */
-                        if (NULL == message.buffer)
-                        {
-                            message.buffer =
-                                (uint8_t *)((currentDtd->bufferPointerPage[0] & USB_DEVICE_ECHI_DTD_PAGE_MASK) |
-                                            (currentDtd->reservedUnion.originalBufferInfo.originalBufferOffest));
-                        }
-                        /* Save the transferred data length */
-                        message.length += (currentDtd->reservedUnion.originalBufferInfo.originalBufferLength -
-                                           currentDtd->dtdTokenUnion.dtdTokenBitmap.totalBytes);
-
-                        /* Move the dtd queue head pointer to next */
-                        if (ehciState->dtdHard[index] == ehciState->dtdTail[index])
-                        {
-                            ehciState->dtdHard[index] = NULL;
-                            ehciState->dtdTail[index] = NULL;
-                            ehciState->qh[index].nextDtdPointer = USB_DEVICE_ECHI_DTD_TERMINATE_MASK;
-                            ehciState->qh[index].dtdTokenUnion.dtdToken = 0U;
-                        }
-                        else
-                        {
-                            ehciState->dtdHard[index] =
-                                (usb_device_ehci_dtd_struct_t *)ehciState->dtdHard[index]->nextDtdPointer;
-                        }
-
-                        /* When the ioc is set or the dtd queue is empty, the up layer will be notified. */
-                        if ((currentDtd->dtdTokenUnion.dtdTokenBitmap.ioc) ||
-                            (0 == ((uint32_t)ehciState->dtdHard[index] & USB_DEVICE_ECHI_DTD_POINTER_MASK)))
-                        {
-                            message.code = endpoint | (uint8_t)((uint32_t)direction << 0x07U);
-                            message.isSetup = 0U;
-                            USB_DeviceNotificationTrigger(ehciState->deviceHandle, &message);
-                            message.buffer = NULL;
-                            message.length = 0U;
-                        }
-                        /* Clear the token field of the dtd */
-                        currentDtd->dtdTokenUnion.dtdToken = 0U;
-                        currentDtd->nextDtdPointer = (uint32_t)ehciState->dtdFree;
-                        ehciState->dtdFree = currentDtd;
-                        ehciState->dtdCount++;
-                        /* Get the next in-used dtd */
-                        currentDtd = (usb_device_ehci_dtd_struct_t *)((uint32_t)ehciState->dtdHard[index] &
-                                                                      USB_DEVICE_ECHI_DTD_POINTER_MASK);
-
-                        if ((NULL != currentDtd) &&
-                            (currentDtd->dtdTokenUnion.dtdTokenBitmap.status & USB_DEVICE_ECHI_DTD_STATUS_ACTIVE))
-                        {
-                            primeBit = 1U << (endpoint + 16U * direction);
-
-                            /* Try to prime the next dtd. */
-                            ehciState->registerBase->EPPRIME = primeBit;
-
-                            /* Whether the endpoint transmit/receive buffer is ready or not. If not, wait for prime bit
-                             * cleared and prime the next dtd. */
-                            if (!(ehciState->registerBase->EPSR & primeBit))
-                            {
-                                /* Wait for the endpoint prime bit cleared by HW */
-                                while (ehciState->registerBase->EPPRIME & primeBit)
-                                {
-                                }
-
-                                /* If the endpoint transmit/receive buffer is not ready */
-                                if (!(ehciState->registerBase->EPSR & primeBit))
-                                {
-                                    /* Prime next dtd and prime the transfer */
-                                    ehciState->qh[index].nextDtdPointer = (uint32_t)currentDtd;
-                                    ehciState->qh[index].dtdTokenUnion.dtdToken = 0U;
-                                    ehciState->registerBase->EPPRIME = primeBit;
-                                }
-                            }
-                        }
-                    }
-                }
+                USB_DeviceEhciTransferDone(ehciState, count - 16U, USB_IN);
+            }
+            else
+            {
+                USB_DeviceEhciTransferDone(ehciState, count, USB_OUT);
             }
         }
     }
@@ -887,43 +1151,212 @@ static void USB_DeviceEhciInterruptSuspend(usb_device_ehci_state_struct_t *ehciS
 #endif /* USB_DEVICE_CONFIG_LOW_POWER_MODE */
 
 /*!
- * @brief Get dtds and link to QH.
+ * @brief Map transfer segments onto dtds.
  *
- * The function is used to get dtds and link to QH.
+ * Data of one segment is split into dtds of up to USB_DEVICE_ECHI_DTD_TOTAL_BYTES. Adjacent segments share a dtd
+ * when the data before ends on a page boundary and the next segment starts on one, the page pointers of a dtd do not
+ * need to be contiguous. Otherwise the next segment starts a new dtd, which is only allowed after a multiple of the
+ * max packet size, as the controller ends the packet at the end of each dtd.
+ *
+ * The dtds are only counted when dtdHead is NULL. Otherwise they are filled in the order of the chain *dtdHead points
+ * to, which is got from USB_DeviceEhciDtdAllocChain for the counted dtds. The chain is not seen by the controller or
+ * the ISR yet, so it is filled with interrupts enabled.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param index           The endpoint index, endpoint number * 2 + direction.
+ * @param segments        The transfer segments.
+ * @param segmentCount    The count of the transfer segments.
+ * @param dtdCount        Returns the dtd count of the transfer.
+ * @param dtdHead         The dtds to fill, the last one is terminated and has the IOC set.
+ *
+ * @retval kStatus_USB_Success              The segments are mapped.
+ * @retval kStatus_USB_InvalidParameter     The segments would end a packet in the middle of the transfer.
+ */
+static usb_status_t USB_DeviceEhciDtdMap(usb_device_ehci_state_struct_t *ehciState,
+                                         uint32_t index,
+                                         const usb_device_transfer_segment_struct_t *segments,
+                                         uint32_t segmentCount,
+                                         uint32_t *dtdCount,
+                                         usb_device_ehci_dtd_struct_t **dtdHead)
+{
+    usb_device_ehci_dtd_struct_t *dtd = NULL;
+    usb_device_ehci_dtd_struct_t *next;
+    usb_device_ehci_dtd_struct_t *chain = (dtdHead) ? *dtdHead : NULL;
+    uint32_t maxPacketSize =
+        ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.maxPacketSize;
+    uint32_t count = 0U;
+    uint32_t dtdLength = 0U;
+    uint32_t dataEnd = 0U;
+    uint32_t pageLimit = 0U;
+    uint32_t pageCount = 0U;
+    uint32_t address;
+    uint32_t remaining;
+    uint32_t capacity;
+    uint32_t segment = 0U;
+
+    do
+    {
+        address = (uint32_t)segments[segment].buffer;
+        remaining = segments[segment].length;
+        /* A zero length transfer still takes one dtd */
+        while ((remaining) || ((!count) && ((segment + 1U) == segmentCount)))
+        {
+            capacity = 0U;
+            if (count)
+            {
+                if (address == dataEnd)
+                {
+                    capacity = (pageLimit - dataEnd) +
+                               (USB_DEVICE_ECHI_DTD_PAGE_COUNT - pageCount) * USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+                }
+                else if ((!(dataEnd & USB_DEVICE_ECHI_DTD_PAGE_OFFSET_MASK)) &&
+                         (!(address & USB_DEVICE_ECHI_DTD_PAGE_OFFSET_MASK)))
+                {
+                    capacity = (USB_DEVICE_ECHI_DTD_PAGE_COUNT - pageCount) * USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+                }
+                if (capacity > (USB_DEVICE_ECHI_DTD_TOTAL_BYTES - dtdLength))
+                {
+                    capacity = USB_DEVICE_ECHI_DTD_TOTAL_BYTES - dtdLength;
+                }
+                /* A segment starting a new dtd would end a short packet */
+                if ((!capacity) && (address != dataEnd) && ((!maxPacketSize) || (dtdLength % maxPacketSize)))
+                {
+                    return kStatus_USB_InvalidParameter;
+                }
+            }
+
+            if (!capacity)
+            {
+                /* Start a new dtd */
+                count++;
+                dtdLength = 0U;
+                dataEnd = address;
+                pageCount = 1U;
+                pageLimit = (address & USB_DEVICE_ECHI_DTD_PAGE_MASK) + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+                capacity = USB_DEVICE_ECHI_DTD_TOTAL_BYTES;
+                if (dtdHead)
+                {
+                    next = chain;
+                    chain = (usb_device_ehci_dtd_struct_t *)next->nextDtdPointer;
+                    next->nextDtdPointer = USB_DEVICE_ECHI_DTD_TERMINATE_MASK;
+                    next->dtdTokenUnion.dtdToken = 0U;
+                    next->bufferPointerPage[0] = address;
+                    next->bufferPointerPage[1] = pageLimit;
+                    next->bufferPointerPage[2] = next->bufferPointerPage[1] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+                    next->bufferPointerPage[3] = next->bufferPointerPage[2] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+                    next->bufferPointerPage[4] = next->bufferPointerPage[3] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+                    /* Save the original buffer address */
+                    next->reservedUnion.originalBufferInfo.originalBufferOffest =
+                        address & USB_DEVICE_ECHI_DTD_PAGE_OFFSET_MASK;
+                    next->reservedUnion.originalBufferInfo.dtdInvalid = 0U;
+                    /* Set dtd active, the controller does not see it before the transfer is linked to the QH */
+                    next->dtdTokenUnion.dtdTokenBitmap.status = USB_DEVICE_ECHI_DTD_STATUS_ACTIVE;
+                    if (dtd)
+                    {
+                        dtd->nextDtdPointer = (uint32_t)next;
+                    }
+                    dtd = next;
+                }
+            }
+            else if (address != dataEnd)
+            {
+                /* The segment continues the dtd at the next page pointer */
+                if (dtd)
+                {
+                    dtd->bufferPointerPage[pageCount] = address;
+                }
+                pageCount++;
+                pageLimit = address + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+            }
+            else
+            {
+            }
+
+            if (capacity > remaining)
+            {
+                capacity = remaining;
+            }
+            dataEnd = address + capacity;
+            while (dataEnd > pageLimit)
+            {
+                if (dtd)
+                {
+                    dtd->bufferPointerPage[pageCount] = pageLimit;
+                }
+                pageCount++;
+                pageLimit += USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
+            }
+            dtdLength += capacity;
+            address += capacity;
+            remaining -= capacity;
+
+            if (dtd)
+            {
+                dtd->dtdTokenUnion.dtdTokenBitmap.totalBytes = dtdLength;
+                /* Save the data length needed to be transferred. */
+                dtd->reservedUnion.originalBufferInfo.originalBufferLength = dtdLength;
+            }
+        }
+        segment++;
+    } while (segment < segmentCount);
+
+    /* Set the IOC field in last dtd. */
+    if (dtd)
+    {
+        dtd->dtdTokenUnion.dtdTokenBitmap.ioc = 1U;
+    }
+    *dtdCount = count;
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Get dtds for transfer segments and link to QH.
+ *
+ * The function is used to get dtds for transfer segments and link to QH, the segments are transferred as one
+ * transfer. Interrupts are only masked to take the dtds, to link them and to check the prime, the dtds are filled
+ * and the prime is waited for with interrupts enabled.
  *
  * @param ehciState       Pointer of the device EHCI state structure.
  * @param endpointAddress The endpoint address, Bit7, 0U - USB_OUT, 1U - USB_IN.
- * @param buffer           The memory address needed to be transferred.
- * @param length           Data length.
+ * @param segments        The transfer segments.
+ * @param segmentCount    The count of the transfer segments.
  *
  * @return A USB error code or kStatus_USB_Success.
  */
-static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciState,
-                                           uint8_t endpointAddress,
-                                           uint8_t *buffer,
-                                           uint32_t length)
+static usb_status_t USB_DeviceEhciTransferV(usb_device_ehci_state_struct_t *ehciState,
+                                            uint8_t endpointAddress,
+                                            const usb_device_transfer_segment_struct_t *segments,
+                                            uint32_t segmentCount)
 {
-    usb_device_ehci_dtd_struct_t *dtd;
     usb_device_ehci_dtd_struct_t *dtdHard;
+    usb_device_ehci_dtd_struct_t *dtdLast;
     uint32_t index = ((endpointAddress & USB_ENDPOINT_NUMBER_MASK) << 1U) |
                      ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
                       USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT);
     uint32_t primeBit = 1U << ((endpointAddress & USB_ENDPOINT_NUMBER_MASK) +
                                ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >> 0x03U));
     uint32_t epStatus = primeBit;
-    uint32_t sendLength;
-    uint32_t currentIndex = 0U;
-    uint32_t dtdRequestCount = (length + USB_DEVICE_ECHI_DTD_TOTAL_BYTES - 1U) / USB_DEVICE_ECHI_DTD_TOTAL_BYTES;
+    uint32_t length = 0U;
+    uint32_t dtdRequestCount;
     uint8_t qhIdle = 0U;
     uint8_t waitingSafelyAccess = 1U;
+    uint8_t waitingPrime = 0U;
+    uint8_t resetEpoch;
+    uint32_t linkedBefore;
     uint32_t primeTimesCount = 0U;
-    OSA_SR_ALLOC();
+    usb_status_t error;
+    USB_OSA_SR_ALLOC();
 
     if (!ehciState)
     {
         return kStatus_USB_InvalidHandle;
     }
 
+    if ((!segments) || (!segmentCount))
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+
     if (0U == ehciState->qh[index].endpointStatusUnion.endpointStatusBitmap.isOpened)
     {
         return kStatus_USB_Error;
@@ -934,88 +1367,63 @@ static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciS
         return kStatus_USB_Error;
     }
 
-    if (!dtdRequestCount)
+    for (uint32_t count = 0U; count < segmentCount; count++)
     {
-        dtdRequestCount = 1U;
+        length += segments[count].length;
     }
 
-    OSA_ENTER_CRITICAL();
-    /* The free dtd count need to not less than the transfer requests. */
-    if (dtdRequestCount > (uint32_t)ehciState->dtdCount)
+    /* Count the dtds before taking any of them */
+    error = USB_DeviceEhciDtdMap(ehciState, index, segments, segmentCount, &dtdRequestCount, NULL);
+    if (kStatus_USB_Success != error)
     {
-        OSA_EXIT_CRITICAL();
-        return kStatus_USB_Busy;
+        return error;
     }
 
-    do
+    /* Only take the dtds with interrupts masked */
+    USB_DEVICE_EHCI_ENTER_CRITICAL(ehciState);
+    /* The dtd count available to the endpoint need to not less than the transfer requests. */
+    if (dtdRequestCount > USB_DeviceEhciDtdAvailable(ehciState, index))
     {
-        /* The transfer length need to not more than USB_DEVICE_ECHI_DTD_TOTAL_BYTES for each dtd. */
-        if (length > USB_DEVICE_ECHI_DTD_TOTAL_BYTES)
-        {
-            sendLength = USB_DEVICE_ECHI_DTD_TOTAL_BYTES;
-        }
-        else
-        {
-            sendLength = length;
-        }
-        length -= sendLength;
-
-        /* Get a free dtd */
-        dtd = ehciState->dtdFree;
-
-        ehciState->dtdFree = (usb_device_ehci_dtd_struct_t *)dtd->nextDtdPointer;
-        ehciState->dtdCount--;
-
-        /* Save the dtd head when current active buffer offset is zero. */
-        if (!currentIndex)
-        {
-            dtdHard = dtd;
-        }
-
-        /* Set the dtd field */
-        dtd->nextDtdPointer = USB_DEVICE_ECHI_DTD_TERMINATE_MASK;
-        dtd->dtdTokenUnion.dtdToken = 0U;
-        dtd->bufferPointerPage[0] = (uint32_t)(buffer + currentIndex);
-        dtd->bufferPointerPage[1] =
-            (dtd->bufferPointerPage[0] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK) & USB_DEVICE_ECHI_DTD_PAGE_MASK;
-        dtd->bufferPointerPage[2] = dtd->bufferPointerPage[1] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
-        dtd->bufferPointerPage[3] = dtd->bufferPointerPage[2] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
-        dtd->bufferPointerPage[4] = dtd->bufferPointerPage[3] + USB_DEVICE_ECHI_DTD_PAGE_BLOCK;
-
-        dtd->dtdTokenUnion.dtdTokenBitmap.totalBytes = sendLength;
-
-        /* Save the data length needed to be transferred. */
-        dtd->reservedUnion.originalBufferInfo.originalBufferLength = sendLength;
-        /* Save the original buffer address */
-        dtd->reservedUnion.originalBufferInfo.originalBufferOffest =
-            dtd->bufferPointerPage[0] & USB_DEVICE_ECHI_DTD_PAGE_OFFSET_MASK;
-        dtd->reservedUnion.originalBufferInfo.dtdInvalid = 0U;
-
-        /* Set the IOC field in last dtd. */
-        if (!length)
-        {
-            dtd->dtdTokenUnion.dtdTokenBitmap.ioc = 1U;
-        }
+        ehciState->dtdExhausted[index]++;
+        USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
+        return kStatus_USB_Busy;
+    }
+    dtdHard = USB_DeviceEhciDtdAllocChain(ehciState, index, dtdRequestCount);
+    resetEpoch = ehciState->resetEpoch;
+    USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
 
-        /* Set dtd active */
-        dtd->dtdTokenUnion.dtdTokenBitmap.status = USB_DEVICE_ECHI_DTD_STATUS_ACTIVE;
+    (void)USB_DeviceEhciDtdMap(ehciState, index, segments, segmentCount, &dtdRequestCount, &dtdHard);
+    dtdLast = dtdHard;
+    while (!(dtdLast->nextDtdPointer & USB_DEVICE_ECHI_DTD_TERMINATE_MASK))
+    {
+        dtdLast = (usb_device_ehci_dtd_struct_t *)dtdLast->nextDtdPointer;
+    }
 
-        /* Move the buffer offset index */
-        currentIndex += sendLength;
+    /* Link and prime with interrupts masked */
+    USB_DEVICE_EHCI_ENTER_CRITICAL(ehciState);
+    /* The endpoint is closed or reset while the dtds are filled */
+    if ((resetEpoch != ehciState->resetEpoch) ||
+        (0U == ehciState->qh[index].endpointStatusUnion.endpointStatusBitmap.isOpened))
+    {
+        USB_DeviceEhciDtdFreeChain(ehciState, index, dtdHard);
+        USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
+        return kStatus_USB_Error;
+    }
 
-        /* Add dtd to the in-used dtd queue */
-        if (ehciState->dtdTail[index])
-        {
-            ehciState->dtdTail[index]->nextDtdPointer = (uint32_t)dtd;
-            ehciState->dtdTail[index] = dtd;
-        }
-        else
-        {
-            ehciState->dtdHard[index] = dtd;
-            ehciState->dtdTail[index] = dtd;
-            qhIdle = 1U;
-        }
-    } while (length);
+    /* Add dtds to the in-used dtd queue */
+    linkedBefore = ehciState->dtdLinked[index];
+    ehciState->dtdLinked[index] += dtdRequestCount;
+    if (ehciState->dtdTail[index])
+    {
+        ehciState->dtdTail[index]->nextDtdPointer = (uint32_t)dtdHard;
+        ehciState->dtdTail[index] = dtdLast;
+    }
+    else
+    {
+        ehciState->dtdHard[index] = dtdHard;
+        ehciState->dtdTail[index] = dtdLast;
+        qhIdle = 1U;
+    }
     if ((USB_CONTROL_ENDPOINT == (endpointAddress & USB_ENDPOINT_NUMBER_MASK)) && (USB_IN == ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
                       USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT)))
     {
@@ -1025,7 +1433,7 @@ static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciS
                     (usb_setup_struct_t *)&ehciState->qh[setupindex].setupBufferBack[0];
         if (1U == ehciState->qh[index].endpointStatusUnion.endpointStatusBitmap.zlt)
         {
-            if ((sendLength) && (sendLength < deviceSetup->wLength) && (!(sendLength % ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.maxPacketSize)))
+            if ((length) && (length < deviceSetup->wLength) && (!(length % ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.maxPacketSize)))
             {
                 /* enable ZLT. */
                 ehciState->qh[index].capabilttiesCharacteristicsUnion.capabilttiesCharacteristicsBitmap.zlt = 0U;
@@ -1038,7 +1446,7 @@ static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciS
         /* If the prime bit is set, nothing need to do. */
         if (ehciState->registerBase->EPPRIME & primeBit)
         {
-            OSA_EXIT_CRITICAL();
+            USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
             return kStatus_USB_Success;
         }
 
@@ -1066,29 +1474,60 @@ static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciS
         ehciState->qh[index].nextDtdPointer = (uint32_t)dtdHard;
         ehciState->qh[index].dtdTokenUnion.dtdToken = 0U;
         ehciState->registerBase->EPPRIME = primeBit;
-        while (!(ehciState->registerBase->EPSR & primeBit))
+        waitingPrime = 1U;
+    }
+    USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
+
+    /* Wait for the controller to take the prime, interrupts are only masked to check it once per round */
+    while (waitingPrime)
+    {
+        USB_DEVICE_EHCI_ENTER_CRITICAL(ehciState);
+        /* Done when the endpoint is primed, the dtds are completed or the transfer is gone by cancel or reset. The dtds
+         * may be back in the free queue and reused, so only the counters are checked, never the dtds. */
+        if ((ehciState->registerBase->EPSR & primeBit) || (ehciState->registerBase->EPCOMPLETE & primeBit) ||
+            (resetEpoch != ehciState->resetEpoch) || ((int32_t)(ehciState->dtdRetired[index] - linkedBefore) > 0))
         {
-            primeTimesCount++;
-            if (primeTimesCount == USB_DEVICE_MAX_TRANSFER_PRIME_TIMES)
-            {
-                OSA_EXIT_CRITICAL();
-                return kStatus_USB_Error;
-            }
-            if (ehciState->registerBase->EPCOMPLETE & primeBit)
-            {
-                break;
-            }
-            else
-            {
-                ehciState->registerBase->EPPRIME = primeBit;
-            }
+            waitingPrime = 0U;
+        }
+        else if (++primeTimesCount == USB_DEVICE_MAX_TRANSFER_PRIME_TIMES)
+        {
+            USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
+            return kStatus_USB_Error;
+        }
+        else
+        {
+            ehciState->registerBase->EPPRIME = primeBit;
         }
+        USB_DEVICE_EHCI_EXIT_CRITICAL(ehciState);
     }
 
-    OSA_EXIT_CRITICAL();
     return kStatus_USB_Success;
 }
 
+/*!
+ * @brief Get dtds and link to QH.
+ *
+ * The function is used to get dtds and link to QH.
+ *
+ * @param ehciState       Pointer of the device EHCI state structure.
+ * @param endpointAddress The endpoint address, Bit7, 0U - USB_OUT, 1U - USB_IN.
+ * @param buffer           The memory address needed to be transferred.
+ * @param length           Data length.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceEhciTransfer(usb_device_ehci_state_struct_t *ehciState,
+                                           uint8_t endpointAddress,
+                                           uint8_t *buffer,
+                                           uint32_t length)
+{
+    usb_device_transfer_segment_struct_t segment;
+
+    segment.buffer = buffer;
+    segment.length = length;
+    return USB_DeviceEhciTransferV(ehciState, endpointAddress, &segment, 1U);
+}
+
 /*!
  * @brief Get a valid device EHCI state for the device EHCI instance.
  *
@@ -1253,13 +1692,33 @@ usb_status_t USB_DeviceEhciInit(uint8_t controllerId,
     {
         return kStatus_USB_Error;
     }
+
+    /* Endpoint reservations have to fit into the DTD buffer. */
+    if (USB_DeviceEhciDtdReservedCount() > USB_DEVICE_CONFIG_EHCI_MAX_DTD)
+    {
+        return kStatus_USB_Error;
+    }
+    if (!USB_DeviceEhciInterruptThresholdValid(USB_DEVICE_CONFIG_EHCI_INTERRUPT_THRESHOLD))
+    {
+        return kStatus_USB_Error;
+    }
+    ehciState->interruptThreshold = USB_DEVICE_CONFIG_EHCI_INTERRUPT_THRESHOLD;
     ehciState->deviceHandle = (usb_device_struct_t *)handle;
 
     /* Clear the controller mode field and set to device mode. */
     ehciState->registerBase->USBMODE &= ~USBHS_USBMODE_CM_MASK;
     ehciState->registerBase->USBMODE |= USBHS_USBMODE_CM(0x02U);
 
+#if (defined(USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS) && (USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS > 0U))
+    /* Start the cycle counter measuring the masked sections. */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    ehciState->criticalLastCycles = 0U;
+    ehciState->criticalMaxCycles = 0U;
+#endif
+
     /* Set the EHCI to default status. */
+    USB_DeviceEhciDtdPoolInit(ehciState);
     USB_DeviceEhciSetDefaultState(ehciState);
     *ehciHandle = (usb_device_controller_handle)ehciState;
 #if (defined(USB_DEVICE_CONFIG_CHARGER_DETECT) && (USB_DEVICE_CONFIG_CHARGER_DETECT > 0U)) && \
@@ -1383,6 +1842,30 @@ usb_status_t USB_DeviceEhciSend(usb_device_controller_handle ehciHandle,
         buffer, length);
 }
 
+/*!
+ * @brief Send data of several buffers through a specified endpoint.
+ *
+ * The buffers are sent as one transfer, see USB_DeviceEhciDtdMap for the alignment they need.
+ *
+ * @param ehciHandle      Pointer of the device EHCI handle.
+ * @param endpointAddress Endpoint index.
+ * @param segments        The buffers to be sent in order.
+ * @param segmentCount    The count of the buffers.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceEhciSendV(usb_device_controller_handle ehciHandle,
+                                 uint8_t endpointAddress,
+                                 const usb_device_transfer_segment_struct_t *segments,
+                                 uint32_t segmentCount)
+{
+    /* Add dtds to the QH */
+    return USB_DeviceEhciTransferV(
+        (usb_device_ehci_state_struct_t *)ehciHandle,
+        (endpointAddress & USB_ENDPOINT_NUMBER_MASK) | (USB_IN << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT),
+        segments, segmentCount);
+}
+
 /*!
  * @brief Receive data through a specified endpoint.
  *
@@ -1442,6 +1925,8 @@ usb_status_t USB_DeviceEhciCancel(usb_device_controller_handle ehciHandle, uint8
         return kStatus_USB_InvalidHandle;
     }
 
+    /* The cancelled transfers are notified with interrupts masked, the notification may call the RTOS, so the RTOS
+     * aware critical section is taken here instead of the USB lock. */
     OSA_ENTER_CRITICAL();
 
     message.buffer = NULL;
@@ -1521,12 +2006,8 @@ usb_status_t USB_DeviceEhciCancel(usb_device_controller_handle ehciHandle, uint8
                 USB_DeviceNotificationTrigger(ehciState->deviceHandle, &message);
                 message.buffer = NULL;
             }
-            /* Clear the token field. */
-            currentDtd->dtdTokenUnion.dtdToken = 0U;
-            /* Save the dtd to the free queue. */
-            currentDtd->nextDtdPointer = (uint32_t)ehciState->dtdFree;
-            ehciState->dtdFree = currentDtd;
-            ehciState->dtdCount++;
+            /* Clear the token field and save the dtd to the free queue. */
+            USB_DeviceEhciDtdRetire(ehciState, index, currentDtd);
         }
         /* Get the next dtd. */
         currentDtd =
@@ -1665,6 +2146,85 @@ usb_status_t USB_DeviceEhciControl(usb_device_controller_handle ehciHandle, usb_
             break;
         case kUSB_DeviceControlGetSynchFrame:
             break;
+        case kUSB_DeviceControlGetTransferResourceStatus:
+            if (param)
+            {
+                usb_device_transfer_resource_status_struct_t *resourceStatus =
+                    (usb_device_transfer_resource_status_struct_t *)param;
+                uint8_t ep = (resourceStatus->endpointAddress) & USB_ENDPOINT_NUMBER_MASK;
+                uint8_t direction =
+                    ((resourceStatus->endpointAddress) & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                    USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
+
+                if (ep < USB_DEVICE_CONFIG_ENDPOINTS)
+                {
+                    uint32_t index = ((uint32_t)ep << 1U) | direction;
+
+                    resourceStatus->reserved = s_UsbDeviceEhciDtdReservation[index];
+                    resourceStatus->inUse = ehciState->dtdUsed[index];
+                    resourceStatus->sharedFree = (uint8_t)ehciState->dtdSharedCount;
+                    resourceStatus->exhausted = ehciState->dtdExhausted[index];
+                    error = kStatus_USB_Success;
+                }
+                else
+                {
+                    error = kStatus_USB_InvalidParameter;
+                }
+            }
+            break;
+        case kUSB_DeviceControlGetInterruptThreshold:
+            if (param)
+            {
+                temp8 = (uint8_t *)param;
+                *temp8 = ehciState->interruptThreshold;
+                error = kStatus_USB_Success;
+            }
+            break;
+        case kUSB_DeviceControlSetInterruptThreshold:
+            if (param)
+            {
+                temp8 = (uint8_t *)param;
+                if (USB_DeviceEhciInterruptThresholdValid(*temp8))
+                {
+                    USB_OSA_SR_ALLOC();
+
+                    USB_OSA_ENTER_CRITICAL();
+                    ehciState->interruptThreshold = *temp8;
+                    ehciState->registerBase->USBCMD =
+                        (ehciState->registerBase->USBCMD & ~USBHS_USBCMD_ITC_MASK) | USBHS_USBCMD_ITC(*temp8);
+                    USB_OSA_EXIT_CRITICAL();
+                    error = kStatus_USB_Success;
+                }
+                else
+                {
+                    error = kStatus_USB_InvalidParameter;
+                }
+            }
+            break;
+#if (defined(USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS) && (USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS > 0U))
+        case kUSB_DeviceControlGetCriticalSectionStatus:
+            if (param)
+            {
+                usb_device_critical_section_status_struct_t *criticalStatus =
+                    (usb_device_critical_section_status_struct_t *)param;
+
+                criticalStatus->lastCycles = ehciState->criticalLastCycles;
+                criticalStatus->maxCycles = ehciState->criticalMaxCycles;
+                error = kStatus_USB_Success;
+            }
+            break;
+        case kUSB_DeviceControlClearCriticalSectionStatus:
+        {
+            USB_OSA_SR_ALLOC();
+
+            USB_OSA_ENTER_CRITICAL();
+            ehciState->criticalLastCycles = 0U;
+            ehciState->criticalMaxCycles = 0U;
+            USB_OSA_EXIT_CRITICAL();
+            error = kStatus_USB_Success;
+        }
+        break;
+#endif
 #if (defined(USB_DEVICE_CONFIG_LOW_POWER_MODE) && (USB_DEVICE_CONFIG_LOW_POWER_MODE > 0U))
 #if defined(USB_DEVICE_CONFIG_REMOTE_WAKEUP) && (USB_DEVICE_CONFIG_REMOTE_WAKEUP > 0U)
         case kUSB_DeviceControlResume:
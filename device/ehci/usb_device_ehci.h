@@ -48,6 +48,7 @@
 #define USB_DEVICE_ECHI_DTD_PAGE_MASK (0xFFFFF000U)
 #define USB_DEVICE_ECHI_DTD_PAGE_OFFSET_MASK (0x00000FFFU)
 #define USB_DEVICE_ECHI_DTD_PAGE_BLOCK (0x00001000U)
+#define USB_DEVICE_ECHI_DTD_PAGE_COUNT (5U)
 #define USB_DEVICE_ECHI_DTD_TOTAL_BYTES_MASK (0x7FFF0000U)
 #define USB_DEVICE_ECHI_DTD_TOTAL_BYTES (0x00004000U)
 #define USB_DEVICE_ECHI_DTD_IOC_MASK (0x00008000U)
@@ -161,11 +162,23 @@ typedef struct _usb_device_ehci_state_struct
     usb_device_ehci_dtd_struct_t
         *dtdTail[USB_DEVICE_CONFIG_ENDPOINTS * 2]; /*!< The transferring DTD list tail for each endpoint */
     int8_t dtdCount;                               /*!< The idle DTD node count */
+    int8_t dtdSharedCount;                         /*!< The idle DTD node count not reserved for any endpoint */
+    uint8_t dtdUsed[USB_DEVICE_CONFIG_ENDPOINTS * 2]; /*!< The DTD nodes queued on each endpoint */
+    uint32_t dtdExhausted[USB_DEVICE_CONFIG_ENDPOINTS * 2]; /*!< Transfers refused for lack of DTD on each endpoint */
+    uint32_t dtdLinked[USB_DEVICE_CONFIG_ENDPOINTS * 2];    /*!< DTDs ever linked to the queue of each endpoint */
+    uint32_t dtdRetired[USB_DEVICE_CONFIG_ENDPOINTS * 2];   /*!< DTDs ever taken off the queue of each endpoint */
     uint8_t endpointCount;                         /*!< The endpoint number of EHCI */
     uint8_t isResetting;                           /*!< Whether a PORT reset is occurring or not  */
     uint8_t controllerId;                          /*!< Controller ID */
     uint8_t speed;                                 /*!< Current speed of EHCI */
     uint8_t isSuspending;                          /*!< Is suspending of the PORT */
+    uint8_t interruptThreshold;                    /*!< Interrupt threshold in micro-frames, kept over bus reset */
+    uint8_t resetEpoch;                            /*!< Bumped each time the default state is restored */
+#if (defined(USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS) && (USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS > 0U))
+    uint32_t criticalStart;                        /*!< Cycle count when the current masked section started */
+    uint32_t criticalLastCycles;                   /*!< Cycles of the last masked section of the transfer path */
+    uint32_t criticalMaxCycles;                    /*!< Most cycles of a masked section of the transfer path */
+#endif
 } usb_device_ehci_state_struct_t;
 
 
@@ -236,6 +249,24 @@ usb_status_t USB_DeviceEhciSend(usb_device_controller_handle ehciHandle,
                                 uint8_t *buffer,
                                 uint32_t length);
 
+/*!
+ * @brief Sends data of several buffers through a specified endpoint.
+ *
+ * The buffers are sent as one transfer. Consecutive buffers share a DTD when the former ends and the latter starts
+ * on a page boundary, otherwise the data before a buffer must be a multiple of the max packet size.
+ *
+ * @param[in] ehciHandle      Pointer of the device EHCI handle.
+ * @param[in] endpointAddress Endpoint index.
+ * @param[in] segments        The buffers to be sent in order.
+ * @param[in] segmentCount    The count of the buffers.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceEhciSendV(usb_device_controller_handle ehciHandle,
+                                 uint8_t endpointAddress,
+                                 const usb_device_transfer_segment_struct_t *segments,
+                                 uint32_t segmentCount);
+
 /*!
  * @brief Receive data through a specified endpoint.
  *
@@ -18,6 +18,21 @@
  * Definitions
  ******************************************************************************/
 
+/*! @brief Whether the endpoint callbacks run in the deferred callback task, the device task takes precedence. */
+#if (!(defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))) && \
+    (defined(USB_DEVICE_CONFIG_DEFERRED_CALLBACK) && (USB_DEVICE_CONFIG_DEFERRED_CALLBACK > 0U))
+#define USB_DEVICE_DEFERRED_CALLBACK_ENABLE (1U)
+#else
+#define USB_DEVICE_DEFERRED_CALLBACK_ENABLE (0U)
+#endif
+
+/*! @brief Whether the notifications are queued to the device task or the deferred callback task. */
+#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U)) || (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U)
+#define USB_DEVICE_NOTIFICATION_QUEUE_ENABLE (1U)
+#else
+#define USB_DEVICE_NOTIFICATION_QUEUE_ENABLE (0U)
+#endif
+
 /*! @brief Defines Get/Set status Types */
 typedef enum _usb_device_status
 {
@@ -35,6 +50,10 @@ typedef enum _usb_device_status
     kUSB_DeviceStatusBusResume,      /*!< Bus resume */
     kUSB_DeviceStatusRemoteWakeup,   /*!< Remote wakeup state */
     kUSB_DeviceStatusBusSleepResume, /*!< Bus resume */
+    kUSB_DeviceStatusTransferResource, /*!< Transfer descriptor usage of endpoint */
+    kUSB_DeviceStatusInterruptThreshold, /*!< Interrupt threshold in micro-frames, uint8_t */
+    kUSB_DeviceStatusNotificationQueue, /*!< Notification queue usage usb_device_notification_queue_status_struct_t */
+    kUSB_DeviceStatusCriticalSection,   /*!< Interrupt masked cycles usb_device_critical_section_status_struct_t */
 } usb_device_status_t;
 
 /*! @brief Defines USB 2.0 device state */
@@ -96,6 +115,7 @@ typedef enum _usb_device_event
     kUSB_DeviceEventGetHidPhysicalDescriptor,     /*!< Get HID physical descriptor. */
     kUSB_DeviceEventGetBOSDescriptor,             /*!< Get configuration descriptor. */
     kUSB_DeviceEventGetDeviceQualifierDescriptor, /*!< Get device qualifier descriptor. */
+    kUSB_DeviceEventGetOtherSpeedConfigurationDescriptor, /*!< Get other speed configuration descriptor. */
     kUSB_DeviceEventVendorRequest,                /*!< Vendor request. */
     kUSB_DeviceEventSetRemoteWakeup,              /*!< Enable or disable remote wakeup function. */
     kUSB_DeviceEventGetConfiguration,             /*!< Get current configuration index */
@@ -172,6 +192,68 @@ typedef struct _usb_device_endpoint_status_struct
     uint16_t endpointStatus; /*!< Endpoint status : idle or stalled */
 } usb_device_endpoint_status_struct_t;
 
+/*! @brief Transfer descriptor usage of endpoint, controllers without descriptor pool report zeros */
+typedef struct _usb_device_transfer_resource_status_struct
+{
+    uint8_t endpointAddress; /*!< Endpoint address, set by caller */
+    uint8_t reserved;        /*!< Descriptors reserved for the endpoint */
+    uint8_t inUse;           /*!< Descriptors queued on the endpoint */
+    uint8_t sharedFree;      /*!< Free descriptors left in pool shared by all endpoints */
+    uint32_t exhausted;      /*!< Transfers refused with kStatus_USB_Busy for lack of descriptors */
+} usb_device_transfer_resource_status_struct_t;
+
+/*! @brief Notification queue usage, control lane carries the bus and control endpoint notifications */
+typedef struct _usb_device_notification_queue_status_struct
+{
+    uint32_t controlOverflow; /*!< Control lane notifications dropped for lack of space */
+    uint32_t bulkOverflow;    /*!< Other endpoint completions dropped for lack of space */
+    uint32_t controlPeak;     /*!< Highest count of control lane notifications waiting */
+    uint32_t bulkPeak;        /*!< Highest count of other endpoint completions waiting */
+} usb_device_notification_queue_status_struct_t;
+
+/*! @brief Cycles the controller transfer path runs with interrupts masked, setting the status clears them */
+typedef struct _usb_device_critical_section_status_struct
+{
+    uint32_t lastCycles; /*!< Cycles of the last masked section */
+    uint32_t maxCycles;  /*!< Most cycles of a masked section since cleared */
+} usb_device_critical_section_status_struct_t;
+
+/*! @brief Transfer segment structure, one buffer of a transfer sent by #USB_DeviceSendRequestV */
+typedef struct _usb_device_transfer_segment_struct
+{
+    uint8_t *buffer; /*!< Segment buffer */
+    uint32_t length; /*!< Segment length */
+} usb_device_transfer_segment_struct_t;
+
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+typedef struct _usb_device_request_struct usb_device_request_struct_t;
+
+/*!
+ * @brief Queued request callback function typedef.
+ *
+ * This callback function is used to notify the upper layer that a request queued by #USB_DeviceQueueRequest is done.
+ * The request memory is owned by the upper layer again when the callback is called.
+ *
+ * @param handle          The device handle. It equals the value returned from #USB_DeviceInit.
+ * @param request         The finished request, usb_device_request_struct_t::actualLength holds the transferred
+ * length or USB_UNINITIALIZED_VAL_32 when the request was cancelled.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+typedef usb_status_t (*usb_device_request_callback_t)(usb_device_handle handle, usb_device_request_struct_t *request);
+
+/*! @brief Queued request structure, provided by the upper layer and kept valid until the request is done */
+struct _usb_device_request_struct
+{
+    usb_device_request_struct_t *next;        /*!< Next request in the endpoint queue, used by the stack */
+    uint8_t *buffer;                          /*!< Transfer buffer */
+    uint32_t length;                          /*!< Requested length */
+    uint32_t actualLength;                    /*!< Transferred length, set by the stack */
+    usb_device_request_callback_t callbackFn; /*!< Request done callback function */
+    void *callbackParam;                      /*!< Parameter for callback function */
+};
+#endif
+
 
 #if defined(__cplusplus)
 extern "C" {
@@ -272,7 +354,7 @@ extern usb_status_t USB_DeviceDeinit(usb_device_handle handle);
  * corresponding callback function.
  * Currently, only one transfer request can be supported for one specific endpoint.
  * If there is a specific requirement to support multiple transfer requests for one specific endpoint, the application
- * should implement a queue on the application level.
+ * should use #USB_DeviceQueueRequest instead.
  * The subsequent transfer can begin only when the previous transfer is done (get notification through the endpoint
  * callback).
  */
@@ -281,6 +363,35 @@ extern usb_status_t USB_DeviceSendRequest(usb_device_handle handle,
                                           uint8_t *buffer,
                                           uint32_t length);
 
+/*!
+ * @brief Sends data of several buffers through a specified endpoint as one transfer.
+ *
+ * The function is used to send a header and a payload kept in separate buffers without copying them together.
+ * The endpoint callback reports the first buffer and the total length.
+ *
+ * @param[in] handle The device handle got from #USB_DeviceInit.
+ * @param[in] endpointAddress Endpoint index.
+ * @param[in] segments The buffers to be sent in order. The array is not used after the function returns.
+ * @param[in] segmentCount The count of the buffers.
+ *
+ * @retval kStatus_USB_Success              The send request is sent successfully.
+ * @retval kStatus_USB_InvalidHandle        The handle is a NULL pointer. Or the controller handle is invalid.
+ * @retval kStatus_USB_InvalidParameter     The segments are empty. Or a buffer would end a short packet in the
+ * middle of the transfer.
+ * @retval kStatus_USB_InvalidRequest       The controller does not support scatter-gather transfers.
+ * @retval kStatus_USB_Busy                 Cannot allocate DTDS for current transfer in EHCI driver.
+ * @retval kStatus_USB_ControllerNotFound   Cannot find the controller.
+ * @retval kStatus_USB_Error                The device is doing reset.
+ *
+ * @note A controller ends the packet at the end of each transfer descriptor. Consecutive buffers share a descriptor
+ * when the former ends and the latter starts on a 4 KiB boundary, e.g. a container header placed at the end of a page
+ * followed by a page aligned payload. Otherwise the data before a buffer must be a multiple of the max packet size.
+ */
+extern usb_status_t USB_DeviceSendRequestV(usb_device_handle handle,
+                                           uint8_t endpointAddress,
+                                           const usb_device_transfer_segment_struct_t *segments,
+                                           uint32_t segmentCount);
+
 /*!
  * @brief Receives data through a specified endpoint.
  *
@@ -302,7 +413,7 @@ extern usb_status_t USB_DeviceSendRequest(usb_device_handle handle,
  * corresponding callback function.
  * Currently, only one transfer request can be supported for one specific endpoint.
  * If there is a specific requirement to support multiple transfer requests for one specific endpoint, the application
- * should implement a queue on the application level.
+ * should use #USB_DeviceQueueRequest instead.
  * The subsequent transfer can begin only when the previous transfer is done (get notification through the endpoint
  * callback).
  */
@@ -325,6 +436,52 @@ extern usb_status_t USB_DeviceRecvRequest(usb_device_handle handle,
  */
 extern usb_status_t USB_DeviceCancel(usb_device_handle handle, uint8_t endpointAddress);
 
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+/*!
+ * @brief Queues a transfer request in a specified endpoint.
+ *
+ * The function appends the request to the endpoint queue. Requests are handed to the controller as soon as it has
+ * resources for them, so the controller can move to the next request without waiting for the upper layer. Every
+ * request is done in queue order by calling its own callback, the endpoint callback is not called for queued requests.
+ *
+ * @param[in] handle The device handle got from #USB_DeviceInit.
+ * @param[in] endpointAddress Endpoint address, bit7 is the direction of endpoint, 1U - IN, and 0U - OUT.
+ * @param[in] request The request, see the structure usb_device_request_struct_t. It must stay valid until its callback
+ * is called.
+ *
+ * @retval kStatus_USB_Success              The request is queued.
+ * @retval kStatus_USB_InvalidHandle        The handle is a NULL pointer. Or the controller handle is invalid.
+ * @retval kStatus_USB_InvalidParameter     The request is a NULL pointer. Or the endpoint is the control endpoint or
+ * its number is more than USB_DEVICE_CONFIG_ENDPOINTS.
+ * @retval kStatus_USB_Busy                 A transfer started by #USB_DeviceSendRequest or #USB_DeviceRecvRequest is
+ * pending in the endpoint. Or the controller cannot take the request and no other request is pending.
+ * @retval kStatus_USB_ControllerNotFound   Cannot find the controller.
+ * @retval kStatus_USB_Error                The device is doing reset.
+ *
+ * @note #USB_DeviceSendRequest and #USB_DeviceRecvRequest return kStatus_USB_Busy while the endpoint queue is not
+ * empty.
+ */
+extern usb_status_t USB_DeviceQueueRequest(usb_device_handle handle,
+                                           uint8_t endpointAddress,
+                                           usb_device_request_struct_t *request);
+
+/*!
+ * @brief Cancels all queued requests in a specified endpoint.
+ *
+ * Requests not handed to the controller yet are done with USB_UNINITIALIZED_VAL_32 length before the function returns.
+ * Requests owned by the controller are cancelled by #USB_DeviceCancel and done when the controller reports them.
+ *
+ * @param[in] handle The device handle got from #USB_DeviceInit.
+ * @param[in] endpointAddress Endpoint address, bit7 is the direction of endpoint, 1U - IN, and 0U - OUT.
+ *
+ * @retval kStatus_USB_Success              The requests are cancelled.
+ * @retval kStatus_USB_InvalidHandle        The handle is a NULL pointer or the controller handle is invalid.
+ * @retval kStatus_USB_InvalidParameter     The endpoint number is more than USB_DEVICE_CONFIG_ENDPOINTS.
+ * @retval kStatus_USB_ControllerNotFound   Cannot find the controller.
+ */
+extern usb_status_t USB_DeviceCancelRequests(usb_device_handle handle, uint8_t endpointAddress);
+#endif
+
 /*!
  * @brief Initializes a specified endpoint.
  *
@@ -464,6 +621,39 @@ extern usb_status_t  USB_DeviceDcdDisable(usb_device_handle handle);
  */
 extern void USB_DeviceTaskFunction(void *deviceHandle);
 
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+/*!
+ * @brief Deferred callback task function.
+ *
+ * The function waits for the completions queued by the controller ISR and calls the endpoint and device callbacks
+ * of all of them. It should be used as a function entry of a high priority task, it returns after each batch.
+ * This function should not be called in the application directly.
+ *
+ * @param[in] deviceHandle The device handle got from #USB_DeviceInit.
+ */
+extern void USB_DeviceDeferredTaskFunction(void *deviceHandle);
+
+/*!
+ * @brief Select where the callback of an endpoint runs.
+ *
+ * The callbacks of latency critical endpoints can be kept in the controller ISR, all others run in the deferred
+ * callback task. The setting is kept over endpoint de-initialization and bus reset, it should be changed while the
+ * endpoint has no transfer pending.
+ *
+ * @param[in] handle The device handle got from #USB_DeviceInit.
+ * @param[in] endpointAddress Endpoint address, bit7 is the direction of endpoint, 1U - IN, and 0U - OUT.
+ * @param[in] inIsr 1U to call back from the ISR, 0U to call back from the deferred callback task.
+ *
+ * @retval kStatus_USB_Success              The setting is changed.
+ * @retval kStatus_USB_InvalidHandle        The device handle is a NULL pointer.
+ * @retval kStatus_USB_InvalidParameter     The endpoint is the control endpoint or its number is more than
+ * USB_DEVICE_CONFIG_ENDPOINTS.
+ */
+extern usb_status_t USB_DeviceSetEndpointCallbackInIsr(usb_device_handle handle,
+                                                       uint8_t endpointAddress,
+                                                       uint8_t inIsr);
+#endif
+
 #if ((defined(USB_DEVICE_CONFIG_KHCI)) && (USB_DEVICE_CONFIG_KHCI > 0U))
 /*!
  * @brief Device KHCI task function.
@@ -427,11 +427,19 @@ static usb_status_t USB_DeviceCh9GetDescriptor(usb_device_common_class_struct_t
         error = USB_DeviceClassCallback(classHandle->handle, kUSB_DeviceEventGetDeviceQualifierDescriptor,
                                         &commonDescriptor.deviceDescriptor);
     }
+    else if (USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION == descriptorType)
+    {
+        /* Get the other speed configuration descriptor */
+        commonDescriptor.configurationDescriptor.configuration = descriptorIndex;
+        error = USB_DeviceClassCallback(classHandle->handle, kUSB_DeviceEventGetOtherSpeedConfigurationDescriptor,
+                                        &commonDescriptor.configurationDescriptor);
+    }
 #endif
-#if (defined(USB_DEVICE_CONFIG_LPM_L1) && (USB_DEVICE_CONFIG_LPM_L1 > 0U))
+#if ((defined(USB_DEVICE_CONFIG_LPM_L1) && (USB_DEVICE_CONFIG_LPM_L1 > 0U)) || \
+     (defined(USB_DEVICE_CONFIG_MS_OS_20) && (USB_DEVICE_CONFIG_MS_OS_20 > 0U)))
     else if (USB_DESCRIPTOR_TYPE_BOS == descriptorType)
     {
-        /* Get the configuration descriptor */
+        /* Get the BOS descriptor */
         commonDescriptor.configurationDescriptor.configuration = descriptorIndex;
         error = USB_DeviceClassCallback(classHandle->handle, kUSB_DeviceEventGetBOSDescriptor,
                                         &commonDescriptor.configurationDescriptor);
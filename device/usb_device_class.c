@@ -55,6 +55,10 @@
 #include "usb_device_mtp.h"
 #endif
 
+#if ((defined(USB_DEVICE_CONFIG_CDC_NCM)) && (USB_DEVICE_CONFIG_CDC_NCM > 0U))
+#include "usb_device_cdc_ncm.h"
+#endif
+
 /*******************************************************************************
  * Definitions
  ******************************************************************************/
@@ -68,6 +72,11 @@ static usb_status_t USB_DeviceClassGetHandleByControllerId(uint8_t controllerId,
                                                            usb_device_common_class_struct_t **handle);
 static usb_status_t USB_DeviceClassGetHandleByDeviceHandle(usb_device_handle deviceHandle,
                                                            usb_device_common_class_struct_t **handle);
+static usb_status_t USB_DeviceClassBuildRoutes(usb_device_common_class_struct_t *classHandle);
+static usb_status_t USB_DeviceClassRouteEvent(usb_device_common_class_struct_t *classHandle,
+                                              uint8_t route,
+                                              usb_device_class_event_t event,
+                                              void *param);
 
 /*******************************************************************************
  * Variables
@@ -114,6 +123,10 @@ static const usb_device_class_map_t s_UsbDeviceClassInterfaceMap[] = {
 #if ((defined(USB_DEVICE_CONFIG_MTP)) && (USB_DEVICE_CONFIG_MTP > 0U))
     {USB_DeviceClassMtpInit, USB_DeviceClassMtpDeinit, USB_DeviceClassMtpEvent, kUSB_DeviceClassTypeMtp},
 #endif
+
+#if ((defined(USB_DEVICE_CONFIG_CDC_NCM)) && (USB_DEVICE_CONFIG_CDC_NCM > 0U))
+    {USB_DeviceCdcNcmInit, USB_DeviceCdcNcmDeinit, USB_DeviceCdcNcmEvent, kUSB_DeviceClassTypeCdcNcm},
+#endif
     {(usb_device_class_init_call_t)NULL, (usb_device_class_deinit_call_t)NULL, (usb_device_class_event_callback_t)NULL,
      (usb_device_class_type_t)0},
 };
@@ -143,16 +156,16 @@ USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE) static uint8_t
 static usb_status_t USB_DeviceClassAllocateHandle(uint8_t controllerId, usb_device_common_class_struct_t **handle)
 {
     uint32_t count;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     /* Check the controller is initialized or not. */
     for (count = 0U; count < USB_DEVICE_CONFIG_NUM; count++)
     {
         if ((NULL != s_UsbDeviceCommonClassStruct[count].handle) &&
             (controllerId == s_UsbDeviceCommonClassStruct[count].controllerId))
         {
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Error;
         }
     }
@@ -164,12 +177,12 @@ static usb_status_t USB_DeviceClassAllocateHandle(uint8_t controllerId, usb_devi
             s_UsbDeviceCommonClassStruct[count].controllerId = controllerId;
             s_UsbDeviceCommonClassStruct[count].setupBuffer  = s_UsbDeviceSetupBuffer[count];
             *handle                                          = &s_UsbDeviceCommonClassStruct[count];
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Success;
         }
     }
 
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
     return kStatus_USB_Busy;
 }
 
@@ -186,9 +199,9 @@ static usb_status_t USB_DeviceClassAllocateHandle(uint8_t controllerId, usb_devi
 static usb_status_t USB_DeviceClassFreeHandle(uint8_t controllerId)
 {
     uint32_t count = 0U;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     for (; count < USB_DEVICE_CONFIG_NUM; count++)
     {
         if ((NULL != s_UsbDeviceCommonClassStruct[count].handle) &&
@@ -197,11 +210,11 @@ static usb_status_t USB_DeviceClassFreeHandle(uint8_t controllerId)
             s_UsbDeviceCommonClassStruct[count].handle       = NULL;
             s_UsbDeviceCommonClassStruct[count].configList   = (usb_device_class_config_list_struct_t *)NULL;
             s_UsbDeviceCommonClassStruct[count].controllerId = 0U;
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Success;
         }
     }
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
 
     return kStatus_USB_InvalidParameter;
 }
@@ -222,20 +235,20 @@ static usb_status_t USB_DeviceClassGetHandleByControllerId(uint8_t controllerId,
                                                            usb_device_common_class_struct_t **handle)
 {
     uint32_t count = 0U;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     for (; count < USB_DEVICE_CONFIG_NUM; count++)
     {
         if ((NULL != s_UsbDeviceCommonClassStruct[count].handle) &&
             (controllerId == s_UsbDeviceCommonClassStruct[count].controllerId))
         {
             *handle = &s_UsbDeviceCommonClassStruct[count];
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Success;
         }
     }
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
     return kStatus_USB_InvalidParameter;
 }
 
@@ -255,19 +268,19 @@ static usb_status_t USB_DeviceClassGetHandleByDeviceHandle(usb_device_handle dev
                                                            usb_device_common_class_struct_t **handle)
 {
     uint32_t count = 0U;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     for (; count < USB_DEVICE_CONFIG_NUM; count++)
     {
         if (deviceHandle == s_UsbDeviceCommonClassStruct[count].handle)
         {
             *handle = &s_UsbDeviceCommonClassStruct[count];
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Success;
         }
     }
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
     return kStatus_USB_InvalidParameter;
 }
 
@@ -285,23 +298,142 @@ static usb_status_t USB_DeviceClassGetHandleByDeviceHandle(usb_device_handle dev
 usb_status_t USB_DeviceClassGetDeviceHandle(uint8_t controllerId, usb_device_handle *handle)
 {
     uint32_t count = 0U;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     for (; count < USB_DEVICE_CONFIG_NUM; count++)
     {
         if ((NULL != s_UsbDeviceCommonClassStruct[count].handle) &&
             (controllerId == s_UsbDeviceCommonClassStruct[count].controllerId))
         {
             *handle = s_UsbDeviceCommonClassStruct[count].handle;
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Success;
         }
     }
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
     return kStatus_USB_InvalidParameter;
 }
 
+/*!
+ * @brief Build the tables routing the class events.
+ *
+ * This function resolves the event callback of every class in the configuration list and records which class owns
+ * each interface number and each endpoint, so an event concerning one interface or endpoint is passed to its class
+ * with one lookup.
+ *
+ * @param classHandle     The device common class handle, its configuration list is set.
+ *
+ * @retval kStatus_USB_Success              The tables are built.
+ * @retval kStatus_USB_InvalidParameter     There are more classes or a higher interface number than
+ * USB_DEVICE_CONFIG_INTERFACES allows, or an endpoint number is more than USB_DEVICE_CONFIG_ENDPOINTS.
+ */
+static usb_status_t USB_DeviceClassBuildRoutes(usb_device_common_class_struct_t *classHandle)
+{
+    usb_device_class_struct_t *classInfomation;
+    usb_device_interfaces_struct_t *interfaces;
+    usb_device_endpoint_list_t *endpointList;
+    uint8_t classIndex;
+    uint8_t mapIndex;
+    uint8_t configuration;
+    uint8_t interfaceIndex;
+    uint8_t alternateSetting;
+    uint8_t endpointIndex;
+    uint8_t endpointAddress;
+    uint8_t count;
+
+    if (classHandle->configList->count > USB_DEVICE_CONFIG_INTERFACES)
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    for (count = 0U; count < USB_DEVICE_CONFIG_INTERFACES; count++)
+    {
+        classHandle->classEventCallback[count] = (usb_device_class_event_callback_t)NULL;
+        classHandle->interfaceClass[count]     = 0U;
+    }
+    for (count = 0U; count < (USB_DEVICE_CONFIG_ENDPOINTS << 1U); count++)
+    {
+        classHandle->endpointClass[count] = 0U;
+    }
+
+    for (classIndex = 0U; classIndex < classHandle->configList->count; classIndex++)
+    {
+        classInfomation = classHandle->configList->config[classIndex].classInfomation;
+        for (mapIndex = 0U; mapIndex < (sizeof(s_UsbDeviceClassInterfaceMap) / sizeof(usb_device_class_map_t));
+             mapIndex++)
+        {
+            if (classInfomation->type == s_UsbDeviceClassInterfaceMap[mapIndex].type)
+            {
+                classHandle->classEventCallback[classIndex] = s_UsbDeviceClassInterfaceMap[mapIndex].classEventCallback;
+                break;
+            }
+        }
+
+        for (configuration = 0U; configuration < classInfomation->configurations; configuration++)
+        {
+            for (interfaceIndex = 0U; interfaceIndex < classInfomation->interfaceList[configuration].count;
+                 interfaceIndex++)
+            {
+                interfaces = &classInfomation->interfaceList[configuration].interfaces[interfaceIndex];
+                if (interfaces->interfaceNumber >= USB_DEVICE_CONFIG_INTERFACES)
+                {
+                    return kStatus_USB_InvalidParameter;
+                }
+                classHandle->interfaceClass[interfaces->interfaceNumber] = classIndex + 1U;
+
+                for (alternateSetting = 0U; alternateSetting < interfaces->count; alternateSetting++)
+                {
+                    endpointList = &interfaces->interface[alternateSetting].endpointList;
+                    for (endpointIndex = 0U; endpointIndex < endpointList->count; endpointIndex++)
+                    {
+                        endpointAddress = endpointList->endpoint[endpointIndex].endpointAddress;
+                        if ((endpointAddress & USB_ENDPOINT_NUMBER_MASK) >= USB_DEVICE_CONFIG_ENDPOINTS)
+                        {
+                            return kStatus_USB_InvalidParameter;
+                        }
+                        classHandle->endpointClass[((uint32_t)(endpointAddress & USB_ENDPOINT_NUMBER_MASK) << 1U) |
+                                                   ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                                                    USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT)] =
+                            classIndex + 1U;
+                    }
+                }
+            }
+        }
+    }
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Pass an event to the class owning its interface or endpoint.
+ *
+ * @param classHandle     The device common class handle.
+ * @param route           The class index + 1 got from the routing tables, 0 when no class owns the target.
+ * @param event           The event codes. Please refer to the enumeration usb_device_class_event_t.
+ * @param param           The param type is determined by the event code.
+ *
+ * @return The error code of the class, kStatus_USB_Error when no class owns the target.
+ */
+static usb_status_t USB_DeviceClassRouteEvent(usb_device_common_class_struct_t *classHandle,
+                                              uint8_t route,
+                                              usb_device_class_event_t event,
+                                              void *param)
+{
+    usb_device_class_event_callback_t callback;
+
+    /* Same result as when every class ignored the event */
+    if (0U == route)
+    {
+        return kStatus_USB_Error;
+    }
+    callback = classHandle->classEventCallback[route - 1U];
+    if ((usb_device_class_event_callback_t)NULL == callback)
+    {
+        return kStatus_USB_Error;
+    }
+    return callback((void *)classHandle->configList->config[route - 1U].classHandle, event, param);
+}
+
 /*!
  * @brief Handle the event passed to the class drivers.
  *
@@ -319,8 +451,10 @@ usb_status_t USB_DeviceClassGetDeviceHandle(uint8_t controllerId, usb_device_han
 usb_status_t USB_DeviceClassEvent(usb_device_handle handle, usb_device_class_event_t event, void *param)
 {
     usb_device_common_class_struct_t *classHandle;
-    uint8_t mapIndex;
+    usb_setup_struct_t *setup;
     uint8_t classIndex;
+    uint8_t index;
+    uint8_t endpointAddress = 0U;
     usb_status_t errorReturn = kStatus_USB_Error;
     usb_status_t error       = kStatus_USB_Error;
 
@@ -336,30 +470,69 @@ usb_status_t USB_DeviceClassEvent(usb_device_handle handle, usb_device_class_eve
         return kStatus_USB_InvalidParameter;
     }
 
-    for (classIndex = 0U; classIndex < classHandle->configList->count; classIndex++)
+    /* Events concerning one interface or endpoint go to its class only */
+    switch (event)
     {
-        for (mapIndex = 0U; mapIndex < (sizeof(s_UsbDeviceClassInterfaceMap) / sizeof(usb_device_class_map_t));
-             mapIndex++)
-        {
-            if (s_UsbDeviceClassInterfaceMap[mapIndex].type ==
-                classHandle->configList->config[classIndex].classInfomation->type)
+        case kUSB_DeviceClassEventClassRequest:
+            setup = ((usb_device_control_request_struct_t *)param)->setup;
+            if (USB_REQUEST_TYPE_RECIPIENT_INTERFACE == (setup->bmRequestType & USB_REQUEST_TYPE_RECIPIENT_MASK))
             {
-                /* Call class event callback of supported class */
-                errorReturn = s_UsbDeviceClassInterfaceMap[mapIndex].classEventCallback(
-                    (void *)classHandle->configList->config[classIndex].classHandle, event, param);
-                /* Return the error code kStatus_USB_InvalidRequest immediately, when a class returns
-                 * kStatus_USB_InvalidRequest. */
-                if (kStatus_USB_InvalidRequest == errorReturn)
-                {
-                    return kStatus_USB_InvalidRequest;
-                }
-                /* For composite device, it should return kStatus_USB_Success once a valid request has been handled */
-                if (kStatus_USB_Success == errorReturn)
-                {
-                    error = kStatus_USB_Success;
-                }
-                break;
+                index = (uint8_t)(setup->wIndex & 0xFFU);
+                return USB_DeviceClassRouteEvent(
+                    classHandle, (index < USB_DEVICE_CONFIG_INTERFACES) ? classHandle->interfaceClass[index] : 0U,
+                    event, param);
+            }
+            if (USB_REQUEST_TYPE_RECIPIENT_ENDPOINT == (setup->bmRequestType & USB_REQUEST_TYPE_RECIPIENT_MASK))
+            {
+                endpointAddress = (uint8_t)(setup->wIndex & 0xFFU);
             }
+            break;
+        case kUSB_DeviceClassEventSetInterface:
+            /* The Bit[15~8] is the interface index, and the alternate setting is in Bit[7~0]. */
+            index = (uint8_t)(*((uint16_t *)param) >> 8U);
+            return USB_DeviceClassRouteEvent(
+                classHandle, (index < USB_DEVICE_CONFIG_INTERFACES) ? classHandle->interfaceClass[index] : 0U, event,
+                param);
+        case kUSB_DeviceClassEventSetEndpointHalt:
+        case kUSB_DeviceClassEventClearEndpointHalt:
+            endpointAddress = *((uint8_t *)param);
+            break;
+        default:
+            break;
+    }
+    /* Endpoint 0 OUT stands for no endpoint, the control endpoint is not owned by any class anyway */
+    if (0U != endpointAddress)
+    {
+        if ((endpointAddress & USB_ENDPOINT_NUMBER_MASK) >= USB_DEVICE_CONFIG_ENDPOINTS)
+        {
+            return kStatus_USB_Error;
+        }
+        index = (uint8_t)((uint32_t)(endpointAddress & USB_ENDPOINT_NUMBER_MASK) << 1U) |
+                ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                 USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT);
+        return USB_DeviceClassRouteEvent(classHandle, classHandle->endpointClass[index], event, param);
+    }
+
+    /* The device wide events go to all classes */
+    for (classIndex = 0U; classIndex < classHandle->configList->count; classIndex++)
+    {
+        if ((usb_device_class_event_callback_t)NULL == classHandle->classEventCallback[classIndex])
+        {
+            continue;
+        }
+        /* Call class event callback of supported class */
+        errorReturn = classHandle->classEventCallback[classIndex](
+            (void *)classHandle->configList->config[classIndex].classHandle, event, param);
+        /* Return the error code kStatus_USB_InvalidRequest immediately, when a class returns
+         * kStatus_USB_InvalidRequest. */
+        if (kStatus_USB_InvalidRequest == errorReturn)
+        {
+            return kStatus_USB_InvalidRequest;
+        }
+        /* For composite device, it should return kStatus_USB_Success once a valid request has been handled */
+        if (kStatus_USB_Success == errorReturn)
+        {
+            error = kStatus_USB_Success;
         }
     }
 
@@ -446,6 +619,15 @@ usb_status_t USB_DeviceClassInit(
     /* Save the configuration list */
     classHandle->configList = configList;
 
+    /* Route the class events before the device can report any */
+    error = USB_DeviceClassBuildRoutes(classHandle);
+    if (kStatus_USB_Success != error)
+    {
+        /* The handle is free again as long as the device handle is not set */
+        classHandle->configList = (usb_device_class_config_list_struct_t *)NULL;
+        return error;
+    }
+
     /* Initialize the device stack. */
     error = USB_DeviceInit(controllerId, USB_DeviceClassCallback, &classHandle->handle);
 
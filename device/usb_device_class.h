@@ -34,6 +34,7 @@ typedef enum _usb_usb_device_class_type
     kUSB_DeviceClassTypeDfu,
     kUSB_DeviceClassTypeCcid,
     kUSB_DeviceClassTypeMtp,
+    kUSB_DeviceClassTypeCdcNcm,
 } usb_device_class_type_t;
 
 /*! @brief Available common class events. */
@@ -316,6 +317,11 @@ typedef struct _usb_device_common_class_struct
                                                         *           get sync frame request
                                                         */
     uint8_t controllerId;                              /*!< Controller ID*/
+    usb_device_class_event_callback_t
+        classEventCallback[USB_DEVICE_CONFIG_INTERFACES]; /*!< Event callback of each class in the configure list*/
+    uint8_t interfaceClass[USB_DEVICE_CONFIG_INTERFACES]; /*!< Class index + 1 owning each interface number, 0 none*/
+    uint8_t endpointClass[USB_DEVICE_CONFIG_ENDPOINTS << 1U]; /*!< Class index + 1 owning each endpoint, indexed by
+                                                                 endpoint number * 2 + direction, 0 none*/
 } usb_device_common_class_struct_t;
 
 /*******************************************************************************
@@ -47,9 +47,16 @@
 #define FSL_COMPONENT_ID "middleware.usb.device_stack"
 #endif
 
-#if defined __CORTEX_M && (__CORTEX_M == 7U)
 #if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
-#warning USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE is not supported.
+#if (USB_CACHE_LINESIZE < 8)
+#error The cache line size is unknown, FSL_FEATURE_L1DCACHE_LINESIZE_BYTE has to be defined for cacheable buffers.
+#endif
+#endif
+
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+#if ((USB_DEVICE_CONFIG_CONTROL_MESSAGES & (USB_DEVICE_CONFIG_CONTROL_MESSAGES - 1U)) != 0U) || \
+    ((USB_DEVICE_CONFIG_MAX_MESSAGES & (USB_DEVICE_CONFIG_MAX_MESSAGES - 1U)) != 0U)
+#error The notification lane sizes have to be powers of two.
 #endif
 #endif
 
@@ -60,6 +67,10 @@ static usb_status_t USB_DeviceAllocateHandle(uint8_t controllerId, usb_device_st
 static usb_status_t USB_DeviceFreeHandle(usb_device_struct_t *handle);
 static usb_status_t USB_DeviceGetControllerInterface(
     uint8_t controllerId, const usb_device_controller_interface_struct_t **controllerInterface);
+static usb_status_t USB_DeviceControllerTransfer(usb_device_struct_t *deviceHandle,
+                                                 uint8_t endpointAddress,
+                                                 uint8_t *buffer,
+                                                 uint32_t length);
 static usb_status_t USB_DeviceTransfer(usb_device_handle handle,
                                        uint8_t endpointAddress,
                                        uint8_t *buffer,
@@ -85,6 +96,16 @@ static usb_status_t USB_DeviceAttachNotification(usb_device_struct_t *handle,
                                                  usb_device_callback_message_struct_t *message);
 #endif
 static usb_status_t USB_DeviceNotification(usb_device_struct_t *handle, usb_device_callback_message_struct_t *message);
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+static usb_status_t USB_DeviceRequestQueueSubmit(usb_device_struct_t *handle,
+                                                 uint8_t endpointAddress,
+                                                 usb_device_request_struct_t **refused);
+static usb_device_request_struct_t *USB_DeviceRequestQueueTake(usb_device_struct_t *handle,
+                                                               uint8_t index,
+                                                               uint8_t includeActive);
+static void USB_DeviceRequestQueueCancel(usb_device_struct_t *handle, usb_device_request_struct_t *request);
+static usb_status_t USB_DeviceRequestDone(usb_device_struct_t *handle, uint8_t endpointAddress, uint32_t length);
+#endif
 
 /*******************************************************************************
  * Variables
@@ -111,15 +132,15 @@ USB_GLOBAL static usb_device_struct_t s_UsbDevice[USB_DEVICE_CONFIG_NUM];
 static usb_status_t USB_DeviceAllocateHandle(uint8_t controllerId, usb_device_struct_t **handle)
 {
     uint32_t count;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     /* Check the controller is initialized or not. */
     for (count = 0U; count < USB_DEVICE_CONFIG_NUM; count++)
     {
         if ((NULL != s_UsbDevice[count].controllerHandle) && (controllerId == s_UsbDevice[count].controllerId))
         {
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Error;
         }
     }
@@ -130,11 +151,11 @@ static usb_status_t USB_DeviceAllocateHandle(uint8_t controllerId, usb_device_st
         {
             s_UsbDevice[count].controllerId = controllerId;
             *handle                         = &s_UsbDevice[count];
-            OSA_EXIT_CRITICAL();
+            USB_OSA_EXIT_CRITICAL();
             return kStatus_USB_Success;
         }
     }
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
     return kStatus_USB_Busy;
 }
 
@@ -149,12 +170,12 @@ static usb_status_t USB_DeviceAllocateHandle(uint8_t controllerId, usb_device_st
  */
 static usb_status_t USB_DeviceFreeHandle(usb_device_struct_t *handle)
 {
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
-    OSA_ENTER_CRITICAL();
+    USB_OSA_ENTER_CRITICAL();
     handle->controllerHandle = NULL;
     handle->controllerId     = 0U;
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
     return kStatus_USB_Success;
 }
 
@@ -169,7 +190,8 @@ static const usb_device_controller_interface_struct_t s_UsbDeviceKhciInterface =
 /* EHCI device driver interface */
 static const usb_device_controller_interface_struct_t s_UsbDeviceEhciInterface = {
     USB_DeviceEhciInit, USB_DeviceEhciDeinit, USB_DeviceEhciSend,
-    USB_DeviceEhciRecv, USB_DeviceEhciCancel, USB_DeviceEhciControl};
+    USB_DeviceEhciRecv, USB_DeviceEhciCancel, USB_DeviceEhciControl,
+    USB_DeviceEhciSendV};
 #endif
 
 #if (((defined(USB_DEVICE_CONFIG_LPCIP3511FS)) && (USB_DEVICE_CONFIG_LPCIP3511FS > 0U)) || \
@@ -246,6 +268,62 @@ static usb_status_t USB_DeviceGetControllerInterface(
     return error;
 }
 
+/*!
+ * @brief Hand a transfer to the controller.
+ *
+ * This function maintains the cache of the transfer buffer and calls the controller send or receive interface.
+ *
+ * @param deviceHandle           The device handle. It equals the value returned from USB_DeviceInit.
+ * @param endpointAddress       Endpoint address. Bit7 is direction, 0U - USB_OUT, 1U - USB_IN.
+ * @param buffer                 The memory address to be transferred, or the memory address to hold the data need to be
+ * sent.
+ * @param length                 The length of the data.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceControllerTransfer(usb_device_struct_t *deviceHandle,
+                                                 uint8_t endpointAddress,
+                                                 uint8_t *buffer,
+                                                 uint32_t length)
+{
+    usb_status_t error;
+
+    if (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK)
+    {
+#if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
+        if (length)
+        {
+            DCACHE_CleanByRange((uint32_t)buffer, length);
+        }
+#endif
+        /* Call the controller send interface, the callbackFn is initialized in
+        USB_DeviceGetControllerInterface */
+        error = deviceHandle->controllerInterface->deviceSend(deviceHandle->controllerHandle, endpointAddress, buffer,
+                                                              length);
+    }
+    else
+    {
+#if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
+        if (length)
+        {
+            /* The received buffer is invalidated again on completion, a line shared with other data would lose the
+            writes done to that data in the meantime. The buffer has to start on a cache line and be sized with
+            USB_DATA_ALIGN_SIZE_MULTIPLE */
+            if ((uint32_t)buffer & (USB_CACHE_LINESIZE - 1U))
+            {
+                return kStatus_USB_InvalidParameter;
+            }
+            DCACHE_CleanInvalidateByRange((uint32_t)buffer, length);
+        }
+#endif
+        /* Call the controller receive interface, the callbackFn is initialized in
+        USB_DeviceGetControllerInterface */
+        error = deviceHandle->controllerInterface->deviceRecv(deviceHandle->controllerHandle, endpointAddress, buffer,
+                                                              length);
+    }
+    return error;
+}
+
 /*!
  * @brief Start a new transfer.
  *
@@ -272,7 +350,7 @@ static usb_status_t USB_DeviceTransfer(usb_device_handle handle,
     uint8_t endpoint                  = endpointAddress & USB_ENDPOINT_NUMBER_MASK;
     uint8_t direction                 = (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
                         USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
-    OSA_SR_ALLOC();
+    USB_OSA_SR_ALLOC();
 
     if (NULL == deviceHandle)
     {
@@ -285,49 +363,259 @@ static usb_status_t USB_DeviceTransfer(usb_device_handle handle,
         {
             return kStatus_USB_Busy;
         }
-        OSA_ENTER_CRITICAL();
+        USB_OSA_ENTER_CRITICAL();
         deviceHandle->epCallback[(uint8_t)((uint32_t)endpoint << 1U) | direction].isBusy = 1U;
-        OSA_EXIT_CRITICAL();
-        if (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK)
+        USB_OSA_EXIT_CRITICAL();
+        error = USB_DeviceControllerTransfer(deviceHandle, endpointAddress, buffer, length);
+        if (kStatus_USB_Success != error)
         {
-#if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
-            if (length)
-            {
-                DCACHE_CleanByRange((uint32_t)buffer, length);
-            }
-#endif
-            /* Call the controller send interface, the callbackFn is initialized in
-            USB_DeviceGetControllerInterface */
-            error = deviceHandle->controllerInterface->deviceSend(deviceHandle->controllerHandle, endpointAddress,
-                                                                  buffer, length);
+            USB_OSA_ENTER_CRITICAL();
+            deviceHandle->epCallback[(uint8_t)((uint32_t)endpoint << 1U) | direction].isBusy = 0U;
+            USB_OSA_EXIT_CRITICAL();
+        }
+    }
+    else
+    {
+        error = kStatus_USB_ControllerNotFound;
+    }
+    return error;
+}
+
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+/*!
+ * @brief Hand the pending requests of an endpoint to the controller.
+ *
+ * The requests are handed in queue order until the controller refuses one. Only the queue bookkeeping is done under
+ * the USB lock: a request is moved to the active queue before the controller is called, so its completion finds it
+ * there, and it is moved back when the controller refuses it. One caller hands the requests of an endpoint at a time,
+ * requests queued meanwhile are handed by that caller. The caller must not hold the USB lock.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ * @param endpointAddress       Endpoint address. Bit7 is direction, 0U - USB_OUT, 1U - USB_IN.
+ * @param refused                Set to the pending requests taken out of the queue when the controller refused one and
+ *                               no active request is left to retry them on, NULL otherwise.
+ *
+ * @return The error of the refused request or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceRequestQueueSubmit(usb_device_struct_t *handle,
+                                                 uint8_t endpointAddress,
+                                                 usb_device_request_struct_t **refused)
+{
+    uint8_t index = (uint8_t)((uint32_t)(endpointAddress & USB_ENDPOINT_NUMBER_MASK) << 1U) |
+                    ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                     USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT);
+    usb_device_request_queue_struct_t *queue = &handle->epQueue[index];
+    usb_device_request_struct_t *request;
+    usb_device_request_struct_t *previous = NULL;
+    usb_device_request_struct_t *active;
+    usb_status_t error = kStatus_USB_Success;
+    USB_OSA_SR_ALLOC();
+
+    *refused = NULL;
+    USB_OSA_ENTER_CRITICAL();
+    if (queue->isSubmitting)
+    {
+        USB_OSA_EXIT_CRITICAL();
+        return kStatus_USB_Success;
+    }
+    queue->isSubmitting = 1U;
+
+    while (NULL != queue->pendingHead)
+    {
+        /* Reserve the request in the active queue */
+        request            = queue->pendingHead;
+        queue->pendingHead = request->next;
+        if (NULL == queue->pendingHead)
+        {
+            queue->pendingTail = NULL;
+        }
+        request->next = NULL;
+        previous      = queue->activeTail;
+        if (NULL == previous)
+        {
+            queue->activeHead = request;
         }
         else
         {
-#if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
-            if (length)
+            previous->next = request;
+        }
+        queue->activeTail = request;
+        USB_OSA_EXIT_CRITICAL();
+
+        error = USB_DeviceControllerTransfer(handle, endpointAddress, request->buffer, request->length);
+
+        USB_OSA_ENTER_CRITICAL();
+        for (active = queue->activeHead; (NULL != active) && (active != request); active = active->next)
+        {
+        }
+        if (NULL == active)
+        {
+            /* The endpoint was reset or de-initialized meanwhile and the request is cancelled by that path, make sure
+            the controller does not keep the transfer */
+            USB_OSA_EXIT_CRITICAL();
+            if (kStatus_USB_Success == error)
             {
-                DCACHE_CleanInvalidateByRange((uint32_t)buffer, length);
+                (void)USB_DeviceCancel(handle, endpointAddress);
             }
-#endif
-            /* Call the controller receive interface, the callbackFn is initialized in
-            USB_DeviceGetControllerInterface */
-            error = deviceHandle->controllerInterface->deviceRecv(deviceHandle->controllerHandle, endpointAddress,
-                                                                  buffer, length);
+            USB_OSA_ENTER_CRITICAL();
+            error = kStatus_USB_Error;
+            break;
         }
         if (kStatus_USB_Success != error)
         {
-            OSA_ENTER_CRITICAL();
-            deviceHandle->epCallback[(uint8_t)((uint32_t)endpoint << 1U) | direction].isBusy = 0U;
-            OSA_EXIT_CRITICAL();
+            /* Roll the reservation back, the request is the active tail as only this caller appends to it. The
+            previous request is still linked unless it was done meanwhile, then the request became the head. */
+            if (queue->activeHead == request)
+            {
+                queue->activeHead = NULL;
+                queue->activeTail = NULL;
+            }
+            else
+            {
+                previous->next    = NULL;
+                queue->activeTail = previous;
+            }
+            request->next      = queue->pendingHead;
+            queue->pendingHead = request;
+            if (NULL == queue->pendingTail)
+            {
+                queue->pendingTail = request;
+            }
+            break;
         }
     }
-    else
+
+    if ((kStatus_USB_Success != error) && (NULL == queue->activeHead))
     {
-        error = kStatus_USB_ControllerNotFound;
+        /* No completion is left to retry the refused requests on */
+        *refused                         = queue->pendingHead;
+        queue->pendingHead               = NULL;
+        queue->pendingTail               = NULL;
+        handle->epCallback[index].isBusy = 0U;
     }
+    queue->isSubmitting = 0U;
+    USB_OSA_EXIT_CRITICAL();
     return error;
 }
 
+/*!
+ * @brief Take requests out of an endpoint queue.
+ *
+ * The pending requests are always taken. The active requests are taken only when the controller does not own them
+ * anymore, after the endpoint has been de-initialized.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ * @param index                  The endpoint index, endpoint number * 2 + direction.
+ * @param includeActive          Take the active requests too.
+ *
+ * @return The taken requests in queue order, linked by usb_device_request_struct_t::next.
+ */
+static usb_device_request_struct_t *USB_DeviceRequestQueueTake(usb_device_struct_t *handle,
+                                                               uint8_t index,
+                                                               uint8_t includeActive)
+{
+    usb_device_request_queue_struct_t *queue = &handle->epQueue[index];
+    usb_device_request_struct_t *request;
+    USB_OSA_SR_ALLOC();
+
+    USB_OSA_ENTER_CRITICAL();
+    request = queue->pendingHead;
+    if ((includeActive) && (NULL != queue->activeHead))
+    {
+        queue->activeTail->next = queue->pendingHead;
+        request                 = queue->activeHead;
+        queue->activeHead       = NULL;
+        queue->activeTail       = NULL;
+    }
+    queue->pendingHead = NULL;
+    queue->pendingTail = NULL;
+    if ((NULL != request) && (NULL == queue->activeHead))
+    {
+        handle->epCallback[index].isBusy = 0U;
+    }
+    USB_OSA_EXIT_CRITICAL();
+    return request;
+}
+
+/*!
+ * @brief Notify the upper layer that requests are cancelled.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ * @param request                The requests got from USB_DeviceRequestQueueTake.
+ */
+static void USB_DeviceRequestQueueCancel(usb_device_struct_t *handle, usb_device_request_struct_t *request)
+{
+    usb_device_request_struct_t *next;
+
+    while (NULL != request)
+    {
+        next                  = request->next;
+        request->next         = NULL;
+        request->actualLength = USB_UNINITIALIZED_VAL_32;
+        if (request->callbackFn)
+        {
+            (void)request->callbackFn(handle, request);
+        }
+        request = next;
+    }
+}
+
+/*!
+ * @brief Finish the oldest active request of an endpoint.
+ *
+ * The next pending requests are handed to the controller before the upper layer is notified, so the controller is not
+ * idle while the callback runs.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ * @param endpointAddress       Endpoint address. Bit7 is direction, 0U - USB_OUT, 1U - USB_IN.
+ * @param length                 The transferred length reported by the controller.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceRequestDone(usb_device_struct_t *handle, uint8_t endpointAddress, uint32_t length)
+{
+    uint8_t index = (uint8_t)((uint32_t)(endpointAddress & USB_ENDPOINT_NUMBER_MASK) << 1U) |
+                    ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                     USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT);
+    usb_device_request_queue_struct_t *queue = &handle->epQueue[index];
+    usb_device_request_struct_t *request;
+    usb_device_request_struct_t *refused = NULL;
+    usb_status_t error                   = kStatus_USB_Success;
+    USB_OSA_SR_ALLOC();
+
+    USB_OSA_ENTER_CRITICAL();
+    request = queue->activeHead;
+    if (NULL == request)
+    {
+        USB_OSA_EXIT_CRITICAL();
+        return kStatus_USB_Error;
+    }
+    queue->activeHead = request->next;
+    if (NULL == queue->activeHead)
+    {
+        queue->activeTail = NULL;
+    }
+    request->next = NULL;
+    USB_OSA_EXIT_CRITICAL();
+
+    (void)USB_DeviceRequestQueueSubmit(handle, endpointAddress, &refused);
+    USB_OSA_ENTER_CRITICAL();
+    if ((NULL == queue->activeHead) && (NULL == queue->pendingHead) && (!queue->isSubmitting))
+    {
+        handle->epCallback[index].isBusy = 0U;
+    }
+    USB_OSA_EXIT_CRITICAL();
+
+    request->actualLength = length;
+    if (request->callbackFn)
+    {
+        error = request->callbackFn(handle, request);
+    }
+    USB_DeviceRequestQueueCancel(handle, refused);
+    return error;
+}
+#endif
+
 /*!
  * @brief Control the status of the selected item.
  *
@@ -380,9 +668,12 @@ static usb_status_t USB_DeviceResetNotification(usb_device_struct_t *handle,
                                                 usb_device_callback_message_struct_t *message)
 {
     uint32_t count;
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+    usb_device_request_struct_t *pending[USB_DEVICE_CONFIG_ENDPOINTS * 2U];
+#endif
 
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
-    OSA_SR_ALLOC();
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    USB_OSA_SR_ALLOC();
 #endif
 
     handle->isResetting = 1U;
@@ -392,17 +683,31 @@ static usb_status_t USB_DeviceResetNotification(usb_device_struct_t *handle,
     handle->remotewakeup = 0U;
 #endif
 
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
-    OSA_ENTER_CRITICAL();
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+    /* Keep the pending requests away from the controller while its transfers are cancelled */
+    for (count = 0U; count < (USB_DEVICE_CONFIG_ENDPOINTS * 2U); count++)
+    {
+        pending[count] = USB_DeviceRequestQueueTake(handle, (uint8_t)count, 0U);
+    }
+#endif
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    USB_OSA_ENTER_CRITICAL();
     handle->epCallbackDirectly = 1;
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
 #endif
     /* Set the controller to default status. */
     USB_DeviceControl(handle, kUSB_DeviceControlSetDefaultStatus, NULL);
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
-    OSA_ENTER_CRITICAL();
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    USB_OSA_ENTER_CRITICAL();
     handle->epCallbackDirectly = 0;
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
+#endif
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+    for (count = 0U; count < (USB_DEVICE_CONFIG_ENDPOINTS * 2U); count++)
+    {
+        USB_DeviceRequestQueueCancel(handle, USB_DeviceRequestQueueTake(handle, (uint8_t)count, 1U));
+        USB_DeviceRequestQueueCancel(handle, pending[count]);
+    }
 #endif
 
     handle->state         = kUSB_DeviceStateDefault;
@@ -624,6 +929,23 @@ static usb_status_t USB_DeviceNotification(usb_device_struct_t *handle, usb_devi
         default:
             if (endpoint < USB_DEVICE_CONFIG_ENDPOINTS)
             {
+#if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
+                if ((USB_OUT == direction) && (!message->isSetup) && (NULL != message->buffer) && (message->length) &&
+                    (USB_UNINITIALIZED_VAL_32 != message->length))
+                {
+                    /* The core may have fetched lines of the buffer speculatively while the controller was writing it */
+                    DCACHE_InvalidateByRange((uint32_t)message->buffer, message->length);
+                }
+#endif
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+                if ((!message->isSetup) &&
+                    (NULL != handle->epQueue[(uint8_t)((uint32_t)endpoint << 1U) | direction].activeHead))
+                {
+                    /* The transfer belongs to a queued request, the request callback is called instead */
+                    error = USB_DeviceRequestDone(handle, message->code, message->length);
+                }
+                else
+#endif
                 if (handle->epCallback[(uint8_t)((uint32_t)endpoint << 1U) | direction].callbackFn)
                 {
                     usb_device_endpoint_callback_message_struct_t endpointCallbackMessage;
@@ -650,6 +972,135 @@ static usb_status_t USB_DeviceNotification(usb_device_struct_t *handle, usb_devi
     return error;
 }
 
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+/*!
+ * @brief Queue a notification for the task.
+ *
+ * The bus and control endpoint notifications go to the control lane, so a burst of bulk completions does not delay
+ * the control transfers. The controller ISR and the cancellations started by tasks both queue notifications, so the
+ * slot is claimed with the interrupts masked. The task reads the lanes without any lock.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ * @param message                The device callback message handle.
+ *
+ * @retval kStatus_USB_Success              The notification is queued.
+ * @retval kStatus_USB_Busy                 The lane is full, the notification is counted as overflow.
+ */
+static usb_status_t USB_DeviceNotificationPut(usb_device_struct_t *handle, usb_device_callback_message_struct_t *message)
+{
+    usb_device_notification_lane_struct_t *lane;
+    uint32_t head;
+    uint32_t count;
+    uint32_t size;
+    uint8_t isBulk = ((message->code & USB_ENDPOINT_NUMBER_MASK) && (!(message->code & 0x70U))) ? 1U : 0U;
+    USB_OSA_SR_ALLOC();
+
+    if (isBulk)
+    {
+        lane = &handle->bulkLane;
+        size = USB_DEVICE_CONFIG_MAX_MESSAGES;
+    }
+    else
+    {
+        lane = &handle->controlLane;
+        size = USB_DEVICE_CONFIG_CONTROL_MESSAGES;
+    }
+
+    USB_OSA_ENTER_CRITICAL();
+    head  = lane->head;
+    count = head - lane->tail;
+    if (count >= size)
+    {
+        lane->overflow++;
+        USB_OSA_EXIT_CRITICAL();
+        return kStatus_USB_Busy;
+    }
+    if (isBulk)
+    {
+        handle->bulkMessage[head & (USB_DEVICE_CONFIG_MAX_MESSAGES - 1U)] = *message;
+    }
+    else
+    {
+        handle->controlMessage[head & (USB_DEVICE_CONFIG_CONTROL_MESSAGES - 1U)].message  = *message;
+        handle->controlMessage[head & (USB_DEVICE_CONFIG_CONTROL_MESSAGES - 1U)].bulkHead = handle->bulkLane.head;
+    }
+    if (count >= lane->peak)
+    {
+        lane->peak = count + 1U;
+    }
+    /* The record has to be complete before the task can see it */
+    __DMB();
+    lane->head = head + 1U;
+    USB_OSA_EXIT_CRITICAL();
+
+    /* The task drains the lanes until they are empty, it only has to be woken when a lane gets non-empty */
+    if (0U == count)
+    {
+        (void)OSA_SemaphorePost(handle->notificationSemaphore);
+    }
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Handle the oldest bulk lane notification.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ */
+static void USB_DeviceNotificationTakeBulk(usb_device_struct_t *handle)
+{
+    usb_device_callback_message_struct_t message;
+    uint32_t tail = handle->bulkLane.tail;
+
+    /* Read the record only after its head update is seen */
+    __DMB();
+    message = handle->bulkMessage[tail & (USB_DEVICE_CONFIG_MAX_MESSAGES - 1U)];
+    /* Release the slot before the callback, which may start transfers completing in the meantime */
+    handle->bulkLane.tail = tail + 1U;
+    USB_DeviceNotification(handle, &message);
+}
+
+/*!
+ * @brief Handle the queued notifications.
+ *
+ * The control lane is served first. A setup packet or a bus event is handled only after the bulk completions queued
+ * before it, so a reset or a new configuration never overtakes the completions of the old one.
+ *
+ * @param handle                 The device handle. It equals the value returned from USB_DeviceInit.
+ */
+static void USB_DeviceNotificationDrain(usb_device_struct_t *handle)
+{
+    usb_device_control_notification_struct_t control;
+    uint32_t tail;
+
+    for (;;)
+    {
+        tail = handle->controlLane.tail;
+        if (tail != handle->controlLane.head)
+        {
+            __DMB();
+            control = handle->controlMessage[tail & (USB_DEVICE_CONFIG_CONTROL_MESSAGES - 1U)];
+            if ((control.message.isSetup) || (control.message.code & 0x70U))
+            {
+                while (handle->bulkLane.tail != control.bulkHead)
+                {
+                    USB_DeviceNotificationTakeBulk(handle);
+                }
+            }
+            handle->controlLane.tail = tail + 1U;
+            USB_DeviceNotification(handle, &control.message);
+        }
+        else if (handle->bulkLane.tail != handle->bulkLane.head)
+        {
+            USB_DeviceNotificationTakeBulk(handle);
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+#endif
+
 /*!
  * @brief Notify the device that the controller status changed.
  *
@@ -676,7 +1127,7 @@ usb_status_t USB_DeviceNotificationTrigger(void *handle, void *msg)
         return kStatus_USB_Error;
     }
 
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
     if (deviceHandle->epCallbackDirectly)
     {
         if ((message->code & USB_ENDPOINT_NUMBER_MASK) && (!(message->code & 0x70U)))
@@ -684,13 +1135,22 @@ usb_status_t USB_DeviceNotificationTrigger(void *handle, void *msg)
             return USB_DeviceNotification(deviceHandle, message);
         }
     }
+#endif
 
-    /* Add the message to message queue when the device task is enabled. */
-    if (KOSA_StatusSuccess != OSA_MsgQPut(deviceHandle->notificationQueue, (osa_msg_handle_t)message))
+#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
+    /* Add the message to the notification queue when the device task is enabled. */
+    return USB_DeviceNotificationPut(deviceHandle, message);
+#elif (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+    /* Completions of the latency critical endpoints are handled in place, the others by the deferred task. */
+    if ((!(message->code & 0x70U)) &&
+        (deviceHandle->epCallbackInIsr &
+         (1U << (((uint32_t)(message->code & USB_ENDPOINT_NUMBER_MASK) << 1U) |
+                 ((message->code & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                  USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT)))))
     {
-        return kStatus_USB_Busy;
+        return USB_DeviceNotification(deviceHandle, message);
     }
-    return kStatus_USB_Success;
+    return USB_DeviceNotificationPut(deviceHandle, message);
 #else
     /* Handle the notification by calling USB_DeviceNotification. */
     return USB_DeviceNotification(deviceHandle, message);
@@ -750,6 +1210,12 @@ usb_status_t USB_DeviceInit(uint8_t controllerId, usb_device_callback_t deviceCa
         deviceHandle->epCallback[count].callbackFn    = (usb_device_endpoint_callback_t)NULL;
         deviceHandle->epCallback[count].callbackParam = NULL;
         deviceHandle->epCallback[count].isBusy        = 0U;
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+        deviceHandle->epQueue[count].activeHead  = NULL;
+        deviceHandle->epQueue[count].activeTail  = NULL;
+        deviceHandle->epQueue[count].pendingHead = NULL;
+        deviceHandle->epQueue[count].pendingTail = NULL;
+#endif
     }
 
     /* Get the controller interface according to the controller id */
@@ -775,16 +1241,24 @@ usb_status_t USB_DeviceInit(uint8_t controllerId, usb_device_callback_t deviceCa
         return kStatus_USB_InvalidControllerInterface;
     }
 
-#if USB_DEVICE_CONFIG_USE_TASK
-    /* Create a message queue when the device handle is enabled. */
-    deviceHandle->notificationQueue = (osa_msgq_handle_t)&deviceHandle->notificationQueueBuffer[0];
-    if (KOSA_StatusSuccess !=
-        OSA_MsgQCreate(deviceHandle->notificationQueue, USB_DEVICE_CONFIG_MAX_MESSAGES, USB_DEVICE_MESSAGES_SIZE))
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    /* Create the semaphore waking the task when the notification queue is enabled. */
+    deviceHandle->controlLane.head     = 0U;
+    deviceHandle->controlLane.tail     = 0U;
+    deviceHandle->controlLane.overflow = 0U;
+    deviceHandle->controlLane.peak     = 0U;
+    deviceHandle->bulkLane             = deviceHandle->controlLane;
+    deviceHandle->notificationSemaphore = (osa_semaphore_handle_t)&deviceHandle->notificationSemaphoreBuffer[0];
+    if (KOSA_StatusSuccess != OSA_SemaphoreCreate(deviceHandle->notificationSemaphore, 0U))
     {
+        deviceHandle->notificationSemaphore = NULL;
         USB_DeviceDeinit(deviceHandle);
         return kStatus_USB_Error;
     }
 #endif
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+    deviceHandle->epCallbackInIsr = 0U;
+#endif
 
     *handle = deviceHandle;
 
@@ -861,12 +1335,12 @@ usb_status_t USB_DeviceDeinit(usb_device_handle handle)
         deviceHandle->controllerInterface = (usb_device_controller_interface_struct_t *)NULL;
     }
 
-#if USB_DEVICE_CONFIG_USE_TASK
-    /* Destroy the message queue. */
-    if (NULL != deviceHandle->notificationQueue)
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    /* Destroy the semaphore of the notification queue. */
+    if (NULL != deviceHandle->notificationSemaphore)
     {
-        OSA_MsgQDestroy(deviceHandle->notificationQueue);
-        deviceHandle->notificationQueue = NULL;
+        OSA_SemaphoreDestroy(deviceHandle->notificationSemaphore);
+        deviceHandle->notificationSemaphore = NULL;
     }
 #endif
 
@@ -907,6 +1381,85 @@ usb_status_t USB_DeviceSendRequest(usb_device_handle handle, uint8_t endpointAdd
         buffer, length);
 }
 
+/*!
+ * @brief Send data of several buffers through a specified endpoint.
+ *
+ * The function is used to send data of several buffers through a specified endpoint as one transfer.
+ *
+ * @param handle The device handle got from USB_DeviceInit.
+ * @param endpointAddress Endpoint index.
+ * @param segments The buffers to be sent in order.
+ * @param segmentCount The count of the buffers.
+ *
+ * @retval kStatus_USB_Success              The send request is sent successfully.
+ * @retval kStatus_USB_InvalidHandle        The handle is a NULL pointer. Or the controller handle is invalid.
+ * @retval kStatus_USB_InvalidParameter     The segments are empty. Or a buffer would end a short packet in the
+ * middle of the transfer.
+ * @retval kStatus_USB_InvalidRequest       The controller does not support scatter-gather transfers.
+ * @retval kStatus_USB_Busy                 Cannot allocate dtds for current transfer in EHCI driver.
+ * @retval kStatus_USB_ControllerNotFound   Cannot find the controller.
+ * @retval kStatus_USB_Error                The device is doing reset.
+ */
+usb_status_t USB_DeviceSendRequestV(usb_device_handle handle,
+                                    uint8_t endpointAddress,
+                                    const usb_device_transfer_segment_struct_t *segments,
+                                    uint32_t segmentCount)
+{
+    usb_device_struct_t *deviceHandle = (usb_device_struct_t *)handle;
+    uint8_t index = (uint8_t)((uint32_t)(endpointAddress & USB_ENDPOINT_NUMBER_MASK) << 1U) | USB_IN;
+    usb_status_t error;
+    USB_OSA_SR_ALLOC();
+
+    if (NULL == deviceHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    if ((NULL == segments) || (0U == segmentCount))
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+    if (NULL == deviceHandle->controllerInterface)
+    {
+        return kStatus_USB_ControllerNotFound;
+    }
+    if (NULL == deviceHandle->controllerInterface->deviceSendV)
+    {
+        return kStatus_USB_InvalidRequest;
+    }
+
+    USB_OSA_ENTER_CRITICAL();
+    if (deviceHandle->epCallback[index].isBusy)
+    {
+        USB_OSA_EXIT_CRITICAL();
+        return kStatus_USB_Busy;
+    }
+    deviceHandle->epCallback[index].isBusy = 1U;
+    USB_OSA_EXIT_CRITICAL();
+
+#if (defined(USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE) && (USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE > 0U))
+    for (uint32_t count = 0U; count < segmentCount; count++)
+    {
+        if (segments[count].length)
+        {
+            DCACHE_CleanByRange((uint32_t)segments[count].buffer, segments[count].length);
+        }
+    }
+#endif
+    /* Call the controller send interface, the callbackFn is initialized in
+    USB_DeviceGetControllerInterface */
+    error = deviceHandle->controllerInterface->deviceSendV(
+        deviceHandle->controllerHandle,
+        (endpointAddress & USB_ENDPOINT_NUMBER_MASK) | (USB_IN << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT),
+        segments, segmentCount);
+    if (kStatus_USB_Success != error)
+    {
+        USB_OSA_ENTER_CRITICAL();
+        deviceHandle->epCallback[index].isBusy = 0U;
+        USB_OSA_EXIT_CRITICAL();
+    }
+    return error;
+}
+
 /*!
  * @brief Receive data through a specified endpoint.
  *
@@ -973,6 +1526,132 @@ usb_status_t USB_DeviceCancel(usb_device_handle handle, uint8_t endpointAddress)
     return error;
 }
 
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+/*!
+ * @brief Queue a transfer request in a specified endpoint.
+ *
+ * The function appends the request to the endpoint queue and hands it to the controller when the controller has
+ * resources for it.
+ *
+ * @param handle The device handle got from USB_DeviceInit.
+ * @param endpointAddress Endpoint address, bit7 is the direction of endpoint, 1U - IN, abd 0U - OUT.
+ * @param request The request, it must stay valid until its callback is called.
+ *
+ * @retval kStatus_USB_Success              The request is queued.
+ * @retval kStatus_USB_InvalidHandle        The handle is a NULL pointer. Or the controller handle is invalid.
+ * @retval kStatus_USB_InvalidParameter     The request is a NULL pointer. Or the endpoint is the control endpoint or
+ * its number is more than USB_DEVICE_CONFIG_ENDPOINTS.
+ * @retval kStatus_USB_Busy                 A transfer not queued by this function is pending in the endpoint. Or the
+ * controller cannot take the request and no other request is pending.
+ * @retval kStatus_USB_ControllerNotFound   Cannot find the controller.
+ * @retval kStatus_USB_Error                The device is doing reset.
+ */
+usb_status_t USB_DeviceQueueRequest(usb_device_handle handle,
+                                    uint8_t endpointAddress,
+                                    usb_device_request_struct_t *request)
+{
+    usb_device_struct_t *deviceHandle = (usb_device_struct_t *)handle;
+    uint8_t endpoint                  = endpointAddress & USB_ENDPOINT_NUMBER_MASK;
+    uint8_t direction                 = (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                        USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
+    uint8_t index                     = (uint8_t)((uint32_t)endpoint << 1U) | direction;
+    usb_device_request_queue_struct_t *queue;
+    usb_device_request_struct_t *refused;
+    usb_status_t error;
+    USB_OSA_SR_ALLOC();
+
+    if (NULL == deviceHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    if ((NULL == request) || (USB_CONTROL_ENDPOINT == endpoint) || (endpoint >= USB_DEVICE_CONFIG_ENDPOINTS))
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+    if (NULL == deviceHandle->controllerInterface)
+    {
+        return kStatus_USB_ControllerNotFound;
+    }
+    if (deviceHandle->isResetting)
+    {
+        return kStatus_USB_Error;
+    }
+
+    queue                 = &deviceHandle->epQueue[index];
+    request->next         = NULL;
+    request->actualLength = 0U;
+
+    USB_OSA_ENTER_CRITICAL();
+    if ((deviceHandle->epCallback[index].isBusy) && (NULL == queue->activeHead) && (NULL == queue->pendingHead))
+    {
+        USB_OSA_EXIT_CRITICAL();
+        return kStatus_USB_Busy;
+    }
+    deviceHandle->epCallback[index].isBusy = 1U;
+    if (NULL == queue->pendingTail)
+    {
+        queue->pendingHead = request;
+    }
+    else
+    {
+        queue->pendingTail->next = request;
+    }
+    queue->pendingTail = request;
+    USB_OSA_EXIT_CRITICAL();
+
+    error = USB_DeviceRequestQueueSubmit(deviceHandle, endpointAddress, &refused);
+    if ((kStatus_USB_Success != error) && (request == refused))
+    {
+        /* The request is returned to the caller, the ones queued behind it meanwhile are done with cancellation */
+        refused       = request->next;
+        request->next = NULL;
+        USB_DeviceRequestQueueCancel(deviceHandle, refused);
+        return error;
+    }
+    USB_DeviceRequestQueueCancel(deviceHandle, refused);
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Cancel all queued requests in a specified endpoint.
+ *
+ * The pending requests are done before the function returns, the active requests are done when the controller
+ * reports their cancellation.
+ *
+ * @param handle The device handle got from USB_DeviceInit.
+ * @param endpointAddress Endpoint address, bit7 is the direction of endpoint, 1U - IN, abd 0U - OUT.
+ *
+ * @retval kStatus_USB_Success              The requests are cancelled.
+ * @retval kStatus_USB_InvalidHandle        The handle is a NULL pointer. Or the controller handle is invalid.
+ * @retval kStatus_USB_InvalidParameter     The endpoint number is more than USB_DEVICE_CONFIG_ENDPOINTS.
+ * @retval kStatus_USB_ControllerNotFound   Cannot find the controller.
+ */
+usb_status_t USB_DeviceCancelRequests(usb_device_handle handle, uint8_t endpointAddress)
+{
+    usb_device_struct_t *deviceHandle = (usb_device_struct_t *)handle;
+    uint8_t endpoint                  = endpointAddress & USB_ENDPOINT_NUMBER_MASK;
+    uint8_t direction                 = (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                        USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
+    usb_device_request_struct_t *pending;
+    usb_status_t error;
+
+    if (NULL == deviceHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    if (endpoint >= USB_DEVICE_CONFIG_ENDPOINTS)
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    /* Take the pending requests first, so the cancelled completions do not hand them to the controller */
+    pending = USB_DeviceRequestQueueTake(deviceHandle, (uint8_t)((uint32_t)endpoint << 1U) | direction, 0U);
+    error   = USB_DeviceCancel(handle, endpointAddress);
+    USB_DeviceRequestQueueCancel(deviceHandle, pending);
+    return error;
+}
+#endif
+
 /*!
  * @brief Initialize a specified endpoint.
  *
@@ -1047,28 +1726,44 @@ usb_status_t USB_DeviceDeinitEndpoint(usb_device_handle handle, uint8_t endpoint
     uint8_t direction                 = (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
                         USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
     usb_status_t error = kStatus_USB_Error;
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
-    OSA_SR_ALLOC();
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+    usb_device_request_struct_t *pending = NULL;
+#endif
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    USB_OSA_SR_ALLOC();
 #endif
 
     if (!deviceHandle)
     {
         return kStatus_USB_InvalidHandle;
     }
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
-    OSA_ENTER_CRITICAL();
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+    if (endpoint < USB_DEVICE_CONFIG_ENDPOINTS)
+    {
+        /* Keep the pending requests away from the controller while its transfers are cancelled */
+        pending = USB_DeviceRequestQueueTake(deviceHandle, (uint8_t)((uint32_t)endpoint << 1U) | direction, 0U);
+    }
+#endif
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    USB_OSA_ENTER_CRITICAL();
     deviceHandle->epCallbackDirectly = 1;
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
 #endif
     error = USB_DeviceControl(handle, kUSB_DeviceControlEndpointDeinit, &endpointAddress);
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
-    OSA_ENTER_CRITICAL();
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    USB_OSA_ENTER_CRITICAL();
     deviceHandle->epCallbackDirectly = 0;
-    OSA_EXIT_CRITICAL();
+    USB_OSA_EXIT_CRITICAL();
 #endif
 
     if (endpoint < USB_DEVICE_CONFIG_ENDPOINTS)
     {
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+        USB_DeviceRequestQueueCancel(
+            deviceHandle,
+            USB_DeviceRequestQueueTake(deviceHandle, (uint8_t)((uint32_t)endpoint << 1U) | direction, 1U));
+        USB_DeviceRequestQueueCancel(deviceHandle, pending);
+#endif
         deviceHandle->epCallback[(uint8_t)((uint32_t)endpoint << 1U) | direction].callbackFn =
             (usb_device_endpoint_callback_t)NULL;
         deviceHandle->epCallback[(uint8_t)((uint32_t)endpoint << 1U) | direction].callbackParam = NULL;
@@ -1182,6 +1877,30 @@ usb_status_t USB_DeviceGetStatus(usb_device_handle handle, usb_device_status_t t
         case kUSB_DeviceStatusSynchFrame:
             error = USB_DeviceControl(handle, kUSB_DeviceControlGetSynchFrame, param);
             break;
+        case kUSB_DeviceStatusTransferResource:
+            error = USB_DeviceControl(handle, kUSB_DeviceControlGetTransferResourceStatus, param);
+            break;
+        case kUSB_DeviceStatusInterruptThreshold:
+            error = USB_DeviceControl(handle, kUSB_DeviceControlGetInterruptThreshold, param);
+            break;
+        case kUSB_DeviceStatusCriticalSection:
+            error = USB_DeviceControl(handle, kUSB_DeviceControlGetCriticalSectionStatus, param);
+            break;
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+        case kUSB_DeviceStatusNotificationQueue:
+            if (NULL != handle)
+            {
+                usb_device_notification_queue_status_struct_t *queueStatus =
+                    (usb_device_notification_queue_status_struct_t *)param;
+
+                queueStatus->controlOverflow = ((usb_device_struct_t *)handle)->controlLane.overflow;
+                queueStatus->bulkOverflow    = ((usb_device_struct_t *)handle)->bulkLane.overflow;
+                queueStatus->controlPeak     = ((usb_device_struct_t *)handle)->controlLane.peak;
+                queueStatus->bulkPeak        = ((usb_device_struct_t *)handle)->bulkLane.peak;
+                error                        = kStatus_USB_Success;
+            }
+            break;
+#endif
 #if ((defined(USB_DEVICE_CONFIG_REMOTE_WAKEUP)) && (USB_DEVICE_CONFIG_REMOTE_WAKEUP > 0U))
         case kUSB_DeviceStatusRemoteWakeup:
             temp8  = (uint8_t *)param;
@@ -1270,6 +1989,12 @@ usb_status_t USB_DeviceSetStatus(usb_device_handle handle, usb_device_status_t t
         case kUSB_DeviceStatusBusSleep:
             error = USB_DeviceControl(handle, kUSB_DeviceControlSleep, param);
             break;
+        case kUSB_DeviceStatusInterruptThreshold:
+            error = USB_DeviceControl(handle, kUSB_DeviceControlSetInterruptThreshold, param);
+            break;
+        case kUSB_DeviceStatusCriticalSection:
+            error = USB_DeviceControl(handle, kUSB_DeviceControlClearCriticalSectionStatus, param);
+            break;
         default:
             break;
     }
@@ -1315,7 +2040,7 @@ usb_status_t USB_DeviceDcdDisable(usb_device_handle handle)
 /*!
  * @brief Device task function.
  *
- * The function is used to handle controller message.
+ * The function waits for the controller messages and handles all of them.
  * This function should not be called in application directly.
  *
  * @param handle The device handle got from USB_DeviceInit.
@@ -1323,19 +2048,83 @@ usb_status_t USB_DeviceDcdDisable(usb_device_handle handle)
 void USB_DeviceTaskFunction(void *deviceHandle)
 {
     usb_device_struct_t *handle = (usb_device_struct_t *)deviceHandle;
-    usb_device_callback_message_struct_t message;
 
     if (deviceHandle)
     {
-        /* Get the message from the queue */
-        if (KOSA_StatusSuccess ==
-            OSA_MsgQGet(handle->notificationQueue, (osa_msg_handle_t)&message, USB_OSA_WAIT_TIMEOUT))
+        /* Wait for the messages and handle all of them */
+        if (KOSA_StatusSuccess == OSA_SemaphoreWait(handle->notificationSemaphore, USB_OSA_WAIT_TIMEOUT))
+        {
+            USB_DeviceNotificationDrain(handle);
+        }
+    }
+}
+#endif
+
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+/*!
+ * @brief Deferred callback task function.
+ *
+ * The function waits for the completions queued by the controller ISR and handles all of them.
+ * This function should not be called in application directly.
+ *
+ * @param handle The device handle got from USB_DeviceInit.
+ */
+void USB_DeviceDeferredTaskFunction(void *deviceHandle)
+{
+    usb_device_struct_t *handle = (usb_device_struct_t *)deviceHandle;
+
+    if (deviceHandle)
+    {
+        if (KOSA_StatusSuccess == OSA_SemaphoreWait(handle->notificationSemaphore, USB_OSA_WAIT_TIMEOUT))
         {
-            /* Handle the message */
-            USB_DeviceNotification(handle, &message);
+            USB_DeviceNotificationDrain(handle);
         }
     }
 }
+
+/*!
+ * @brief Select where the callback of an endpoint runs.
+ *
+ * @param handle The device handle got from USB_DeviceInit.
+ * @param endpointAddress Endpoint address, bit7 is the direction of endpoint, 1U - IN, abd 0U - OUT.
+ * @param inIsr 1U to call back from the ISR, 0U to call back from the deferred callback task.
+ *
+ * @retval kStatus_USB_Success              The setting is changed.
+ * @retval kStatus_USB_InvalidHandle        The device handle is a NULL pointer.
+ * @retval kStatus_USB_InvalidParameter     The endpoint is the control endpoint or its number is more than
+ * USB_DEVICE_CONFIG_ENDPOINTS.
+ */
+usb_status_t USB_DeviceSetEndpointCallbackInIsr(usb_device_handle handle, uint8_t endpointAddress, uint8_t inIsr)
+{
+    usb_device_struct_t *deviceHandle = (usb_device_struct_t *)handle;
+    uint8_t endpoint                  = endpointAddress & USB_ENDPOINT_NUMBER_MASK;
+    uint8_t direction                 = (endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                        USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT;
+    uint32_t mask;
+    USB_OSA_SR_ALLOC();
+
+    if (NULL == deviceHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    if ((USB_CONTROL_ENDPOINT == endpoint) || (endpoint >= USB_DEVICE_CONFIG_ENDPOINTS))
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    mask = 1U << (((uint32_t)endpoint << 1U) | direction);
+    USB_OSA_ENTER_CRITICAL();
+    if (inIsr)
+    {
+        deviceHandle->epCallbackInIsr |= mask;
+    }
+    else
+    {
+        deviceHandle->epCallbackInIsr &= ~mask;
+    }
+    USB_OSA_EXIT_CRITICAL();
+    return kStatus_USB_Success;
+}
 #endif
 
 /*!
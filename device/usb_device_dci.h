@@ -75,6 +75,11 @@ typedef enum _usb_device_control_type
 #endif
     kUSB_DeviceControlPreSetDeviceAddress, /*!< Pre set device address */
     kUSB_DeviceControlUpdateHwTick,        /*!< update hardware tick */
+    kUSB_DeviceControlGetTransferResourceStatus, /*!< Get transfer descriptor usage of endpoint */
+    kUSB_DeviceControlGetInterruptThreshold,     /*!< Get interrupt threshold in micro-frames */
+    kUSB_DeviceControlSetInterruptThreshold,     /*!< Set interrupt threshold in micro-frames */
+    kUSB_DeviceControlGetCriticalSectionStatus,  /*!< Get interrupt masked cycles of the transfer path */
+    kUSB_DeviceControlClearCriticalSectionStatus, /*!< Clear interrupt masked cycles of the transfer path */
 } usb_device_control_type_t;
 
 /*! @brief USB device controller initialization function typedef */
@@ -97,6 +102,12 @@ typedef usb_status_t (*usb_device_controller_recv_t)(usb_device_controller_handl
                                                      uint8_t *buffer,
                                                      uint32_t length);
 
+/*! @brief USB device controller send data of several buffers function typedef */
+typedef usb_status_t (*usb_device_controller_send_v_t)(usb_device_controller_handle controllerHandle,
+                                                       uint8_t endpointAddress,
+                                                       const usb_device_transfer_segment_struct_t *segments,
+                                                       uint32_t segmentCount);
+
 /*! @brief USB device controller cancel transfer function in a specified endpoint typedef */
 typedef usb_status_t (*usb_device_controller_cancel_t)(usb_device_controller_handle controllerHandle,
                                                        uint8_t endpointAddress);
@@ -115,8 +126,39 @@ typedef struct _usb_device_controller_interface_struct
     usb_device_controller_recv_t deviceRecv;       /*!< Controller receive data */
     usb_device_controller_cancel_t deviceCancel;   /*!< Controller cancel transfer */
     usb_device_controller_control_t deviceControl; /*!< Controller control */
+    usb_device_controller_send_v_t deviceSendV;    /*!< Controller send data of several buffers, optional */
 } usb_device_controller_interface_struct_t;
 
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+/*! @brief Endpoint request queue structure */
+typedef struct _usb_device_request_queue_struct
+{
+    usb_device_request_struct_t *activeHead;  /*!< Oldest request owned by the controller */
+    usb_device_request_struct_t *activeTail;  /*!< Newest request owned by the controller */
+    usb_device_request_struct_t *pendingHead; /*!< Oldest request waiting for controller resources */
+    usb_device_request_struct_t *pendingTail; /*!< Newest request waiting for controller resources */
+    uint8_t isSubmitting;                     /*!< Pending requests are being handed to the controller */
+} usb_device_request_queue_struct_t;
+#endif
+
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+/*! @brief Notification lane indexes, written by the controller side and read by the task */
+typedef struct _usb_device_notification_lane_struct
+{
+    volatile uint32_t head; /*!< Next record to write, moved by the producers only */
+    volatile uint32_t tail; /*!< Next record to read, moved by the task only */
+    uint32_t overflow;      /*!< Notifications dropped because the lane was full */
+    uint32_t peak;          /*!< Highest count of records waiting */
+} usb_device_notification_lane_struct_t;
+
+/*! @brief Control lane record */
+typedef struct _usb_device_control_notification_struct
+{
+    usb_device_callback_message_struct_t message; /*!< The notification */
+    uint32_t bulkHead; /*!< Bulk lane head when queued, setup and bus events wait for the completions before it */
+} usb_device_control_notification_struct_t;
+#endif
+
 /*! @brief USB device status structure */
 typedef struct _usb_device_struct
 {
@@ -126,13 +168,26 @@ typedef struct _usb_device_struct
 #endif
     usb_device_controller_handle controllerHandle;                       /*!< Controller handle */
     const usb_device_controller_interface_struct_t *controllerInterface; /*!< Controller interface handle */
-#if USB_DEVICE_CONFIG_USE_TASK
-    MSGQ_HANDLE_BUFFER_DEFINE(notificationQueueBuffer, USB_DEVICE_CONFIG_MAX_MESSAGES, USB_DEVICE_MESSAGES_SIZE); /*!< Message queue buffer*/
-    osa_msgq_handle_t notificationQueue; /*!< Message queue*/
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+    usb_device_control_notification_struct_t
+        controlMessage[USB_DEVICE_CONFIG_CONTROL_MESSAGES]; /*!< Bus and control endpoint notifications */
+    usb_device_callback_message_struct_t
+        bulkMessage[USB_DEVICE_CONFIG_MAX_MESSAGES];        /*!< Completions of the other endpoints */
+    usb_device_notification_lane_struct_t controlLane;      /*!< Control lane indexes */
+    usb_device_notification_lane_struct_t bulkLane;         /*!< Bulk lane indexes */
+    SEMAPHORE_HANDLE_BUFFER_DEFINE(notificationSemaphoreBuffer); /*!< Semaphore buffer */
+    osa_semaphore_handle_t notificationSemaphore;           /*!< Wakes the task when a lane gets non-empty */
+#endif
+#if (defined(USB_DEVICE_DEFERRED_CALLBACK_ENABLE) && (USB_DEVICE_DEFERRED_CALLBACK_ENABLE > 0U))
+    uint32_t epCallbackInIsr; /*!< Endpoints calling back from ISR, bit per endpoint index */
 #endif
     usb_device_callback_t deviceCallback; /*!< Device callback function pointer */
     usb_device_endpoint_callback_struct_t
         epCallback[USB_DEVICE_CONFIG_ENDPOINTS << 1U]; /*!< Endpoint callback function structure */
+#if (defined(USB_DEVICE_CONFIG_REQUEST_QUEUE) && (USB_DEVICE_CONFIG_REQUEST_QUEUE > 0U))
+    usb_device_request_queue_struct_t
+        epQueue[USB_DEVICE_CONFIG_ENDPOINTS << 1U]; /*!< Endpoint request queue structure */
+#endif
     uint8_t deviceAddress;                             /*!< Current device address */
     uint8_t controllerId;                              /*!< Controller ID */
     uint8_t state;                                     /*!< Current device state */
@@ -140,7 +195,7 @@ typedef struct _usb_device_struct
     uint8_t remotewakeup; /*!< Remote wakeup is enabled or not */
 #endif
     uint8_t isResetting; /*!< Is doing device reset or not */
-#if (defined(USB_DEVICE_CONFIG_USE_TASK) && (USB_DEVICE_CONFIG_USE_TASK > 0U))
+#if (defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
     uint8_t epCallbackDirectly; /*!< Whether call ep callback directly when the task is enabled */
 #endif
 } usb_device_struct_t;
@@ -29,6 +29,31 @@
 #define USB_OSA_WAIT_TIMEOUT (0U)
 #endif /* (defined(USE_RTOS) && (USE_RTOS > 0)) */
 
+/*! @brief Lock the data the USB stack shares with the USB interrupt.
+ *
+ * BASEPRI is raised to USB_DEVICE_INTERRUPT_PRIORITY only, so interrupts of higher priority are not delayed by the USB
+ * bookkeeping. The lock nests and can be taken in task and interrupt context. No task level RTOS call may be made
+ * while it is held, leaving the RTOS critical section would clear BASEPRI, the FromISR calls are fine.
+ * Cores without BASEPRI fall back to the OSA critical section. The _SR variants keep the previous state in a caller
+ * provided variable, for a lock taken and released in different functions.
+ */
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3U)
+#define USB_OSA_ENTER_CRITICAL_SR(sr)                                                          \
+    do                                                                                         \
+    {                                                                                          \
+        (sr) = __get_BASEPRI();                                                                \
+        __set_BASEPRI_MAX((uint32_t)USB_DEVICE_INTERRUPT_PRIORITY << (8U - __NVIC_PRIO_BITS)); \
+        __ISB();                                                                               \
+    } while (0)
+#define USB_OSA_EXIT_CRITICAL_SR(sr) __set_BASEPRI(sr)
+#else
+#define USB_OSA_ENTER_CRITICAL_SR(sr) OSA_EnterCritical(&(sr))
+#define USB_OSA_EXIT_CRITICAL_SR(sr) OSA_ExitCritical(sr)
+#endif
+#define USB_OSA_SR_ALLOC() uint32_t usbOsaCurrentSr
+#define USB_OSA_ENTER_CRITICAL() USB_OSA_ENTER_CRITICAL_SR(usbOsaCurrentSr)
+#define USB_OSA_EXIT_CRITICAL() USB_OSA_EXIT_CRITICAL_SR(usbOsaCurrentSr)
+
 /*! @brief Define USB printf */
 #if defined(__cplusplus)
 extern "C" {
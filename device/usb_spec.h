@@ -55,6 +55,7 @@ typedef struct _usb_setup_struct
 #define USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY_WIRELESS (0x01U)
 #define USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY_USB20_EXTENSION (0x02U)
 #define USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY_SUPERSPEED (0x03U)
+#define USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY_PLATFORM (0x05U)
 
 /* USB standard descriptor type */
 #define USB_DESCRIPTOR_TYPE_DEVICE (0x01U)
@@ -9,81 +9,153 @@
 #include "usb_spec.h"
 #include "usb_misc.h"
 
-USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE) uint8_t USB_StringDescriptorBuffer[128];
+/* String descriptor as sent to the host, UTF-16LE without terminator. The extra
+ * code unit holds the terminator of the initializing literal only. */
+typedef struct {
+    uint8_t bLength;
+    uint8_t bDescriptorType;
+    uint16_t bString[MAX_DESCRIPTOR_STRING_LENGTH + 1];
+} usb_string_descriptor_t;
+
+/* Compiler encodes the literal as UTF-16, its size with the terminator is
+ * exactly the descriptor length */
+#define UTF16_DESCRIPTOR(id, value) {sizeof(u"" value), USB_DESCRIPTOR_TYPE_STRING, u"" value}
 
 /* Sadly, there's no way to create statically initialized array
  * of mutable, variable-length arrays in C: array can only hold
  * objects of the same type, but arrays of different lengths are
  * treated as different types. Thus, all strings need to have
  * predefined maximum length, even though some of them are
- * shorter than others. */
+ * shorter than others. UTF-8 never takes fewer bytes than UTF-16
+ * code units, so the same limit fits both encodings. */
 static char usb_strings[][MAX_DESCRIPTOR_STRING_LENGTH + 1] = {
     USB_STRINGS(VALUE)
 };
 
-static char *get_usb_string(usb_device_string_id id)
+/* Descriptors are built once, at compile time or when string is set, and
+ * sent directly from here */
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static usb_string_descriptor_t usb_string_descriptors[] = {
+    USB_STRINGS(UTF16_DESCRIPTOR)
+};
+
+/* English (United States) */
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t usb_languages_descriptor[] = {4, USB_DESCRIPTOR_TYPE_STRING, 0x09, 0x04};
+
+static int is_valid_id(usb_device_string_id id)
 {
-    if ((id <= USB_STRING_EMPTY) || (id > USB_STRING_MAX_ID)) {
-        return NULL;
-    }
-    return usb_strings[id - 1];
+    return (id > USB_STRING_EMPTY) && (id < USB_STRING_MAX_ID);
 }
 
-static uint16_t languages_descriptor(uint8_t *ptr)
+/* Decodes one UTF-8 sequence, malformed one is consumed byte by byte
+ * and decoded as U+FFFD */
+static uint32_t utf8_decode(const char **text)
 {
-    const uint8_t size = 4;
-    *ptr++ = size;
-    *ptr++ = USB_DESCRIPTOR_TYPE_STRING;
-    *ptr++ = 0x09;
-    *ptr++ = 0x04;
-    return size;
+    const uint8_t *p = (const uint8_t *)*text;
+    uint32_t code;
+    size_t count;
+    uint32_t min;
+
+    if (p[0] < 0x80) {
+        *text += 1;
+        return p[0];
+    } else if ((p[0] & 0xE0) == 0xC0) {
+        code = p[0] & 0x1F;
+        count = 1;
+        min = 0x80;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        code = p[0] & 0x0F;
+        count = 2;
+        min = 0x800;
+    } else if ((p[0] & 0xF8) == 0xF0) {
+        code = p[0] & 0x07;
+        count = 3;
+        min = 0x10000;
+    } else {
+        *text += 1;
+        return 0xFFFD;
+    }
+
+    for (size_t i = 1; i <= count; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *text += 1;
+            return 0xFFFD;
+        }
+        code = (code << 6) | (p[i] & 0x3F);
+    }
+    *text += count + 1;
+
+    if ((code < min) || (code > 0x10FFFF) || ((code >= 0xD800) && (code <= 0xDFFF))) {
+        return 0xFFFD;
+    }
+    return code;
 }
 
-static uint16_t string_descriptor(uint8_t *ptr, const char *ascii)
+static void encode_descriptor(usb_string_descriptor_t *desc, const char *utf8)
 {
-    const uint8_t len = strlen(ascii);
-    const uint8_t size = 2 + sizeof(uint16_t) * len;
+    size_t units = 0;
 
-    *ptr++ = size;
-    *ptr++ = USB_DESCRIPTOR_TYPE_STRING;
-
-    uint16_t *utf16 = (uint16_t *)ptr;
-    for (size_t i = 0; i < len; i++) {
-        *utf16++ = (uint16_t) ascii[i];
+    while (*utf8 != '\0') {
+        uint32_t code = utf8_decode(&utf8);
+        if (code >= 0x10000) {
+            if (units + 2 > MAX_DESCRIPTOR_STRING_LENGTH) {
+                break;
+            }
+            code -= 0x10000;
+            desc->bString[units++] = 0xD800 | (code >> 10);
+            desc->bString[units++] = 0xDC00 | (code & 0x3FF);
+        } else {
+            if (units + 1 > MAX_DESCRIPTOR_STRING_LENGTH) {
+                break;
+            }
+            desc->bString[units++] = code;
+        }
     }
 
-    return size;
+    desc->bDescriptorType = USB_DESCRIPTOR_TYPE_STRING;
+    desc->bLength = 2 + sizeof(uint16_t) * units;
 }
 
-uint16_t USB_GetStringDescriptor(void *buffer, usb_device_string_id id)
+uint16_t USB_GetStringDescriptor(usb_device_string_id id, uint8_t **descriptor)
 {
-    uint8_t *ptr = buffer;
     if (id == USB_STRING_EMPTY) {
-        return languages_descriptor(ptr);
+        *descriptor = usb_languages_descriptor;
+        return sizeof(usb_languages_descriptor);
     }
 
-    const char *usb_string = get_usb_string(id);
-    if (usb_string == NULL) {
+    if (!is_valid_id(id)) {
         return 0;
     }
 
-    return string_descriptor(ptr, usb_string);
+    usb_string_descriptor_t *desc = &usb_string_descriptors[id - 1];
+    *descriptor = (uint8_t *)desc;
+    return desc->bLength;
 }
 
 uint16_t USB_SetDescriptorString(const char *descriptor, usb_device_string_id id)
 {
-    char *usb_string = get_usb_string(id);
-    if (usb_string == NULL) {
+    if (!is_valid_id(id)) {
         return 0;
     }
 
-    const uint16_t len = MIN(strlen(descriptor), MAX_DESCRIPTOR_STRING_LENGTH);
+    char *usb_string = usb_strings[id - 1];
+    uint16_t len = MIN(strlen(descriptor), MAX_DESCRIPTOR_STRING_LENGTH);
+    /* Do not cut multibyte character in half */
+    while ((len > 0) && (len < strlen(descriptor)) && (((uint8_t)descriptor[len] & 0xC0) == 0x80)) {
+        len--;
+    }
     memcpy(usb_string, descriptor, len);
     usb_string[len] = '\0';
+
+    encode_descriptor(&usb_string_descriptors[id - 1], usb_string);
     return len;
 }
 
 const char *USB_GetDescriptorStringPtr(usb_device_string_id id)
 {
-    return get_usb_string(id);
+    if (!is_valid_id(id)) {
+        return NULL;
+    }
+    return usb_strings[id - 1];
 }
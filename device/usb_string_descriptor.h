@@ -35,17 +35,19 @@ typedef enum {
 
 /*
  * @brief Returns USB string descriptor for id
- * @param buffer for descriptor's binary data
  * @param id of string descriptor to be read
+ * @param descriptor set to descriptor's binary data, it stays valid
+ *        until the string is set again
  * @return length of descriptor's binary data or 0 for non-existing string
  */
-uint16_t USB_GetStringDescriptor(void *buffer, usb_device_string_id id);
+uint16_t USB_GetStringDescriptor(usb_device_string_id id, uint8_t **descriptor);
 
 /*
- * @brief Sets new value of descriptor string
- * @param data to be set as descriptor string
+ * @brief Sets new value of descriptor string, descriptor is encoded
+ *        right away, so it must not be called while host can read it
+ * @param data to be set as descriptor string, UTF-8 encoded
  * @param id of string to be set
- * @return length of descriptor's binary data or 0 for non-existing string
+ * @return length of stored string in bytes or 0 for non-existing string
  */
 uint16_t USB_SetDescriptorString(const char *descriptor, usb_device_string_id id);
 
@@ -56,6 +58,5 @@ uint16_t USB_SetDescriptorString(const char *descriptor, usb_device_string_id id
  */
 const char *USB_GetDescriptorStringPtr(usb_device_string_id id);
 
-extern uint8_t USB_StringDescriptorBuffer[];
 #endif /*_USB_STRING_DESCRIPTOR_H */
 
@@ -0,0 +1,285 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include "usb.h"
+#include "usb_device.h"
+#include "usb_device_class.h"
+#include "usb_device_dfu.h"
+#include "usb_device_descriptor.h"
+#include "fsl_common.h"
+#include "fsl_os_abstraction.h"
+#include "composite.h"
+#include "dfu.h"
+#include "log.hpp"
+
+#include <errno.h>
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+
+#define UNUSED(x) do { (void)(x); } while (0)
+
+#define DFU_TASK_STACK_SIZE (2U * 1024U)
+
+/* Worker checks for termination in between */
+#define DFU_WAIT_SLICE_MS (100)
+
+/* Host writes DFU_DNLOAD data stage straight into staging buffers */
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_dfuBuffer[2][USB_DATA_ALIGN_SIZE_MULTIPLE(USB_DFU_BUFFER_SIZE)];
+
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_dfuResponse[USB_DATA_ALIGN_SIZE_MULTIPLE(DFU_STATUS_LENGTH)];
+
+static void OpWakeup(void *ctx)
+{
+    usb_dfu_struct_t *dfuApp = (usb_dfu_struct_t *)ctx;
+
+    if (__get_IPSR()) {
+        xSemaphoreGiveFromISR(dfuApp->wakeup, NULL);
+    }
+    else {
+        xSemaphoreGive(dfuApp->wakeup);
+    }
+}
+
+static int OpManifest(void *ctx, uint32_t length, uint32_t crc)
+{
+    usb_dfu_struct_t *dfuApp = (usb_dfu_struct_t *)ctx;
+
+    log_debug("[DFU] Image complete, %u bytes, crc 0x%08x", (unsigned int)length, (unsigned int)crc);
+    if (dfuApp->manifest) {
+        return dfuApp->manifest(dfuApp->manifestArg, length, crc);
+    }
+    return 0;
+}
+
+/* Buffer handover is shared between USB context (ISR or USB task) and worker. Locked sections only update the
+ * buffer states, so the USB lock covers them. */
+static void OpLock(void *ctx)
+{
+    usb_dfu_struct_t *dfuApp = (usb_dfu_struct_t *)ctx;
+    uint32_t sr;
+
+    USB_OSA_ENTER_CRITICAL_SR(sr);
+    dfuApp->lockState = sr;
+}
+
+static void OpUnlock(void *ctx)
+{
+    usb_dfu_struct_t *dfuApp = (usb_dfu_struct_t *)ctx;
+    USB_OSA_EXIT_CRITICAL_SR(dfuApp->lockState);
+}
+
+static const struct dfu_function_ops s_dfuOps = {
+    .wakeup   = OpWakeup,
+    .manifest = OpManifest,
+    .lock     = OpLock,
+    .unlock   = OpUnlock,
+};
+
+static int OnDownload(usb_dfu_struct_t *dfuApp, usb_device_dfu_request_param_struct_t *req)
+{
+    if (req->isSetup) {
+        return dfu_function_dnload_setup(&dfuApp->function, req->setupValue, req->setupLength, req->buffer);
+    }
+    return dfu_function_dnload(&dfuApp->function, (uint16_t)*req->length);
+}
+
+static usb_status_t OnClassRequest(usb_dfu_struct_t *dfuApp, usb_device_dfu_request_param_struct_t *req)
+{
+    struct dfu_function *function = &dfuApp->function;
+    int ret                       = 0;
+
+    if (!dfuApp->available) {
+        return kStatus_USB_InvalidRequest;
+    }
+
+    switch (req->request) {
+    case DFU_REQUEST_DNLOAD:
+        ret = OnDownload(dfuApp, req);
+        break;
+    case DFU_REQUEST_GETSTATUS:
+        dfu_function_get_status(function, s_dfuResponse);
+        *req->buffer = s_dfuResponse;
+        *req->length = DFU_STATUS_LENGTH;
+        break;
+    case DFU_REQUEST_GETSTATE:
+        s_dfuResponse[0] = dfu_function_get_state(function);
+        *req->buffer     = s_dfuResponse;
+        *req->length     = 1;
+        break;
+    case DFU_REQUEST_CLRSTATUS:
+        ret = dfu_function_clear_status(function);
+        break;
+    case DFU_REQUEST_ABORT:
+        ret = dfu_function_abort(function);
+        break;
+    default:
+        /* DETACH is meaningless in DFU mode. Image lives in filesystem, which must not be read from USB
+         * interrupt, so UPLOAD is not announced in bmAttributes either */
+        ret = -EINVAL;
+        break;
+    }
+
+    if (ret < 0) {
+        log_debug("[DFU] Request 0x%x rejected: %d", req->request, ret);
+        return kStatus_USB_InvalidRequest;
+    }
+    return kStatus_USB_Success;
+}
+
+usb_status_t DfuUSBCallback(uint32_t event, void *param, void *userArg)
+{
+    usb_dfu_struct_t *dfuApp = (usb_dfu_struct_t *)userArg;
+
+    if (!dfuApp || !dfuApp->classHandle) {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    switch (event) {
+    case kUSB_DeviceDfuEventClassRequest:
+        return OnClassRequest(dfuApp, (usb_device_dfu_request_param_struct_t *)param);
+    default:
+        log_debug("[DFU] Unknown event from device class driver: %d", (int)event);
+        break;
+    }
+
+    return kStatus_USB_Error;
+}
+
+static void DfuTask(void *handle)
+{
+    usb_dfu_struct_t *dfuApp = (usb_dfu_struct_t *)handle;
+
+    while (!dfuApp->is_terminated) {
+        if (xSemaphoreTake(dfuApp->wakeup, pdMS_TO_TICKS(DFU_WAIT_SLICE_MS)) != pdTRUE) {
+            continue;
+        }
+        /* Host keeps filling the other buffer while this one is programmed */
+        while (!dfuApp->is_terminated && dfu_function_work(&dfuApp->function)) {
+        }
+    }
+
+    xSemaphoreGive(dfuApp->join);
+    log_debug("[DFU] DFU task end");
+    vTaskDelete(NULL);
+}
+
+static int OpenImage(usb_dfu_struct_t *dfuApp, const usb_dfu_config_t *config)
+{
+    struct dfu_function_buffers buffers = {
+        .data          = {s_dfuBuffer[0], s_dfuBuffer[1]},
+        .size          = USB_DFU_BUFFER_SIZE,
+        .transfer_size = USB_DFU_TRANSFER_SIZE,
+        .poll_timeout  = USB_DFU_POLL_TIMEOUT,
+    };
+    int ret;
+
+    if ((config == NULL) || (config->imagePath == NULL)) {
+        return -ENOENT;
+    }
+
+    /* Update image is plain file, it is overwritten in place */
+    ret = dfu_file_flash_open(&dfuApp->flash, config->imagePath, config->imageSize, USB_DFU_ERASE_SIZE, 0);
+    if (ret) {
+        log_error("[DFU] Unable to open update image %s", config->imagePath);
+        return ret;
+    }
+
+    ret = dfu_function_init(
+        &dfuApp->function, &s_dfuOps, dfuApp, dfu_file_flash_device(&dfuApp->flash), &buffers);
+    if (ret) {
+        log_error("[DFU] Buffer configuration rejected");
+        dfu_file_flash_close(&dfuApp->flash);
+        return ret;
+    }
+
+    dfuApp->manifest    = config->manifest;
+    dfuApp->manifestArg = config->manifestArg;
+    return 0;
+}
+
+usb_status_t DfuInit(usb_dfu_struct_t *dfuApp, class_handle_t classHandle, const usb_dfu_config_t *config)
+{
+    dfuApp->is_terminated = false;
+    dfuApp->classHandle   = classHandle;
+    dfuApp->manifest      = NULL;
+    dfuApp->manifestArg   = NULL;
+
+    /* Without image every download is stalled */
+    dfuApp->available = (OpenImage(dfuApp, config) == 0);
+
+    if ((dfuApp->join = xSemaphoreCreateBinary()) == NULL) {
+        goto error;
+    }
+
+    if ((dfuApp->wakeup = xSemaphoreCreateBinary()) == NULL) {
+        goto error_wakeup;
+    }
+
+    if (xTaskCreate(DfuTask,                                      /* pointer to the task */
+                    "DFU task",                                   /* task name for kernel awareness debugging */
+                    DFU_TASK_STACK_SIZE / sizeof(portSTACK_TYPE), /* task stack size */
+                    dfuApp,                                       /* optional task startup argument */
+                    tskIDLE_PRIORITY,                             /* initial priority */
+                    &dfuApp->dfu_task_handle                      /* optional task handle to create */
+                    ) != pdPASS) {
+        log_debug("[DFU] Create task failed");
+        goto error_task;
+    }
+    return kStatus_USB_Success;
+
+error_task:
+    vSemaphoreDelete(dfuApp->wakeup);
+error_wakeup:
+    vSemaphoreDelete(dfuApp->join);
+error:
+    if (dfuApp->available) {
+        dfu_file_flash_close(&dfuApp->flash);
+        dfuApp->available = false;
+    }
+    dfuApp->wakeup = NULL;
+    dfuApp->join   = NULL;
+    return kStatus_USB_AllocFail;
+}
+
+void DfuDeinit(usb_dfu_struct_t *dfuApp)
+{
+    dfuApp->is_terminated = true;
+    xSemaphoreGive(dfuApp->wakeup);
+
+    /* Worker finishes buffer being programmed first */
+    if (!xSemaphoreTake(dfuApp->join, pdMS_TO_TICKS(3 * DFU_WAIT_SLICE_MS))) {
+        log_debug("[DFU] Unable to join DFU thread");
+    }
+
+    if (dfuApp->available) {
+        dfuApp->available = false;
+        dfu_file_flash_close(&dfuApp->flash);
+    }
+    vSemaphoreDelete(dfuApp->wakeup);
+    vSemaphoreDelete(dfuApp->join);
+    dfuApp->wakeup = NULL;
+    dfuApp->join   = NULL;
+
+    log_debug("[DFU] Deinitialized");
+}
+
+void DfuReset(usb_dfu_struct_t *dfuApp)
+{
+    if (dfuApp->available) {
+        dfu_function_reset(&dfuApp->function);
+    }
+}
+
+void DfuDetached(usb_dfu_struct_t *dfuApp)
+{
+    log_debug("[DFU] Detached");
+    if (dfuApp->available) {
+        dfu_function_reset(&dfuApp->function);
+    }
+}
+
+#endif /* USB_DEVICE_CONFIG_DFU */
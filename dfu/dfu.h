@@ -0,0 +1,62 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _DFU_H_
+#define _DFU_H_
+
+#include "usb_device_dfu.h"
+#include "dfu_function.h"
+#include "dfu_file_flash.h"
+
+/*! @brief Size of each of two staging buffers, multiple of USB_DFU_TRANSFER_SIZE and of USB_DFU_ERASE_SIZE. */
+#ifndef USB_DFU_BUFFER_SIZE
+#define USB_DFU_BUFFER_SIZE (16384U)
+#endif
+
+/*! @brief Sector size of update area, unit of erase. Power of two. */
+#ifndef USB_DFU_ERASE_SIZE
+#define USB_DFU_ERASE_SIZE (4096U)
+#endif
+
+/*! @brief Milliseconds host waits before next DFU_GETSTATUS while both staging buffers are programmed. */
+#ifndef USB_DFU_POLL_TIMEOUT
+#define USB_DFU_POLL_TIMEOUT (10U)
+#endif
+
+/* @brief Function called by worker once complete image was written and read back.
+ * @return 0 to accept image, negative errno to report it to host as corrupt */
+typedef int (*dfuManifestHook)(void *userArg, uint32_t length, uint32_t crc);
+
+/* Firmware upgrade function configuration */
+typedef struct _usb_dfu_config
+{
+    const char *imagePath;    /* Update image written by host, NULL rejects every download */
+    uint32_t imageSize;       /* Largest image accepted */
+    dfuManifestHook manifest; /* Optional, validates and activates downloaded image */
+    void *manifestArg;
+} usb_dfu_config_t;
+
+typedef struct {
+    class_handle_t classHandle;
+    struct dfu_function function;
+    struct dfu_file_flash flash; /* Image file */
+    dfuManifestHook manifest;
+    void *manifestArg;
+    uint32_t lockState;
+
+    uint8_t available;           /* Image file opened, downloads are accepted */
+    uint8_t is_terminated;
+    SemaphoreHandle_t wakeup;
+    SemaphoreHandle_t join;
+    TaskHandle_t dfu_task_handle; /* USB DFU worker task handle */
+} usb_dfu_struct_t;
+
+usb_status_t DfuUSBCallback(uint32_t event, void *param, void *userArg);
+usb_status_t DfuInit(usb_dfu_struct_t *dfuApp, class_handle_t classHandle, const usb_dfu_config_t *config);
+void DfuReset(usb_dfu_struct_t *dfuApp);
+void DfuDeinit(usb_dfu_struct_t *dfuApp);
+void DfuDetached(usb_dfu_struct_t *dfuApp);
+
+#endif /* _DFU_H_ */
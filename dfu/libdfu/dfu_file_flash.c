@@ -0,0 +1,160 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include <errno.h>
+#include <string.h>
+#include "dfu_file_flash.h"
+
+#define CHUNK_SIZE (256)
+
+/* Reads what file holds, filling area past its end as erased */
+static int file_read(void *ctx, uint32_t offset, uint8_t *data, uint32_t length)
+{
+    struct dfu_file_flash *ff = ctx;
+    size_t got;
+
+    if ((offset > ff->flash.size) || (length > ff->flash.size - offset))
+        return -EINVAL;
+    if (fseek(ff->file, offset, SEEK_SET) != 0)
+        return -EIO;
+
+    got = fread(data, 1, length, ff->file);
+    if ((got < length) && ferror(ff->file))
+        return -EIO;
+    memset(data + got, DFU_FILE_FLASH_ERASED, length - got);
+    return 0;
+}
+
+static int file_write(struct dfu_file_flash *ff, uint32_t offset, const uint8_t *data, uint32_t length)
+{
+    if (fseek(ff->file, offset, SEEK_SET) != 0)
+        return -EIO;
+    if (fwrite(data, 1, length, ff->file) != length)
+        return -EIO;
+    return 0;
+}
+
+static int file_erase(void *ctx, uint32_t offset, uint32_t length)
+{
+    struct dfu_file_flash *ff = ctx;
+    uint8_t erased[CHUNK_SIZE];
+    uint32_t chunk;
+    int ret;
+
+    if ((offset | length) & (ff->flash.erase_size - 1))
+        return -EINVAL;
+    if ((offset > ff->flash.size) || (length > ff->flash.size - offset))
+        return -EINVAL;
+
+    ff->stats.erased_sectors += length / ff->flash.erase_size;
+    if (!(ff->flags & DFU_FILE_FLASH_NOR))
+        return 0;
+
+    memset(erased, DFU_FILE_FLASH_ERASED, sizeof(erased));
+    while (length) {
+        chunk = (length < sizeof(erased)) ? length : sizeof(erased);
+        ret = file_write(ff, offset, erased, chunk);
+        if (ret)
+            return ret;
+        offset += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+/* NOR cells only go from 1 to 0, catch programming without erase */
+static int check_erased(struct dfu_file_flash *ff, uint32_t offset, uint32_t length)
+{
+    uint8_t current[CHUNK_SIZE];
+    uint32_t chunk, i;
+    int ret;
+
+    while (length) {
+        chunk = (length < sizeof(current)) ? length : sizeof(current);
+        ret = file_read(ff, offset, current, chunk);
+        if (ret)
+            return ret;
+        for (i = 0; i < chunk; i++)
+            if (current[i] != DFU_FILE_FLASH_ERASED)
+                return -EIO;
+        offset += chunk;
+        length -= chunk;
+    }
+    return 0;
+}
+
+static int file_program(void *ctx, uint32_t offset, const uint8_t *data, uint32_t length)
+{
+    struct dfu_file_flash *ff = ctx;
+    int ret;
+
+    if ((offset > ff->flash.size) || (length > ff->flash.size - offset))
+        return -EINVAL;
+
+    if (ff->flags & DFU_FILE_FLASH_NOR) {
+        ret = check_erased(ff, offset, length);
+        if (ret)
+            return ret;
+    }
+
+    ret = file_write(ff, offset, data, length);
+    if (ret)
+        return ret;
+    ff->stats.programmed_bytes += length;
+    return 0;
+}
+
+static int file_flush(void *ctx)
+{
+    struct dfu_file_flash *ff = ctx;
+
+    return fflush(ff->file) ? -EIO : 0;
+}
+
+static const struct dfu_flash_ops file_ops = {
+    .erase = file_erase,
+    .program = file_program,
+    .read = file_read,
+    .flush = file_flush,
+};
+
+int dfu_file_flash_init(struct dfu_file_flash *ff, FILE *file, uint32_t size, uint32_t erase_size, int flags)
+{
+    if (!file || !erase_size || (erase_size & (erase_size - 1)) || (size < erase_size))
+        return -EINVAL;
+
+    memset(ff, 0, sizeof(*ff));
+    ff->flash.ops = &file_ops;
+    ff->flash.ctx = ff;
+    ff->flash.size = size & ~(erase_size - 1);
+    ff->flash.erase_size = erase_size;
+    ff->file = file;
+    ff->flags = flags;
+    return 0;
+}
+
+int dfu_file_flash_open(struct dfu_file_flash *ff, const char *path, uint32_t size, uint32_t erase_size, int flags)
+{
+    FILE *file;
+    int ret;
+
+    file = fopen(path, "r+b");
+    if (!file)
+        file = fopen(path, "w+b");
+    if (!file)
+        return -ENOENT;
+
+    ret = dfu_file_flash_init(ff, file, size, erase_size, flags);
+    if (ret)
+        fclose(file);
+    return ret;
+}
+
+void dfu_file_flash_close(struct dfu_file_flash *ff)
+{
+    if (ff->file)
+        fclose(ff->file);
+    ff->file = NULL;
+}
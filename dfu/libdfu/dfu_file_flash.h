@@ -0,0 +1,56 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _DFU_FILE_FLASH_H
+#define _DFU_FILE_FLASH_H
+
+#include <stdio.h>
+#include "dfu_flash.h"
+
+/* Emulate NOR semantics: erase fills sectors with 0xFF and programming
+ * requires erased area. Without it erase is a no-op and file is written
+ * in place, as on a file system. */
+#define DFU_FILE_FLASH_NOR (1 << 0)
+
+#define DFU_FILE_FLASH_ERASED (0xFF)
+
+struct dfu_file_flash_stats
+{
+    uint32_t erased_sectors;
+    uint32_t programmed_bytes;
+};
+
+/* Update area kept in a file, bytes past end of file read as erased */
+struct dfu_file_flash
+{
+    struct dfu_flash flash;
+    FILE *file;
+    int flags;
+    struct dfu_file_flash_stats stats;
+};
+
+/*
+ * @brief Wraps already opened file, which stays owned by caller
+ * @return 0 on success, -EINVAL if erase size is not a power of two
+ */
+int dfu_file_flash_init(struct dfu_file_flash *ff, FILE *file, uint32_t size, uint32_t erase_size, int flags);
+
+/*
+ * @brief Opens or creates file at path
+ * @return 0 on success, -ENOENT when file cannot be opened
+ */
+int dfu_file_flash_open(struct dfu_file_flash *ff, const char *path, uint32_t size, uint32_t erase_size, int flags);
+
+/*
+ * @brief Closes file opened by dfu_file_flash_open
+ */
+void dfu_file_flash_close(struct dfu_file_flash *ff);
+
+static inline const struct dfu_flash *dfu_file_flash_device(const struct dfu_file_flash *ff)
+{
+    return &ff->flash;
+}
+
+#endif /* _DFU_FILE_FLASH_H */
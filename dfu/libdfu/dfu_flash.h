@@ -0,0 +1,33 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _DFU_FLASH_H
+#define _DFU_FLASH_H
+
+#include <stdint.h>
+
+/* Firmware storage. Offsets are relative to start of the update area.
+ * Functions return 0 or negative errno and are called from worker context
+ * only, except read which also serves DFU_UPLOAD. */
+struct dfu_flash_ops
+{
+    /* Erase whole sectors, offset and length are multiples of erase_size */
+    int (*erase)(void *ctx, uint32_t offset, uint32_t length);
+    /* Program erased area */
+    int (*program)(void *ctx, uint32_t offset, const uint8_t *data, uint32_t length);
+    int (*read)(void *ctx, uint32_t offset, uint8_t *data, uint32_t length);
+    /* Optional, commit programmed data before image is manifested */
+    int (*flush)(void *ctx);
+};
+
+struct dfu_flash
+{
+    const struct dfu_flash_ops *ops;
+    void *ctx;
+    uint32_t size;          /* Largest image accepted */
+    uint32_t erase_size;    /* Sector size, power of two */
+};
+
+#endif /* _DFU_FLASH_H */
@@ -0,0 +1,440 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include <errno.h>
+#include <string.h>
+#include "dfu_function.h"
+
+#define BUFFER_FREE (0)
+#define BUFFER_FILLING (1)
+#define BUFFER_READY (2)    /* Waits for worker */
+#define BUFFER_BUSY (3)     /* Being programmed */
+
+#define CRC32_INIT (0xFFFFFFFFU)
+#define VERIFY_CHUNK (64)
+
+/* CRC-32 (IEEE 802.3), half byte at a time to keep the table small */
+static const uint32_t crc32_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+    while (length--) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+        crc = (crc >> 4) ^ crc32_table[crc & 0x0F];
+    }
+    return crc;
+}
+
+static void lock(struct dfu_function *dfu)
+{
+    if (dfu->ops->lock)
+        dfu->ops->lock(dfu->ctx);
+}
+
+static void unlock(struct dfu_function *dfu)
+{
+    if (dfu->ops->unlock)
+        dfu->ops->unlock(dfu->ctx);
+}
+
+static void wakeup(struct dfu_function *dfu)
+{
+    if (dfu->ops->wakeup)
+        dfu->ops->wakeup(dfu->ctx);
+}
+
+static void fail(struct dfu_function *dfu, uint8_t status)
+{
+    dfu->state = DFU_STATE_ERROR;
+    dfu->status = status;
+    dfu->stats.errors++;
+}
+
+/* Request not allowed in current state, DFU 1.1, A.1 */
+static int stall(struct dfu_function *dfu)
+{
+    fail(dfu, DFU_STATUS_ERR_STALLEDPKT);
+    return -EPROTO;
+}
+
+/* Buffer being programmed is released by worker, its result is ignored
+ * because session changes */
+static void drop_download(struct dfu_function *dfu)
+{
+    int i;
+
+    lock(dfu);
+    for (i = 0; i < 2; i++)
+        if (dfu->buffer[i].state != BUFFER_BUSY)
+            dfu->buffer[i].state = BUFFER_FREE;
+    dfu->fill = NULL;
+    dfu->session++;
+    dfu->work_status = DFU_STATUS_OK;
+    dfu->manifest_request = 0;
+    dfu->manifest_done = 0;
+    unlock(dfu);
+}
+
+static int worker_idle(struct dfu_function *dfu)
+{
+    return (dfu->buffer[0].state == BUFFER_FREE) && (dfu->buffer[1].state == BUFFER_FREE) &&
+        (!dfu->manifest_request || dfu->manifest_done);
+}
+
+static struct dfu_buffer *free_buffer(struct dfu_function *dfu)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+        if (dfu->buffer[i].state == BUFFER_FREE)
+            return &dfu->buffer[i];
+    return NULL;
+}
+
+static void start_download(struct dfu_function *dfu, uint16_t block)
+{
+    drop_download(dfu);
+    lock(dfu);
+    dfu->programmed_offset = 0;
+    dfu->crc = CRC32_INIT;
+    unlock(dfu);
+    dfu->block = block;
+    dfu->offset = 0;
+    dfu->last_block = 0;
+}
+
+/* Hand filled buffer over to worker */
+static void submit(struct dfu_function *dfu)
+{
+    lock(dfu);
+    dfu->fill->state = dfu->fill->length ? BUFFER_READY : BUFFER_FREE;
+    unlock(dfu);
+    dfu->fill = NULL;
+    wakeup(dfu);
+}
+
+int dfu_function_init(struct dfu_function *dfu, const struct dfu_function_ops *ops, void *ctx,
+        const struct dfu_flash *flash, const struct dfu_function_buffers *buffers)
+{
+    int i;
+
+    if (!ops || !flash || !flash->ops || !buffers || !buffers->data[0] || !buffers->data[1])
+        return -EINVAL;
+    if (!flash->erase_size || !buffers->transfer_size || (buffers->size < flash->erase_size))
+        return -EINVAL;
+    if ((buffers->size % flash->erase_size) || (buffers->size % buffers->transfer_size))
+        return -EINVAL;
+
+    memset(dfu, 0, sizeof(*dfu));
+    dfu->ops = ops;
+    dfu->ctx = ctx;
+    dfu->flash = flash;
+    for (i = 0; i < 2; i++)
+        dfu->buffer[i].data = buffers->data[i];
+    dfu->buffer_size = buffers->size;
+    dfu->transfer_size = buffers->transfer_size;
+    dfu->poll_timeout = buffers->poll_timeout;
+    dfu->state = DFU_STATE_IDLE;
+    dfu->status = DFU_STATUS_OK;
+    dfu->crc = CRC32_INIT;
+    return 0;
+}
+
+int dfu_function_dnload_setup(struct dfu_function *dfu, uint16_t block, uint16_t length, uint8_t **buffer)
+{
+    *buffer = NULL;
+
+    switch (dfu->state) {
+    case DFU_STATE_IDLE:
+        if (!length)
+            return stall(dfu);
+        start_download(dfu, block);
+        break;
+    case DFU_STATE_DNLOAD_IDLE:
+        if (!length) {
+            /* End of image, flush partially filled buffer */
+            if (dfu->fill)
+                submit(dfu);
+            lock(dfu);
+            dfu->manifest_request = 1;
+            unlock(dfu);
+            wakeup(dfu);
+            dfu->state = DFU_STATE_MANIFEST_SYNC;
+            return 0;
+        }
+        break;
+    default:
+        return stall(dfu);
+    }
+
+    if ((block != dfu->block) || (length > dfu->transfer_size) || dfu->last_block)
+        return stall(dfu);
+    if (length > dfu->flash->size - dfu->offset) {
+        fail(dfu, DFU_STATUS_ERR_ADDRESS);
+        return -EINVAL;
+    }
+
+    if (!dfu->fill) {
+        lock(dfu);
+        dfu->fill = free_buffer(dfu);
+        if (dfu->fill) {
+            dfu->fill->state = BUFFER_FILLING;
+            dfu->fill->offset = dfu->offset;
+            dfu->fill->length = 0;
+        }
+        unlock(dfu);
+        /* Host did not wait for dfuDNLOAD-IDLE */
+        if (!dfu->fill)
+            return stall(dfu);
+    }
+
+    *buffer = dfu->fill->data + dfu->fill->length;
+    return 0;
+}
+
+int dfu_function_dnload(struct dfu_function *dfu, uint16_t length)
+{
+    if (!dfu->fill || ((dfu->state != DFU_STATE_IDLE) && (dfu->state != DFU_STATE_DNLOAD_IDLE)))
+        return stall(dfu);
+    if (length > dfu->buffer_size - dfu->fill->length)
+        return stall(dfu);
+
+    dfu->fill->length += length;
+    dfu->offset += length;
+    dfu->block++;
+    dfu->stats.blocks++;
+
+    if (length < dfu->transfer_size)
+        dfu->last_block = 1;
+    if ((dfu->fill->length == dfu->buffer_size) || dfu->last_block)
+        submit(dfu);
+
+    dfu->state = DFU_STATE_DNLOAD_SYNC;
+    return 0;
+}
+
+int dfu_function_upload(struct dfu_function *dfu, uint16_t block, uint8_t *buffer, uint16_t length)
+{
+    uint32_t limit;
+    uint16_t count;
+
+    switch (dfu->state) {
+    case DFU_STATE_IDLE:
+        /* Flash may be still written by worker after abort */
+        if (!worker_idle(dfu)) {
+            fail(dfu, DFU_STATUS_ERR_NOTDONE);
+            return -EBUSY;
+        }
+        dfu->block = block;
+        dfu->offset = 0;
+        break;
+    case DFU_STATE_UPLOAD_IDLE:
+        break;
+    default:
+        return stall(dfu);
+    }
+
+    if (block != dfu->block)
+        return stall(dfu);
+
+    limit = dfu->image_length ? dfu->image_length : dfu->flash->size;
+    count = (length < limit - dfu->offset) ? length : (uint16_t)(limit - dfu->offset);
+    if (count && dfu->flash->ops->read(dfu->flash->ctx, dfu->offset, buffer, count)) {
+        fail(dfu, DFU_STATUS_ERR_UNKNOWN);
+        return -EIO;
+    }
+
+    dfu->offset += count;
+    dfu->block++;
+    /* Short frame ends upload */
+    dfu->state = (count < length) ? DFU_STATE_IDLE : DFU_STATE_UPLOAD_IDLE;
+    return count;
+}
+
+void dfu_function_get_status(struct dfu_function *dfu, uint8_t *status)
+{
+    uint32_t poll = 0;
+    uint8_t state;
+
+    lock(dfu);
+    if ((dfu->work_status != DFU_STATUS_OK) &&
+        ((dfu->state == DFU_STATE_DNLOAD_SYNC) || (dfu->state == DFU_STATE_DNLOAD_IDLE) ||
+         (dfu->state == DFU_STATE_MANIFEST_SYNC)))
+        fail(dfu, dfu->work_status);
+
+    switch (dfu->state) {
+    case DFU_STATE_DNLOAD_SYNC:
+        /* Next block is accepted as soon as there is room for it, so host
+         * streams while worker programs */
+        if (dfu->fill || free_buffer(dfu)) {
+            dfu->state = DFU_STATE_DNLOAD_IDLE;
+            state = DFU_STATE_DNLOAD_IDLE;
+        } else {
+            state = DFU_STATE_DNBUSY;
+            poll = dfu->poll_timeout;
+            dfu->stats.busy_polls++;
+        }
+        break;
+    case DFU_STATE_MANIFEST_SYNC:
+        if (dfu->manifest_done) {
+            /* Manifestation tolerant, stay in DFU mode */
+            dfu->state = DFU_STATE_IDLE;
+            state = DFU_STATE_IDLE;
+        } else {
+            state = DFU_STATE_MANIFEST;
+            poll = dfu->poll_timeout;
+        }
+        break;
+    default:
+        state = dfu->state;
+        break;
+    }
+    unlock(dfu);
+
+    status[0] = dfu->status;
+    status[1] = poll & 0xFF;
+    status[2] = (poll >> 8) & 0xFF;
+    status[3] = (poll >> 16) & 0xFF;
+    status[4] = state;
+    status[5] = 0;
+}
+
+uint8_t dfu_function_get_state(const struct dfu_function *dfu)
+{
+    return dfu->state;
+}
+
+int dfu_function_clear_status(struct dfu_function *dfu)
+{
+    if (dfu->state != DFU_STATE_ERROR)
+        return stall(dfu);
+
+    drop_download(dfu);
+    dfu->state = DFU_STATE_IDLE;
+    dfu->status = DFU_STATUS_OK;
+    return 0;
+}
+
+int dfu_function_abort(struct dfu_function *dfu)
+{
+    switch (dfu->state) {
+    case DFU_STATE_IDLE:
+    case DFU_STATE_DNLOAD_SYNC:
+    case DFU_STATE_DNLOAD_IDLE:
+    case DFU_STATE_MANIFEST_SYNC:
+    case DFU_STATE_UPLOAD_IDLE:
+        drop_download(dfu);
+        dfu->state = DFU_STATE_IDLE;
+        return 0;
+    default:
+        return stall(dfu);
+    }
+}
+
+void dfu_function_reset(struct dfu_function *dfu)
+{
+    drop_download(dfu);
+    dfu->state = DFU_STATE_IDLE;
+    dfu->status = DFU_STATUS_OK;
+}
+
+/* Erase, program and read back one buffer, returns DFU status */
+static uint8_t program(struct dfu_function *dfu, struct dfu_buffer *buf)
+{
+    const struct dfu_flash *flash = dfu->flash;
+    uint32_t erase_length = (buf->length + flash->erase_size - 1) & ~(flash->erase_size - 1);
+    uint8_t verify[VERIFY_CHUNK];
+    uint32_t done, chunk;
+
+    if (erase_length > flash->size - buf->offset)
+        erase_length = flash->size - buf->offset;
+    if (flash->ops->erase(flash->ctx, buf->offset, erase_length))
+        return DFU_STATUS_ERR_ERASE;
+    if (flash->ops->program(flash->ctx, buf->offset, buf->data, buf->length))
+        return DFU_STATUS_ERR_PROG;
+
+    for (done = 0; done < buf->length; done += chunk) {
+        chunk = (buf->length - done < sizeof(verify)) ? buf->length - done : sizeof(verify);
+        if (flash->ops->read(flash->ctx, buf->offset + done, verify, chunk) ||
+                memcmp(verify, buf->data + done, chunk))
+            return DFU_STATUS_ERR_VERIFY;
+    }
+    return DFU_STATUS_OK;
+}
+
+static uint8_t manifest(struct dfu_function *dfu, uint32_t length, uint32_t crc)
+{
+    const struct dfu_flash *flash = dfu->flash;
+
+    if (flash->ops->flush && flash->ops->flush(flash->ctx))
+        return DFU_STATUS_ERR_WRITE;
+    if (dfu->ops->manifest && dfu->ops->manifest(dfu->ctx, length, crc))
+        return DFU_STATUS_ERR_FIRMWARE;
+    return DFU_STATUS_OK;
+}
+
+int dfu_function_work(struct dfu_function *dfu)
+{
+    struct dfu_buffer *buf = NULL;
+    uint32_t session, length = 0, crc = 0;
+    int do_manifest = 0;
+    uint8_t status;
+    int i;
+
+    lock(dfu);
+    session = dfu->session;
+    /* Program in download order, CRC covers the image sequentially */
+    for (i = 0; i < 2; i++)
+        if ((dfu->buffer[i].state == BUFFER_READY) && (!buf || (dfu->buffer[i].offset < buf->offset)))
+            buf = &dfu->buffer[i];
+    if (buf) {
+        buf->state = BUFFER_BUSY;
+    } else if (dfu->manifest_request && !dfu->manifest_done && (dfu->work_status == DFU_STATUS_OK)) {
+        do_manifest = 1;
+        length = dfu->programmed_offset;
+        crc = dfu->crc ^ CRC32_INIT;
+    }
+    unlock(dfu);
+
+    if (buf) {
+        status = program(dfu, buf);
+        /* Outside of lock, result is dropped if download was restarted meanwhile */
+        if (status == DFU_STATUS_OK)
+            crc = crc32_update(dfu->crc, buf->data, buf->length);
+        lock(dfu);
+        if (session == dfu->session) {
+            if (status == DFU_STATUS_OK) {
+                dfu->crc = crc;
+                dfu->programmed_offset = buf->offset + buf->length;
+                dfu->stats.programmed += buf->length;
+            } else {
+                dfu->work_status = status;
+            }
+        }
+        buf->state = BUFFER_FREE;
+        unlock(dfu);
+        return 1;
+    }
+
+    if (do_manifest) {
+        status = manifest(dfu, length, crc);
+        lock(dfu);
+        if (session == dfu->session) {
+            if (status == DFU_STATUS_OK) {
+                dfu->image_length = length;
+                dfu->manifest_done = 1;
+            } else {
+                dfu->work_status = status;
+            }
+        }
+        unlock(dfu);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _DFU_FUNCTION_H
+#define _DFU_FUNCTION_H
+
+#include <stdint.h>
+#include "dfu_flash.h"
+
+/* DFU 1.1, 3: class specific requests */
+#define DFU_REQUEST_DETACH (0x00)
+#define DFU_REQUEST_DNLOAD (0x01)
+#define DFU_REQUEST_UPLOAD (0x02)
+#define DFU_REQUEST_GETSTATUS (0x03)
+#define DFU_REQUEST_CLRSTATUS (0x04)
+#define DFU_REQUEST_GETSTATE (0x05)
+#define DFU_REQUEST_ABORT (0x06)
+
+/* DFU 1.1, 6.1.2: device states */
+#define DFU_STATE_APP_IDLE (0)
+#define DFU_STATE_APP_DETACH (1)
+#define DFU_STATE_IDLE (2)
+#define DFU_STATE_DNLOAD_SYNC (3)
+#define DFU_STATE_DNBUSY (4)
+#define DFU_STATE_DNLOAD_IDLE (5)
+#define DFU_STATE_MANIFEST_SYNC (6)
+#define DFU_STATE_MANIFEST (7)
+#define DFU_STATE_MANIFEST_WAIT_RESET (8)
+#define DFU_STATE_UPLOAD_IDLE (9)
+#define DFU_STATE_ERROR (10)
+
+/* DFU 1.1, 6.1.2: status codes */
+#define DFU_STATUS_OK (0x00)
+#define DFU_STATUS_ERR_TARGET (0x01)
+#define DFU_STATUS_ERR_FILE (0x02)
+#define DFU_STATUS_ERR_WRITE (0x03)
+#define DFU_STATUS_ERR_ERASE (0x04)
+#define DFU_STATUS_ERR_CHECK_ERASED (0x05)
+#define DFU_STATUS_ERR_PROG (0x06)
+#define DFU_STATUS_ERR_VERIFY (0x07)
+#define DFU_STATUS_ERR_ADDRESS (0x08)
+#define DFU_STATUS_ERR_NOTDONE (0x09)
+#define DFU_STATUS_ERR_FIRMWARE (0x0A)
+#define DFU_STATUS_ERR_VENDOR (0x0B)
+#define DFU_STATUS_ERR_USBR (0x0C)
+#define DFU_STATUS_ERR_POR (0x0D)
+#define DFU_STATUS_ERR_UNKNOWN (0x0E)
+#define DFU_STATUS_ERR_STALLEDPKT (0x0F)
+
+/* DFU 1.1, 4.1.3: functional descriptor */
+#define DFU_FUNCTIONAL_DESCRIPTOR_TYPE (0x21)
+#define DFU_FUNCTIONAL_DESCRIPTOR_LENGTH (9)
+#define DFU_ATTR_CAN_DNLOAD (1 << 0)
+#define DFU_ATTR_CAN_UPLOAD (1 << 1)
+#define DFU_ATTR_MANIFESTATION_TOLERANT (1 << 2)
+#define DFU_ATTR_WILL_DETACH (1 << 3)
+#define DFU_VERSION (0x0110)
+
+#define DFU_STATUS_LENGTH (6)
+
+/* Called from USB context */
+struct dfu_function_ops
+{
+    /* Wake worker, buffer is ready to be programmed or image to be manifested */
+    void (*wakeup)(void *ctx);
+    /* Optional, validate and activate complete image, called by worker */
+    int (*manifest)(void *ctx, uint32_t length, uint32_t crc);
+    /* Optional, serialize buffer handover between USB context and worker */
+    void (*lock)(void *ctx);
+    void (*unlock)(void *ctx);
+};
+
+/* Download goes directly to one of two buffers, which is programmed while
+ * the other one is being filled by host */
+struct dfu_function_buffers
+{
+    uint8_t *data[2];       /* Reachable by USB controller */
+    uint32_t size;          /* Multiple of erase size and of transfer size */
+    uint16_t transfer_size; /* Announced to host as wTransferSize */
+    uint16_t poll_timeout;  /* Milliseconds host waits when both buffers are in use */
+};
+
+struct dfu_buffer
+{
+    uint8_t *data;
+    uint32_t offset;
+    uint32_t length;
+    volatile uint8_t state;
+};
+
+struct dfu_function_stats
+{
+    uint32_t blocks;
+    uint32_t busy_polls;    /* Host had to wait for programming */
+    uint32_t programmed;    /* Bytes written to flash */
+    uint32_t errors;
+};
+
+struct dfu_function
+{
+    const struct dfu_function_ops *ops;
+    void *ctx;
+    const struct dfu_flash *flash;
+
+    struct dfu_buffer buffer[2];
+    uint32_t buffer_size;
+    uint16_t transfer_size;
+    uint16_t poll_timeout;
+
+    uint8_t state;
+    uint8_t status;
+    uint16_t block;             /* Expected wBlockNum */
+    uint32_t offset;            /* Download or upload position */
+    int last_block;             /* Short block received, image is complete */
+    struct dfu_buffer *fill;    /* Buffer receiving download, NULL if none */
+
+    /* Worker side, written under lock */
+    uint32_t session;           /* Incremented on every abort */
+    volatile uint8_t work_status;
+    volatile int manifest_request;
+    volatile int manifest_done;
+    uint32_t programmed_offset; /* End of data programmed in order */
+    uint32_t crc;
+    uint32_t image_length;      /* Length of last manifested image, limits upload */
+
+    struct dfu_function_stats stats;
+};
+
+/*
+ * @brief Sets up DFU function in dfuIDLE state
+ * @return 0 on success, -EINVAL for incompatible buffer, transfer and erase sizes
+ */
+int dfu_function_init(struct dfu_function *dfu, const struct dfu_function_ops *ops, void *ctx,
+        const struct dfu_flash *flash, const struct dfu_function_buffers *buffers);
+
+/*
+ * @brief Handles setup stage of DFU_DNLOAD
+ * @param buffer set to location where data stage should be received
+ * @return 0 to accept request, negative errno to stall it
+ */
+int dfu_function_dnload_setup(struct dfu_function *dfu, uint16_t block, uint16_t length, uint8_t **buffer);
+
+/*
+ * @brief Handles data stage of DFU_DNLOAD, data was received into the buffer
+ *        returned by dfu_function_dnload_setup
+ */
+int dfu_function_dnload(struct dfu_function *dfu, uint16_t length);
+
+/*
+ * @brief Handles DFU_UPLOAD
+ * @return number of bytes placed in buffer, negative errno to stall request
+ */
+int dfu_function_upload(struct dfu_function *dfu, uint16_t block, uint8_t *buffer, uint16_t length);
+
+/*
+ * @brief Handles DFU_GETSTATUS, advances synchronization states
+ * @param status DFU_STATUS_LENGTH bytes of response
+ */
+void dfu_function_get_status(struct dfu_function *dfu, uint8_t *status);
+
+/*
+ * @brief Handles DFU_GETSTATE
+ */
+uint8_t dfu_function_get_state(const struct dfu_function *dfu);
+
+/*
+ * @brief Handles DFU_CLRSTATUS
+ * @return 0 or negative errno when not in dfuERROR state
+ */
+int dfu_function_clear_status(struct dfu_function *dfu);
+
+/*
+ * @brief Handles DFU_ABORT, drops data not programmed yet
+ * @return 0 or negative errno when abort is not allowed in current state
+ */
+int dfu_function_abort(struct dfu_function *dfu);
+
+/*
+ * @brief Returns to dfuIDLE on USB reset or detach, unfinished download is dropped
+ */
+void dfu_function_reset(struct dfu_function *dfu);
+
+/*
+ * @brief Programs one ready buffer or manifests complete image, called by worker
+ * @return 1 if work was done, 0 if there was nothing to do
+ */
+int dfu_function_work(struct dfu_function *dfu);
+
+#endif /* _DFU_FUNCTION_H */
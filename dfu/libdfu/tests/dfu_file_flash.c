@@ -0,0 +1,95 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <string.h>
+#include <errno.h>
+#include "dfu_file_flash.h"
+
+#define FLASH_SIZE (1024)
+#define ERASE_SIZE (256)
+
+static FILE *file;
+static struct dfu_file_flash ff;
+static const struct dfu_flash *flash;
+static uint8_t data[ERASE_SIZE];
+static uint8_t check[ERASE_SIZE];
+
+Describe(dfu_file_flash);
+
+BeforeEach(dfu_file_flash)
+{
+    file = tmpfile();
+    memset(data, 0x5A, sizeof(data));
+}
+
+AfterEach(dfu_file_flash)
+{
+    fclose(file);
+}
+
+static void init(int flags)
+{
+    assert_that(dfu_file_flash_init(&ff, file, FLASH_SIZE, ERASE_SIZE, flags), is_equal_to(0));
+    flash = dfu_file_flash_device(&ff);
+}
+
+Ensure(dfu_file_flash, rejects_erase_size_not_power_of_two)
+{
+    assert_that(dfu_file_flash_init(&ff, file, FLASH_SIZE, 300, 0), is_equal_to(-EINVAL));
+}
+
+Ensure(dfu_file_flash, size_is_rounded_down_to_sectors)
+{
+    assert_that(dfu_file_flash_init(&ff, file, FLASH_SIZE + 10, ERASE_SIZE, 0), is_equal_to(0));
+    assert_that(ff.flash.size, is_equal_to(FLASH_SIZE));
+}
+
+Ensure(dfu_file_flash, area_past_end_of_file_reads_as_erased)
+{
+    init(0);
+
+    assert_that(flash->ops->read(flash->ctx, 0, check, sizeof(check)), is_equal_to(0));
+    assert_that(check[0], is_equal_to(DFU_FILE_FLASH_ERASED));
+    assert_that(check[ERASE_SIZE - 1], is_equal_to(DFU_FILE_FLASH_ERASED));
+}
+
+Ensure(dfu_file_flash, erase_rejects_unaligned_range)
+{
+    init(DFU_FILE_FLASH_NOR);
+
+    assert_that(flash->ops->erase(flash->ctx, 1, ERASE_SIZE), is_equal_to(-EINVAL));
+    assert_that(flash->ops->erase(flash->ctx, 0, ERASE_SIZE + 1), is_equal_to(-EINVAL));
+    assert_that(flash->ops->erase(flash->ctx, FLASH_SIZE, ERASE_SIZE), is_equal_to(-EINVAL));
+}
+
+Ensure(dfu_file_flash, nor_mode_requires_erase_before_program)
+{
+    init(DFU_FILE_FLASH_NOR);
+
+    assert_that(flash->ops->program(flash->ctx, 0, data, sizeof(data)), is_equal_to(0));
+    assert_that(flash->ops->program(flash->ctx, 0, data, sizeof(data)), is_equal_to(-EIO));
+
+    assert_that(flash->ops->erase(flash->ctx, 0, ERASE_SIZE), is_equal_to(0));
+    assert_that(flash->ops->program(flash->ctx, 0, data, sizeof(data)), is_equal_to(0));
+    assert_that(ff.stats.erased_sectors, is_equal_to(1));
+}
+
+Ensure(dfu_file_flash, plain_mode_overwrites_in_place)
+{
+    init(0);
+
+    assert_that(flash->ops->program(flash->ctx, ERASE_SIZE, data, sizeof(data)), is_equal_to(0));
+    memset(data, 0x11, sizeof(data));
+    assert_that(flash->ops->program(flash->ctx, ERASE_SIZE, data, sizeof(data)), is_equal_to(0));
+
+    assert_that(flash->ops->read(flash->ctx, ERASE_SIZE, check, sizeof(check)), is_equal_to(0));
+    assert_that(check, is_equal_to_contents_of(data, sizeof(data)));
+    assert_that(ff.stats.programmed_bytes, is_equal_to(2 * ERASE_SIZE));
+}
+
+Ensure(dfu_file_flash, program_past_end_is_rejected)
+{
+    init(0);
+
+    assert_that(flash->ops->program(flash->ctx, FLASH_SIZE - 1, data, 2), is_equal_to(-EINVAL));
+}
@@ -0,0 +1,388 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <string.h>
+#include <errno.h>
+#include "dfu_function.h"
+#include "dfu_file_flash.h"
+
+#define FLASH_SIZE (2048)
+#define ERASE_SIZE (128)
+#define BUFFER_SIZE (256)
+#define TRANSFER_SIZE (64)
+#define POLL_TIMEOUT (5)
+
+static FILE *file;
+static struct dfu_file_flash ff;
+static struct dfu_function dfu;
+static uint8_t buffers[2][BUFFER_SIZE];
+static uint8_t image[FLASH_SIZE];
+static uint8_t status[DFU_STATUS_LENGTH];
+
+/* Flash wrapper able to fail programming */
+static int program_fails;
+
+static int flash_erase(void *ctx, uint32_t offset, uint32_t length)
+{
+    return ff.flash.ops->erase(ctx, offset, length);
+}
+
+static int flash_program(void *ctx, uint32_t offset, const uint8_t *data, uint32_t length)
+{
+    if (program_fails)
+        return -EIO;
+    return ff.flash.ops->program(ctx, offset, data, length);
+}
+
+static int flash_read(void *ctx, uint32_t offset, uint8_t *data, uint32_t length)
+{
+    return ff.flash.ops->read(ctx, offset, data, length);
+}
+
+static int flash_flush(void *ctx)
+{
+    return ff.flash.ops->flush(ctx);
+}
+
+static const struct dfu_flash_ops flash_ops = {
+    .erase = flash_erase,
+    .program = flash_program,
+    .read = flash_read,
+    .flush = flash_flush,
+};
+
+static struct dfu_flash flash;
+
+static int wakeups;
+static int manifest_result;
+static uint32_t manifest_length, manifest_crc;
+
+static void wakeup(void *ctx)
+{
+    (void)ctx;
+    wakeups++;
+}
+
+static int manifest(void *ctx, uint32_t length, uint32_t crc)
+{
+    (void)ctx;
+    manifest_length = length;
+    manifest_crc = crc;
+    return manifest_result;
+}
+
+static const struct dfu_function_ops ops = {
+    .wakeup = wakeup,
+    .manifest = manifest,
+};
+
+static uint32_t reference_crc(const uint8_t *data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    int bit;
+
+    while (length--) {
+        crc ^= *data++;
+        for (bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    }
+    return ~crc;
+}
+
+static void run_worker(void)
+{
+    while (dfu_function_work(&dfu))
+        ;
+}
+
+static uint8_t poll_state(void)
+{
+    dfu_function_get_status(&dfu, status);
+    return status[4];
+}
+
+static uint32_t poll_timeout(void)
+{
+    return status[1] | (status[2] << 8) | (status[3] << 16);
+}
+
+/* Host side of single DFU_DNLOAD */
+static int host_dnload(uint16_t block, const uint8_t *data, uint16_t length)
+{
+    uint8_t *buffer;
+    int ret;
+
+    ret = dfu_function_dnload_setup(&dfu, block, length, &buffer);
+    if (ret || !length)
+        return ret;
+    memcpy(buffer, data, length);
+    return dfu_function_dnload(&dfu, length);
+}
+
+/* Sends whole image the way dfu-util does, waiting on dfuDNBUSY */
+static void host_download(const uint8_t *data, uint32_t length)
+{
+    uint32_t offset = 0;
+    uint16_t block = 0;
+    uint16_t chunk;
+
+    while (offset < length) {
+        chunk = (length - offset < TRANSFER_SIZE) ? length - offset : TRANSFER_SIZE;
+        assert_that(host_dnload(block++, data + offset, chunk), is_equal_to(0));
+        offset += chunk;
+        while (poll_state() == DFU_STATE_DNBUSY)
+            run_worker();
+        assert_that(status[4], is_equal_to(DFU_STATE_DNLOAD_IDLE));
+    }
+    assert_that(host_dnload(block, NULL, 0), is_equal_to(0));
+}
+
+static void read_flash(uint8_t *data, uint32_t length)
+{
+    assert_that(ff.flash.ops->read(&ff, 0, data, length), is_equal_to(0));
+}
+
+Describe(dfu_function);
+
+BeforeEach(dfu_function)
+{
+    struct dfu_function_buffers config = {
+        .data = { buffers[0], buffers[1] },
+        .size = BUFFER_SIZE,
+        .transfer_size = TRANSFER_SIZE,
+        .poll_timeout = POLL_TIMEOUT,
+    };
+    uint32_t i;
+
+    file = tmpfile();
+    assert_that(dfu_file_flash_init(&ff, file, FLASH_SIZE, ERASE_SIZE, DFU_FILE_FLASH_NOR), is_equal_to(0));
+    flash = ff.flash;
+    flash.ops = &flash_ops;
+
+    for (i = 0; i < sizeof(image); i++)
+        image[i] = i * 7 + (i >> 8);
+    program_fails = 0;
+    wakeups = 0;
+    manifest_result = 0;
+    manifest_length = manifest_crc = 0;
+
+    assert_that(dfu_function_init(&dfu, &ops, NULL, &flash, &config), is_equal_to(0));
+}
+
+AfterEach(dfu_function)
+{
+    fclose(file);
+}
+
+Ensure(dfu_function, init_rejects_buffer_not_multiple_of_erase_size)
+{
+    struct dfu_function_buffers config = {
+        .data = { buffers[0], buffers[1] },
+        .size = ERASE_SIZE + TRANSFER_SIZE,
+        .transfer_size = TRANSFER_SIZE,
+    };
+
+    assert_that(dfu_function_init(&dfu, &ops, NULL, &flash, &config), is_equal_to(-EINVAL));
+}
+
+Ensure(dfu_function, starts_idle)
+{
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_IDLE));
+    assert_that(poll_state(), is_equal_to(DFU_STATE_IDLE));
+    assert_that(status[0], is_equal_to(DFU_STATUS_OK));
+}
+
+Ensure(dfu_function, block_is_received_directly_into_staging_buffer)
+{
+    uint8_t *buffer;
+
+    assert_that(dfu_function_dnload_setup(&dfu, 0, TRANSFER_SIZE, &buffer), is_equal_to(0));
+    assert_that(buffer, is_equal_to(buffers[0]));
+    dfu_function_dnload(&dfu, TRANSFER_SIZE);
+    poll_state();
+
+    assert_that(dfu_function_dnload_setup(&dfu, 1, TRANSFER_SIZE, &buffer), is_equal_to(0));
+    assert_that(buffer, is_equal_to(buffers[0] + TRANSFER_SIZE));
+}
+
+Ensure(dfu_function, next_block_is_accepted_while_previous_buffer_is_programmed)
+{
+    int i;
+
+    for (i = 0; i < BUFFER_SIZE / TRANSFER_SIZE; i++) {
+        host_dnload(i, image + i * TRANSFER_SIZE, TRANSFER_SIZE);
+        assert_that(poll_state(), is_equal_to(DFU_STATE_DNLOAD_IDLE));
+        assert_that(poll_timeout(), is_equal_to(0));
+    }
+    assert_that(wakeups, is_equal_to(1));
+
+    /* Second buffer fills without any programming done yet */
+    for (; i < 2 * BUFFER_SIZE / TRANSFER_SIZE - 1; i++) {
+        host_dnload(i, image + i * TRANSFER_SIZE, TRANSFER_SIZE);
+        assert_that(poll_state(), is_equal_to(DFU_STATE_DNLOAD_IDLE));
+    }
+    assert_that(ff.stats.programmed_bytes, is_equal_to(0));
+}
+
+Ensure(dfu_function, host_waits_when_both_buffers_are_in_use)
+{
+    int i;
+
+    for (i = 0; i < 2 * BUFFER_SIZE / TRANSFER_SIZE; i++) {
+        host_dnload(i, image + i * TRANSFER_SIZE, TRANSFER_SIZE);
+        if (i < 2 * BUFFER_SIZE / TRANSFER_SIZE - 1)
+            poll_state();
+    }
+
+    assert_that(poll_state(), is_equal_to(DFU_STATE_DNBUSY));
+    assert_that(poll_timeout(), is_equal_to(POLL_TIMEOUT));
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_DNLOAD_SYNC));
+    assert_that(dfu.stats.busy_polls, is_equal_to(1));
+
+    assert_that(dfu_function_work(&dfu), is_equal_to(1));
+    assert_that(poll_state(), is_equal_to(DFU_STATE_DNLOAD_IDLE));
+}
+
+Ensure(dfu_function, image_is_programmed_and_manifested)
+{
+    uint8_t written[FLASH_SIZE];
+    uint32_t length = 3 * BUFFER_SIZE + 100;
+
+    host_download(image, length);
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_MANIFEST_SYNC));
+    assert_that(poll_state(), is_equal_to(DFU_STATE_MANIFEST));
+
+    run_worker();
+    assert_that(poll_state(), is_equal_to(DFU_STATE_IDLE));
+    assert_that(status[0], is_equal_to(DFU_STATUS_OK));
+
+    read_flash(written, length);
+    assert_that(written, is_equal_to_contents_of(image, length));
+    assert_that(manifest_length, is_equal_to(length));
+    assert_that(manifest_crc, is_equal_to(reference_crc(image, length)));
+    assert_that(dfu.stats.programmed, is_equal_to(length));
+}
+
+Ensure(dfu_function, each_sector_is_erased_once)
+{
+    host_download(image, FLASH_SIZE);
+    run_worker();
+    poll_state();
+
+    assert_that(ff.stats.erased_sectors, is_equal_to(FLASH_SIZE / ERASE_SIZE));
+}
+
+Ensure(dfu_function, zero_length_download_in_idle_stalls)
+{
+    assert_that(host_dnload(0, NULL, 0), is_equal_to(-EPROTO));
+    assert_that(poll_state(), is_equal_to(DFU_STATE_ERROR));
+    assert_that(status[0], is_equal_to(DFU_STATUS_ERR_STALLEDPKT));
+
+    assert_that(dfu_function_clear_status(&dfu), is_equal_to(0));
+    assert_that(poll_state(), is_equal_to(DFU_STATE_IDLE));
+}
+
+Ensure(dfu_function, out_of_sequence_block_stalls)
+{
+    host_dnload(0, image, TRANSFER_SIZE);
+    poll_state();
+
+    assert_that(host_dnload(2, image, TRANSFER_SIZE), is_equal_to(-EPROTO));
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_ERROR));
+}
+
+Ensure(dfu_function, block_after_short_block_stalls)
+{
+    host_dnload(0, image, TRANSFER_SIZE / 2);
+    poll_state();
+
+    assert_that(host_dnload(1, image, TRANSFER_SIZE), is_equal_to(-EPROTO));
+}
+
+Ensure(dfu_function, image_larger_than_flash_is_rejected)
+{
+    uint32_t i;
+
+    for (i = 0; i < FLASH_SIZE / TRANSFER_SIZE; i++) {
+        host_dnload(i, image, TRANSFER_SIZE);
+        while (poll_state() == DFU_STATE_DNBUSY)
+            run_worker();
+    }
+
+    assert_that(host_dnload(i, image, TRANSFER_SIZE), is_equal_to(-EINVAL));
+    assert_that(poll_state(), is_equal_to(DFU_STATE_ERROR));
+    assert_that(status[0], is_equal_to(DFU_STATUS_ERR_ADDRESS));
+}
+
+Ensure(dfu_function, program_failure_is_reported_on_next_status)
+{
+    program_fails = 1;
+    host_dnload(0, image, TRANSFER_SIZE / 2);
+    run_worker();
+
+    assert_that(poll_state(), is_equal_to(DFU_STATE_ERROR));
+    assert_that(status[0], is_equal_to(DFU_STATUS_ERR_PROG));
+}
+
+Ensure(dfu_function, rejected_image_reports_firmware_error)
+{
+    manifest_result = -EINVAL;
+    host_download(image, 100);
+    run_worker();
+
+    assert_that(poll_state(), is_equal_to(DFU_STATE_ERROR));
+    assert_that(status[0], is_equal_to(DFU_STATUS_ERR_FIRMWARE));
+}
+
+Ensure(dfu_function, abort_drops_data_not_programmed)
+{
+    host_dnload(0, image, TRANSFER_SIZE);
+    poll_state();
+    host_dnload(1, image, TRANSFER_SIZE / 2);
+
+    assert_that(dfu_function_abort(&dfu), is_equal_to(0));
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_IDLE));
+    assert_that(dfu_function_work(&dfu), is_equal_to(0));
+    assert_that(ff.stats.programmed_bytes, is_equal_to(0));
+}
+
+Ensure(dfu_function, result_of_buffer_programmed_during_abort_is_ignored)
+{
+    program_fails = 1;
+    host_dnload(0, image, TRANSFER_SIZE / 2);
+    /* Worker picks buffer, host aborts before it completes */
+    dfu.buffer[0].state = 3;
+    dfu_function_abort(&dfu);
+    dfu.buffer[0].state = 2;
+    dfu_function_work(&dfu);
+
+    assert_that(poll_state(), is_equal_to(DFU_STATE_IDLE));
+    assert_that(status[0], is_equal_to(DFU_STATUS_OK));
+}
+
+Ensure(dfu_function, upload_returns_manifested_image)
+{
+    uint8_t buffer[TRANSFER_SIZE];
+    uint32_t length = TRANSFER_SIZE + 10;
+
+    host_download(image, length);
+    run_worker();
+    poll_state();
+
+    assert_that(dfu_function_upload(&dfu, 0, buffer, sizeof(buffer)), is_equal_to(TRANSFER_SIZE));
+    assert_that(buffer, is_equal_to_contents_of(image, TRANSFER_SIZE));
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_UPLOAD_IDLE));
+
+    assert_that(dfu_function_upload(&dfu, 1, buffer, sizeof(buffer)), is_equal_to(10));
+    assert_that(buffer, is_equal_to_contents_of(image + TRANSFER_SIZE, 10));
+    assert_that(dfu_function_get_state(&dfu), is_equal_to(DFU_STATE_IDLE));
+}
+
+Ensure(dfu_function, reset_returns_to_idle)
+{
+    host_dnload(0, image, TRANSFER_SIZE);
+    dfu_function_reset(&dfu);
+
+    assert_that(poll_state(), is_equal_to(DFU_STATE_IDLE));
+    assert_that(dfu_function_work(&dfu), is_equal_to(0));
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "usb_device_config.h"
+#include "usb.h"
+#include "usb_device.h"
+
+#include "usb_device_class.h"
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+#include "usb_device_dfu.h"
+
+/*******************************************************************************
+ * Variables
+ ******************************************************************************/
+/* DFU device instance */
+
+USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE)
+    usb_device_dfu_struct_t g_dfuHandle[USB_DEVICE_CONFIG_DFU_MAX_INSTANCE];
+
+/*******************************************************************************
+ * Code
+ ******************************************************************************/
+
+/*!
+ * @brief Allocates the DFU device handle.
+ *
+ * @param handle The class handle of the DFU class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceDfuAllocateHandle(usb_device_dfu_struct_t **handle)
+{
+    uint32_t count;
+    for (count = 0; count < USB_DEVICE_CONFIG_DFU_MAX_INSTANCE; count++)
+    {
+        if (NULL == g_dfuHandle[count].handle)
+        {
+            *handle = &g_dfuHandle[count];
+            return kStatus_USB_Success;
+        }
+    }
+
+    return kStatus_USB_Busy;
+}
+
+/*!
+ * @brief Frees the DFU device handle.
+ *
+ * @param handle The class handle of the DFU class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceDfuFreeHandle(usb_device_dfu_struct_t *handle)
+{
+    handle->handle        = NULL;
+    handle->configStruct  = NULL;
+    handle->configuration = 0;
+    handle->hasInterface  = 0;
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Looks up the DFU interface in current configuration.
+ *
+ * DFU interface has no endpoints, only its number is needed to filter class requests.
+ *
+ * @param dfuHandle The class handle of the DFU class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceDfuFindInterface(usb_device_dfu_struct_t *dfuHandle)
+{
+    usb_device_interface_list_t *interfaceList;
+    uint32_t count;
+
+    dfuHandle->hasInterface = 0;
+
+    /* return error when configuration is invalid (0 or more than the configuration number) */
+    if ((dfuHandle->configuration == 0U) ||
+        (dfuHandle->configuration > dfuHandle->configStruct->classInfomation->configurations))
+    {
+        return kStatus_USB_Error;
+    }
+
+    interfaceList = &dfuHandle->configStruct->classInfomation->interfaceList[dfuHandle->configuration - 1];
+
+    for (count = 0; count < interfaceList->count; count++)
+    {
+        if (USB_DEVICE_DFU_CLASS_CODE == interfaceList->interfaces[count].classCode)
+        {
+            dfuHandle->interfaceNumber = interfaceList->interfaces[count].interfaceNumber;
+            dfuHandle->hasInterface    = 1;
+            return kStatus_USB_Success;
+        }
+    }
+    return kStatus_USB_Error;
+}
+
+/*!
+ * @brief Handles the DFU class event.
+ *
+ * This function responses to various events including the common device events and the class specific events.
+ * Class specific requests are passed to the application, DFU state machine lives above the class driver.
+ *
+ * @param handle The class handle of the DFU class.
+ * @param event The event type.
+ * @param param The parameter of the event.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceDfuEvent(void *handle, uint32_t event, void *param)
+{
+    usb_device_dfu_struct_t *dfuHandle;
+    usb_device_dfu_request_param_struct_t reqParam;
+    usb_status_t error = kStatus_USB_Error;
+    uint8_t *temp8;
+
+    if ((!param) || (!handle))
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    dfuHandle = (usb_device_dfu_struct_t *)handle;
+
+    switch (event)
+    {
+        case kUSB_DeviceClassEventDeviceReset:
+            /* Bus reset, clear the configuration. */
+            dfuHandle->configuration = 0;
+            dfuHandle->hasInterface  = 0;
+            break;
+        case kUSB_DeviceClassEventSetConfiguration:
+            temp8 = ((uint8_t *)param);
+            if (!dfuHandle->configStruct)
+            {
+                break;
+            }
+            if (*temp8 == dfuHandle->configuration)
+            {
+                break;
+            }
+
+            dfuHandle->configuration = *temp8;
+            error                    = USB_DeviceDfuFindInterface(dfuHandle);
+            if (kStatus_USB_Success != error)
+            {
+#ifdef DEBUG
+                usb_echo("kUSB_DeviceClassEventSetConfiguration, DFU interface not found\r\n");
+#endif
+            }
+            break;
+        case kUSB_DeviceClassEventClassRequest:
+        {
+            usb_device_control_request_struct_t *controlRequest = (usb_device_control_request_struct_t *)param;
+
+            if ((!dfuHandle->hasInterface) ||
+                ((controlRequest->setup->wIndex & 0xFFU) != dfuHandle->interfaceNumber))
+            {
+                break;
+            }
+            if ((USB_REQUEST_TYPE_TYPE_CLASS != (controlRequest->setup->bmRequestType & USB_REQUEST_TYPE_TYPE_MASK)) ||
+                (!dfuHandle->configStruct) || (!dfuHandle->configStruct->classCallback))
+            {
+                break;
+            }
+            reqParam.buffer         = &(controlRequest->buffer);
+            reqParam.length         = &(controlRequest->length);
+            reqParam.interfaceIndex = controlRequest->setup->wIndex;
+            reqParam.setupValue     = controlRequest->setup->wValue;
+            reqParam.setupLength    = controlRequest->setup->wLength;
+            reqParam.request        = controlRequest->setup->bRequest;
+            reqParam.isSetup        = controlRequest->isSetup;
+            /* classCallback is initialized in classInit of s_UsbDeviceClassInterfaceMap,
+            it is from the second parameter of classInit */
+            error = dfuHandle->configStruct->classCallback(kUSB_DeviceDfuEventClassRequest, &reqParam,
+                                                           dfuHandle->configStruct->classCalbackArg);
+        }
+        break;
+        default:
+            break;
+    }
+    return error;
+}
+
+/*!
+ * @brief Initializes the USB DFU class.
+ *
+ * @param controllerId The id of the controller.
+ * @param config The user configuration structure of type usb_device_class_config_struct_t.
+ * @param handle It is out parameter. The class handle of the DFU class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceDfuInit(uint8_t controllerId, usb_device_class_config_struct_t *config, class_handle_t *handle)
+{
+    usb_device_dfu_struct_t *dfuHandle;
+    usb_status_t error = kStatus_USB_Error;
+
+    error = USB_DeviceDfuAllocateHandle(&dfuHandle);
+
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+
+    error = USB_DeviceClassGetDeviceHandle(controllerId, &dfuHandle->handle);
+
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+
+    if (!dfuHandle->handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    dfuHandle->configStruct  = config;
+    dfuHandle->configuration = 0;
+    dfuHandle->hasInterface  = 0;
+
+    *handle = (class_handle_t)dfuHandle;
+    return error;
+}
+
+/*!
+ * @brief De-Initializes the USB DFU class.
+ *
+ * @param handle The class handle of the DFU class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceDfuDeinit(class_handle_t handle)
+{
+    usb_device_dfu_struct_t *dfuHandle;
+
+    dfuHandle = (usb_device_dfu_struct_t *)handle;
+
+    if (!dfuHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    USB_DeviceDfuFreeHandle(dfuHandle);
+    return kStatus_USB_Success;
+}
+
+#endif /* USB_DEVICE_CONFIG_DFU */
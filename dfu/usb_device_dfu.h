@@ -0,0 +1,90 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _USB_DEVICE_DFU_H_
+#define _USB_DEVICE_DFU_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define USB_DEVICE_CONFIG_DFU_MAX_INSTANCE (1)  /*!< The maximum number of DFU device instance. */
+#define USB_DEVICE_DFU_CLASS_CODE (0xFE)        /*!< The application specific class code. */
+#define USB_DEVICE_DFU_SUBCLASS_CODE (0x01)     /*!< Device Firmware Upgrade subclass. */
+#define USB_DEVICE_DFU_PROTOCOL_RUNTIME (0x01)  /*!< Interface of running application. */
+#define USB_DEVICE_DFU_PROTOCOL_DFU_MODE (0x02) /*!< Interface accepting firmware download. */
+
+/*! @brief Definition of DFU class event. */
+typedef enum _usb_device_dfu_event
+{
+    kUSB_DeviceDfuEventClassRequest = 0x01, /*!< Class request addressed to DFU interface. */
+} usb_device_dfu_event_t;
+
+/*! @brief Definition of parameters for DFU request. */
+typedef struct _usb_device_dfu_request_param_struct
+{
+    uint8_t **buffer;        /*!< The pointer to the address of the buffer for DFU class request. */
+    uint32_t *length;        /*!< The pointer to the length of the buffer for DFU class request. */
+    uint16_t interfaceIndex; /*!< The interface index of the setup packet. */
+    uint16_t setupValue;     /*!< The wValue field of the setup packet, wBlockNum or wTimeout. */
+    uint16_t setupLength;    /*!< The wLength field of the setup packet. */
+    uint8_t request;         /*!< The bRequest field of the setup packet. */
+    uint8_t isSetup;         /*!< The flag indicates if it is a setup packet, 1: yes, 0: no. */
+} usb_device_dfu_request_param_struct_t;
+
+/*! @brief Definition of structure for DFU device. */
+typedef struct _usb_device_dfu_struct
+{
+    usb_device_handle handle;                       /*!< The handle of the USB device. */
+    usb_device_class_config_struct_t *configStruct; /*!< The class configure structure. */
+    uint8_t configuration;                          /*!< The current configuration value. */
+    uint8_t interfaceNumber;                        /*!< The interface number of the class. */
+    uint8_t hasInterface;                           /*!< DFU interface is present in current configuration. */
+} usb_device_dfu_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*!
+ * @brief Initializes the USB DFU class.
+ *
+ * @param controllerId The controller ID of the USB IP.
+ * @param config The class configuration information.
+ * @param handle An parameter used to return pointer of the DFU class handle to the caller.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceDfuInit(uint8_t controllerId,
+                                      usb_device_class_config_struct_t *config,
+                                      class_handle_t *handle);
+
+/*!
+ * @brief Deinitializes the USB DFU class.
+ *
+ * @param handle The DFU class handle got from usb_device_class_config_struct_t::classHandle.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceDfuDeinit(class_handle_t handle);
+
+/*!
+ * @brief Handles the DFU class event.
+ *
+ * DFU uses control endpoint only, class requests are passed to the application.
+ *
+ * @param handle The DFU class handle.
+ * @param event The event type.
+ * @param param The parameter of the event.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceDfuEvent(void *handle, uint32_t event, void *param);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* _USB_DEVICE_DFU_H_ */
@@ -0,0 +1,45 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _MSC_BLOCK_H
+#define _MSC_BLOCK_H
+
+#include <stdint.h>
+
+/* Block device operations. Functions return 0 on success, negative errno
+ * otherwise. Device is accessed from single task only. */
+struct msc_block_ops
+{
+    int (*read)(void *ctx, uint32_t lba, uint8_t *buffer, uint32_t count);
+    int (*write)(void *ctx, uint32_t lba, const uint8_t *buffer, uint32_t count);
+    /* Optional, commit data held in volatile memory to the medium */
+    int (*flush)(void *ctx);
+};
+
+struct msc_block_dev
+{
+    const struct msc_block_ops *ops;
+    void *ctx;
+    uint32_t block_size;    /* Bytes per block, 512 for most hosts */
+    uint32_t block_count;
+    int read_only;
+};
+
+static inline int msc_block_read(const struct msc_block_dev *dev, uint32_t lba, uint8_t *buffer, uint32_t count)
+{
+    return dev->ops->read(dev->ctx, lba, buffer, count);
+}
+
+static inline int msc_block_write(const struct msc_block_dev *dev, uint32_t lba, const uint8_t *buffer, uint32_t count)
+{
+    return dev->ops->write(dev->ctx, lba, buffer, count);
+}
+
+static inline int msc_block_flush(const struct msc_block_dev *dev)
+{
+    return dev->ops->flush ? dev->ops->flush(dev->ctx) : 0;
+}
+
+#endif /* _MSC_BLOCK_H */
@@ -0,0 +1,495 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include "msc_bot.h"
+#include <string.h>
+#include <errno.h>
+
+#define INQUIRY_LENGTH (36)
+#define REQUEST_SENSE_LENGTH (18)
+#define MODE_SENSE_6_LENGTH (4)
+#define MODE_SENSE_10_LENGTH (8)
+#define FORMAT_CAPACITIES_LENGTH (12)
+#define READ_CAPACITY_LENGTH (8)
+
+static inline uint16_t get_be16(const uint8_t *buffer)
+{
+    return ((uint16_t)buffer[0] << 8) | buffer[1];
+}
+
+static inline uint32_t get_be32(const uint8_t *buffer)
+{
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) |
+        ((uint32_t)buffer[2] << 8) | buffer[3];
+}
+
+static inline void put_be16(uint8_t *buffer, uint16_t value)
+{
+    buffer[0] = (value >> 8) & 0xFF;
+    buffer[1] = value & 0xFF;
+}
+
+static inline void put_be32(uint8_t *buffer, uint32_t value)
+{
+    put_be16(buffer, (value >> 16) & 0xFFFF);
+    put_be16(buffer + 2, value & 0xFFFF);
+}
+
+static inline uint32_t get_le32(const uint8_t *buffer)
+{
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+        ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+static inline void put_le32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = (value >> 24) & 0xFF;
+}
+
+static inline uint32_t min(uint32_t a, uint32_t b)
+{
+    return (a < b) ? a : b;
+}
+
+static void put_string(uint8_t *buffer, const char *string, size_t length)
+{
+    size_t i = 0;
+
+    if (string)
+        for (; (i < length) && string[i]; i++)
+            buffer[i] = string[i];
+    for (; i < length; i++)
+        buffer[i] = ' ';
+}
+
+static void fail(struct msc_bot *bot, uint8_t key, uint8_t asc)
+{
+    bot->status = MSC_BOT_STATUS_FAILED;
+    bot->sense_key = key;
+    bot->sense_asc = asc;
+}
+
+static int medium_ready(struct msc_bot *bot)
+{
+    if (bot->present)
+        return 1;
+    fail(bot, SCSI_SENSE_NOT_READY, SCSI_ASC_MEDIUM_NOT_PRESENT);
+    return 0;
+}
+
+static int transfer(struct msc_bot *bot, int in, uint8_t *buffer, uint32_t length)
+{
+    int ret;
+
+    if (in)
+        ret = bot->transport->send(bot->ctx, buffer, length);
+    else
+        ret = bot->transport->recv(bot->ctx, buffer, length);
+    if (ret < 0)
+        return ret;
+    return bot->transport->wait(bot->ctx);
+}
+
+/* Compares device intent with host expectation, 1 when data phase may run.
+ * Mismatch in direction or host expecting less than device has is phase error. */
+static int data_phase(struct msc_bot *bot, int in, uint32_t length)
+{
+    if ((bot->host_length == 0) || (bot->host_in != in) || (bot->host_length < length)) {
+        bot->phase_error = 1;
+        return 0;
+    }
+    return 1;
+}
+
+/* Sends response prepared in first data buffer, truncated to host length */
+static int respond(struct msc_bot *bot, uint32_t length)
+{
+    int ret;
+
+    if ((bot->host_length == 0) || !bot->host_in) {
+        bot->phase_error = 1;
+        return 0;
+    }
+
+    length = min(length, bot->host_length);
+    ret = transfer(bot, MSC_BOT_DIR_IN, bot->data[0], length);
+    if (ret < 0)
+        return ret;
+
+    bot->transferred = ret;
+    return 0;
+}
+
+static int inquiry(struct msc_bot *bot, const uint8_t *cb)
+{
+    uint8_t *r = bot->data[0];
+
+    if (cb[1] & 0x01) {
+        fail(bot, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB);
+        return 0;
+    }
+
+    memset(r, 0, INQUIRY_LENGTH);
+    r[0] = 0x00;        /* Direct access block device */
+    r[1] = 0x80;        /* Removable */
+    r[2] = 0x04;        /* SPC-2 */
+    r[3] = 0x02;        /* Response data format */
+    r[4] = INQUIRY_LENGTH - 5;
+    put_string(r + 8, bot->vendor, 8);
+    put_string(r + 16, bot->product, 16);
+    put_string(r + 32, bot->revision, 4);
+
+    return respond(bot, min(INQUIRY_LENGTH, get_be16(cb + 3)));
+}
+
+static int request_sense(struct msc_bot *bot, const uint8_t *cb)
+{
+    uint8_t *r = bot->data[0];
+
+    memset(r, 0, REQUEST_SENSE_LENGTH);
+    r[0] = 0x70;        /* Current error, fixed format */
+    r[2] = bot->sense_key;
+    r[7] = REQUEST_SENSE_LENGTH - 8;
+    r[12] = bot->sense_asc;
+
+    bot->sense_key = SCSI_SENSE_NO_SENSE;
+    bot->sense_asc = 0;
+
+    return respond(bot, min(REQUEST_SENSE_LENGTH, cb[4]));
+}
+
+static int mode_sense(struct msc_bot *bot, const uint8_t *cb, int ten)
+{
+    uint8_t *r = bot->data[0];
+    uint8_t wp = bot->dev->read_only ? 0x80 : 0x00;
+
+    if (ten) {
+        memset(r, 0, MODE_SENSE_10_LENGTH);
+        put_be16(r, MODE_SENSE_10_LENGTH - 2);
+        r[3] = wp;
+        return respond(bot, min(MODE_SENSE_10_LENGTH, get_be16(cb + 7)));
+    }
+
+    memset(r, 0, MODE_SENSE_6_LENGTH);
+    r[0] = MODE_SENSE_6_LENGTH - 1;
+    r[2] = wp;
+    return respond(bot, min(MODE_SENSE_6_LENGTH, cb[4]));
+}
+
+static int start_stop_unit(struct msc_bot *bot, const uint8_t *cb)
+{
+    int load_eject = cb[4] & 0x02;
+    int start = cb[4] & 0x01;
+
+    if (!load_eject)
+        return 0;
+
+    if (start) {
+        bot->present = 1;
+        return 0;
+    }
+
+    if (bot->prevent_removal) {
+        fail(bot, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_MEDIUM_REMOVAL_PREVENTED);
+        return 0;
+    }
+
+    msc_block_flush(bot->dev);
+    bot->present = 0;
+    return 0;
+}
+
+static int read_format_capacities(struct msc_bot *bot, const uint8_t *cb)
+{
+    uint8_t *r = bot->data[0];
+
+    memset(r, 0, FORMAT_CAPACITIES_LENGTH);
+    r[3] = FORMAT_CAPACITIES_LENGTH - 4;
+    put_be32(r + 4, bot->dev->block_count);
+    put_be32(r + 8, bot->dev->block_size);
+    r[8] = bot->present ? 0x02 : 0x03;  /* Formatted or no medium */
+
+    return respond(bot, min(FORMAT_CAPACITIES_LENGTH, get_be16(cb + 7)));
+}
+
+static int read_capacity(struct msc_bot *bot)
+{
+    uint8_t *r = bot->data[0];
+
+    if (!medium_ready(bot))
+        return 0;
+
+    put_be32(r, bot->dev->block_count - 1);
+    put_be32(r + 4, bot->dev->block_size);
+    return respond(bot, READ_CAPACITY_LENGTH);
+}
+
+static int check_range(struct msc_bot *bot, uint32_t lba, uint32_t count)
+{
+    if ((lba < bot->dev->block_count) && (count <= bot->dev->block_count - lba))
+        return 1;
+    fail(bot, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_LBA_OUT_OF_RANGE);
+    return 0;
+}
+
+/* Medium read of next chunk overlaps transfer of previous one */
+static int read10(struct msc_bot *bot, const uint8_t *cb)
+{
+    uint32_t lba = get_be32(cb + 2);
+    uint32_t count = get_be16(cb + 7);
+    uint32_t bs = bot->dev->block_size;
+    uint32_t chunk = bot->data_size / bs;
+    int pending = 0;
+    int current = 0;
+    int ret;
+
+    if (!medium_ready(bot) || !check_range(bot, lba, count) || (count == 0))
+        return 0;
+    if (!data_phase(bot, MSC_BOT_DIR_IN, count * bs))
+        return 0;
+
+    while (count) {
+        uint32_t n = min(count, chunk);
+        int err = msc_block_read(bot->dev, lba, bot->data[current], n);
+
+        if (pending) {
+            ret = bot->transport->wait(bot->ctx);
+            if (ret < 0)
+                return ret;
+            bot->transferred += ret;
+            pending = 0;
+        }
+        if (err) {
+            fail(bot, SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_UNRECOVERED_READ_ERROR);
+            return 0;
+        }
+
+        ret = bot->transport->send(bot->ctx, bot->data[current], n * bs);
+        if (ret < 0)
+            return ret;
+        pending = 1;
+
+        bot->stats.read_bytes += n * bs;
+        lba += n;
+        count -= n;
+        current ^= 1;
+    }
+
+    ret = bot->transport->wait(bot->ctx);
+    if (ret < 0)
+        return ret;
+    bot->transferred += ret;
+    return 0;
+}
+
+/* Reception of next chunk overlaps medium write of previous one */
+static int write10(struct msc_bot *bot, const uint8_t *cb)
+{
+    uint32_t lba = get_be32(cb + 2);
+    uint32_t count = get_be16(cb + 7);
+    uint32_t bs = bot->dev->block_size;
+    uint32_t chunk = bot->data_size / bs;
+    uint32_t n = min(count, chunk);
+    int current = 0;
+    int ret;
+
+    if (!medium_ready(bot) || !check_range(bot, lba, count))
+        return 0;
+    if (bot->dev->read_only) {
+        fail(bot, SCSI_SENSE_DATA_PROTECT, SCSI_ASC_WRITE_PROTECTED);
+        return 0;
+    }
+    if ((count == 0) || !data_phase(bot, MSC_BOT_DIR_OUT, count * bs))
+        return 0;
+
+    ret = bot->transport->recv(bot->ctx, bot->data[current], n * bs);
+    if (ret < 0)
+        return ret;
+
+    while (count) {
+        uint32_t next;
+
+        ret = bot->transport->wait(bot->ctx);
+        if (ret < 0)
+            return ret;
+        bot->transferred += ret;
+        if ((uint32_t)ret != n * bs) {
+            bot->phase_error = 1;
+            return 0;
+        }
+
+        next = min(count - n, chunk);
+        if (next) {
+            ret = bot->transport->recv(bot->ctx, bot->data[current ^ 1], next * bs);
+            if (ret < 0)
+                return ret;
+        }
+
+        if (msc_block_write(bot->dev, lba, bot->data[current], n)) {
+            fail(bot, SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_ERROR);
+            if (next) {
+                ret = bot->transport->wait(bot->ctx);
+                if (ret < 0)
+                    return ret;
+                bot->transferred += ret;
+            }
+            return 0;
+        }
+
+        bot->stats.written_bytes += n * bs;
+        lba += n;
+        count -= n;
+        current ^= 1;
+        n = next;
+    }
+    return 0;
+}
+
+static int verify10(struct msc_bot *bot, const uint8_t *cb)
+{
+    if (!medium_ready(bot) || !check_range(bot, get_be32(cb + 2), get_be16(cb + 7)))
+        return 0;
+    /* Byte by byte comparison is not supported */
+    if (cb[1] & 0x02)
+        fail(bot, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_FIELD_IN_CDB);
+    return 0;
+}
+
+static int synchronize_cache(struct msc_bot *bot)
+{
+    if (!medium_ready(bot))
+        return 0;
+    if (msc_block_flush(bot->dev))
+        fail(bot, SCSI_SENSE_MEDIUM_ERROR, SCSI_ASC_WRITE_ERROR);
+    return 0;
+}
+
+static int execute(struct msc_bot *bot, const uint8_t *cb)
+{
+    switch (cb[0]) {
+        case SCSI_TEST_UNIT_READY:
+            medium_ready(bot);
+            return 0;
+        case SCSI_REQUEST_SENSE:
+            return request_sense(bot, cb);
+        case SCSI_INQUIRY:
+            return inquiry(bot, cb);
+        case SCSI_MODE_SENSE_6:
+            return mode_sense(bot, cb, 0);
+        case SCSI_MODE_SENSE_10:
+            return mode_sense(bot, cb, 1);
+        case SCSI_START_STOP_UNIT:
+            return start_stop_unit(bot, cb);
+        case SCSI_PREVENT_ALLOW_MEDIUM_REMOVAL:
+            bot->prevent_removal = cb[4] & 0x01;
+            return 0;
+        case SCSI_READ_FORMAT_CAPACITIES:
+            return read_format_capacities(bot, cb);
+        case SCSI_READ_CAPACITY_10:
+            return read_capacity(bot);
+        case SCSI_READ_10:
+            return read10(bot, cb);
+        case SCSI_WRITE_10:
+            return write10(bot, cb);
+        case SCSI_VERIFY_10:
+            return verify10(bot, cb);
+        case SCSI_SYNCHRONIZE_CACHE_10:
+            return synchronize_cache(bot);
+        default:
+            fail(bot, SCSI_SENSE_ILLEGAL_REQUEST, SCSI_ASC_INVALID_COMMAND);
+            return 0;
+    }
+}
+
+static int cbw_valid(const uint8_t *cbw, int length)
+{
+    return (length == MSC_BOT_CBW_LENGTH) &&
+        (get_le32(cbw) == MSC_BOT_CBW_SIGNATURE) &&
+        (cbw[13] == 0) &&                           /* Single LUN */
+        (cbw[14] >= 1) && (cbw[14] <= 16);
+}
+
+int msc_bot_init(struct msc_bot *bot, const struct msc_bot_transport *transport, void *ctx,
+        const struct msc_block_dev *dev, uint8_t *memory, size_t size)
+{
+    uint32_t data_size;
+
+    if (!transport || !dev || !memory || (dev->block_size == 0) || (size < MSC_BOT_HEADER_SPACE))
+        return -EINVAL;
+
+    data_size = (size - MSC_BOT_HEADER_SPACE) / 2;
+    data_size -= data_size % dev->block_size;
+    if (data_size == 0)
+        return -EINVAL;
+
+    memset(bot, 0, sizeof(*bot));
+    bot->transport = transport;
+    bot->ctx = ctx;
+    bot->dev = dev;
+    bot->cbw = memory;
+    bot->csw = memory + MSC_BOT_HEADER_SPACE / 2;
+    bot->data[0] = memory + MSC_BOT_HEADER_SPACE;
+    bot->data[1] = bot->data[0] + data_size;
+    bot->data_size = data_size;
+    bot->present = 1;
+    return 0;
+}
+
+int msc_bot_process(struct msc_bot *bot)
+{
+    const uint8_t *cb = bot->cbw + 15;
+    uint32_t residue;
+    int ret;
+
+    ret = transfer(bot, MSC_BOT_DIR_OUT, bot->cbw, MSC_BOT_CBW_LENGTH);
+    if (ret < 0)
+        return ret;
+
+    if (!cbw_valid(bot->cbw, ret)) {
+        /* Device stays halted until host runs reset recovery */
+        bot->stats.invalid_cbw++;
+        bot->transport->stall(bot->ctx, MSC_BOT_DIR_IN, 1);
+        bot->transport->stall(bot->ctx, MSC_BOT_DIR_OUT, 1);
+        return -EPROTO;
+    }
+
+    bot->host_length = get_le32(bot->cbw + 8);
+    bot->host_in = (bot->cbw[12] & 0x80) ? MSC_BOT_DIR_IN : MSC_BOT_DIR_OUT;
+    bot->transferred = 0;
+    bot->status = MSC_BOT_STATUS_PASSED;
+    bot->phase_error = 0;
+    bot->stats.commands++;
+
+    ret = execute(bot, cb);
+    if (ret < 0)
+        return ret;
+
+    /* Host expects more data than device had, halt the pipe so host
+     * learns the data phase ended and report difference as residue */
+    residue = bot->host_length - bot->transferred;
+    if (residue)
+        bot->transport->stall(bot->ctx, bot->host_in, 0);
+
+    if (bot->phase_error)
+        bot->status = MSC_BOT_STATUS_PHASE_ERROR;
+    if (bot->status != MSC_BOT_STATUS_PASSED)
+        bot->stats.failed++;
+
+    put_le32(bot->csw, MSC_BOT_CSW_SIGNATURE);
+    memcpy(bot->csw + 4, bot->cbw + 4, 4);
+    put_le32(bot->csw + 8, residue);
+    bot->csw[12] = bot->status;
+
+    ret = transfer(bot, MSC_BOT_DIR_IN, bot->csw, MSC_BOT_CSW_LENGTH);
+    return (ret < 0) ? ret : 0;
+}
+
+void msc_bot_set_present(struct msc_bot *bot, int present)
+{
+    bot->present = present;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _MSC_BOT_H
+#define _MSC_BOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "msc_block.h"
+
+#define MSC_BOT_CBW_SIGNATURE (0x43425355U)
+#define MSC_BOT_CSW_SIGNATURE (0x53425355U)
+#define MSC_BOT_CBW_LENGTH (31)
+#define MSC_BOT_CSW_LENGTH (13)
+
+#define MSC_BOT_STATUS_PASSED (0x00)
+#define MSC_BOT_STATUS_FAILED (0x01)
+#define MSC_BOT_STATUS_PHASE_ERROR (0x02)
+
+#define MSC_BOT_DIR_OUT (0)
+#define MSC_BOT_DIR_IN (1)
+
+/* Memory reserved in front of data buffers for CBW and CSW, keeps data aligned */
+#define MSC_BOT_HEADER_SPACE (64)
+
+#define SCSI_TEST_UNIT_READY (0x00)
+#define SCSI_REQUEST_SENSE (0x03)
+#define SCSI_INQUIRY (0x12)
+#define SCSI_MODE_SENSE_6 (0x1A)
+#define SCSI_START_STOP_UNIT (0x1B)
+#define SCSI_PREVENT_ALLOW_MEDIUM_REMOVAL (0x1E)
+#define SCSI_READ_FORMAT_CAPACITIES (0x23)
+#define SCSI_READ_CAPACITY_10 (0x25)
+#define SCSI_READ_10 (0x28)
+#define SCSI_WRITE_10 (0x2A)
+#define SCSI_VERIFY_10 (0x2F)
+#define SCSI_SYNCHRONIZE_CACHE_10 (0x35)
+#define SCSI_MODE_SENSE_10 (0x5A)
+
+#define SCSI_SENSE_NO_SENSE (0x00)
+#define SCSI_SENSE_NOT_READY (0x02)
+#define SCSI_SENSE_MEDIUM_ERROR (0x03)
+#define SCSI_SENSE_ILLEGAL_REQUEST (0x05)
+#define SCSI_SENSE_DATA_PROTECT (0x07)
+
+#define SCSI_ASC_WRITE_ERROR (0x0C)
+#define SCSI_ASC_UNRECOVERED_READ_ERROR (0x11)
+#define SCSI_ASC_INVALID_COMMAND (0x20)
+#define SCSI_ASC_LBA_OUT_OF_RANGE (0x21)
+#define SCSI_ASC_INVALID_FIELD_IN_CDB (0x24)
+#define SCSI_ASC_WRITE_PROTECTED (0x27)
+#define SCSI_ASC_MEDIUM_NOT_PRESENT (0x3A)
+#define SCSI_ASC_MEDIUM_REMOVAL_PREVENTED (0x53)
+
+/* Bulk endpoints access. Only one transfer is started at a time and it is
+ * always followed by wait. */
+struct msc_bot_transport
+{
+    /* Start transfer to host */
+    int (*send)(void *ctx, const uint8_t *buffer, uint32_t length);
+    /* Start transfer from host */
+    int (*recv)(void *ctx, uint8_t *buffer, uint32_t length);
+    /* Block until started transfer completes, returns transferred length or
+     * negative errno, -ECONNRESET when host requested Bulk-Only reset */
+    int (*wait)(void *ctx);
+    /* Halt endpoint of given MSC_BOT_DIR_ direction, wedged endpoint
+     * ignores host clearing the halt until Bulk-Only reset */
+    int (*stall)(void *ctx, int dir, int wedge);
+};
+
+struct msc_bot_stats
+{
+    uint32_t commands;
+    uint32_t failed;        /* Commands completed with status other than passed */
+    uint32_t invalid_cbw;
+    uint64_t read_bytes;
+    uint64_t written_bytes;
+};
+
+struct msc_bot
+{
+    const struct msc_bot_transport *transport;
+    void *ctx;
+    const struct msc_block_dev *dev;
+
+    uint8_t *cbw;
+    uint8_t *csw;
+    uint8_t *data[2];       /* Disk access on one overlaps transfer of other */
+    uint32_t data_size;     /* Bytes in each data buffer, multiple of block size */
+
+    /* Strings reported by INQUIRY, padded with spaces */
+    const char *vendor;
+    const char *product;
+    const char *revision;
+
+    int present;            /* Medium is loaded, host can eject it */
+    int prevent_removal;
+    uint8_t sense_key;
+    uint8_t sense_asc;
+
+    /* Current command */
+    uint32_t host_length;
+    int host_in;
+    uint32_t transferred;
+    uint8_t status;
+    int phase_error;
+
+    struct msc_bot_stats stats;
+};
+
+/*
+ * @brief Sets up Bulk-Only Transport over block device
+ * @param memory buffer for CBW, CSW and two data buffers, has to be reachable by USB DMA
+ * @param size bytes of memory, must hold header and at least one block in each data buffer
+ * @return 0 on success, -EINVAL otherwise
+ */
+int msc_bot_init(struct msc_bot *bot, const struct msc_bot_transport *transport, void *ctx,
+        const struct msc_block_dev *dev, uint8_t *memory, size_t size);
+
+/*
+ * @brief Handles single command: receives CBW, runs data phase and sends CSW
+ * @return 0 when status was sent, -EPROTO when invalid CBW was received and
+ *         both endpoints were stalled, negative errno returned by transport
+ */
+int msc_bot_process(struct msc_bot *bot);
+
+/*
+ * @brief Marks medium as loaded or ejected
+ */
+void msc_bot_set_present(struct msc_bot *bot, int present);
+
+#endif /* _MSC_BOT_H */
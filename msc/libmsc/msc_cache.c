@@ -0,0 +1,366 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include "msc_cache.h"
+#include <string.h>
+#include <errno.h>
+
+#define LINE_UNUSED (0xFFFFFFFFU)
+
+static inline uint32_t range_mask(uint32_t first, uint32_t count)
+{
+    uint32_t mask = (count >= 32) ? 0xFFFFFFFFU : ((1U << count) - 1);
+    return mask << first;
+}
+
+static inline uint32_t popcount(uint32_t mask)
+{
+    return (uint32_t)__builtin_popcount(mask);
+}
+
+static inline uint8_t *line_data(const struct msc_cache *c, uint32_t index)
+{
+    return c->memory + (size_t)index * c->line_blocks * c->lower->block_size;
+}
+
+/* Blocks of the line which exist on device, last line may be partial */
+static uint32_t line_mask(const struct msc_cache *c, uint32_t tag)
+{
+    uint32_t first = tag * c->line_blocks;
+    uint32_t count = c->lower->block_count - first;
+
+    return range_mask(0, (count < c->line_blocks) ? count : c->line_blocks);
+}
+
+static int find(const struct msc_cache *c, uint32_t tag)
+{
+    uint32_t i;
+
+    for (i = 0; i < c->line_count; i++)
+        if (c->lines[i].tag == tag)
+            return i;
+    return -1;
+}
+
+/* Writes runs of consecutive dirty blocks */
+static int writeback(struct msc_cache *c, uint32_t index)
+{
+    struct msc_cache_line *line = &c->lines[index];
+    uint32_t bs = c->lower->block_size;
+    uint32_t first = 0;
+    int ret;
+
+    while (line->dirty >> first) {
+        uint32_t count = 0;
+
+        while (!(line->dirty & (1U << first)))
+            first++;
+        while ((first + count < c->line_blocks) && (line->dirty & (1U << (first + count))))
+            count++;
+
+        ret = msc_block_write(c->lower, line->tag * c->line_blocks + first,
+                line_data(c, index) + first * bs, count);
+        if (ret)
+            return ret;
+
+        c->stats.writebacks++;
+        line->dirty &= ~range_mask(first, count);
+        first += count;
+    }
+    return 0;
+}
+
+/* Reads blocks of mask which are not valid yet, dirty blocks are never overwritten */
+static int fill(struct msc_cache *c, uint32_t index, uint32_t mask)
+{
+    struct msc_cache_line *line = &c->lines[index];
+    uint32_t missing = mask & ~line->valid;
+    uint32_t bs = c->lower->block_size;
+    uint32_t first = 0;
+    int ret;
+
+    while (missing >> first) {
+        uint32_t count = 0;
+
+        while (!(missing & (1U << first)))
+            first++;
+        while ((first + count < c->line_blocks) && (missing & (1U << (first + count))))
+            count++;
+
+        ret = msc_block_read(c->lower, line->tag * c->line_blocks + first,
+                line_data(c, index) + first * bs, count);
+        if (ret)
+            return ret;
+
+        line->valid |= range_mask(first, count);
+        first += count;
+    }
+    return 0;
+}
+
+static int allocate(struct msc_cache *c, uint32_t tag)
+{
+    uint32_t victim = 0;
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < c->line_count; i++) {
+        if (c->lines[i].tag == LINE_UNUSED) {
+            victim = i;
+            break;
+        }
+        if (c->lines[i].age < c->lines[victim].age)
+            victim = i;
+    }
+
+    ret = writeback(c, victim);
+    if (ret)
+        return ret;
+
+    c->lines[victim].tag = tag;
+    c->lines[victim].valid = 0;
+    c->lines[victim].dirty = 0;
+    c->lines[victim].age = ++c->clock;
+    return victim;
+}
+
+/* Counts lines from tag on, which are requested whole and not cached, they bypass cache */
+static uint32_t uncached_lines(const struct msc_cache *c, uint32_t tag, uint32_t count)
+{
+    uint32_t lines = 0;
+
+    while ((count >= c->line_blocks) && (find(c, tag + lines) < 0)) {
+        lines++;
+        count -= c->line_blocks;
+    }
+    return lines;
+}
+
+static void prefetch(struct msc_cache *c, uint32_t tag)
+{
+    int index;
+
+    if ((tag * c->line_blocks >= c->lower->block_count) || (find(c, tag) >= 0))
+        return;
+
+    index = allocate(c, tag);
+    if (index < 0)
+        return;
+
+    if (fill(c, index, line_mask(c, tag)) == 0)
+        c->stats.prefetched += popcount(c->lines[index].valid);
+}
+
+static int cache_read(void *ctx, uint32_t lba, uint8_t *buffer, uint32_t count)
+{
+    struct msc_cache *c = ctx;
+    uint32_t bs = c->lower->block_size;
+    int sequential = (lba == c->next_lba);
+    int ret;
+
+    if ((lba >= c->lower->block_count) || (count > c->lower->block_count - lba))
+        return -EINVAL;
+
+    c->next_lba = lba + count;
+
+    while (count) {
+        uint32_t tag = lba / c->line_blocks;
+        uint32_t offset = lba % c->line_blocks;
+        uint32_t n = c->line_blocks - offset;
+        uint32_t want, fill_mask;
+        int index;
+
+        if (offset == 0) {
+            uint32_t lines = uncached_lines(c, tag, count);
+            if (lines) {
+                n = lines * c->line_blocks;
+                ret = msc_block_read(c->lower, lba, buffer, n);
+                if (ret)
+                    return ret;
+                c->stats.read_misses += n;
+                goto next;
+            }
+        }
+
+        if (n > count)
+            n = count;
+
+        index = find(c, tag);
+        if (index < 0) {
+            index = allocate(c, tag);
+            if (index < 0)
+                return index;
+        }
+        c->lines[index].age = ++c->clock;
+
+        want = range_mask(offset, n);
+        fill_mask = (c->flags & MSC_CACHE_READ_AHEAD) ? line_mask(c, tag) : want;
+
+        c->stats.read_hits += popcount(want & c->lines[index].valid);
+        c->stats.read_misses += popcount(want & ~c->lines[index].valid);
+        c->stats.prefetched += popcount(fill_mask & ~want & ~c->lines[index].valid);
+
+        ret = fill(c, index, fill_mask);
+        if (ret)
+            return ret;
+
+        memcpy(buffer, line_data(c, index) + offset * bs, n * bs);
+next:
+        lba += n;
+        buffer += n * bs;
+        count -= n;
+    }
+
+    if ((c->flags & MSC_CACHE_READ_AHEAD) && sequential)
+        prefetch(c, (c->next_lba + c->line_blocks - 1) / c->line_blocks);
+
+    return 0;
+}
+
+static int cache_write(void *ctx, uint32_t lba, const uint8_t *buffer, uint32_t count)
+{
+    struct msc_cache *c = ctx;
+    uint32_t bs = c->lower->block_size;
+    int write_back = c->flags & MSC_CACHE_WRITE_BACK;
+    int ret;
+
+    if ((lba >= c->lower->block_count) || (count > c->lower->block_count - lba))
+        return -EINVAL;
+
+    if (!write_back) {
+        ret = msc_block_write(c->lower, lba, buffer, count);
+        if (ret)
+            return ret;
+        c->stats.writebacks++;
+    }
+
+    while (count) {
+        uint32_t tag = lba / c->line_blocks;
+        uint32_t offset = lba % c->line_blocks;
+        uint32_t n = c->line_blocks - offset;
+        uint32_t mask;
+        int index;
+
+        /* Streams of whole lines gain nothing from caching, only small
+         * scattered writes (allocation tables, directories) do */
+        if (write_back && (offset == 0)) {
+            uint32_t lines = uncached_lines(c, tag, count);
+            if (lines) {
+                n = lines * c->line_blocks;
+                ret = msc_block_write(c->lower, lba, buffer, n);
+                if (ret)
+                    return ret;
+                c->stats.writebacks++;
+                goto next;
+            }
+        }
+
+        if (n > count)
+            n = count;
+        mask = range_mask(offset, n);
+
+        index = find(c, tag);
+        if (index >= 0) {
+            c->stats.write_hits += n;
+        } else if (write_back) {
+            index = allocate(c, tag);
+            if (index < 0)
+                return index;
+        } else {
+            goto next;
+        }
+
+        c->lines[index].age = ++c->clock;
+        memcpy(line_data(c, index) + offset * bs, buffer, n * bs);
+        c->lines[index].valid |= mask;
+        if (write_back)
+            c->lines[index].dirty |= mask;
+next:
+        lba += n;
+        buffer += n * bs;
+        count -= n;
+    }
+    return 0;
+}
+
+static int cache_flush(void *ctx)
+{
+    return msc_cache_flush(ctx);
+}
+
+static const struct msc_block_ops cache_ops = {
+    .read = cache_read,
+    .write = cache_write,
+    .flush = cache_flush,
+};
+
+int msc_cache_init(struct msc_cache *cache, const struct msc_block_dev *lower,
+        uint8_t *memory, size_t size, uint32_t line_blocks, int flags)
+{
+    size_t line_size;
+
+    if (!lower || !memory || (lower->block_size == 0) || (line_blocks == 0) ||
+        (line_blocks > MSC_CACHE_MAX_LINE_BLOCKS) || (line_blocks & (line_blocks - 1)))
+        return -EINVAL;
+
+    line_size = (size_t)line_blocks * lower->block_size;
+    if (size < 2 * line_size)
+        return -EINVAL;
+
+    cache->lower = lower;
+    cache->flags = flags;
+    cache->memory = memory;
+    cache->line_blocks = line_blocks;
+    cache->line_count = size / line_size;
+    if (cache->line_count > MSC_CACHE_MAX_LINES)
+        cache->line_count = MSC_CACHE_MAX_LINES;
+
+    cache->dev.ops = &cache_ops;
+    cache->dev.ctx = cache;
+    cache->dev.block_size = lower->block_size;
+    cache->dev.block_count = lower->block_count;
+    cache->dev.read_only = lower->read_only;
+
+    cache->stats = (struct msc_cache_stats){ 0 };
+    msc_cache_invalidate(cache);
+    return 0;
+}
+
+int msc_cache_flush(struct msc_cache *cache)
+{
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < cache->line_count; i++) {
+        ret = writeback(cache, i);
+        if (ret)
+            return ret;
+    }
+    return msc_block_flush(cache->lower);
+}
+
+void msc_cache_invalidate(struct msc_cache *cache)
+{
+    uint32_t i;
+
+    for (i = 0; i < cache->line_count; i++) {
+        cache->lines[i].tag = LINE_UNUSED;
+        cache->lines[i].valid = 0;
+        cache->lines[i].dirty = 0;
+        cache->lines[i].age = 0;
+    }
+    cache->clock = 0;
+    cache->next_lba = LINE_UNUSED;
+}
+
+uint32_t msc_cache_dirty_count(const struct msc_cache *cache)
+{
+    uint32_t count = 0;
+    uint32_t i;
+
+    for (i = 0; i < cache->line_count; i++)
+        count += popcount(cache->lines[i].dirty);
+    return count;
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _MSC_CACHE_H
+#define _MSC_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "msc_block.h"
+
+/* Upper bound of cache lines, memory passed to msc_cache_init beyond it is unused */
+#ifndef MSC_CACHE_MAX_LINES
+#define MSC_CACHE_MAX_LINES (32)
+#endif
+
+/* Line is a group of consecutive blocks, tracked with 32 bit masks */
+#define MSC_CACHE_MAX_LINE_BLOCKS (32)
+
+/* Write-back: writes are acknowledged once cached and reach the medium on
+ * eviction or flush. Without it writes go straight through. */
+#define MSC_CACHE_WRITE_BACK (1 << 0)
+/* Read-ahead: a miss loads whole line, sequential reads prefetch next line */
+#define MSC_CACHE_READ_AHEAD (1 << 1)
+
+struct msc_cache_line
+{
+    uint32_t tag;       /* First block of the line divided by line size */
+    uint32_t valid;     /* Bit per block holding medium or newer data */
+    uint32_t dirty;     /* Bit per block not yet written to medium */
+    uint32_t age;       /* Last access stamp, least recent is evicted */
+};
+
+struct msc_cache_stats
+{
+    uint32_t read_hits;     /* Blocks served from cache */
+    uint32_t read_misses;   /* Blocks read from medium on behalf of host */
+    uint32_t prefetched;    /* Blocks read ahead of host requests */
+    uint32_t write_hits;    /* Blocks absorbed by already cached line */
+    uint32_t writebacks;    /* Write operations issued to medium */
+};
+
+struct msc_cache
+{
+    struct msc_block_dev dev;           /* Cached view, pass it to users */
+    const struct msc_block_dev *lower;
+    int flags;
+    uint8_t *memory;
+    uint32_t line_blocks;
+    uint32_t line_count;
+    uint32_t clock;
+    uint32_t next_lba;                  /* Expected start of sequential read */
+    struct msc_cache_line lines[MSC_CACHE_MAX_LINES];
+    struct msc_cache_stats stats;
+};
+
+/*
+ * @brief Sets up cache in front of block device
+ * @param memory storage for cached blocks, split into lines
+ * @param line_blocks blocks per line, power of two up to MSC_CACHE_MAX_LINE_BLOCKS
+ * @param flags MSC_CACHE_WRITE_BACK and MSC_CACHE_READ_AHEAD
+ * @return 0 on success, -EINVAL if memory can't hold at least two lines
+ */
+int msc_cache_init(struct msc_cache *cache, const struct msc_block_dev *lower,
+        uint8_t *memory, size_t size, uint32_t line_blocks, int flags);
+
+/*
+ * @brief Block device backed by the cache, flush writes back dirty blocks
+ */
+static inline const struct msc_block_dev *msc_cache_device(const struct msc_cache *cache)
+{
+    return &cache->dev;
+}
+
+/*
+ * @brief Writes back dirty blocks and flushes lower device
+ */
+int msc_cache_flush(struct msc_cache *cache);
+
+/*
+ * @brief Drops all cached blocks, dirty ones are lost
+ */
+void msc_cache_invalidate(struct msc_cache *cache);
+
+/*
+ * @return number of blocks waiting to be written back
+ */
+uint32_t msc_cache_dirty_count(const struct msc_cache *cache);
+
+#endif /* _MSC_CACHE_H */
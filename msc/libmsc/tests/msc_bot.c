@@ -0,0 +1,349 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <string.h>
+#include <errno.h>
+#include "msc_bot.h"
+
+#define BLOCK_SIZE (512)
+#define BLOCK_COUNT (64)
+#define DATA_SIZE (4 * BLOCK_SIZE)
+
+static uint8_t disk[BLOCK_COUNT * BLOCK_SIZE];
+static int disk_fail;
+
+static int disk_read(void *ctx, uint32_t lba, uint8_t *buffer, uint32_t count)
+{
+    (void)ctx;
+    if (disk_fail)
+        return -EIO;
+    memcpy(buffer, disk + lba * BLOCK_SIZE, count * BLOCK_SIZE);
+    return 0;
+}
+
+static int disk_write(void *ctx, uint32_t lba, const uint8_t *buffer, uint32_t count)
+{
+    (void)ctx;
+    if (disk_fail)
+        return -EIO;
+    memcpy(disk + lba * BLOCK_SIZE, buffer, count * BLOCK_SIZE);
+    return 0;
+}
+
+static const struct msc_block_ops disk_ops = {
+    .read = disk_read,
+    .write = disk_write,
+};
+
+static struct msc_block_dev ram = {
+    .ops = &disk_ops,
+    .block_size = BLOCK_SIZE,
+    .block_count = BLOCK_COUNT,
+};
+
+/* Simulated host: OUT stream is scripted, IN stream is recorded */
+static uint8_t host_out[4 * DATA_SIZE];
+static uint32_t host_out_length, host_out_offset;
+static uint8_t host_in[4 * DATA_SIZE];
+static uint32_t host_in_length;
+static int started;
+static int result;
+static int stalled[2];
+
+static int ep_send(void *ctx, const uint8_t *buffer, uint32_t length)
+{
+    (void)ctx;
+    if (started)
+        return -EBUSY;
+    memcpy(host_in + host_in_length, buffer, length);
+    host_in_length += length;
+    result = length;
+    started = 1;
+    return 0;
+}
+
+static int ep_recv(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    uint32_t available = host_out_length - host_out_offset;
+
+    (void)ctx;
+    if (started)
+        return -EBUSY;
+    if (available == 0) {
+        result = -ECONNRESET;
+    } else {
+        if (length > available)
+            length = available;
+        memcpy(buffer, host_out + host_out_offset, length);
+        host_out_offset += length;
+        result = length;
+    }
+    started = 1;
+    return 0;
+}
+
+static int ep_wait(void *ctx)
+{
+    (void)ctx;
+    started = 0;
+    return result;
+}
+
+static int ep_stall(void *ctx, int dir, int wedge)
+{
+    (void)ctx;
+    stalled[dir] = wedge ? 2 : 1;
+    return 0;
+}
+
+static const struct msc_bot_transport transport = {
+    .send = ep_send,
+    .recv = ep_recv,
+    .wait = ep_wait,
+    .stall = ep_stall,
+};
+
+static uint8_t memory[MSC_BOT_HEADER_SPACE + 2 * DATA_SIZE];
+static struct msc_bot bot;
+
+static void put_le32(uint8_t *buffer, uint32_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t get_le32(const uint8_t *buffer)
+{
+    return buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+static void host_cbw(uint32_t length, int in, const uint8_t *cb, uint8_t cb_length)
+{
+    uint8_t *cbw = host_out + host_out_length;
+
+    memset(cbw, 0, MSC_BOT_CBW_LENGTH);
+    put_le32(cbw, MSC_BOT_CBW_SIGNATURE);
+    put_le32(cbw + 4, 0x1234);
+    put_le32(cbw + 8, length);
+    cbw[12] = in ? 0x80 : 0x00;
+    cbw[14] = cb_length;
+    memcpy(cbw + 15, cb, cb_length);
+    host_out_length += MSC_BOT_CBW_LENGTH;
+}
+
+static void host_data(const uint8_t *data, uint32_t length)
+{
+    memcpy(host_out + host_out_length, data, length);
+    host_out_length += length;
+}
+
+/* CSW is always last thing sent to host */
+static const uint8_t *csw(void)
+{
+    return host_in + host_in_length - MSC_BOT_CSW_LENGTH;
+}
+
+static uint8_t request_sense_key(void)
+{
+    static const uint8_t cb[6] = { SCSI_REQUEST_SENSE, 0, 0, 0, 18, 0 };
+
+    host_in_length = 0;
+    host_cbw(18, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    return host_in[2];
+}
+
+Describe(msc_bot);
+
+BeforeEach(msc_bot)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLOCK_COUNT; i++)
+        memset(disk + i * BLOCK_SIZE, i, BLOCK_SIZE);
+    disk_fail = 0;
+    ram.read_only = 0;
+    host_out_length = host_out_offset = 0;
+    host_in_length = 0;
+    started = 0;
+    stalled[0] = stalled[1] = 0;
+    assert_that(msc_bot_init(&bot, &transport, NULL, &ram, memory, sizeof(memory)), is_equal_to(0));
+    bot.vendor = "Mudita";
+    bot.product = "Pure";
+    bot.revision = "1.0";
+}
+
+AfterEach(msc_bot)
+{
+}
+
+Ensure(msc_bot, init_splits_memory_into_block_aligned_buffers)
+{
+    assert_that(bot.data_size, is_equal_to(DATA_SIZE));
+    assert_that(bot.data[1] - bot.data[0], is_equal_to(DATA_SIZE));
+    assert_that(msc_bot_init(&bot, &transport, NULL, &ram, memory, MSC_BOT_HEADER_SPACE + BLOCK_SIZE),
+            is_equal_to(-EINVAL));
+}
+
+Ensure(msc_bot, inquiry)
+{
+    static const uint8_t cb[6] = { SCSI_INQUIRY, 0, 0, 0, 36, 0 };
+
+    host_cbw(36, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(host_in_length, is_equal_to(36 + MSC_BOT_CSW_LENGTH));
+    assert_that(host_in[1], is_equal_to(0x80));
+    assert_that(host_in + 8, is_equal_to_contents_of("Mudita  Pure            1.0 ", 28));
+    assert_that(get_le32(csw()), is_equal_to(MSC_BOT_CSW_SIGNATURE));
+    assert_that(get_le32(csw() + 4), is_equal_to(0x1234));
+    assert_that(get_le32(csw() + 8), is_equal_to(0));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_PASSED));
+}
+
+Ensure(msc_bot, read_capacity)
+{
+    static const uint8_t cb[10] = { SCSI_READ_CAPACITY_10 };
+    static const uint8_t expected[8] = { 0, 0, 0, BLOCK_COUNT - 1, 0, 0, 0x02, 0x00 };
+
+    host_cbw(8, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(host_in, is_equal_to_contents_of(expected, 8));
+}
+
+Ensure(msc_bot, read_streams_through_both_buffers)
+{
+    static const uint8_t cb[10] = { SCSI_READ_10, 0, 0, 0, 0, 2, 0, 0, 10, 0 };
+
+    host_cbw(10 * BLOCK_SIZE, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(host_in_length, is_equal_to(10 * BLOCK_SIZE + MSC_BOT_CSW_LENGTH));
+    assert_that(host_in, is_equal_to_contents_of(disk + 2 * BLOCK_SIZE, 10 * BLOCK_SIZE));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_PASSED));
+    assert_that(bot.stats.read_bytes, is_equal_to(10 * BLOCK_SIZE));
+}
+
+Ensure(msc_bot, write_streams_to_medium)
+{
+    static const uint8_t cb[10] = { SCSI_WRITE_10, 0, 0, 0, 0, 5, 0, 0, 9, 0 };
+    static uint8_t data[9 * BLOCK_SIZE];
+
+    memset(data, 0xA5, sizeof(data));
+    host_cbw(sizeof(data), 0, cb, sizeof(cb));
+    host_data(data, sizeof(data));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(disk + 5 * BLOCK_SIZE, is_equal_to_contents_of(data, sizeof(data)));
+    assert_that(disk[14 * BLOCK_SIZE], is_equal_to(14));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_PASSED));
+}
+
+Ensure(msc_bot, invalid_cbw_stalls_both_endpoints)
+{
+    static const uint8_t cb[6] = { SCSI_TEST_UNIT_READY };
+
+    host_cbw(0, 0, cb, sizeof(cb));
+    host_out[0] = 0;
+    assert_that(msc_bot_process(&bot), is_equal_to(-EPROTO));
+    assert_that(stalled[MSC_BOT_DIR_IN], is_equal_to(2));
+    assert_that(stalled[MSC_BOT_DIR_OUT], is_equal_to(2));
+    assert_that(host_in_length, is_equal_to(0));
+}
+
+Ensure(msc_bot, unknown_command_fails_with_illegal_request)
+{
+    static const uint8_t cb[6] = { 0xEE };
+
+    host_cbw(0, 0, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_FAILED));
+    assert_that(request_sense_key(), is_equal_to(SCSI_SENSE_ILLEGAL_REQUEST));
+    assert_that(host_in[12], is_equal_to(SCSI_ASC_INVALID_COMMAND));
+    assert_that(request_sense_key(), is_equal_to(SCSI_SENSE_NO_SENSE));
+}
+
+Ensure(msc_bot, short_response_stalls_in_and_reports_residue)
+{
+    static const uint8_t cb[6] = { SCSI_INQUIRY, 0, 0, 0, 36, 0 };
+
+    host_cbw(64, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(stalled[MSC_BOT_DIR_IN], is_true);
+    assert_that(get_le32(csw() + 8), is_equal_to(28));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_PASSED));
+}
+
+Ensure(msc_bot, direction_mismatch_is_phase_error)
+{
+    static const uint8_t cb[10] = { SCSI_READ_10, 0, 0, 0, 0, 0, 0, 0, 1, 0 };
+
+    host_cbw(BLOCK_SIZE, 0, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(stalled[MSC_BOT_DIR_OUT], is_true);
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_PHASE_ERROR));
+}
+
+Ensure(msc_bot, write_protected_medium_rejects_write)
+{
+    static const uint8_t cb[10] = { SCSI_WRITE_10, 0, 0, 0, 0, 0, 0, 0, 1, 0 };
+
+    ram.read_only = 1;
+    host_cbw(BLOCK_SIZE, 0, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(stalled[MSC_BOT_DIR_OUT], is_true);
+    assert_that(get_le32(csw() + 8), is_equal_to(BLOCK_SIZE));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_FAILED));
+    assert_that(request_sense_key(), is_equal_to(SCSI_SENSE_DATA_PROTECT));
+}
+
+Ensure(msc_bot, mode_sense_reports_write_protection)
+{
+    static const uint8_t cb[6] = { SCSI_MODE_SENSE_6, 0, 0x3F, 0, 4, 0 };
+
+    ram.read_only = 1;
+    host_cbw(4, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(host_in[2], is_equal_to(0x80));
+}
+
+Ensure(msc_bot, read_past_end_fails)
+{
+    static const uint8_t cb[10] = { SCSI_READ_10, 0, 0, 0, 0, BLOCK_COUNT - 1, 0, 0, 2, 0 };
+
+    host_cbw(2 * BLOCK_SIZE, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(host_in_length, is_equal_to(MSC_BOT_CSW_LENGTH));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_FAILED));
+    assert_that(request_sense_key(), is_equal_to(SCSI_SENSE_ILLEGAL_REQUEST));
+}
+
+Ensure(msc_bot, medium_error_ends_data_phase)
+{
+    static const uint8_t cb[10] = { SCSI_READ_10, 0, 0, 0, 0, 0, 0, 0, 2, 0 };
+
+    disk_fail = 1;
+    host_cbw(2 * BLOCK_SIZE, 1, cb, sizeof(cb));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(stalled[MSC_BOT_DIR_IN], is_true);
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_FAILED));
+    disk_fail = 0;
+    assert_that(request_sense_key(), is_equal_to(SCSI_SENSE_MEDIUM_ERROR));
+}
+
+Ensure(msc_bot, ejected_medium_is_not_ready)
+{
+    static const uint8_t eject[6] = { SCSI_START_STOP_UNIT, 0, 0, 0, 0x02, 0 };
+    static const uint8_t tur[6] = { SCSI_TEST_UNIT_READY };
+
+    host_cbw(0, 0, eject, sizeof(eject));
+    host_cbw(0, 0, tur, sizeof(tur));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(msc_bot_process(&bot), is_equal_to(0));
+    assert_that(csw()[12], is_equal_to(MSC_BOT_STATUS_FAILED));
+    assert_that(request_sense_key(), is_equal_to(SCSI_SENSE_NOT_READY));
+}
+
+Ensure(msc_bot, transport_reset_aborts_command)
+{
+    assert_that(msc_bot_process(&bot), is_equal_to(-ECONNRESET));
+}
@@ -0,0 +1,242 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include <string.h>
+#include <errno.h>
+#include "msc_cache.h"
+
+#define BLOCK_SIZE (512)
+#define BLOCK_COUNT (98)
+#define LINE_BLOCKS (4)
+#define LINES (4)
+
+/* RAM disk counting operations reaching the medium */
+static uint8_t disk[BLOCK_COUNT * BLOCK_SIZE];
+static int reads, writes, flushes;
+static uint32_t written_blocks;
+
+static int disk_read(void *ctx, uint32_t lba, uint8_t *buffer, uint32_t count)
+{
+    (void)ctx;
+    reads++;
+    memcpy(buffer, disk + lba * BLOCK_SIZE, count * BLOCK_SIZE);
+    return 0;
+}
+
+static int disk_write(void *ctx, uint32_t lba, const uint8_t *buffer, uint32_t count)
+{
+    (void)ctx;
+    writes++;
+    written_blocks += count;
+    memcpy(disk + lba * BLOCK_SIZE, buffer, count * BLOCK_SIZE);
+    return 0;
+}
+
+static int disk_flush(void *ctx)
+{
+    (void)ctx;
+    flushes++;
+    return 0;
+}
+
+static const struct msc_block_ops disk_ops = {
+    .read = disk_read,
+    .write = disk_write,
+    .flush = disk_flush,
+};
+
+static const struct msc_block_dev ram = {
+    .ops = &disk_ops,
+    .block_size = BLOCK_SIZE,
+    .block_count = BLOCK_COUNT,
+};
+
+static uint8_t memory[LINES * LINE_BLOCKS * BLOCK_SIZE];
+static struct msc_cache cache;
+static const struct msc_block_dev *dev;
+static uint8_t buffer[16 * BLOCK_SIZE];
+
+static void fill_disk(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLOCK_COUNT; i++)
+        memset(disk + i * BLOCK_SIZE, i, BLOCK_SIZE);
+}
+
+static void setup(int flags)
+{
+    assert_that(msc_cache_init(&cache, &ram, memory, sizeof(memory), LINE_BLOCKS, flags), is_equal_to(0));
+    dev = msc_cache_device(&cache);
+    reads = writes = flushes = 0;
+    written_blocks = 0;
+}
+
+Describe(msc_cache);
+
+BeforeEach(msc_cache)
+{
+    fill_disk();
+    setup(MSC_CACHE_WRITE_BACK | MSC_CACHE_READ_AHEAD);
+}
+
+AfterEach(msc_cache)
+{
+}
+
+Ensure(msc_cache, init_rejects_memory_for_single_line)
+{
+    assert_that(msc_cache_init(&cache, &ram, memory, LINE_BLOCKS * BLOCK_SIZE, LINE_BLOCKS, 0),
+            is_equal_to(-EINVAL));
+    assert_that(msc_cache_init(&cache, &ram, memory, sizeof(memory), 3, 0), is_equal_to(-EINVAL));
+}
+
+Ensure(msc_cache, device_mirrors_lower_geometry)
+{
+    assert_that(dev->block_size, is_equal_to(BLOCK_SIZE));
+    assert_that(dev->block_count, is_equal_to(BLOCK_COUNT));
+}
+
+Ensure(msc_cache, miss_loads_whole_line_with_read_ahead)
+{
+    assert_that(msc_block_read(dev, 1, buffer, 1), is_equal_to(0));
+    assert_that(buffer[0], is_equal_to(1));
+    assert_that(reads, is_equal_to(1));
+
+    assert_that(msc_block_read(dev, 3, buffer, 1), is_equal_to(0));
+    assert_that(buffer[0], is_equal_to(3));
+    assert_that(reads, is_equal_to(1));
+    assert_that(cache.stats.read_hits, is_equal_to(1));
+}
+
+Ensure(msc_cache, miss_loads_requested_blocks_only_without_read_ahead)
+{
+    setup(MSC_CACHE_WRITE_BACK);
+
+    msc_block_read(dev, 1, buffer, 1);
+    msc_block_read(dev, 3, buffer, 1);
+    assert_that(reads, is_equal_to(2));
+    assert_that(cache.stats.prefetched, is_equal_to(0));
+}
+
+Ensure(msc_cache, sequential_reads_prefetch_next_line)
+{
+    msc_block_read(dev, 0, buffer, 2);
+    msc_block_read(dev, 2, buffer, 2);
+
+    assert_that(msc_block_read(dev, 4, buffer, 4), is_equal_to(0));
+    assert_that(buffer[0], is_equal_to(4));
+    assert_that(buffer[3 * BLOCK_SIZE], is_equal_to(7));
+    assert_that(cache.stats.read_misses, is_equal_to(2));
+    assert_that(cache.stats.read_hits, is_equal_to(6));
+}
+
+Ensure(msc_cache, whole_uncached_lines_bypass_cache)
+{
+    assert_that(msc_block_read(dev, 8, buffer, 12), is_equal_to(0));
+    assert_that(reads, is_equal_to(1));
+    assert_that(buffer[11 * BLOCK_SIZE], is_equal_to(19));
+}
+
+Ensure(msc_cache, write_back_delays_medium_write)
+{
+    memset(buffer, 0xAA, BLOCK_SIZE);
+    assert_that(msc_block_write(dev, 5, buffer, 1), is_equal_to(0));
+    assert_that(writes, is_equal_to(0));
+    assert_that(msc_cache_dirty_count(&cache), is_equal_to(1));
+
+    memset(buffer, 0, BLOCK_SIZE);
+    msc_block_read(dev, 5, buffer, 1);
+    assert_that(buffer[0], is_equal_to(0xAA));
+    assert_that(disk[5 * BLOCK_SIZE], is_equal_to(5));
+}
+
+Ensure(msc_cache, flush_coalesces_adjacent_dirty_blocks)
+{
+    memset(buffer, 0xBB, 2 * BLOCK_SIZE);
+    msc_block_write(dev, 4, buffer, 1);
+    msc_block_write(dev, 5, buffer, 1);
+    msc_block_write(dev, 7, buffer, 1);
+
+    assert_that(msc_cache_flush(&cache), is_equal_to(0));
+    assert_that(writes, is_equal_to(2));
+    assert_that(written_blocks, is_equal_to(3));
+    assert_that(flushes, is_equal_to(1));
+    assert_that(msc_cache_dirty_count(&cache), is_equal_to(0));
+    assert_that(disk[7 * BLOCK_SIZE], is_equal_to(0xBB));
+    assert_that(disk[6 * BLOCK_SIZE], is_equal_to(6));
+}
+
+Ensure(msc_cache, repeated_writes_to_same_block_reach_medium_once)
+{
+    int i;
+
+    for (i = 0; i < 10; i++) {
+        memset(buffer, i, BLOCK_SIZE);
+        msc_block_write(dev, 9, buffer, 1);
+    }
+    msc_cache_flush(&cache);
+    assert_that(writes, is_equal_to(1));
+    assert_that(disk[9 * BLOCK_SIZE], is_equal_to(9));
+    assert_that(cache.stats.write_hits, is_equal_to(9));
+}
+
+Ensure(msc_cache, eviction_writes_back_least_recently_used_line)
+{
+    memset(buffer, 0xCC, BLOCK_SIZE);
+    msc_block_write(dev, 0, buffer, 1);
+    msc_block_read(dev, 4, buffer, 1);
+    msc_block_read(dev, 8, buffer, 1);
+    msc_block_read(dev, 12, buffer, 1);
+    msc_block_read(dev, 4, buffer, 1);
+    assert_that(writes, is_equal_to(0));
+
+    msc_block_read(dev, 40, buffer, 1);
+    assert_that(writes, is_equal_to(1));
+    assert_that(disk[0], is_equal_to(0xCC));
+}
+
+Ensure(msc_cache, miss_does_not_overwrite_dirty_blocks)
+{
+    memset(buffer, 0xDD, BLOCK_SIZE);
+    msc_block_write(dev, 13, buffer, 1);
+
+    msc_block_read(dev, 12, buffer, 4);
+    assert_that(buffer[0], is_equal_to(12));
+    assert_that(buffer[BLOCK_SIZE], is_equal_to(0xDD));
+    assert_that(buffer[2 * BLOCK_SIZE], is_equal_to(14));
+}
+
+Ensure(msc_cache, write_through_updates_medium_and_cached_copy)
+{
+    setup(MSC_CACHE_READ_AHEAD);
+
+    msc_block_read(dev, 20, buffer, 1);
+    memset(buffer, 0xEE, BLOCK_SIZE);
+    assert_that(msc_block_write(dev, 21, buffer, 1), is_equal_to(0));
+    assert_that(writes, is_equal_to(1));
+    assert_that(disk[21 * BLOCK_SIZE], is_equal_to(0xEE));
+    assert_that(msc_cache_dirty_count(&cache), is_equal_to(0));
+
+    msc_block_read(dev, 21, buffer, 1);
+    assert_that(cache.stats.read_hits, is_equal_to(1));
+    assert_that(buffer[0], is_equal_to(0xEE));
+}
+
+Ensure(msc_cache, last_partial_line_is_not_read_past_device_end)
+{
+    assert_that(msc_block_read(dev, 95, buffer, 3), is_equal_to(0));
+    assert_that(buffer[2 * BLOCK_SIZE], is_equal_to(97));
+    assert_that(cache.stats.prefetched, is_equal_to(3));
+    assert_that(msc_block_read(dev, 97, buffer, 2), is_equal_to(-EINVAL));
+}
+
+Ensure(msc_cache, invalidate_drops_dirty_blocks)
+{
+    memset(buffer, 0x11, BLOCK_SIZE);
+    msc_block_write(dev, 2, buffer, 1);
+    msc_cache_invalidate(&cache);
+    msc_cache_flush(&cache);
+    assert_that(writes, is_equal_to(0));
+    assert_that(disk[2 * BLOCK_SIZE], is_equal_to(2));
+}
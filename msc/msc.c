@@ -0,0 +1,394 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#include "usb.h"
+#include "usb_device.h"
+#include "usb_device_class.h"
+#include "usb_device_msc.h"
+#include "usb_device_descriptor.h"
+#include "usb_string_descriptor.h"
+#include "composite.h"
+#include "msc.h"
+#include "log.hpp"
+
+#include <errno.h>
+
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+
+#define UNUSED(x) do { (void)(x); } while (0)
+
+#define MSC_TASK_STACK_SIZE (2U * 1024U)
+
+/* Transfer timeout slice, task checks for detach and termination in between */
+#define MSC_WAIT_SLICE_MS (100)
+
+/* CBW is received into the first half of the header space, it must not share a cache line with CSW */
+#if ((MSC_BOT_HEADER_SPACE / 2) % USB_DATA_ALIGN_SIZE) != 0
+#error MSC_BOT_HEADER_SPACE halves have to be multiples of USB_DATA_ALIGN_SIZE.
+#endif
+
+/* CBW, CSW and two data buffers, see msc_bot_init() */
+USB_DMA_NONINIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+static uint8_t s_botBuffer[MSC_BOT_HEADER_SPACE + 2U * USB_DATA_ALIGN_SIZE_MULTIPLE(USB_MSC_TRANSFER_BUFFER_SIZE)];
+
+/* Disk image is accessed by CPU only, cache does not need DMA reachable memory */
+static uint8_t s_cacheMemory[USB_MSC_CACHE_SIZE];
+
+static int ImageRead(void *ctx, uint32_t lba, uint8_t *buffer, uint32_t count)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+
+    if (fseek(mscApp->image, (long)lba * USB_MSC_BLOCK_SIZE, SEEK_SET) != 0) {
+        return -EIO;
+    }
+    if (fread(buffer, USB_MSC_BLOCK_SIZE, count, mscApp->image) != count) {
+        return -EIO;
+    }
+    return 0;
+}
+
+static int ImageWrite(void *ctx, uint32_t lba, const uint8_t *buffer, uint32_t count)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+
+    if (fseek(mscApp->image, (long)lba * USB_MSC_BLOCK_SIZE, SEEK_SET) != 0) {
+        return -EIO;
+    }
+    if (fwrite(buffer, USB_MSC_BLOCK_SIZE, count, mscApp->image) != count) {
+        return -EIO;
+    }
+    return 0;
+}
+
+static int ImageFlush(void *ctx)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+
+    return (fflush(mscApp->image) == 0) ? 0 : -EIO;
+}
+
+static const struct msc_block_ops s_imageOps = {
+    .read  = ImageRead,
+    .write = ImageWrite,
+    .flush = ImageFlush,
+};
+
+static int OpenImage(usb_msc_struct_t *mscApp, const usb_msc_config_t *config)
+{
+    long size;
+
+    mscApp->disk.ops        = &s_imageOps;
+    mscApp->disk.ctx        = mscApp;
+    mscApp->disk.block_size = USB_MSC_BLOCK_SIZE;
+
+    if ((config == NULL) || (config->imagePath == NULL)) {
+        return -ENOENT;
+    }
+
+    if ((mscApp->image = fopen(config->imagePath, config->readOnly ? "rb" : "r+b")) == NULL) {
+        log_error("[MSC] Unable to open disk image %s", config->imagePath);
+        return -ENOENT;
+    }
+
+    if ((fseek(mscApp->image, 0, SEEK_END) != 0) || ((size = ftell(mscApp->image)) < (long)USB_MSC_BLOCK_SIZE)) {
+        log_error("[MSC] Disk image %s is empty", config->imagePath);
+        fclose(mscApp->image);
+        mscApp->image = NULL;
+        return -EINVAL;
+    }
+
+    mscApp->disk.block_count = (uint32_t)(size / USB_MSC_BLOCK_SIZE);
+    mscApp->disk.read_only   = config->readOnly;
+    return 0;
+}
+
+static int OpSend(void *ctx, const uint8_t *buffer, uint32_t length)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+
+    /* Drop completion of transfer abandoned on reset */
+    xSemaphoreTake(mscApp->done, 0);
+    mscApp->pending = 1;
+    if (USB_DeviceMscSend(mscApp->classHandle, USB_MSC_BULK_IN_ENDPOINT, (uint8_t *)buffer, length) !=
+        kStatus_USB_Success) {
+        mscApp->pending = 0;
+        return -EIO;
+    }
+    return 0;
+}
+
+static int OpRecv(void *ctx, uint8_t *buffer, uint32_t length)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+
+    xSemaphoreTake(mscApp->done, 0);
+    mscApp->pending = 1;
+    if (USB_DeviceMscRecv(mscApp->classHandle, USB_MSC_BULK_OUT_ENDPOINT, buffer, length) != kStatus_USB_Success) {
+        mscApp->pending = 0;
+        return -EIO;
+    }
+    return 0;
+}
+
+static int OpWait(void *ctx)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+
+    while (xSemaphoreTake(mscApp->done, pdMS_TO_TICKS(MSC_WAIT_SLICE_MS)) != pdTRUE) {
+        if (mscApp->in_reset || mscApp->is_terminated) {
+            mscApp->pending = 0;
+            return -ECONNRESET;
+        }
+    }
+    return mscApp->result;
+}
+
+static int OpStall(void *ctx, int dir, int wedge)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)ctx;
+    uint8_t ep = (dir == MSC_BOT_DIR_IN)
+                     ? (USB_MSC_BULK_IN_ENDPOINT | (USB_IN << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT))
+                     : (USB_MSC_BULK_OUT_ENDPOINT | (USB_OUT << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT));
+
+    return (USB_DeviceMscStall(mscApp->classHandle, ep, wedge) == kStatus_USB_Success) ? 0 : -EIO;
+}
+
+static const struct msc_bot_transport s_transport = {
+    .send  = OpSend,
+    .recv  = OpRecv,
+    .wait  = OpWait,
+    .stall = OpStall,
+};
+
+static void Complete(usb_msc_struct_t *mscApp, int result)
+{
+    if (mscApp->pending) {
+        mscApp->result  = result;
+        mscApp->pending = 0;
+        xSemaphoreGiveFromISR(mscApp->done, NULL);
+    }
+}
+
+static usb_status_t OnConfigurationComplete(usb_msc_struct_t *mscApp, void *param)
+{
+    UNUSED(param);
+    mscApp->configured = true;
+    xSemaphoreGiveFromISR(mscApp->configuring, NULL);
+    return kStatus_USB_Success;
+}
+
+static usb_status_t OnTransferComplete(usb_msc_struct_t *mscApp, void *param)
+{
+    usb_device_endpoint_callback_message_struct_t *epCbParam = (usb_device_endpoint_callback_message_struct_t *)param;
+
+    if (epCbParam->length == USB_UNINITIALIZED_VAL_32) {
+        /* Transfer cancelled by controller */
+        Complete(mscApp, -ECONNRESET);
+    }
+    else {
+        Complete(mscApp, (int)epCbParam->length);
+    }
+    return kStatus_USB_Success;
+}
+
+static usb_status_t OnBulkOnlyReset(usb_msc_struct_t *mscApp, void *param)
+{
+    UNUSED(param);
+    log_debug("[MSC] Bulk-Only reset");
+    /* Transfer deferred on halted pipe is dropped without completion */
+    Complete(mscApp, -ECONNRESET);
+    return kStatus_USB_Success;
+}
+
+usb_status_t MscUSBCallback(uint32_t event, void *param, void *userArg)
+{
+    usb_status_t error       = kStatus_USB_Error;
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)userArg;
+
+    switch (event) {
+    case kUSB_DeviceMscEventConfigured:
+        error = OnConfigurationComplete(mscApp, param);
+        break;
+    case kUSB_DeviceMscEventSendResponse:
+    case kUSB_DeviceMscEventRecvResponse:
+        error = OnTransferComplete(mscApp, param);
+        break;
+    case kUSB_DeviceMscEventReset:
+        error = OnBulkOnlyReset(mscApp, param);
+        break;
+    default:
+        log_debug("[MSC] Unknown event from device class driver: %d", (int)event);
+    }
+
+    return error;
+}
+
+/* Writes cached data to the image, called whenever host goes away */
+static void FlushImage(usb_msc_struct_t *mscApp)
+{
+    if (mscApp->image && (msc_block_flush(mscApp->bot.dev) != 0)) {
+        log_error("[MSC] Disk image flush failed");
+    }
+}
+
+static void MscTask(void *handle)
+{
+    usb_msc_struct_t *mscApp = (usb_msc_struct_t *)handle;
+    int ret;
+
+    while (!mscApp->is_terminated) {
+        if (!mscApp->configured) {
+            log_debug("[MSC] Wait for configuration");
+            xSemaphoreTake(mscApp->configuring, portMAX_DELAY);
+            continue;
+        }
+
+        log_debug("[MSC] Ready");
+
+        mscApp->in_reset = false;
+
+        while (!mscApp->in_reset && !mscApp->is_terminated) {
+            ret = msc_bot_process(&mscApp->bot);
+            if (ret == -EPROTO) {
+                log_debug("[MSC] Invalid CBW, waiting for reset recovery");
+            }
+            else if ((ret < 0) && (ret != -ECONNRESET)) {
+                log_debug("[MSC] Command aborted: %d", ret);
+            }
+        }
+
+        FlushImage(mscApp);
+        /* Medium ejected by host is loaded again for next session */
+        msc_bot_set_present(&mscApp->bot, mscApp->image != NULL);
+    }
+
+    xSemaphoreGive(mscApp->join);
+    log_debug("[MSC] MSC task end");
+    vTaskDelete(NULL);
+}
+
+usb_status_t MscInit(usb_msc_struct_t *mscApp, class_handle_t classHandle, const usb_msc_config_t *config)
+{
+    const struct msc_block_dev *dev;
+
+    mscApp->configured    = false;
+    mscApp->in_reset      = false;
+    mscApp->is_terminated = false;
+    mscApp->pending       = 0;
+    mscApp->image         = NULL;
+    mscApp->classHandle   = classHandle;
+
+    /* Without image host sees drive with no medium inserted */
+    OpenImage(mscApp, config);
+    dev = &mscApp->disk;
+
+    if (mscApp->image && config->cacheFlags) {
+        if (msc_cache_init(&mscApp->cache,
+                           &mscApp->disk,
+                           s_cacheMemory,
+                           sizeof(s_cacheMemory),
+                           USB_MSC_CACHE_LINE_BLOCKS,
+                           config->cacheFlags) == 0) {
+            dev = msc_cache_device(&mscApp->cache);
+        }
+        else {
+            log_error("[MSC] Cache configuration rejected, using image directly");
+        }
+    }
+
+    if (msc_bot_init(&mscApp->bot, &s_transport, mscApp, dev, s_botBuffer, sizeof(s_botBuffer)) != 0) {
+        goto error;
+    }
+    mscApp->bot.vendor   = USB_GetDescriptorStringPtr(USB_STRING_MANUFACTURER);
+    mscApp->bot.product  = USB_GetDescriptorStringPtr(USB_STRING_PRODUCT);
+    mscApp->bot.revision = "1";
+    msc_bot_set_present(&mscApp->bot, mscApp->image != NULL);
+
+    if ((mscApp->join = xSemaphoreCreateBinary()) == NULL) {
+        goto error;
+    }
+
+    if ((mscApp->configuring = xSemaphoreCreateBinary()) == NULL) {
+        goto error_configuring;
+    }
+
+    if ((mscApp->done = xSemaphoreCreateBinary()) == NULL) {
+        goto error_done;
+    }
+
+    if (xTaskCreate(MscTask,                                      /* pointer to the task */
+                    "MSC task",                                   /* task name for kernel awareness debugging */
+                    MSC_TASK_STACK_SIZE / sizeof(portSTACK_TYPE), /* task stack size */
+                    mscApp,                                       /* optional task startup argument */
+                    tskIDLE_PRIORITY,                             /* initial priority */
+                    &mscApp->msc_task_handle                      /* optional task handle to create */
+                    ) != pdPASS) {
+        log_debug("[MSC] Create task failed");
+        goto error_task;
+    }
+    return kStatus_USB_Success;
+
+error_task:
+    vSemaphoreDelete(mscApp->done);
+error_done:
+    vSemaphoreDelete(mscApp->configuring);
+error_configuring:
+    vSemaphoreDelete(mscApp->join);
+error:
+    if (mscApp->image) {
+        fclose(mscApp->image);
+        mscApp->image = NULL;
+    }
+    mscApp->done        = NULL;
+    mscApp->configuring = NULL;
+    mscApp->join        = NULL;
+    return kStatus_USB_AllocFail;
+}
+
+void MscDeinit(usb_msc_struct_t *mscApp)
+{
+    if (!mscApp->configured) {
+        /* Poke the task waiting for configuration */
+        mscApp->configured = true;
+        xSemaphoreGive(mscApp->configuring);
+    }
+
+    mscApp->in_reset      = true;
+    mscApp->is_terminated = true;
+
+    /* Task leaves pending transfer within one wait slice, then flushes the image */
+    if (!xSemaphoreTake(mscApp->join, pdMS_TO_TICKS(3 * MSC_WAIT_SLICE_MS))) {
+        log_debug("[MSC] Unable to join MSC thread");
+    }
+
+    if (mscApp->image) {
+        fclose(mscApp->image);
+        mscApp->image = NULL;
+    }
+    vSemaphoreDelete(mscApp->done);
+    vSemaphoreDelete(mscApp->join);
+    vSemaphoreDelete(mscApp->configuring);
+    mscApp->done        = NULL;
+    mscApp->join        = NULL;
+    mscApp->configuring = NULL;
+
+    log_debug("[MSC] Deinitialized");
+}
+
+void MscReset(usb_msc_struct_t *mscApp, uint8_t speed)
+{
+    mscApp->configured = false;
+    mscApp->in_reset   = true;
+    log_debug("[MSC] Reset to %s", (speed == USB_SPEED_FULL) ? "Full-Speed 12Mbps" : "High-Speed 480Mbps");
+}
+
+void MscDetached(usb_msc_struct_t *mscApp)
+{
+    log_debug("[MSC] Detached");
+    mscApp->configured = false;
+    mscApp->in_reset   = true;
+}
+
+#endif /* USB_DEVICE_CONFIG_MSC */
@@ -0,0 +1,63 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _MSC_H_
+#define _MSC_H_
+
+#include <stdio.h>
+#include "usb_device_msc.h"
+#include "msc_bot.h"
+#include "msc_cache.h"
+
+/*! @brief Size of each of two data buffers used by Bulk-Only Transport, limits single USB transfer. */
+#ifndef USB_MSC_TRANSFER_BUFFER_SIZE
+#define USB_MSC_TRANSFER_BUFFER_SIZE (8192U)
+#endif
+
+/*! @brief Memory of sector cache placed in front of disk image, unused when cache is disabled. */
+#ifndef USB_MSC_CACHE_SIZE
+#define USB_MSC_CACHE_SIZE (16384U)
+#endif
+
+/*! @brief Blocks in cache line, unit of read-ahead and eviction. Power of two up to 32. */
+#ifndef USB_MSC_CACHE_LINE_BLOCKS
+#define USB_MSC_CACHE_LINE_BLOCKS (8U)
+#endif
+
+#define USB_MSC_BLOCK_SIZE (512U)
+
+/* Mass storage function configuration */
+typedef struct _usb_msc_config
+{
+    const char *imagePath; /* Disk image exposed to host, NULL presents drive without medium */
+    bool readOnly;         /* Report medium as write protected */
+    int cacheFlags;        /* MSC_CACHE_WRITE_BACK, MSC_CACHE_READ_AHEAD, 0 to access image directly */
+} usb_msc_config_t;
+
+typedef struct {
+    class_handle_t classHandle;
+    struct msc_bot bot;
+    struct msc_cache cache;
+    struct msc_block_dev disk; /* Image file */
+    FILE *image;
+
+    uint8_t configured;
+    uint8_t in_reset;
+    uint8_t is_terminated;
+    volatile uint8_t pending;  /* Transfer started and not completed */
+    volatile int result;       /* Length of completed transfer or negative errno */
+    SemaphoreHandle_t done;
+    SemaphoreHandle_t join;
+    SemaphoreHandle_t configuring;
+    TaskHandle_t msc_task_handle; /* USB MSC task handle */
+} usb_msc_struct_t;
+
+usb_status_t MscUSBCallback(uint32_t event, void *param, void *userArg);
+usb_status_t MscInit(usb_msc_struct_t *mscApp, class_handle_t classHandle, const usb_msc_config_t *config);
+void MscReset(usb_msc_struct_t *mscApp, uint8_t speed);
+void MscDeinit(usb_msc_struct_t *mscApp);
+void MscDetached(usb_msc_struct_t *mscApp);
+
+#endif /* _MSC_H_ */
@@ -0,0 +1,673 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "usb_device_config.h"
+#include "usb.h"
+#include "usb_device.h"
+
+#include "usb_device_class.h"
+
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+#include "usb_device_msc.h"
+
+/*******************************************************************************
+ * Variables
+ ******************************************************************************/
+/* MSC device instance */
+
+USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE)
+    usb_device_msc_struct_t g_mscHandle[USB_DEVICE_CONFIG_MSC_MAX_INSTANCE];
+
+/*******************************************************************************
+ * Code
+ ******************************************************************************/
+
+/*!
+ * @brief Allocates the MSC device handle.
+ *
+ * @param handle The class handle of the MSC class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscAllocateHandle(usb_device_msc_struct_t **handle)
+{
+    uint32_t count;
+    for (count = 0; count < USB_DEVICE_CONFIG_MSC_MAX_INSTANCE; count++)
+    {
+        if (NULL == g_mscHandle[count].handle)
+        {
+            *handle = &g_mscHandle[count];
+            return kStatus_USB_Success;
+        }
+    }
+
+    return kStatus_USB_Busy;
+}
+
+/*!
+ * @brief Frees the MSC device handle.
+ *
+ * @param handle The class handle of the MSC class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscFreeHandle(usb_device_msc_struct_t *handle)
+{
+    handle->handle        = NULL;
+    handle->configStruct  = NULL;
+    handle->configuration = 0;
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief Passes endpoint event to the class callback.
+ *
+ * @param mscHandle The class handle of the MSC class.
+ * @param pipe The pipe which completed the transfer.
+ * @param event The MSC class event reported to the application.
+ * @param message The pointer to the message of the endpoint callback.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscPipeDone(usb_device_msc_struct_t *mscHandle,
+                                          usb_device_msc_pipe_t *pipe,
+                                          uint32_t event,
+                                          usb_device_endpoint_callback_message_struct_t *message)
+{
+    usb_status_t error = kStatus_USB_Error;
+
+    pipe->isBusy = 0;
+
+    if ((NULL != mscHandle->configStruct) && (mscHandle->configStruct->classCallback))
+    {
+        /*classCallback is initialized in classInit of s_UsbDeviceClassInterfaceMap,
+        it is from the second parameter of classInit */
+        error = mscHandle->configStruct->classCallback(event, message, mscHandle->configStruct->classCalbackArg);
+    }
+    return error;
+}
+
+/*!
+ * @brief Responds to the bulk in endpoint event.
+ */
+static usb_status_t USB_DeviceMscBulkIn(usb_device_handle handle,
+                                        usb_device_endpoint_callback_message_struct_t *message,
+                                        void *callbackParam)
+{
+    usb_device_msc_struct_t *mscHandle = (usb_device_msc_struct_t *)callbackParam;
+
+    if (!mscHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    return USB_DeviceMscPipeDone(mscHandle, &mscHandle->bulkIn, kUSB_DeviceMscEventSendResponse, message);
+}
+
+/*!
+ * @brief Responds to the bulk out endpoint event.
+ */
+static usb_status_t USB_DeviceMscBulkOut(usb_device_handle handle,
+                                         usb_device_endpoint_callback_message_struct_t *message,
+                                         void *callbackParam)
+{
+    usb_device_msc_struct_t *mscHandle = (usb_device_msc_struct_t *)callbackParam;
+
+    if (!mscHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    return USB_DeviceMscPipeDone(mscHandle, &mscHandle->bulkOut, kUSB_DeviceMscEventRecvResponse, message);
+}
+
+/*!
+ * @brief Initializes the endpoints of MSC interface.
+ *
+ * @param mscHandle The class handle of the MSC class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscEndpointsInit(usb_device_msc_struct_t *mscHandle)
+{
+    usb_device_interface_list_t *interfaceList;
+    usb_device_interface_struct_t *interface = NULL;
+    usb_status_t error                       = kStatus_USB_Error;
+    uint32_t count;
+    uint32_t index;
+
+    /* return error when configuration is invalid (0 or more than the configuration number) */
+    if ((mscHandle->configuration == 0U) ||
+        (mscHandle->configuration > mscHandle->configStruct->classInfomation->configurations))
+    {
+        return error;
+    }
+
+    interfaceList = &mscHandle->configStruct->classInfomation->interfaceList[mscHandle->configuration - 1];
+
+    for (count = 0; count < interfaceList->count; count++)
+    {
+        if (USB_DEVICE_MSC_CLASS_CODE == interfaceList->interfaces[count].classCode)
+        {
+            for (index = 0; index < interfaceList->interfaces[count].count; index++)
+            {
+                if (interfaceList->interfaces[count].interface[index].alternateSetting == 0U)
+                {
+                    interface = &interfaceList->interfaces[count].interface[index];
+                    break;
+                }
+            }
+            mscHandle->interfaceNumber = interfaceList->interfaces[count].interfaceNumber;
+            break;
+        }
+    }
+    if (!interface)
+    {
+        return error;
+    }
+    mscHandle->interfaceHandle = interface;
+
+    for (count = 0; count < interface->endpointList.count; count++)
+    {
+        usb_device_endpoint_init_struct_t epInitStruct;
+        usb_device_endpoint_callback_struct_t epCallback;
+        usb_device_msc_pipe_t *pipe;
+
+        epInitStruct.zlt             = 0;
+        epInitStruct.interval        = interface->endpointList.endpoint[count].interval;
+        epInitStruct.endpointAddress = interface->endpointList.endpoint[count].endpointAddress;
+        epInitStruct.maxPacketSize   = interface->endpointList.endpoint[count].maxPacketSize;
+        epInitStruct.transferType    = interface->endpointList.endpoint[count].transferType;
+
+        if (USB_IN == ((epInitStruct.endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                       USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT))
+        {
+            pipe                  = &mscHandle->bulkIn;
+            epCallback.callbackFn = USB_DeviceMscBulkIn;
+        }
+        else
+        {
+            pipe                  = &mscHandle->bulkOut;
+            epCallback.callbackFn = USB_DeviceMscBulkOut;
+        }
+        pipe->ep                 = (epInitStruct.endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_NUMBER_MASK);
+        pipe->isBusy             = 0;
+        pipe->pipeDataBuffer     = (uint8_t *)USB_UNINITIALIZED_VAL_32;
+        pipe->pipeDataLen        = 0U;
+        pipe->pipeStall          = 0U;
+        epCallback.callbackParam = mscHandle;
+
+        error = USB_DeviceInitEndpoint(mscHandle->handle, &epInitStruct, &epCallback);
+        if (kStatus_USB_Success != error)
+        {
+            return error;
+        }
+    }
+    mscHandle->wedged = 0U;
+    return error;
+}
+
+/*!
+ * @brief De-initializes the endpoints of MSC interface.
+ *
+ * @param mscHandle The class handle of the MSC class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscEndpointsDeinit(usb_device_msc_struct_t *mscHandle)
+{
+    usb_status_t error = kStatus_USB_Error;
+    uint32_t count;
+
+    if (!mscHandle->interfaceHandle)
+    {
+        return error;
+    }
+    for (count = 0; count < mscHandle->interfaceHandle->endpointList.count; count++)
+    {
+        error = USB_DeviceDeinitEndpoint(mscHandle->handle,
+                                         mscHandle->interfaceHandle->endpointList.endpoint[count].endpointAddress);
+    }
+    mscHandle->interfaceHandle = NULL;
+    return error;
+}
+
+/*!
+ * @brief Gets the pipe of endpoint address, NULL if endpoint does not belong to MSC interface.
+ */
+static usb_device_msc_pipe_t *USB_DeviceMscGetPipe(usb_device_msc_struct_t *mscHandle, uint8_t endpointAddress)
+{
+    if (!mscHandle->interfaceHandle)
+    {
+        return NULL;
+    }
+    if (USB_IN == ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) >>
+                   USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT))
+    {
+        if ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_NUMBER_MASK) == mscHandle->bulkIn.ep)
+        {
+            return &mscHandle->bulkIn;
+        }
+    }
+    else if ((endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_NUMBER_MASK) == mscHandle->bulkOut.ep)
+    {
+        return &mscHandle->bulkOut;
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Clears the halt of the pipe and issues the transfer requested while it was halted.
+ *
+ * @param mscHandle The class handle of the MSC class.
+ * @param pipe The pipe to be unstalled.
+ * @param endpointAddress The endpoint address of the pipe.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscUnstallPipe(usb_device_msc_struct_t *mscHandle,
+                                             usb_device_msc_pipe_t *pipe,
+                                             uint8_t endpointAddress)
+{
+    usb_device_endpoint_callback_message_struct_t endpointCallbackMessage;
+    usb_status_t error;
+    uint8_t *buffer;
+
+    error = USB_DeviceUnstallEndpoint(mscHandle->handle, endpointAddress);
+    if (!pipe->pipeStall)
+    {
+        return error;
+    }
+    pipe->pipeStall = 0U;
+    if ((uint8_t *)USB_UNINITIALIZED_VAL_32 == pipe->pipeDataBuffer)
+    {
+        return error;
+    }
+
+    buffer               = pipe->pipeDataBuffer;
+    pipe->pipeDataBuffer = (uint8_t *)USB_UNINITIALIZED_VAL_32;
+    if (&mscHandle->bulkIn == pipe)
+    {
+        error = USB_DeviceSendRequest(mscHandle->handle, pipe->ep, buffer, pipe->pipeDataLen);
+    }
+    else
+    {
+        error = USB_DeviceRecvRequest(mscHandle->handle, pipe->ep, buffer, pipe->pipeDataLen);
+    }
+    if (kStatus_USB_Success != error)
+    {
+        /* Report failed transfer, so the application does not wait for it forever */
+        endpointCallbackMessage.buffer  = buffer;
+        endpointCallbackMessage.length  = USB_UNINITIALIZED_VAL_32;
+        endpointCallbackMessage.isSetup = 0U;
+        USB_DeviceMscPipeDone(mscHandle, pipe,
+                              (&mscHandle->bulkIn == pipe) ? kUSB_DeviceMscEventSendResponse :
+                                                             kUSB_DeviceMscEventRecvResponse,
+                              &endpointCallbackMessage);
+    }
+    return error;
+}
+
+/*!
+ * @brief Handles Bulk-Only Mass Storage Reset and Get Max LUN requests.
+ *
+ * @param mscHandle The class handle of the MSC class.
+ * @param controlRequest The control request.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+static usb_status_t USB_DeviceMscClassRequest(usb_device_msc_struct_t *mscHandle,
+                                              usb_device_control_request_struct_t *controlRequest)
+{
+    usb_status_t error = kStatus_USB_InvalidRequest;
+
+    if ((controlRequest->setup->wIndex & 0xFFU) != mscHandle->interfaceNumber)
+    {
+        return kStatus_USB_Error;
+    }
+
+    switch (controlRequest->setup->bRequest)
+    {
+        case USB_DEVICE_MSC_BULK_ONLY_RESET:
+            if ((controlRequest->setup->wValue != 0U) || (controlRequest->setup->wLength != 0U) ||
+                ((controlRequest->setup->bmRequestType & USB_REQUEST_TYPE_DIR_MASK) != USB_REQUEST_TYPE_DIR_OUT))
+            {
+                break;
+            }
+            /* Halts remain, host clears them as part of reset recovery */
+            mscHandle->wedged                  = 0U;
+            mscHandle->bulkIn.pipeDataBuffer   = (uint8_t *)USB_UNINITIALIZED_VAL_32;
+            mscHandle->bulkOut.pipeDataBuffer  = (uint8_t *)USB_UNINITIALIZED_VAL_32;
+            mscHandle->bulkIn.isBusy           = 0U;
+            mscHandle->bulkOut.isBusy          = 0U;
+            USB_DeviceCancel(mscHandle->handle, mscHandle->bulkIn.ep | (USB_IN << 7U));
+            USB_DeviceCancel(mscHandle->handle, mscHandle->bulkOut.ep | (USB_OUT << 7U));
+            error = kStatus_USB_Success;
+            if (mscHandle->configStruct->classCallback)
+            {
+                error = mscHandle->configStruct->classCallback(kUSB_DeviceMscEventReset, NULL,
+                                                               mscHandle->configStruct->classCalbackArg);
+            }
+            break;
+        case USB_DEVICE_MSC_GET_MAX_LUN:
+            if ((controlRequest->setup->wValue != 0U) || (controlRequest->setup->wLength != 1U) ||
+                ((controlRequest->setup->bmRequestType & USB_REQUEST_TYPE_DIR_MASK) != USB_REQUEST_TYPE_DIR_IN))
+            {
+                break;
+            }
+            mscHandle->maxLun      = 0U;
+            controlRequest->buffer = &mscHandle->maxLun;
+            controlRequest->length = sizeof(mscHandle->maxLun);
+            error                  = kStatus_USB_Success;
+            break;
+        default:
+            break;
+    }
+    return error;
+}
+
+/*!
+ * @brief Handles the MSC class event.
+ *
+ * This function responses to various events including the common device events and the class specific events.
+ *
+ * @param handle The class handle of the MSC class.
+ * @param event The event type.
+ * @param param The parameter of the event.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceMscEvent(void *handle, uint32_t event, void *param)
+{
+    usb_device_msc_struct_t *mscHandle;
+    usb_device_msc_pipe_t *pipe;
+    usb_status_t error = kStatus_USB_Error;
+    uint8_t *temp8;
+
+    if ((!param) || (!handle))
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    mscHandle = (usb_device_msc_struct_t *)handle;
+
+    switch (event)
+    {
+        case kUSB_DeviceClassEventDeviceReset:
+            /* Bus reset, clear the configuration. */
+            mscHandle->configuration = 0;
+            mscHandle->wedged        = 0U;
+            break;
+        case kUSB_DeviceClassEventSetConfiguration:
+            temp8 = ((uint8_t *)param);
+            if (!mscHandle->configStruct)
+            {
+                break;
+            }
+            if (*temp8 == mscHandle->configuration)
+            {
+                break;
+            }
+
+            error                    = USB_DeviceMscEndpointsDeinit(mscHandle);
+            mscHandle->configuration = *temp8;
+            error                    = USB_DeviceMscEndpointsInit(mscHandle);
+            if (kStatus_USB_Success != error)
+            {
+#ifdef DEBUG
+                usb_echo("kUSB_DeviceClassEventSetConfiguration, USB_DeviceInitEndpoint fail\r\n");
+#endif
+                break;
+            }
+            if (mscHandle->configStruct->classCallback)
+            {
+                error = mscHandle->configStruct->classCallback(kUSB_DeviceMscEventConfigured, NULL,
+                                                               mscHandle->configStruct->classCalbackArg);
+            }
+            break;
+        case kUSB_DeviceClassEventSetEndpointHalt:
+            temp8 = ((uint8_t *)param);
+            pipe  = USB_DeviceMscGetPipe(mscHandle, *temp8);
+            if (!pipe)
+            {
+                break;
+            }
+            pipe->pipeStall = 1U;
+            error           = USB_DeviceStallEndpoint(mscHandle->handle, *temp8);
+            break;
+        case kUSB_DeviceClassEventClearEndpointHalt:
+            temp8 = ((uint8_t *)param);
+            pipe  = USB_DeviceMscGetPipe(mscHandle, *temp8);
+            if (!pipe)
+            {
+                break;
+            }
+            if (mscHandle->wedged)
+            {
+                /* BOT 6.6.1, halt persists until reset recovery */
+                error = kStatus_USB_Success;
+                break;
+            }
+            error = USB_DeviceMscUnstallPipe(mscHandle, pipe, *temp8);
+            break;
+        case kUSB_DeviceClassEventClassRequest:
+            if ((!mscHandle->configStruct) || (!mscHandle->interfaceHandle))
+            {
+                break;
+            }
+            error = USB_DeviceMscClassRequest(mscHandle, (usb_device_control_request_struct_t *)param);
+            break;
+        default:
+            break;
+    }
+    return error;
+}
+
+/*!
+ * @brief Initializes the USB MSC class.
+ *
+ * @param controllerId The id of the controller.
+ * @param config The user configuration structure of type usb_device_class_config_struct_t.
+ * @param handle It is out parameter. The class handle of the MSC class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceMscInit(uint8_t controllerId, usb_device_class_config_struct_t *config, class_handle_t *handle)
+{
+    usb_device_msc_struct_t *mscHandle;
+    usb_status_t error = kStatus_USB_Error;
+
+    error = USB_DeviceMscAllocateHandle(&mscHandle);
+
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+
+    error = USB_DeviceClassGetDeviceHandle(controllerId, &mscHandle->handle);
+
+    if (kStatus_USB_Success != error)
+    {
+        return error;
+    }
+
+    if (!mscHandle->handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    mscHandle->configStruct    = config;
+    mscHandle->configuration   = 0;
+    mscHandle->interfaceHandle = NULL;
+    mscHandle->wedged          = 0U;
+    mscHandle->bulkIn.isBusy   = 0;
+    mscHandle->bulkOut.isBusy  = 0;
+
+    *handle = (class_handle_t)mscHandle;
+    return error;
+}
+
+/*!
+ * @brief De-Initializes the USB MSC class.
+ *
+ * @param handle The class handle of the MSC class.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceMscDeinit(class_handle_t handle)
+{
+    usb_device_msc_struct_t *mscHandle;
+    usb_status_t error = kStatus_USB_Error;
+
+    mscHandle = (usb_device_msc_struct_t *)handle;
+
+    if (!mscHandle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    error = USB_DeviceMscEndpointsDeinit(mscHandle);
+    USB_DeviceMscFreeHandle(mscHandle);
+    return error;
+}
+
+/*!
+ * @brief Primes the pipe, or keeps the transfer aside while the pipe is halted.
+ */
+static usb_status_t USB_DeviceMscTransfer(usb_device_msc_struct_t *mscHandle,
+                                          usb_device_msc_pipe_t *pipe,
+                                          uint8_t *buffer,
+                                          uint32_t length)
+{
+    usb_status_t error;
+
+    if (1U == pipe->isBusy)
+    {
+        return kStatus_USB_Busy;
+    }
+    pipe->isBusy = 1U;
+
+    if (pipe->pipeStall)
+    {
+        pipe->pipeDataBuffer = buffer;
+        pipe->pipeDataLen    = length;
+        return kStatus_USB_Success;
+    }
+
+    if (&mscHandle->bulkIn == pipe)
+    {
+        error = USB_DeviceSendRequest(mscHandle->handle, pipe->ep, buffer, length);
+    }
+    else
+    {
+        error = USB_DeviceRecvRequest(mscHandle->handle, pipe->ep, buffer, length);
+    }
+    if (kStatus_USB_Success != error)
+    {
+        pipe->isBusy = 0U;
+    }
+    return error;
+}
+
+/*!
+ * @brief Prime the endpoint to send packet to host.
+ *
+ * @param handle The class handle of the MSC class.
+ * @param ep The endpoint number of the transfer.
+ * @param buffer The pointer to the buffer to be transferred.
+ * @param length The length of the buffer to be transferred.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceMscSend(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length)
+{
+    usb_device_msc_struct_t *mscHandle;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    mscHandle = (usb_device_msc_struct_t *)handle;
+
+    if ((!mscHandle->interfaceHandle) || (mscHandle->bulkIn.ep != ep))
+    {
+        return kStatus_USB_Error;
+    }
+    return USB_DeviceMscTransfer(mscHandle, &mscHandle->bulkIn, buffer, length);
+}
+
+/*!
+ * @brief Prime the endpoint to receive packet from host.
+ *
+ * @param handle The class handle of the MSC class.
+ * @param ep The endpoint number of the transfer.
+ * @param buffer The pointer to the buffer to be transferred.
+ * @param length The length of the buffer to be transferred.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceMscRecv(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length)
+{
+    usb_device_msc_struct_t *mscHandle;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    mscHandle = (usb_device_msc_struct_t *)handle;
+
+    if ((!mscHandle->interfaceHandle) || (mscHandle->bulkOut.ep != ep))
+    {
+        return kStatus_USB_Error;
+    }
+    return USB_DeviceMscTransfer(mscHandle, &mscHandle->bulkOut, buffer, length);
+}
+
+/*!
+ * @brief Halts bulk endpoint of the MSC interface.
+ *
+ * @param handle The class handle of the MSC class.
+ * @param ep The endpoint address.
+ * @param wedge Ignore clear halt requests until Bulk-Only Mass Storage Reset.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceMscStall(class_handle_t handle, uint8_t ep, uint8_t wedge)
+{
+    usb_device_msc_struct_t *mscHandle;
+    usb_device_msc_pipe_t *pipe;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    mscHandle = (usb_device_msc_struct_t *)handle;
+
+    pipe = USB_DeviceMscGetPipe(mscHandle, ep);
+    if (!pipe)
+    {
+        return kStatus_USB_Error;
+    }
+    if (wedge)
+    {
+        mscHandle->wedged = 1U;
+    }
+    pipe->pipeStall = 1U;
+    return USB_DeviceStallEndpoint(mscHandle->handle, ep);
+}
+
+/*
+ * @brief Checks if any transfer is pending or in progress for endpont.
+ *
+ * @param handle The class handle for the MSC class
+ * @param ep The endpoint number
+ * @retval FALSE(0) no transfer scheduled
+ * @retval TRUE(1) transfer is pending or in progress
+ */
+int USB_DeviceMscIsBusy(class_handle_t handle, uint8_t ep)
+{
+    usb_device_msc_struct_t *mscHandle;
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+
+    mscHandle = (usb_device_msc_struct_t *)handle;
+
+    if (ep == (mscHandle->bulkIn.ep))
+        return mscHandle->bulkIn.isBusy;
+    if (ep == (mscHandle->bulkOut.ep))
+        return mscHandle->bulkOut.isBusy;
+    return 1;
+}
+
+#endif /* USB_DEVICE_CONFIG_MSC */
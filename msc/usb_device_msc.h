@@ -0,0 +1,129 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _USB_DEVICE_MSC_H_
+#define _USB_DEVICE_MSC_H_
+
+/*******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define USB_DEVICE_CONFIG_MSC_MAX_INSTANCE (1) /*!< The maximum number of MSC device instance. */
+#define USB_DEVICE_MSC_CLASS_CODE (0x08)       /*!< The mass storage class code. */
+#define USB_DEVICE_MSC_SUBCLASS_SCSI (0x06)    /*!< SCSI transparent command set. */
+#define USB_DEVICE_MSC_PROTOCOL_BBB (0x50)     /*!< Bulk-Only Transport. */
+
+#define USB_DEVICE_MSC_BULK_ONLY_RESET (0xFF) /*!< Bulk-Only Mass Storage Reset class request. */
+#define USB_DEVICE_MSC_GET_MAX_LUN (0xFE)     /*!< Get Max LUN class request. */
+
+/*! @brief Definition of MSC class event. */
+typedef enum _usb_device_msc_event
+{
+    kUSB_DeviceMscEventConfigured = 0x01, /*!< Endpoints are ready, the first CBW may be received. */
+    kUSB_DeviceMscEventSendResponse,      /*!< The bulk send transfer is complete or cancelled. */
+    kUSB_DeviceMscEventRecvResponse,      /*!< The bulk receive transfer is complete or cancelled. */
+    kUSB_DeviceMscEventReset,             /*!< Host requested Bulk-Only Mass Storage Reset, pending transfers
+                                               were cancelled. */
+} usb_device_msc_event_t;
+
+/*! @brief Definition of pipe structure. */
+typedef struct _usb_device_msc_pipe
+{
+    uint8_t *pipeDataBuffer; /*!< Transfer requested while the pipe is halted, issued once halt is cleared. */
+    uint32_t pipeDataLen;    /*!< Length of the deferred transfer. */
+    uint8_t pipeStall;       /*!< The pipe is halted. */
+    uint8_t ep;              /*!< The endpoint number of the pipe. */
+    uint8_t isBusy;          /*!< 1: The pipe is transferring packet, 0: The pipe is idle. */
+} usb_device_msc_pipe_t;
+
+/*! @brief Definition of structure for MSC device. */
+typedef struct _usb_device_msc_struct
+{
+    usb_device_handle handle;                       /*!< The handle of the USB device. */
+    usb_device_class_config_struct_t *configStruct; /*!< The class configure structure. */
+    usb_device_interface_struct_t *interfaceHandle; /*!< The current interface handle. */
+    usb_device_msc_pipe_t bulkIn;                   /*!< The bulk in pipe. */
+    usb_device_msc_pipe_t bulkOut;                  /*!< The bulk out pipe. */
+    uint8_t configuration;                          /*!< The current configuration value. */
+    uint8_t interfaceNumber;                        /*!< The interface number of the class. */
+    uint8_t wedged;                                 /*!< Invalid CBW was received, endpoints stay halted until
+                                                         Bulk-Only Mass Storage Reset. */
+    uint8_t maxLun;                                 /*!< Reply to Get Max LUN request. */
+} usb_device_msc_struct_t;
+
+/*******************************************************************************
+ * API
+ ******************************************************************************/
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/*!
+ * @brief Initializes the USB MSC class.
+ *
+ * @param controllerId The controller ID of the USB IP.
+ * @param config The class configuration information.
+ * @param handle An parameter used to return pointer of the MSC class handle to the caller.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceMscInit(uint8_t controllerId,
+                                      usb_device_class_config_struct_t *config,
+                                      class_handle_t *handle);
+
+/*!
+ * @brief Deinitializes the USB MSC class.
+ *
+ * @param handle The MSC class handle got from usb_device_class_config_struct_t::classHandle.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceMscDeinit(class_handle_t handle);
+
+/*!
+ * @brief Handles the MSC class event.
+ *
+ * @param handle The MSC class handle.
+ * @param event The event type.
+ * @param param The parameter of the event.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceMscEvent(void *handle, uint32_t event, void *param);
+
+/*!
+ * @brief Primes the bulk in endpoint. Transfer requested on halted endpoint starts once host clears the halt.
+ *
+ * @return A USB error code or kStatus_USB_Success, kStatus_USB_Busy if the pipe is transferring.
+ */
+extern usb_status_t USB_DeviceMscSend(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length);
+
+/*!
+ * @brief Primes the bulk out endpoint. Transfer requested on halted endpoint starts once host clears the halt.
+ *
+ * @return A USB error code or kStatus_USB_Success, kStatus_USB_Busy if the pipe is transferring.
+ */
+extern usb_status_t USB_DeviceMscRecv(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length);
+
+/*!
+ * @brief Halts bulk endpoint, used to end data phase early and to reject invalid CBW.
+ *
+ * @param handle The MSC class handle.
+ * @param ep The endpoint address, direction bit selects the pipe.
+ * @param wedge Keep the endpoint halted until Bulk-Only Mass Storage Reset, host clearing the halt is ignored.
+ * @return A USB error code or kStatus_USB_Success.
+ */
+extern usb_status_t USB_DeviceMscStall(class_handle_t handle, uint8_t ep, uint8_t wedge);
+
+/*
+ * @brief Checks if any transfer is pending or in progress for endpont.
+ *
+ * @retval FALSE(0) no transfer scheduled
+ * @retval TRUE(1) transfer is pending or in progress
+ */
+extern int USB_DeviceMscIsBusy(class_handle_t handle, uint8_t ep);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* _USB_DEVICE_MSC_H_ */
@@ -6,6 +6,7 @@
 #include "mtp_responder.h"
 #include "mtp_storage.h"
 #include "mtp_util.h"
+#include "mtp_schema.h"
 
 const uint16_t MTP_SUPPORTED_OPERATIONS[] =
 {
@@ -289,28 +290,34 @@ bool is_format_code_supported(uint16_t format_code)
     return false;
 }
 
-uint32_t serialize_device_info(const mtp_device_info_t *info, uint8_t *data)
+/* DeviceInfo dataset up to the MTP Vendor Extension Description */
+#define MTP_DEVICE_INFO_HEAD(FIELD, RESERVED, info) \
+    RESERVED(uint16_t, standard_version, 100) \
+    RESERVED(uint32_t, vendor_extension_id, 6) \
+    RESERVED(uint16_t, vendor_extension_version, 100)
+
+MTP_SCHEMA_STRUCT(device_info_head, MTP_DEVICE_INFO_HEAD);
+
+#define PUT_CODES(writer, codes) \
+    mtp_writer_put_array(writer, codes, sizeof(codes)/sizeof(uint16_t), sizeof(uint16_t))
+
+uint32_t serialize_device_info(const mtp_device_info_t *info, uint8_t *data, uint32_t size)
 {
-    uint32_t length = 0;
-    length += put_16(data, 100u);
-    length += put_32(data + length, 6u);
-    length += put_16(data + length, 100u);
-    length += put_string(data + length, "microsoft.com: 1.0;");
-    length += put_16(data + length, 0u);
-    length += put_array(data + length, MTP_SUPPORTED_OPERATIONS,
-                sizeof(MTP_SUPPORTED_OPERATIONS)/sizeof(uint16_t), sizeof(uint16_t));
-    length += put_array(data + length, MTP_SUPPORTED_EVENTS,
-                sizeof(MTP_SUPPORTED_EVENTS)/sizeof(uint16_t), sizeof(uint16_t));
-    length += put_array(data + length, MTP_SUPPORTED_DEVICE_PROPERTIES,
-                sizeof(MTP_SUPPORTED_DEVICE_PROPERTIES)/sizeof(uint16_t), sizeof(uint16_t));
-    length += put_array(data + length, MTP_SUPPORTED_CAPTURE_FORMATS,
-                sizeof(MTP_SUPPORTED_CAPTURE_FORMATS)/sizeof(uint16_t), sizeof(uint16_t));
-    length += put_array(data + length, MTP_SUPPORTED_PLAYBACK_FORMATS,
-                sizeof(MTP_SUPPORTED_PLAYBACK_FORMATS)/sizeof(uint16_t), sizeof(uint16_t));
-    length += put_string(data + length, info->manufacturer);
-    length += put_string(data + length, info->model);
-    length += put_string(data + length, info->version);
-    length += put_string(data + length, info->serial);
-    return length;
+    const uint16_t functional_mode = 0;
+    mtp_writer_t writer;
 
+    mtp_writer_init(&writer, data, size);
+    MTP_SCHEMA_PUT(&writer, device_info_head, MTP_DEVICE_INFO_HEAD, info);
+    mtp_writer_put_string(&writer, "microsoft.com: 1.0;");
+    mtp_writer_put(&writer, &functional_mode, sizeof(functional_mode));
+    PUT_CODES(&writer, MTP_SUPPORTED_OPERATIONS);
+    PUT_CODES(&writer, MTP_SUPPORTED_EVENTS);
+    PUT_CODES(&writer, MTP_SUPPORTED_DEVICE_PROPERTIES);
+    PUT_CODES(&writer, MTP_SUPPORTED_CAPTURE_FORMATS);
+    PUT_CODES(&writer, MTP_SUPPORTED_PLAYBACK_FORMATS);
+    mtp_writer_put_string(&writer, info->manufacturer);
+    mtp_writer_put_string(&writer, info->model);
+    mtp_writer_put_string(&writer, info->version);
+    mtp_writer_put_string(&writer, info->serial);
+    return mtp_writer_finish(&writer);
 }
@@ -17,7 +17,8 @@ typedef struct {
 } mtp_device_info_t;
 
 bool is_format_code_supported(uint16_t format_code);
-uint32_t serialize_device_info(const mtp_device_info_t *info, uint8_t *data);
+/* Returns dataset length, zero if it doesn't fit in size bytes */
+uint32_t serialize_device_info(const mtp_device_info_t *info, uint8_t *data, uint32_t size);
 
 #endif /* _MTP_DATASET_H */
 
@@ -17,6 +17,13 @@
 
 #define UNUSED(x) do { (void)(x); } while (0)
 
+typedef struct {
+    uint16_t opcode;
+    uint16_t param;
+    uint32_t offset;
+    uint32_t length;
+} mtp_dataset_blob_t;
+
 struct mtp_responder
 {
     bool session_open;
@@ -33,8 +40,10 @@ struct mtp_responder
         uint32_t handle;
         size_t total;
         size_t in_buffer;
+        uint16_t data_status;
         bool file_open;
         bool keep;
+        size_t header_length;
         union {
             size_t sent;
             size_t received;
@@ -45,6 +54,14 @@ struct mtp_responder
         mtp_data_cntr_t *cntr;
     };
     size_t buf_size;
+    mtp_cntr_hdr_t *header;
+
+    struct {
+        uint8_t *data;
+        uint32_t size;
+        int count;
+        mtp_dataset_blob_t blob[CONFIG_MTP_DATASET_CACHE_ENTRIES];
+    } datasets;
 };
 
 typedef struct {
@@ -215,9 +232,110 @@ mtp_responder_t* mtp_responder_alloc(void)
     return malloc(sizeof(mtp_responder_t));
 }
 
+/* Space left for a dataset after container header */
+static uint32_t payload_size(const mtp_responder_t *mtp)
+{
+    return mtp->buf_size - MTP_CONTAINER_HEADER_SIZE;
+}
+
+static void free_datasets(mtp_responder_t *mtp)
+{
+    free(mtp->datasets.data);
+    mtp->datasets.data = NULL;
+    mtp->datasets.size = 0;
+    mtp->datasets.count = 0;
+}
+
+static int add_dataset(mtp_responder_t *mtp, uint16_t opcode, uint16_t param,
+        const uint8_t *data, uint32_t length)
+{
+    mtp_dataset_blob_t *blob;
+    uint8_t *grown;
+
+    if (mtp->datasets.count == CONFIG_MTP_DATASET_CACHE_ENTRIES)
+        return -1;
+
+    grown = realloc(mtp->datasets.data, mtp->datasets.size + length);
+    if (!grown)
+        return -1;
+    memcpy(grown + mtp->datasets.size, data, length);
+
+    blob = &mtp->datasets.blob[mtp->datasets.count++];
+    blob->opcode = opcode;
+    blob->param = param;
+    blob->offset = mtp->datasets.size;
+    blob->length = length;
+    mtp->datasets.data = grown;
+    mtp->datasets.size += length;
+    return 0;
+}
+
+/* Host asks for these datasets over and over again (per format code), but
+ * they never change. Serialize each once into data buffer and keep a copy.
+ * Any failure leaves responder serializing on request, as before. */
+static void cache_datasets(mtp_responder_t *mtp)
+{
+    uint16_t prop_codes[CONFIG_MTP_DATASET_CACHE_ENTRIES];
+    uint8_t *scratch;
+    uint32_t length;
+    uint32_t count;
+    uint32_t i;
+
+    free_datasets(mtp);
+    if (!mtp->device_info || !mtp->buffer)
+        return;
+    scratch = (uint8_t *)mtp->cntr->payload;
+
+    length = serialize_device_info(mtp->device_info, scratch, payload_size(mtp));
+    if (!length || add_dataset(mtp, MTP_OPERATION_GET_DEVICE_INFO, 0, scratch, length))
+        goto cache_datasets_fail;
+
+    length = serialize_object_props_supported(scratch, payload_size(mtp));
+    if (length < 4 || add_dataset(mtp, MTP_OPERATION_GET_OBJECT_PROPS_SUPPORTED, 0, scratch, length))
+        goto cache_datasets_fail;
+
+    memcpy(&count, scratch, sizeof(count));
+    if (count > (length - 4) / 2 || count > CONFIG_MTP_DATASET_CACHE_ENTRIES - 2)
+        goto cache_datasets_fail;
+    memcpy(prop_codes, scratch + 4, count * sizeof(uint16_t));
+
+    for (i = 0; i < count; i++)
+    {
+        length = serialize_object_prop_desc(prop_codes[i], scratch, payload_size(mtp));
+        if (!length || add_dataset(mtp, MTP_OPERATION_GET_OBJECT_PROP_DESC, prop_codes[i], scratch, length))
+            goto cache_datasets_fail;
+    }
+    return;
+
+cache_datasets_fail:
+    log_error("Failed to cache datasets, serializing on request");
+    free_datasets(mtp);
+}
+
+/* Copy cached dataset to data phase. Returns false if it isn't cached. */
+static bool get_cached_dataset(mtp_responder_t *mtp, uint16_t opcode, uint16_t param)
+{
+    const mtp_dataset_blob_t *blob;
+    int i;
+
+    for (i = 0; i < mtp->datasets.count; i++)
+    {
+        blob = &mtp->datasets.blob[i];
+        if (blob->opcode == opcode && blob->param == param)
+        {
+            memcpy(mtp->cntr->payload, mtp->datasets.data + blob->offset, blob->length);
+            mtp->transaction.total = blob->length;
+            mtp->transaction.in_buffer = blob->length;
+            return true;
+        }
+    }
+    return false;
+}
+
 void mtp_responder_free(mtp_responder_t *mtp)
 {
     assert(mtp);
+    free_datasets(mtp);
     free(mtp);
 }
 
@@ -226,6 +344,13 @@ void mtp_responder_set_data_buffer(mtp_responder_t *mtp, void *buffer, size_t si
     assert(mtp && buffer);
     mtp->buffer = buffer;
     mtp->buf_size = size;
+    cache_datasets(mtp);
+}
+
+void mtp_responder_set_header_buffer(mtp_responder_t *mtp, void *header)
+{
+    assert(mtp);
+    mtp->header = (mtp_cntr_hdr_t *)header;
 }
 
 int mtp_responder_set_device_info(mtp_responder_t *mtp,
@@ -240,6 +365,7 @@ int mtp_responder_set_device_info(mtp_responder_t *mtp,
         return -1;
     }
     mtp->device_info = info;
+    cache_datasets(mtp);
     return 0;
 }
 
@@ -263,12 +389,12 @@ void mtp_responder_bind_storage_lock(mtp_responder_t *mtp, bool *lock)
     mtp->storage_lock = lock;
 }
 
-static void set_data_header(mtp_responder_t *mtp)
+static void set_data_header(mtp_responder_t *mtp, mtp_cntr_hdr_t *header)
 {
-    mtp->cntr->header.type = MTP_CONTAINER_TYPE_DATA;
-    mtp->cntr->header.operation_code = mtp->transaction.opcode;
-    mtp->cntr->header.transaction_id = mtp->transaction.id;
-    mtp->cntr->header.length = MTP_CONTAINER_HEADER_SIZE + mtp->transaction.total;
+    header->type = MTP_CONTAINER_TYPE_DATA;
+    header->operation_code = mtp->transaction.opcode;
+    header->transaction_id = mtp->transaction.id;
+    header->length = MTP_CONTAINER_HEADER_SIZE + mtp->transaction.total;
 }
 
 static uint16_t operation_open_session(mtp_responder_t *mtp, const mtp_op_cntr_t *request)
@@ -284,9 +410,15 @@ static uint16_t operation_open_session(mtp_responder_t *mtp, const mtp_op_cntr_t
 static uint16_t operation_get_device_info(mtp_responder_t *mtp, const mtp_op_cntr_t *request)
 {
     uint8_t *payload = (uint8_t *)mtp->cntr->payload;
-    uint32_t total = serialize_device_info(mtp->device_info, payload);
+    uint32_t total;
     UNUSED(request);
 
+    if (get_cached_dataset(mtp, MTP_OPERATION_GET_DEVICE_INFO, 0))
+        return MTP_RESPONSE_OK;
+
+    total = serialize_device_info(mtp->device_info, payload, payload_size(mtp));
+    if (!total)
+        return MTP_RESPONSE_GENERAL_ERROR;
     mtp->transaction.total = total;
     mtp->transaction.in_buffer = total;
 
@@ -313,9 +445,12 @@ static uint16_t operation_close_session(mtp_responder_t *mtp, const mtp_op_cntr_
 static uint16_t operation_get_storage_ids(mtp_responder_t *mtp, const mtp_op_cntr_t *request)
 {
     uint8_t *payload = (uint8_t *)mtp->cntr->payload;
-    uint32_t total = serialize_storage_ids(&mtp->storage, 1, payload);
+    uint32_t total = serialize_storage_ids(&mtp->storage, 1, payload, payload_size(mtp));
     UNUSED(request);
 
+    if (!total)
+        return MTP_RESPONSE_GENERAL_ERROR;
+
     mtp->transaction.total = total;
     mtp->transaction.in_buffer = total;
 
@@ -340,7 +475,11 @@ static uint16_t operation_get_storage_info(mtp_responder_t *mtp, const mtp_op_cn
         }
 
         uint8_t *payload = (uint8_t *)mtp->cntr->payload;
-        uint32_t total = serialize_storage_info(&mtp->storage, payload);
+        uint32_t total = serialize_storage_info(&mtp->storage, payload, payload_size(mtp));
+        if (!total) {
+            error = MTP_RESPONSE_GENERAL_ERROR;
+            break;
+        }
         mtp->transaction.total = total;
         mtp->transaction.in_buffer = total;
         error = MTP_RESPONSE_OK;
@@ -427,7 +566,12 @@ static uint16_t operation_get_object_info(mtp_responder_t *mtp, const mtp_op_cnt
         goto get_object_info_exit;
     }
 
-    uint32_t total = serialize_object_info(&info, payload);
+    uint32_t total = serialize_object_info(&info, payload, payload_size(mtp));
+    if (!total)
+    {
+        error = MTP_RESPONSE_GENERAL_ERROR;
+        goto get_object_info_exit;
+    }
     mtp->transaction.total = total;
     mtp->transaction.in_buffer = total;
     error = MTP_RESPONSE_OK;
@@ -445,7 +589,13 @@ static uint16_t operation_get_object_props_supported(mtp_responder_t *mtp,
 
     if (is_format_code_supported(format_code))
     {
-        uint32_t total = serialize_object_props_supported(payload);
+        if (get_cached_dataset(mtp, MTP_OPERATION_GET_OBJECT_PROPS_SUPPORTED, 0))
+            return MTP_RESPONSE_OK;
+
+        uint32_t total = serialize_object_props_supported(payload, payload_size(mtp));
+        if (!total)
+            return MTP_RESPONSE_GENERAL_ERROR;
+
         mtp->transaction.total = total;
         mtp->transaction.in_buffer = total;
         error = MTP_RESPONSE_OK;
@@ -468,13 +618,25 @@ static uint16_t operation_get_object_prop_desc(mtp_responder_t *mtp,
         goto get_object_prop_desc_exit;
     }
 
-    uint32_t total = serialize_object_prop_desc(prop_code, payload);
-    if (!total)
+    if (get_cached_dataset(mtp, MTP_OPERATION_GET_OBJECT_PROP_DESC, prop_code))
+    {
+        error = MTP_RESPONSE_OK;
+        goto get_object_prop_desc_exit;
+    }
+
+    if (!is_object_prop_supported(prop_code))
     {
         error = MTP_RESPONSE_INVALID_OBJECT_PROP_CODE;
         goto get_object_prop_desc_exit;
     }
 
+    uint32_t total = serialize_object_prop_desc(prop_code, payload, payload_size(mtp));
+    if (!total)
+    {
+        error = MTP_RESPONSE_GENERAL_ERROR;
+        goto get_object_prop_desc_exit;
+    }
+
     mtp->transaction.total = total;
     mtp->transaction.in_buffer = total;
     error = MTP_RESPONSE_OK;
@@ -498,13 +660,19 @@ static uint16_t operation_get_object_prop_value(mtp_responder_t *mtp,
         goto get_object_prop_value_exit;
     }
 
-    uint32_t total = serialize_object_prop_value(prop_code, &info, payload);
-    if (total == 0)
+    if (!is_object_prop_supported(prop_code))
     {
         error = MTP_RESPONSE_INVALID_OBJECT_PROP_CODE;
         goto get_object_prop_value_exit;
     }
 
+    uint32_t total = serialize_object_prop_value(prop_code, &info, payload, payload_size(mtp));
+    if (total == 0)
+    {
+        error = MTP_RESPONSE_GENERAL_ERROR;
+        goto get_object_prop_value_exit;
+    }
+
     mtp->transaction.total = total;
     mtp->transaction.in_buffer = total;
     error = MTP_RESPONSE_OK;
@@ -552,22 +720,31 @@ static uint16_t operation_get_object(mtp_responder_t *mtp,
         goto get_object_exit;
     }
 
-    size_t empty_space = (mtp->buf_size - MTP_CONTAINER_HEADER_SIZE);
+    /* With a header buffer object data starts at the beginning of the data
+     * buffer, like the chunks that follow it */
+    uint8_t *payload = mtp->header ? (uint8_t *)mtp->buffer : (uint8_t *)mtp->cntr->payload;
+    size_t empty_space = mtp->header ? mtp->buf_size : (mtp->buf_size - MTP_CONTAINER_HEADER_SIZE);
     uint32_t total = info.size;
+    uint32_t in_buffer = 0;
 
-    int data_read = mtp->storage.api->read(mtp->storage.api_arg,
-                           mtp->cntr->payload,
-                           empty_space);
-    if (data_read < 0)
+    while (in_buffer < empty_space && in_buffer < total)
     {
-        mtp->storage.api->close(mtp->storage.api_arg);
-        error = MTP_RESPONSE_INCOMPLETE_TRANSFER;
-        goto get_object_exit;
-
+        int data_read = mtp->storage.api->read(mtp->storage.api_arg,
+                               payload + in_buffer,
+                               empty_space - in_buffer);
+        if (data_read < 0)
+        {
+            mtp->storage.api->close(mtp->storage.api_arg);
+            error = MTP_RESPONSE_INCOMPLETE_TRANSFER;
+            goto get_object_exit;
+        }
+        if (data_read == 0)
+            break;
+        in_buffer += data_read;
     }
 
     mtp->transaction.total = total;
-    mtp->transaction.in_buffer = data_read;
+    mtp->transaction.in_buffer = in_buffer;
     error = MTP_RESPONSE_OK;
 
 get_object_exit:
@@ -631,6 +808,7 @@ static uint16_t handle_command(mtp_responder_t *mtp, const mtp_op_cntr_t *reques
 
     mtp->transaction.id = request->header.transaction_id;
     mtp->transaction.opcode = request->header.operation_code;
+    mtp->transaction.data_status = MTP_RESPONSE_OK;
     if (!mtp->transaction.keep)
     {
         mtp->transaction.in_buffer = 0;
@@ -859,9 +1037,20 @@ size_t mtp_responder_get_data(mtp_responder_t *mtp)
     assert(mtp);
     size_t cntr_length = 0;
 
-    if (mtp->transaction.in_buffer)
+    mtp->transaction.header_length = 0;
+
+    if (mtp->transaction.in_buffer && mtp->header && mtp->transaction.opcode == MTP_OPERATION_GET_OBJECT)
     {
-        set_data_header(mtp);
+        set_data_header(mtp, mtp->header);
+        mtp->transaction.header_length = MTP_CONTAINER_HEADER_SIZE;
+        cntr_length = mtp->transaction.in_buffer;
+        mtp->transaction.sent = mtp->transaction.in_buffer;
+        log_info("DT> %s: %d", dbg_operation(mtp->transaction.opcode), mtp->transaction.in_buffer);
+        mtp->transaction.in_buffer = 0;
+    }
+    else if (mtp->transaction.in_buffer)
+    {
+        set_data_header(mtp, &mtp->cntr->header);
         cntr_length = MTP_CONTAINER_HEADER_SIZE + mtp->transaction.in_buffer;
         mtp->transaction.sent = mtp->transaction.in_buffer;
         log_info("DT> %s: %d", dbg_operation(mtp->transaction.opcode), mtp->transaction.in_buffer);
@@ -889,10 +1078,27 @@ size_t mtp_responder_get_data(mtp_responder_t *mtp)
     {
         if (mtp->transaction.sent < mtp->transaction.total)
         {
-            cntr_length = mtp->storage.api->read(mtp->storage.api_arg,
-                           mtp->buffer,
-                           mtp->buf_size);
-            mtp->transaction.sent += cntr_length;
+            /* Storage may return less than asked for, keep reading until
+             * the buffer is full, so transport gets as few chunks as possible */
+            while (cntr_length < mtp->buf_size && mtp->transaction.sent < mtp->transaction.total)
+            {
+                int data_read = mtp->storage.api->read(mtp->storage.api_arg,
+                               (uint8_t *)mtp->buffer + cntr_length,
+                               mtp->buf_size - cntr_length);
+                if (data_read < 0)
+                {
+                    /* Data phase ends here, the response carries the error */
+                    mtp->storage.api->close(mtp->storage.api_arg);
+                    mtp->transaction.file_open = false;
+                    mtp->transaction.data_status = MTP_RESPONSE_INCOMPLETE_TRANSFER;
+                    log_error("DT+> %s: read failed", dbg_operation(mtp->transaction.opcode));
+                    return 0;
+                }
+                if (data_read == 0)
+                    break;
+                cntr_length += data_read;
+                mtp->transaction.sent += data_read;
+            }
 
             log_info("DT+> %s: +%d", dbg_operation(mtp->transaction.opcode), cntr_length);
         } else if (mtp->transaction.sent && mtp->transaction.sent >= mtp->transaction.total)
@@ -905,6 +1111,17 @@ size_t mtp_responder_get_data(mtp_responder_t *mtp)
     return cntr_length;
 }
 
+size_t mtp_responder_get_data_header_size(mtp_responder_t *mtp)
+{
+    assert(mtp);
+    return mtp->transaction.header_length;
+}
+
+uint16_t mtp_responder_get_data_status(mtp_responder_t *mtp)
+{
+    return mtp->transaction.data_status;
+}
+
 bool mtp_responder_data_transaction_open(mtp_responder_t *mtp)
 {
     return (mtp->transaction.received) > 0 && (mtp->transaction.received < mtp->transaction.total);
@@ -1020,6 +1237,7 @@ void mtp_responder_transaction_reset(mtp_responder_t *mtp)
     mtp->transaction.sent = 0;
     mtp->transaction.received = 0;
     mtp->transaction.in_buffer = 0;
+    mtp->transaction.data_status = MTP_RESPONSE_OK;
     mtp->transaction.handle = 0;
     log_info("mtp_responder: reset %u", (unsigned int) mtp->transaction.id);
 }
@@ -15,6 +15,10 @@
 /* TODO: need to implement this */
 #define CONFIG_MTP_OBJECTS_PER_NODE
 
+/* Immutable datasets (device info, supported properties and their
+ * descriptions) serialized once and served from memory */
+#define CONFIG_MTP_DATASET_CACHE_ENTRIES 16
+
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -46,7 +50,8 @@ void mtp_responder_init(mtp_responder_t *mtp);
 /** @brief Free memory allocated by @mtp_responder_alloc */
 void mtp_responder_free(mtp_responder_t *mtp);
 
-/** @brief Set device specific data
+/** @brief Set device specific data. Once data buffer is set too, immutable
+ *         datasets are serialized and cached, so info must not change later.
  *  @param mtp library handle
  *  @param info about device
  *  @return zero on success
@@ -76,9 +81,20 @@ void mtp_responder_bind_storage_lock(mtp_responder_t *mtp, bool *lock);
 /** @brief Setup space for store data coming from handled request
  *  @param buffer pinter to memory to store data
  *  @param size of buffer
+ *  @note the buffer is also scratch space for caching immutable datasets
+ *  @note size is not tied to the USB packet size, mtp_responder_get_data()
+ *        fills the whole buffer and transport splits it into packets
  *  */
 void mtp_responder_set_data_buffer(mtp_responder_t *mtp, void *buffer, size_t size);
 
+/** @brief Setup space for the data container header of object data
+ *  @param header pointer to MTP_CONTAINER_HEADER_SIZE bytes of memory
+ *  @note object data then starts at the beginning of the data buffer and
+ *        the transport sends the header in front of it, see
+ *        mtp_responder_get_data_header_size()
+ *  */
+void mtp_responder_set_header_buffer(mtp_responder_t *mtp, void *header);
+
 
 void mtp_responder_handle_event(mtp_responder_t *mtp, void *event);
 
@@ -101,6 +117,21 @@ uint16_t mtp_responder_handle_request(mtp_responder_t *mtp,
  *  */
 size_t mtp_responder_get_data(mtp_responder_t *mtp);
 
+/** @brief Size of the container header written to the header buffer by the
+ *         last mtp_responder_get_data() call
+ *  @param mtp library handle
+ *  @returns MTP_CONTAINER_HEADER_SIZE when the header has to be sent in front
+ *           of the data buffer, zero when the data buffer holds it already
+ *  */
+size_t mtp_responder_get_data_header_size(mtp_responder_t *mtp);
+
+/** @brief Status of the data phase ended by mtp_responder_get_data()
+ *  @param mtp library handle
+ *  @returns MTP_RESPONSE_OK or error code to be sent in response instead of
+ *           the one returned by mtp_responder_handle_request()
+ *  */
+uint16_t mtp_responder_get_data_status(mtp_responder_t *mtp);
+
 /** @brief Tells if incoming frame is container with header or just data that
  *         didn't fit in previous frames
  *  @param mtp library handle
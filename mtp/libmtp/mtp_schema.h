@@ -0,0 +1,234 @@
+/*
+ * Copyright  Onplick <info@onplick.com> - All Rights Reserved
+ * Unauthorized copying of this file, via any medium is strictly prohibited
+ * Proprietary and confidential
+ */
+#ifndef _MTP_SCHEMA_H
+#define _MTP_SCHEMA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "mtp_util.h"
+
+/*
+ * Datasets are described by schemas: X-macro lists of fixed width fields
+ *
+ *   #define MY_SCHEMA(FIELD, RESERVED, arg) \
+ *       FIELD(uint32_t, storage_id, (arg)->storage_id) \
+ *       RESERVED(uint16_t, thumb_format, 0)
+ *
+ * FIELD value is an expression when encoding and an lvalue when decoding.
+ * RESERVED value is a constant written when encoding and skipped when
+ * decoding. A schema becomes
+ * packed struct, so all its fields are moved with a single memcpy. Strings,
+ * dates and arrays in between are written with mtp_writer_put_* functions.
+ */
+#define MTP_SCHEMA_MEMBER(type, name, ...) type name;
+#define MTP_SCHEMA_ENCODE_FIELD(type, name, value) .name = (type)(value),
+#define MTP_SCHEMA_ENCODE_RESERVED(type, name, value) .name = (type)(value),
+#define MTP_SCHEMA_DECODE_FIELD(type, name, value) (value) = fields.name;
+#define MTP_SCHEMA_DECODE_RESERVED(type, name, value)
+
+#define MTP_SCHEMA_STRUCT(tag, SCHEMA) \
+    struct __attribute__((packed)) tag { SCHEMA(MTP_SCHEMA_MEMBER, MTP_SCHEMA_MEMBER, 0) }
+
+#define MTP_SCHEMA_PUT(writer, tag, SCHEMA, arg) do { \
+        const struct tag fields = { SCHEMA(MTP_SCHEMA_ENCODE_FIELD, MTP_SCHEMA_ENCODE_RESERVED, arg) }; \
+        mtp_writer_put(writer, &fields, sizeof(fields)); \
+    } while (0)
+
+#define MTP_SCHEMA_GET(reader, tag, SCHEMA, arg) do { \
+        struct tag fields; \
+        if (mtp_reader_get(reader, &fields, sizeof(fields)) == 0) { \
+            SCHEMA(MTP_SCHEMA_DECODE_FIELD, MTP_SCHEMA_DECODE_RESERVED, arg) \
+        } \
+    } while (0)
+
+/* YYYYMMDDThhmmss+hhmm with terminating null */
+#define MTP_SCHEMA_DATE_MAX_SIZE (1 + 21 * 2)
+
+/* Chunk sink, called with full output buffer. Returns zero on success. */
+typedef int (*mtp_writer_flush_t)(void *arg, const uint8_t *data, uint32_t length);
+
+typedef struct {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t length;
+    uint32_t flushed;
+    bool overflow;
+    mtp_writer_flush_t flush;
+    void *flush_arg;
+} mtp_writer_t;
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t length;
+    uint32_t offset;
+    bool error;
+} mtp_reader_t;
+
+static inline void mtp_writer_init(mtp_writer_t *writer, uint8_t *data, uint32_t size)
+{
+    memset(writer, 0, sizeof(mtp_writer_t));
+    writer->data = data;
+    writer->size = size;
+}
+
+/* Output goes to flush in chunks of buffer size instead of failing when
+ * buffer is full */
+static inline void mtp_writer_set_flush(mtp_writer_t *writer, mtp_writer_flush_t flush, void *arg)
+{
+    writer->flush = flush;
+    writer->flush_arg = arg;
+}
+
+static inline bool mtp_writer_flush(mtp_writer_t *writer)
+{
+    if (!writer->flush || writer->flush(writer->flush_arg, writer->data, writer->length))
+    {
+        writer->overflow = true;
+        return false;
+    }
+    writer->flushed += writer->length;
+    writer->length = 0;
+    return true;
+}
+
+static inline void mtp_writer_put(mtp_writer_t *writer, const void *data, uint32_t length)
+{
+    const uint8_t *in = data;
+    uint32_t chunk;
+
+    while (!writer->overflow && length)
+    {
+        if (writer->length == writer->size && !mtp_writer_flush(writer))
+            return;
+        chunk = writer->size - writer->length;
+        if (chunk > length)
+            chunk = length;
+        memcpy(writer->data + writer->length, in, chunk);
+        writer->length += chunk;
+        in += chunk;
+        length -= chunk;
+    }
+}
+
+/* Returns contiguous space for at most length bytes or NULL */
+static inline uint8_t *mtp_writer_reserve(mtp_writer_t *writer, uint32_t length)
+{
+    if (writer->overflow)
+        return NULL;
+    if (writer->size - writer->length < length && !mtp_writer_flush(writer))
+        return NULL;
+    if (writer->size - writer->length < length)
+    {
+        writer->overflow = true;
+        return NULL;
+    }
+    return writer->data + writer->length;
+}
+
+static inline void mtp_writer_put_string(mtp_writer_t *writer, const char *text)
+{
+    uint8_t *out;
+
+    if (writer->overflow)
+        return;
+    out = mtp_writer_reserve(writer, (uint32_t)string_size(text));
+    if (out)
+        writer->length += put_string(out, text);
+}
+
+static inline void mtp_writer_put_date(mtp_writer_t *writer, time_t time)
+{
+    uint8_t *out = mtp_writer_reserve(writer, MTP_SCHEMA_DATE_MAX_SIZE);
+    if (out)
+        writer->length += put_date(out, time);
+}
+
+static inline void mtp_writer_put_array(mtp_writer_t *writer, const void *array, uint32_t count, uint32_t element_size)
+{
+    mtp_writer_put(writer, &count, sizeof(count));
+    mtp_writer_put(writer, array, count * element_size);
+}
+
+static inline void mtp_writer_put_zero(mtp_writer_t *writer, uint32_t length)
+{
+    static const uint8_t zero[16];
+    uint32_t chunk;
+
+    while (length)
+    {
+        chunk = length < sizeof(zero) ? length : sizeof(zero);
+        mtp_writer_put(writer, zero, chunk);
+        length -= chunk;
+    }
+}
+
+/* Returns dataset length, zero if it didn't fit */
+static inline uint32_t mtp_writer_finish(const mtp_writer_t *writer)
+{
+    return writer->overflow ? 0 : writer->flushed + writer->length;
+}
+
+static inline void mtp_reader_init(mtp_reader_t *reader, const uint8_t *data, uint32_t length)
+{
+    memset(reader, 0, sizeof(mtp_reader_t));
+    reader->data = data;
+    reader->length = length;
+}
+
+static inline int mtp_reader_get(mtp_reader_t *reader, void *out, uint32_t length)
+{
+    if (reader->error || reader->length - reader->offset < length)
+    {
+        reader->error = true;
+        return -1;
+    }
+    memcpy(out, reader->data + reader->offset, length);
+    reader->offset += length;
+    return 0;
+}
+
+/* String must fit in dataset as announced by its count */
+static inline bool mtp_reader_has_string(const mtp_reader_t *reader)
+{
+    uint32_t left = reader->length - reader->offset;
+    return !reader->error && left > 0
+        && 1 + reader->data[reader->offset] * sizeof(uint16_t) <= left;
+}
+
+static inline int mtp_reader_get_string(mtp_reader_t *reader, char *text, int size)
+{
+    int length;
+
+    if (!mtp_reader_has_string(reader))
+    {
+        reader->error = true;
+        return -1;
+    }
+    length = get_string(reader->data + reader->offset, text, size);
+    if (length <= 0)
+    {
+        reader->error = true;
+        return -1;
+    }
+    reader->offset += length;
+    return 0;
+}
+
+/* Dates are optional, unparsable one is skipped without failing the dataset */
+static inline int mtp_reader_get_date(mtp_reader_t *reader, time_t *time)
+{
+    const uint8_t *date = reader->data + reader->offset;
+
+    if (!mtp_reader_has_string(reader))
+        return -1;
+    reader->offset += 1 + date[0] * sizeof(uint16_t);
+    return get_date(date, time) > 0 ? 0 : -1;
+}
+
+#endif /* _MTP_SCHEMA_H */
@@ -6,6 +6,7 @@
 #include "mtp_responder.h"
 #include "mtp_storage.h"
 #include "mtp_util.h"
+#include "mtp_schema.h"
 #include <string.h>
 
 typedef struct {
@@ -32,300 +33,208 @@ static const obj_property_t properties[] =
 };
 static const int properties_num = sizeof(properties) / sizeof(obj_property_t);
 
-uint32_t serialize_storage_list(mtp_storage_t *storage, uint32_t parent, uint8_t *data)
-{
-    uint32_t handle = 0;
-    uint32_t count = 0;
-    uint32_t *ptr = (uint32_t*)(data + 4);
-
-    if ((handle = storage->api->find_first(storage->api_arg, parent, &count))) {
-        *ptr++ = handle;
-        while((handle = storage->api->find_next(storage->api_arg))) {
-            *ptr++ = handle;
-        }
-    }
-    *(uint32_t*)data = count;
-    return (1 + count)*sizeof(uint32_t);
-}
+/* ObjectInfo dataset up to the Filename */
+#define MTP_OBJECT_INFO_HEAD(FIELD, RESERVED, info) \
+    FIELD(uint32_t, storage_id, (info)->storage_id) \
+    FIELD(uint16_t, format_code, (info)->format_code) \
+    FIELD(uint16_t, protection, (info)->protection) \
+    FIELD(uint32_t, compressed_size, (info)->size) /* size is 64 bit, but dataset can handle only 32 bit */ \
+    RESERVED(uint16_t, thumb_format, 0) \
+    RESERVED(uint32_t, thumb_compressed_size, 0) \
+    RESERVED(uint32_t, thumb_pix_width, 0) \
+    RESERVED(uint32_t, thumb_pix_height, 0) \
+    RESERVED(uint32_t, image_pix_width, 0) \
+    RESERVED(uint32_t, image_pix_height, 0) \
+    RESERVED(uint32_t, image_bit_depth, 0) \
+    FIELD(uint32_t, parent, (info)->parent) \
+    FIELD(uint16_t, association_type, (info)->association_type) \
+    FIELD(uint32_t, association_desc, (info)->association_desc) \
+    RESERVED(uint32_t, sequence_number, 0)
+
+MTP_SCHEMA_STRUCT(object_info_head, MTP_OBJECT_INFO_HEAD);
 
-uint32_t serialize_object_info(mtp_object_info_t* info, uint8_t *data)
-{
-    uint32_t length = 0;
-    length += put_32(data + length, info->storage_id);
-    length += put_16(data + length, info->format_code);
-    length += put_16(data + length, info->protection);
-    length += put_32(data + length, info->size); /* size is 64 bit, but this call can handle only 32 bit */
-    length += put_16(data + length, 0);
-    length += put_32(data + length, 0);
-    length += put_32(data + length, 0);
-    length += put_32(data + length, 0);
-    length += put_32(data + length, 0);
-    length += put_32(data + length, 0);
-    length += put_32(data + length, 0);
-    length += put_32(data + length, info->parent);
-    length += put_16(data + length, info->association_type);
-    length += put_32(data + length, info->association_desc);
-    length += put_32(data + length, 0);
-    length += put_string(data + length, info->filename);
-    length += put_date(data + length, info->created);
-    length += put_date(data + length, info->modified);
-    length += put_string(data + length, NULL);
-    return length;
-}
-
-int deserialize_object_info(const uint8_t *data, size_t length, mtp_object_info_t *info)
+typedef struct {
+    const mtp_storage_properties_t *props;
+    uint64_t free_space;
+} storage_info_t;
+
+/* StorageInfo dataset up to the Storage Description */
+#define MTP_STORAGE_INFO_HEAD(FIELD, RESERVED, info) \
+    FIELD(uint16_t, type, (info)->props->type) \
+    FIELD(uint16_t, fs_type, (info)->props->fs_type) \
+    FIELD(uint16_t, access_caps, (info)->props->access_caps) \
+    FIELD(uint64_t, capacity, (info)->props->capacity) \
+    FIELD(uint64_t, free_space, (info)->free_space) \
+    RESERVED(uint32_t, free_objects, 0xffffffff)
+
+MTP_SCHEMA_STRUCT(storage_info_head, MTP_STORAGE_INFO_HEAD);
+
+/* ObjectPropDesc dataset, the Default Value goes in between */
+#define MTP_PROP_DESC_HEAD(FIELD, RESERVED, prop) \
+    FIELD(uint16_t, code, (prop)->id) \
+    FIELD(uint16_t, type, (prop)->type) \
+    FIELD(uint8_t, get_set, (prop)->writeable ? 1 : 0)
+
+#define MTP_PROP_DESC_TAIL(FIELD, RESERVED, prop) \
+    RESERVED(uint32_t, group, 0) \
+    FIELD(uint8_t, form, (prop)->form)
+
+MTP_SCHEMA_STRUCT(prop_desc_head, MTP_PROP_DESC_HEAD);
+MTP_SCHEMA_STRUCT(prop_desc_tail, MTP_PROP_DESC_TAIL);
+
+static uint32_t type_size(uint16_t type)
 {
-    const uint8_t *ptr = data;
-    int returned_length;
-    info->storage_id = *(uint32_t*)ptr; ptr += 4;
-    info->format_code = *(uint16_t*)ptr; ptr += 2;
-    info->protection =  *(uint16_t*)ptr; ptr += 2;
-    info->size = *(uint32_t*)ptr; ptr += 4;
-    ptr += 1 * sizeof(uint16_t);
-    ptr += 6 * sizeof(uint32_t);
-    info->parent = *(uint32_t*)ptr; ptr += 4;
-    info->association_type =  *(uint16_t*)ptr; ptr += 2;
-    info->association_desc = *(uint32_t*)ptr; ptr += 4;
-    ptr += sizeof(uint32_t);
-
-    returned_length = get_string(ptr, info->filename, sizeof(info->filename));
-    if (returned_length <= 0) {
-        return -1;
-    }
-    ptr += returned_length;
-
-    returned_length = get_date(ptr, &info->created);
-    if (returned_length > 0) {
-        ptr += returned_length;
-    }
-
-    returned_length = get_date(ptr, &info->modified);
-    if (returned_length > 0) {
-        ptr += returned_length;
+    switch (type)
+    {
+        case MTP_TYPE_UINT16:
+            return 2;
+        case MTP_TYPE_UINT32:
+            return 4;
+        case MTP_TYPE_UINT64:
+            return 8;
+        case MTP_TYPE_UINT128:
+            return 16;
+        case MTP_TYPE_STR:
+            return 1; /* empty string */
     }
-    
     return 0;
 }
 
-uint32_t serialize_object_props_supported(uint8_t *data)
+static const obj_property_t *find_property(uint16_t prop_code)
 {
     int i;
-    uint16_t *item;
-    uint32_t length = 0;
-
-    item = (uint16_t *)(data + 4);
-    for (i = 0; i < properties_num; i++) {
-        item[i] = properties[i].id;
+    for (i = 0; i < properties_num; i++)
+    {
+        if (properties[i].id == prop_code)
+            return &properties[i];
     }
-    *(uint32_t *)data = properties_num;
-    length = 4 + 2 * properties_num;
-    return length;
+    return NULL;
 }
 
-uint32_t serialize_storage_info(mtp_storage_t *storage, uint8_t *data)
+bool is_object_prop_supported(uint16_t prop_code)
 {
-    const struct mtp_storage_api *api = storage->api;
-    const struct mtp_storage_props *p = api->get_properties(storage->api_arg);
-    uint32_t length = 0;
-    length += put_16(data + length, p->type);
-    length += put_16(data + length, p->fs_type);
-    length += put_16(data + length, p->access_caps);
-    length += put_64(data + length, p->capacity);
-    length += put_64(data + length, api->get_free_space(storage->api_arg));
-    length += put_32(data + length, 0xffffffff);
-    length += put_string(data + length, p->description);
-    length += put_string(data + length, p->volume_id);
-    return length;
+    return find_property(prop_code) != NULL;
 }
 
-uint32_t serialize_storage_ids(mtp_storage_t *storage, int count, uint8_t *data)
+uint32_t serialize_storage_list(mtp_storage_t *storage, uint32_t parent, uint8_t *data, uint32_t size)
 {
-    int i;
-    uint32_t *size = (uint32_t*)data;
-    uint32_t *values = (uint32_t*)&data[4];
-
-    *size = (uint32_t)count;
-    for(i = 0; i < count; i++)
-        values[i] = storage->id;
-
-    return 4*(count+1);
+    uint32_t handle = 0;
+    uint32_t count = 0;
+    mtp_writer_t writer;
+
+    mtp_writer_init(&writer, data, size);
+    handle = storage->api->find_first(storage->api_arg, parent, &count);
+    mtp_writer_put(&writer, &count, sizeof(count));
+    while (handle) {
+        mtp_writer_put(&writer, &handle, sizeof(handle));
+        handle = storage->api->find_next(storage->api_arg);
+    }
+    return mtp_writer_finish(&writer);
 }
 
-static uint32_t serialize_type_desc_uint16(const obj_property_t *prop, uint8_t *data)
+uint32_t serialize_object_info(mtp_object_info_t* info, uint8_t *data, uint32_t size)
 {
-    *(uint16_t*)data = prop->id;                     /* Property Code*/
-    *(uint16_t*)(data + 2) = MTP_TYPE_UINT16;        /* Datatype */
-    *(uint8_t*)(data + 4) = prop->writeable ? 1 : 0; /* Get/GetSet */
-    *(uint16_t*)(data + 5) = 0;                      /* Default value*/
-    *(uint32_t*)(data + 7) = 0;                      /* Group */
-    *(uint8_t*)(data + 11) = 0;                      /* Form */
-    return 12;
+    mtp_writer_t writer;
+    mtp_writer_init(&writer, data, size);
+    MTP_SCHEMA_PUT(&writer, object_info_head, MTP_OBJECT_INFO_HEAD, info);
+    mtp_writer_put_string(&writer, info->filename);
+    mtp_writer_put_date(&writer, info->created);
+    mtp_writer_put_date(&writer, info->modified);
+    mtp_writer_put_string(&writer, NULL);
+    return mtp_writer_finish(&writer);
 }
 
-static uint32_t serialize_type_desc_uint32(const obj_property_t *prop, uint8_t *data)
+int deserialize_object_info(const uint8_t *data, size_t length, mtp_object_info_t *info)
 {
-    *(uint16_t*)data = prop->id;                      /* Property Code*/
-    *(uint16_t*)(data + 2) = MTP_TYPE_UINT32;         /* Datatype */
-    *(uint8_t*)(data + 4) = prop->writeable ? 1 : 0;  /* Get/GetSet */
-    *(uint32_t*)(data + 5) = 0;                       /* Default value*/
-    *(uint32_t*)(data + 9) = 0;                       /* Group */
-    *(uint8_t*)(data + 13) = 0;                       /* Form */
-    return 14;
-}
+    mtp_reader_t reader;
+    mtp_reader_init(&reader, data, length);
+    MTP_SCHEMA_GET(&reader, object_info_head, MTP_OBJECT_INFO_HEAD, info);
 
-static uint32_t serialize_type_desc_uint64(const obj_property_t *prop, uint8_t *data)
-{
-    *(uint16_t*)data = prop->id;                       /* Property Code*/
-    *(uint16_t*)(data + 2) = MTP_TYPE_UINT64;          /* Datatype */
-    *(uint8_t*)(data + 4) = prop->writeable ? 1 : 0;   /* Get/GetSet */
-    *(uint32_t*)(data + 5) = 0;                        /* Default value*/
-    *(uint32_t*)(data + 9) = 0;
-    *(uint32_t*)(data + 13) = 0;                       /* Group */
-    *(uint8_t*)(data + 17) = 0;                        /* Form */
-    return 18;
-}
+    if (mtp_reader_get_string(&reader, info->filename, sizeof(info->filename))) {
+        return -1;
+    }
 
-static uint32_t serialize_type_desc_uint128(const obj_property_t *prop, uint8_t *data)
-{
-    *(uint16_t*)data = prop->id;                      /* Property Code*/
-    *(uint16_t*)(data + 2) = MTP_TYPE_UINT128;        /* Datatype */
-    *(uint8_t*)(data + 4) = prop->writeable ? 1 : 0;  /* Get/GetSet */
-    *(uint32_t*)(data + 5) = 0;                       /* Default value*/
-    *(uint32_t*)(data + 9) = 0;
-    *(uint32_t*)(data + 13) = 0;
-    *(uint32_t*)(data + 17) = 0;
-    *(uint32_t*)(data + 21) = 0;                      /* Group */
-    *(uint8_t*)(data + 25) = 0;                       /* Form */
-    return 26;
+    mtp_reader_get_date(&reader, &info->created);
+    mtp_reader_get_date(&reader, &info->modified);
+    return 0;
 }
 
-
-static uint32_t serialize_type_desc_str(const obj_property_t *prop, uint8_t *data)
+uint32_t serialize_object_props_supported(uint8_t *data, uint32_t size)
 {
-    *(uint16_t*)data = prop->id;                      /* Property Code*/
-    *(uint16_t*)(data + 2) = MTP_TYPE_STR;            /* Datatype */
-    *(uint8_t*)(data + 4) = prop->writeable ? 1 : 0;  /* Get/GetSet */
-    *(uint8_t*)(data + 5) = 0;                        /* Default value*/
-    *(uint32_t*)(data + 6) = 0;                       /* Group */
-    *(uint8_t*)(data + 10) = prop->form;              /* Form */
-    return 11;
-}
+    uint32_t count = (uint32_t)properties_num;
+    mtp_writer_t writer;
+    int i;
 
-static uint32_t serialize_type_desc(const obj_property_t* prop, uint8_t *data)
-{
-    uint32_t length = 0;
-    switch(prop->type)
-    {
-        case MTP_TYPE_UINT16:
-            length = serialize_type_desc_uint16(prop, data);
-            break;
-        case MTP_TYPE_UINT32:
-            length = serialize_type_desc_uint32(prop, data);
-            break;
-        case MTP_TYPE_UINT64:
-            length = serialize_type_desc_uint64(prop, data);
-            break;
-        case MTP_TYPE_UINT128:
-            length = serialize_type_desc_uint128(prop, data);
-            break;
-        case MTP_TYPE_STR:
-            length = serialize_type_desc_str(prop, data);
-            break;
+    mtp_writer_init(&writer, data, size);
+    mtp_writer_put(&writer, &count, sizeof(count));
+    for (i = 0; i < properties_num; i++) {
+        mtp_writer_put(&writer, &properties[i].id, sizeof(properties[i].id));
     }
-    return length;
+    return mtp_writer_finish(&writer);
 }
 
-uint32_t serialize_object_prop_desc(uint16_t prop_code, uint8_t *data)
+uint32_t serialize_storage_info(mtp_storage_t *storage, uint8_t *data, uint32_t size)
 {
-    uint32_t length = 0;
-    int i;
-    for(i = 0; i < properties_num; i++)
-    {
-        if (properties[i].id == prop_code)
-        {
-            length = serialize_type_desc(&properties[i], data);
-            break;
-        }
-    }
-    return length;
-}
+    const struct mtp_storage_api *api = storage->api;
+    storage_info_t info;
+    mtp_writer_t writer;
 
-static uint32_t serialize_type_value_uint16(const obj_property_t *prop, mtp_object_info_t *info, uint8_t *data)
-{
-    *(uint16_t*)data = *(uint16_t*)((uint8_t*)info + prop->offset);
-    return 2;
-}
+    info.props = api->get_properties(storage->api_arg);
+    info.free_space = api->get_free_space(storage->api_arg);
 
-static uint32_t serialize_type_value_uint32(const obj_property_t *prop, mtp_object_info_t *info, uint8_t *data)
-{
-    *(uint32_t*)data = *(uint32_t*)((uint8_t*)info + prop->offset);
-    return 4;
+    mtp_writer_init(&writer, data, size);
+    MTP_SCHEMA_PUT(&writer, storage_info_head, MTP_STORAGE_INFO_HEAD, &info);
+    mtp_writer_put_string(&writer, info.props->description);
+    mtp_writer_put_string(&writer, info.props->volume_id);
+    return mtp_writer_finish(&writer);
 }
 
-static uint32_t serialize_type_value_uint64(const obj_property_t *prop, mtp_object_info_t *info, uint8_t *data)
+uint32_t serialize_storage_ids(mtp_storage_t *storage, int count, uint8_t *data, uint32_t size)
 {
-    memcpy(data, (uint8_t*)info + prop->offset, 8);
-    return 8;
-}
+    uint32_t length = (uint32_t)count;
+    mtp_writer_t writer;
+    int i;
 
-static uint32_t serialize_type_value_uint128(const obj_property_t *prop, mtp_object_info_t *info, uint8_t *data)
-{
-    memcpy(data, (uint8_t*)info + prop->offset, 16);
-    return 16;
+    mtp_writer_init(&writer, data, size);
+    mtp_writer_put(&writer, &length, sizeof(length));
+    for (i = 0; i < count; i++)
+        mtp_writer_put(&writer, &storage->id, sizeof(storage->id));
+    return mtp_writer_finish(&writer);
 }
 
-static uint32_t serialize_type_value_str(const obj_property_t *prop, mtp_object_info_t *info, uint8_t *data)
+uint32_t serialize_object_prop_desc(uint16_t prop_code, uint8_t *data, uint32_t size)
 {
-    uint32_t length = 0;
-    if (prop->form == 0)
-    {
-        length = put_string(data, (char*)info + prop->offset);
-    }
-    else if (prop->form == 3)
-    {
-        time_t *t  = (time_t*)((uint8_t*)info + prop->offset);
-        length = put_date(data, *t);
-    }
-    return length;
-}
+    const obj_property_t *prop = find_property(prop_code);
+    mtp_writer_t writer;
 
-static uint32_t serialize_prop_value(const obj_property_t *prop, mtp_object_info_t *info, uint8_t *data)
-{
-    uint32_t length = 0;
-    switch(prop->type)
-    {
-        case MTP_TYPE_UINT16:
-            length = serialize_type_value_uint16(prop, info, data);
-            break;
-        case MTP_TYPE_UINT32:
-            length = serialize_type_value_uint32(prop, info, data);
-            break;
-        case MTP_TYPE_UINT64:
-            length = serialize_type_value_uint64(prop, info, data);
-            break;
-        case MTP_TYPE_UINT128:
-            length = serialize_type_value_uint128(prop, info, data);
-            break;
-        case MTP_TYPE_STR:
-            length = serialize_type_value_str(prop, info, data);
-            break;
-    }
-    return length;
+    if (!prop)
+        return 0;
+
+    mtp_writer_init(&writer, data, size);
+    MTP_SCHEMA_PUT(&writer, prop_desc_head, MTP_PROP_DESC_HEAD, prop);
+    mtp_writer_put_zero(&writer, type_size(prop->type)); /* Default value */
+    MTP_SCHEMA_PUT(&writer, prop_desc_tail, MTP_PROP_DESC_TAIL, prop);
+    return mtp_writer_finish(&writer);
 }
 
-uint32_t serialize_object_prop_value(uint16_t prop_code, mtp_object_info_t *info, uint8_t *data)
+uint32_t serialize_object_prop_value(uint16_t prop_code, mtp_object_info_t *info, uint8_t *data, uint32_t size)
 {
-    uint32_t length = 0;
-    int i;
-    for(i = 0; i < properties_num; i++)
-    {
-        if (properties[i].id == prop_code)
-        {
-            length += serialize_prop_value(&properties[i], info, data);
-            break;
-        }
-    }
-    return length;
+    const obj_property_t *prop = find_property(prop_code);
+    const uint8_t *value;
+    mtp_writer_t writer;
+
+    if (!prop)
+        return 0;
+
+    value = (const uint8_t *)info + prop->offset;
+    mtp_writer_init(&writer, data, size);
+    if (prop->type != MTP_TYPE_STR)
+        mtp_writer_put(&writer, value, type_size(prop->type));
+    else if (prop->form == 0)
+        mtp_writer_put_string(&writer, (const char *)value);
+    else if (prop->form == 3)
+        mtp_writer_put_date(&writer, *(const time_t *)value);
+    return mtp_writer_finish(&writer);
 }
 
 static int deserialize_prop_value(const obj_property_t *prop, const uint8_t *data, void *value, int value_size)
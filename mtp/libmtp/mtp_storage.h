@@ -6,6 +6,7 @@
 #ifndef _MTP_STORAGE_H
 #define _MTP_STORAGE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <time.h>
 
@@ -55,14 +56,16 @@ typedef struct {
     void *api_arg;
 } mtp_storage_t;
 
+bool is_object_prop_supported(uint16_t prop_code);
 
-uint32_t serialize_storage_list(mtp_storage_t *storage, uint32_t parent, uint8_t *data);
-uint32_t serialize_storage_info(mtp_storage_t *storage, uint8_t *data);
-uint32_t serialize_storage_ids(mtp_storage_t *storage, int count, uint8_t *data);
-uint32_t serialize_object_info(mtp_object_info_t* info, uint8_t *data);
-uint32_t serialize_object_props_supported(uint8_t *data);
-uint32_t serialize_object_prop_desc(uint16_t prop_code, uint8_t *data);
-uint32_t serialize_object_prop_value(uint16_t prop_code, mtp_object_info_t *info, uint8_t *data);
+/* Serializers return zero when the dataset doesn't fit */
+uint32_t serialize_storage_list(mtp_storage_t *storage, uint32_t parent, uint8_t *data, uint32_t size);
+uint32_t serialize_storage_info(mtp_storage_t *storage, uint8_t *data, uint32_t size);
+uint32_t serialize_storage_ids(mtp_storage_t *storage, int count, uint8_t *data, uint32_t size);
+uint32_t serialize_object_info(mtp_object_info_t* info, uint8_t *data, uint32_t size);
+uint32_t serialize_object_props_supported(uint8_t *data, uint32_t size);
+uint32_t serialize_object_prop_desc(uint16_t prop_code, uint8_t *data, uint32_t size);
+uint32_t serialize_object_prop_value(uint16_t prop_code, mtp_object_info_t *info, uint8_t *data, uint32_t size);
 int deserialize_object_prop_value(uint16_t prop_code, const uint8_t *data, void *value, int value_size);
 
 int deserialize_object_info(const uint8_t *data, size_t length, mtp_object_info_t *info);
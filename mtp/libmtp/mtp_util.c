@@ -5,8 +5,14 @@
  */
 #include "mtp_util.h"
 #include <string.h>
-#include <stdio.h>
 #include <time.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef MIN
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+#endif
 
 inline int put_16(uint8_t *buffer, uint16_t value)
 {
@@ -42,11 +48,167 @@ inline int put_array(uint8_t *buffer, const void *array, int length, int element
     return sizeof(uint32_t) + length*element_size;
 }
 
-int put_string(uint8_t *buffer, const char *text)
+/* MTP string counts characters in one byte, terminating null included */
+#define MTP_STRING_MAX_UNITS 254
+#define REPLACEMENT_CHAR 0xFFFD
+
+/* Widens ASCII block by block until the first non-ASCII byte. Returns number
+ * of widened characters. */
+static int widen_ascii(uint8_t *out, const uint8_t *in, int count)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16)
+    {
+        __m128i chars = _mm_loadu_si128((const __m128i *)(in + i));
+        if (_mm_movemask_epi8(chars))
+            break;
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(chars, zero));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(chars, zero));
+    }
+#endif
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t chars, lo, hi;
+        memcpy(&chars, in + i, sizeof(chars));
+        if (chars & 0x80808080U)
+            break;
+        lo = (chars & 0x000000FFU) | ((chars & 0x0000FF00U) << 8);
+        hi = ((chars & 0x00FF0000U) >> 16) | ((chars & 0xFF000000U) >> 8);
+        memcpy(out + 2 * i, &lo, sizeof(lo));
+        memcpy(out + 2 * i + 4, &hi, sizeof(hi));
+    }
+    for (; i < count && in[i] < 0x80; i++)
+    {
+        out[2 * i] = in[i];
+        out[2 * i + 1] = 0;
+    }
+    return i;
+}
+
+/* Narrows ASCII block by block until the first non-ASCII unit. Returns number
+ * of narrowed characters. */
+static int narrow_ascii(uint8_t *out, const uint8_t *in, int count)
 {
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128i high = _mm_set1_epi16((short)0xFF80);
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i units = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, high), zero)) != 0xFFFF)
+            break;
+        _mm_storel_epi64((__m128i *)(out + i), _mm_packus_epi16(units, units));
+    }
+#endif
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t units[2], chars;
+        memcpy(units, in + 2 * i, sizeof(units));
+        if ((units[0] | units[1]) & 0xFF80FF80U)
+            break;
+        chars = (units[0] & 0xFFU) | ((units[0] >> 8) & 0xFF00U) |
+                ((units[1] & 0xFFU) << 16) | ((units[1] << 8) & 0xFF000000U);
+        memcpy(out + i, &chars, sizeof(chars));
+    }
+    for (; i < count && in[2 * i] < 0x80 && in[2 * i + 1] == 0; i++)
+    {
+        out[i] = in[2 * i];
+    }
+    return i;
+}
+
+/* Decodes one UTF-8 sequence, malformed one is consumed byte by byte
+ * and decoded as replacement character */
+static uint32_t utf8_decode(const uint8_t **text, const uint8_t *end)
+{
+    const uint8_t *p = *text;
+    uint32_t code;
+    uint32_t min;
+    int count;
     int i;
-    int length;
-    uint16_t *utf16;
+
+    if (p[0] < 0x80) {
+        *text += 1;
+        return p[0];
+    } else if ((p[0] & 0xE0) == 0xC0) {
+        code = p[0] & 0x1F;
+        count = 1;
+        min = 0x80;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        code = p[0] & 0x0F;
+        count = 2;
+        min = 0x800;
+    } else if ((p[0] & 0xF8) == 0xF0) {
+        code = p[0] & 0x07;
+        count = 3;
+        min = 0x10000;
+    } else {
+        *text += 1;
+        return REPLACEMENT_CHAR;
+    }
+
+    if (end - p <= count) {
+        *text += 1;
+        return REPLACEMENT_CHAR;
+    }
+    for (i = 1; i <= count; i++) {
+        if ((p[i] & 0xC0) != 0x80) {
+            *text += 1;
+            return REPLACEMENT_CHAR;
+        }
+        code = (code << 6) | (p[i] & 0x3F);
+    }
+    *text += count + 1;
+
+    if ((code < min) || (code > 0x10FFFF) || ((code >= 0xD800) && (code <= 0xDFFF)))
+        return REPLACEMENT_CHAR;
+    return code;
+}
+
+static int utf8_length(uint32_t code)
+{
+    if (code < 0x80)
+        return 1;
+    if (code < 0x800)
+        return 2;
+    if (code < 0x10000)
+        return 3;
+    return 4;
+}
+
+static int utf8_encode(char *text, uint32_t code)
+{
+    if (code < 0x80) {
+        text[0] = (char)code;
+        return 1;
+    } else if (code < 0x800) {
+        text[0] = (char)(0xC0 | (code >> 6));
+        text[1] = (char)(0x80 | (code & 0x3F));
+        return 2;
+    } else if (code < 0x10000) {
+        text[0] = (char)(0xE0 | (code >> 12));
+        text[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+        text[2] = (char)(0x80 | (code & 0x3F));
+        return 3;
+    }
+    text[0] = (char)(0xF0 | (code >> 18));
+    text[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+    text[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+    text[3] = (char)(0x80 | (code & 0x3F));
+    return 4;
+}
+
+int put_string(uint8_t *buffer, const char *text)
+{
+    const uint8_t *in = (const uint8_t *)text;
+    const uint8_t *end;
+    uint8_t *utf16 = buffer + 1;
+    int units;
 
     if (!text)
     {
@@ -56,77 +218,351 @@ int put_string(uint8_t *buffer, const char *text)
         return 3;
     }
 
-    length = strlen(text);
-    *buffer++ = (uint8_t)length + 1;
-    utf16 = (uint16_t*)buffer;
-
-    for(i = 0; i < length; i++, utf16++)
+    end = in + strlen(text);
+    units = 0;
+    while (in < end && units < MTP_STRING_MAX_UNITS)
     {
-        *utf16 = (uint16_t)text[i];
+        uint32_t code;
+        int ascii = widen_ascii(utf16 + 2 * units, in,
+                MIN(end - in, MTP_STRING_MAX_UNITS - units));
+        in += ascii;
+        units += ascii;
+        if (in == end || units == MTP_STRING_MAX_UNITS)
+            break;
+
+        code = utf8_decode(&in, end);
+        if (code >= 0x10000)
+        {
+            /* Surrogate pair is never split by the length limit */
+            if (units + 2 > MTP_STRING_MAX_UNITS)
+                break;
+            code -= 0x10000;
+            put_16(utf16 + 2 * units++, 0xD800 | (code >> 10));
+            put_16(utf16 + 2 * units++, 0xDC00 | (code & 0x3FF));
+        }
+        else
+        {
+            put_16(utf16 + 2 * units++, code);
+        }
     }
-    *utf16 = 0;
+    put_16(utf16 + 2 * units, 0);
 
     /* add null termination char, each char is 2 bytes, 1 byte for string length */
-    return 1 + ((length + 1) * sizeof(uint16_t));
+    buffer[0] = (uint8_t)(units + 1);
+    return 1 + ((units + 1) * sizeof(uint16_t));
+}
+
+/* Bytes put_string() writes for text */
+int string_size(const char *text)
+{
+    const uint8_t *in = (const uint8_t *)text;
+    const uint8_t *end;
+    int units = 0;
+
+    if (!text)
+        return 3;
+
+    end = in + strlen(text);
+    while (in < end && units < MTP_STRING_MAX_UNITS)
+    {
+        if (*in < 0x80)
+        {
+            in++;
+            units++;
+        }
+        else if (utf8_decode(&in, end) >= 0x10000)
+        {
+            if (units + 2 > MTP_STRING_MAX_UNITS)
+                break;
+            units += 2;
+        }
+        else
+        {
+            units++;
+        }
+    }
+    return 1 + ((units + 1) * sizeof(uint16_t));
 }
 
 int get_string(const uint8_t *buffer, char *text, int length)
 {
     uint8_t parsed_len = buffer[0];
-    uint16_t *unicode = (uint16_t *)&buffer[1];
-    int i;
+    const uint8_t *utf16 = &buffer[1];
+    int count = parsed_len ? parsed_len - 1 : 0;
+    int i = 0;
+    int out = 0;
 
-    if (parsed_len > length) {
+    if (length <= 0) {
         return -1;
     }
 
-    for (i = 0; i < parsed_len; i++)
+    while (i < count)
     {
-        text[i] = *(char *)unicode;
-        unicode++;
+        uint16_t unit;
+        uint32_t code;
+        int ascii = narrow_ascii((uint8_t *)text + out, utf16 + 2 * i,
+                MIN(count - i, length - 1 - out));
+        i += ascii;
+        out += ascii;
+        if (i == count)
+            break;
+
+        unit = utf16[2 * i] | (utf16[2 * i + 1] << 8);
+        i++;
+        code = unit;
+        if (unit >= 0xD800 && unit <= 0xDBFF && i < count)
+        {
+            uint16_t low = utf16[2 * i] | (utf16[2 * i + 1] << 8);
+            if (low >= 0xDC00 && low <= 0xDFFF)
+            {
+                code = 0x10000 + ((uint32_t)(unit - 0xD800) << 10) + (low - 0xDC00);
+                i++;
+            }
+        }
+        if (code >= 0xD800 && code <= 0xDFFF)
+            code = REPLACEMENT_CHAR;
+
+        /* Encoded character plus null termination has to fit */
+        if (out + utf8_length(code) + 1 > length)
+            return -1;
+        out += utf8_encode(text + out, code);
     }
+    text[out] = '\0';
 
     return 1 + (parsed_len * sizeof(uint16_t));
 }
 
+#define SECONDS_PER_DAY 86400L
+
+/* Days since 1970-01-01 of a proleptic Gregorian date */
+static int64_t days_from_civil(int year, unsigned month, unsigned day)
+{
+    int64_t era;
+    unsigned yoe, doy, doe;
+
+    year -= month <= 2;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yoe = (unsigned)(year - era * 400);
+    doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static unsigned days_in_month(unsigned year, unsigned month)
+{
+    static const uint8_t days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+        return 29;
+    return days[month - 1];
+}
+
+static void civil_from_days(int64_t days, int *year, unsigned *month, unsigned *day)
+{
+    int64_t era;
+    unsigned doe, yoe, doy, mp;
+
+    days += 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    doe = (unsigned)(days - era * 146097);
+    yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+static int64_t floor_days(int64_t seconds)
+{
+    return (seconds >= 0 ? seconds : seconds - (SECONDS_PER_DAY - 1)) / SECONDS_PER_DAY;
+}
+
+/* Offset of local time from UTC in seconds, as libc sees it */
+static long libc_offset(time_t time)
+{
+    int64_t day = floor_days(time);
+    struct tm tms;
+
+    if (localtime_r(&time, &tms) == NULL)
+        return 0;
+    return (long)((days_from_civil(tms.tm_year + 1900, tms.tm_mon + 1, tms.tm_mday) - day) * SECONDS_PER_DAY
+        + tms.tm_hour * 3600L + tms.tm_min * 60L + tms.tm_sec - (time - day * SECONDS_PER_DAY));
+}
+
+/*
+ * Offset of local time from UTC in seconds. Asking libc is expensive and the
+ * offset changes at most once a day, so it is kept for the part of the UTC
+ * day around the last asked time in which it holds. A miss costs two libc
+ * calls, the transition is only searched for on the days that have one. TZ
+ * is read again on a miss, its change shows from the next day asked.
+ */
+static long local_offset(time_t time)
+{
+    static int64_t valid_from = 1;
+    static int64_t valid_to = 0;
+    static long cached_offset;
+    int64_t first, last, good, bad;
+    long first_offset, last_offset;
+
+    if ((int64_t)time >= valid_from && (int64_t)time <= valid_to)
+        return cached_offset;
+
+    tzset();
+    first = floor_days(time) * SECONDS_PER_DAY;
+    last = first + SECONDS_PER_DAY - 1;
+    first_offset = libc_offset((time_t)first);
+    last_offset = libc_offset((time_t)last);
+
+    valid_from = first;
+    valid_to = last;
+    cached_offset = first_offset;
+    if (first_offset != last_offset)
+    {
+        good = first;
+        bad = last;
+        while (bad - good > 1)
+        {
+            int64_t middle = good + (bad - good) / 2;
+            if (libc_offset((time_t)middle) == first_offset)
+                good = middle;
+            else
+                bad = middle;
+        }
+        if ((int64_t)time <= good)
+        {
+            valid_to = good;
+        }
+        else
+        {
+            valid_from = bad;
+            cached_offset = last_offset;
+        }
+    }
+    return cached_offset;
+}
+
+static uint16_t get_16(const uint8_t *buffer)
+{
+    return (uint16_t)(buffer[0] | (buffer[1] << 8));
+}
+
+static uint8_t *put_digits(uint8_t *out, unsigned value, int count)
+{
+    for (int i = count - 1; i >= 0; i--)
+    {
+        out[2 * i] = '0' + value % 10;
+        out[2 * i + 1] = 0;
+        value /= 10;
+    }
+    return out + 2 * count;
+}
+
+static int get_digits(const uint8_t *in, int count, unsigned *value)
+{
+    *value = 0;
+    for (int i = 0; i < count; i++)
+    {
+        unsigned digit = (unsigned)get_16(in + 2 * i) - '0';
+        if (digit > 9)
+            return -1;
+        *value = *value * 10 + digit;
+    }
+    return 0;
+}
+
+/* YYYYMMDDThhmmss, optionally followed by the +hhmm time zone suffix */
 int put_date(uint8_t *buffer, time_t time)
 {
-    struct tm *tms;
-    char date[16];
-    tms = localtime(&time);
-    sprintf(date, "%04u%02u%02uT%02u%02u%02u",
-            tms->tm_year + 1900,
-            tms->tm_mon + 1,
-            tms->tm_mday,
-            tms->tm_hour,
-            tms->tm_min,
-            tms->tm_sec);
-    return put_string(buffer, date);
+    long offset = local_offset(time);
+    int64_t local = (int64_t)time + offset;
+    int64_t days = floor_days(local);
+    unsigned seconds = (unsigned)(local - days * SECONDS_PER_DAY);
+    unsigned month, day;
+    int year;
+    uint8_t *out = buffer + 1;
+
+    civil_from_days(days, &year, &month, &day);
+    out = put_digits(out, (unsigned)year, 4);
+    out = put_digits(out, month, 2);
+    out = put_digits(out, day, 2);
+    out += put_16(out, 'T');
+    out = put_digits(out, seconds / 3600, 2);
+    out = put_digits(out, seconds / 60 % 60, 2);
+    out = put_digits(out, seconds % 60, 2);
+#if MTP_DATE_TIMEZONE_SUFFIX
+    out += put_16(out, offset < 0 ? '-' : '+');
+    offset = offset < 0 ? -offset : offset;
+    out = put_digits(out, (unsigned)(offset / 3600), 2);
+    out = put_digits(out, (unsigned)(offset / 60 % 60), 2);
+#endif
+    out += put_16(out, 0);
+    buffer[0] = (uint8_t)((out - buffer - 1) / sizeof(uint16_t));
+    return out - buffer;
 }
 
+/*
+ * Accepts YYYYMMDDThhmmss[.s][Z|+hh[mm]|-hh[mm]]. Without a time zone suffix
+ * the date is in local time.
+ */
 int get_date(const uint8_t *buffer, time_t *time)
 {
-    struct tm tms = {0};
-    int parsed_len;
-    int fields;
-    char date[16];
-    parsed_len = get_string(buffer, date, 16);
-
-    if (parsed_len < 0)
-        return parsed_len;
-
-    fields = sscanf(date, "%04u%02u%02uT%02u%02u%02u",
-            &tms.tm_year,
-            &tms.tm_mon,
-            &tms.tm_mday,
-            &tms.tm_hour,
-            &tms.tm_min,
-            &tms.tm_sec);
-    if (fields != 6)
+    unsigned year, month, day, hour, minute, second, zone_hour, zone_minute = 0;
+    int units = buffer[0];
+    const uint8_t *in = buffer + 1;
+    const uint8_t *end;
+    int64_t local;
+    long offset;
+
+    /* Terminating null is included in the length */
+    if (units < 16 || get_16(in + 2 * (units - 1)) != 0)
+        return -1;
+    end = in + 2 * (units - 1);
+
+    if (get_digits(in, 4, &year) || get_digits(in + 8, 2, &month) || get_digits(in + 12, 2, &day)
+            || get_16(in + 16) != 'T' || get_digits(in + 18, 2, &hour)
+            || get_digits(in + 22, 2, &minute) || get_digits(in + 26, 2, &second))
+        return -1;
+    if (month < 1 || month > 12 || day < 1 || day > days_in_month(year, month) || hour > 23 || minute > 59
+            || second > 59)
         return -1;
-    tms.tm_year -= 1900;
-    tms.tm_mon -= 1;
-    tms.tm_isdst = 0;
-    *time = mktime(&tms);
-    return parsed_len;
+    in += 30;
+
+    /* Tenths of second are below MTP resolution */
+    if (in < end && get_16(in) == '.')
+    {
+        in += 2;
+        if (in == end || (unsigned)get_16(in) - '0' > 9)
+            return -1;
+        in += 2;
+    }
+
+    local = days_from_civil((int)year, month, day) * SECONDS_PER_DAY + hour * 3600L + minute * 60L + second;
+    if (in == end)
+    {
+        /* Offset at the local time is a good enough guess of the offset at UTC time */
+        offset = local_offset((time_t)local);
+        offset = local_offset((time_t)(local - offset));
+    }
+    else if (get_16(in) == 'Z' && in + 2 == end)
+    {
+        offset = 0;
+    }
+    else if (get_16(in) == '+' || get_16(in) == '-')
+    {
+        int length = (end - in) / 2 - 1;
+        if ((length != 2 && length != 4) || get_digits(in + 2, 2, &zone_hour)
+                || (length == 4 && get_digits(in + 6, 2, &zone_minute)) || zone_hour > 23 || zone_minute > 59)
+            return -1;
+        offset = zone_hour * 3600L + zone_minute * 60L;
+        if (get_16(in) == '-')
+            offset = -offset;
+    }
+    else
+    {
+        return -1;
+    }
+
+    *time = (time_t)(local - offset);
+    return 1 + units * sizeof(uint16_t);
 }
@@ -3,44 +3,49 @@
 #include "mtp_responder.h"
 #include "mtp_storage.h"
 
-uint32_t serialize_storage_list(mtp_storage_t *storage, uint32_t parent, uint8_t *data)
+bool is_object_prop_supported(uint16_t prop_code)
 {
-    return (uint32_t)mock(storage, parent, data);
+    return (bool)mock(prop_code);
 }
 
-uint32_t serialize_storage_info(mtp_storage_t *storage, uint8_t *data)
+uint32_t serialize_storage_list(mtp_storage_t *storage, uint32_t parent, uint8_t *data, uint32_t size)
 {
-    return (uint32_t)mock(storage, data);
+    return (uint32_t)mock(storage, parent, data, size);
 }
 
-uint32_t serialize_storage_ids(mtp_storage_t *storage, int count,  uint8_t *data)
+uint32_t serialize_storage_info(mtp_storage_t *storage, uint8_t *data, uint32_t size)
 {
-    return (uint32_t)mock(storage, data);
+    return (uint32_t)mock(storage, data, size);
 }
 
-uint32_t serialize_object_info(mtp_object_info_t *info, uint8_t *data)
+uint32_t serialize_storage_ids(mtp_storage_t *storage, int count,  uint8_t *data, uint32_t size)
 {
-    return (uint32_t)mock(info, data);
+    return (uint32_t)mock(storage, data, size);
 }
 
-uint32_t serialize_object_props_supported(uint8_t *data)
+uint32_t serialize_object_info(mtp_object_info_t *info, uint8_t *data, uint32_t size)
 {
-    return (uint32_t)mock(data);
+    return (uint32_t)mock(info, data, size);
 }
 
-uint32_t serialize_object_prop_desc(uint16_t prop_code, uint8_t *data)
+uint32_t serialize_object_props_supported(uint8_t *data, uint32_t size)
 {
-    return (uint32_t)mock(prop_code, data);
+    return (uint32_t)mock(data, size);
 }
 
-uint32_t serialize_object_prop_value(uint16_t prop_code, mtp_object_info_t *info, uint8_t *data)
+uint32_t serialize_object_prop_desc(uint16_t prop_code, uint8_t *data, uint32_t size)
 {
-    return (uint32_t)mock(prop_code, info, data);
+    return (uint32_t)mock(prop_code, data, size);
 }
 
-int deserialize_object_prop_value(uint16_t prop_code, const uint8_t *data, void *value)
+uint32_t serialize_object_prop_value(uint16_t prop_code, mtp_object_info_t *info, uint8_t *data, uint32_t size)
 {
-    return (int)mock(prop_code, data, value);
+    return (uint32_t)mock(prop_code, info, data, size);
+}
+
+int deserialize_object_prop_value(uint16_t prop_code, const uint8_t *data, void *value, int value_size)
+{
+    return (int)mock(prop_code, data, value, value_size);
 }
 
 int deserialize_object_info(const uint8_t *data, size_t length, mtp_object_info_t *info)
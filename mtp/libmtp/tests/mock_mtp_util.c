@@ -27,6 +27,11 @@ int put_string(uint8_t *buffer, const char *text)
     return (int)mock(buffer, text);
 }
 
+int string_size(const char *text)
+{
+    return (int)mock(text);
+}
+
 int get_string(uint8_t *buffer, char *text, int length)
 {
     return (int)mock(buffer, text, length);
@@ -38,52 +38,79 @@ Ensure(mtp_dataset, device_info)
     extern const uint16_t MTP_SUPPORTED_CAPTURE_FORMATS[];
     extern const uint16_t MTP_SUPPORTED_PLAYBACK_FORMATS[];
 
-    expect(put_16, when(value, is_equal_to(100)), will_return(2));  /* Standard Version */
-    expect(put_32, when(value, is_equal_to(6)), will_return(4)); /* MTP Vendor Extension ID */
-    expect(put_16, when(value, is_equal_to(100)), will_return(2));  /* MTP Version */
+    const uint16_t *arrays[] = {
+        MTP_SUPPORTED_OPERATIONS,                                   /* Operations Supported */
+        MTP_SUPPORTED_EVENTS,                                       /* Events Supported */
+        MTP_SUPPORTED_DEVICE_PROPERTIES,                            /* Device Properties Supported */
+        MTP_SUPPORTED_CAPTURE_FORMATS,                              /* Capture Formats */
+        MTP_SUPPORTED_PLAYBACK_FORMATS,                             /* Playback Formats */
+    };
+    const uint8_t expected[] = {
+        0x64, 0x00,                                                 /* Standard Version */
+        0x06, 0x00, 0x00, 0x00,                                     /* MTP Vendor Extension ID */
+        0x64, 0x00,                                                 /* MTP Version */
+    };
+    uint32_t offset;
+    uint32_t count;
+    unsigned i;
+
+    expect(string_size,
+            when(text, is_equal_to_contents_of("microsoft.com: 1.0;", 15)),
+            will_return(1));
     expect(put_string,
+            when(buffer, is_equal_to(&given[8])),
             when(text, is_equal_to_contents_of("microsoft.com: 1.0;", 15)),
             will_return(1));                                        /* MTP Extensions */
-    expect(put_16, when(value, is_equal_to(0)), will_return(2));    /* Functional Mode */
-    expect(put_array,
-            when(array, is_equal_to(MTP_SUPPORTED_OPERATIONS)),
-            when(length, is_equal_to(15)),
-            when(element_size, is_equal_to(2)),
-            will_return(4+15*2));                                    /* Operations Supported */
-    expect(put_array,
-            when(array, is_equal_to(MTP_SUPPORTED_EVENTS)),
-            when(length, is_equal_to(18)),
-            will_return(4+18*2));                                    /* Events Supported */
-    expect(put_array,
-            when(array, is_equal_to(MTP_SUPPORTED_DEVICE_PROPERTIES)),
-            when(length, is_equal_to(0)),
-            will_return(4+0*2));                                    /* Device Properties Supported */
-    expect(put_array,
-            when(array, is_equal_to(MTP_SUPPORTED_CAPTURE_FORMATS)),
-            when(length, is_equal_to(3)),
-            when(element_size, is_equal_to(2)),
-            will_return(4+3*2));                                    /* Capture Formats */
-    expect(put_array,
-            when(array, is_equal_to(MTP_SUPPORTED_PLAYBACK_FORMATS)),
-            when(length, is_equal_to(3)),
-            when(element_size, is_equal_to(2)),
-            will_return(4+3*2));                                    /* Playback Formats */
+    expect(string_size,
+            when(text, is_equal_to_contents_of("Manufacturer", 12)),
+            will_return(1+13*2));
     expect(put_string,
             when(text, is_equal_to_contents_of("Manufacturer", 12)),
             will_return(1+13*2));                                   /* Manufacturer */
+    expect(string_size,
+            when(text, is_equal_to_contents_of("Model", 5)),
+            will_return(1+6*2));
     expect(put_string,
             when(text, is_equal_to_contents_of("Model", 5)),
             will_return(1+6*2));                                   /* Model */
+    expect(string_size,
+            when(text, is_equal_to_contents_of("1.0.0", 5)),
+            will_return(1+5*2));
     expect(put_string,
             when(text, is_equal_to_contents_of("1.0.0", 5)),
             will_return(1+5*2));                                   /* Version */
+    expect(string_size,
+            when(text, is_equal_to_contents_of("10000000000000000000000000000001", 32)),
+            will_return(1+33*2));
     expect(put_string,
             when(text, is_equal_to_contents_of("10000000000000000000000000000001", 32)),
             will_return(1+33*2));                                   /* Serial Number */
 
-    given_length = serialize_device_info(&device_info, given);
+    given_length = serialize_device_info(&device_info, given, sizeof(given));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+    assert_that(*(uint16_t*)&given[9], is_equal_to(0));           /* Functional Mode */
+
+    offset = 11;
+    for (i = 0; i < sizeof(arrays)/sizeof(arrays[0]); i++)
+    {
+        memcpy(&count, &given[offset], sizeof(count));
+        assert_that(&given[offset + 4], is_equal_to_contents_of(arrays[i], count * sizeof(uint16_t)));
+        offset += 4 + count * sizeof(uint16_t);
+    }
+    assert_that(given_length, is_equal_to(offset + 1+13*2 + 1+6*2 + 1+5*2 + 1+33*2));
+}
+
+Ensure(mtp_dataset, device_info_fails_when_buffer_too_small)
+{
+    expect(string_size,
+            when(text, is_equal_to_contents_of("microsoft.com: 1.0;", 15)),
+            will_return(1));
+    expect(put_string,
+            when(text, is_equal_to_contents_of("microsoft.com: 1.0;", 15)),
+            will_return(1));
 
-    assert_that(given_length, is_equal_to(227));
+    given_length = serialize_device_info(&device_info, given, 64);
+    assert_that(given_length, is_equal_to(0));
 }
 
 
@@ -0,0 +1,195 @@
+#include <cgreen/cgreen.h>
+#include <cgreen/mocks.h>
+
+#include "mtp_responder.h"
+#include "mtp_container.h"
+#include "mtp_storage.h"
+#include "mtp_util.h"
+
+#include "mock_mtp_storage_api.h"
+
+static mtp_responder_t *mtp = NULL;
+static size_t given_data_size;
+static uint16_t error;
+static uint8_t given_data[512];
+static const mtp_op_cntr_t *given = (mtp_op_cntr_t*)given_data;
+
+static const mtp_device_info_t device_info = {
+    .manufacturer = "Manufacturer",
+    .model = "Model",
+    .version = "1.0",
+    .serial = "0123456789",
+};
+
+/* one supported property: MTP_PROPERTY_STORAGE_ID */
+static const uint8_t props_supported[] = { 0x01, 0x00, 0x00, 0x00, 0x01, 0xDC };
+static const uint8_t device_info_data[] = { 0x64, 0x00, 0x06, 0x00, 0x00, 0x00 };
+static const uint8_t prop_desc_data[] = { 0x01, 0xDC, 0x06, 0x00, 0x00 };
+
+Describe(dataset_cache);
+
+BeforeEach(dataset_cache)
+{
+    mtp = mtp_responder_alloc();
+    mtp_responder_init(mtp);
+    mtp_responder_set_storage(mtp, 0x00010001, &mock_api, NULL);
+    mtp_responder_set_data_buffer(mtp, given_data, sizeof(given_data));
+
+    expect(serialize_device_info,
+            will_set_contents_of_parameter(data, device_info_data, sizeof(device_info_data)),
+            will_return(sizeof(device_info_data)));
+    expect(serialize_object_props_supported,
+            will_set_contents_of_parameter(data, props_supported, sizeof(props_supported)),
+            will_return(sizeof(props_supported)));
+    expect(serialize_object_prop_desc,
+            when(prop_code, is_equal_to(MTP_PROPERTY_STORAGE_ID)),
+            will_set_contents_of_parameter(data, prop_desc_data, sizeof(prop_desc_data)),
+            will_return(sizeof(prop_desc_data)));
+    mtp_responder_set_device_info(mtp, &device_info);
+
+    given_data_size = 0xaabbccdd;
+    memset(given_data, 0xaa, sizeof(given_data));
+    error = 0xaa;
+}
+
+AfterEach(dataset_cache)
+{
+    mtp_responder_free(mtp);
+}
+
+Ensure(dataset_cache, serves_device_info_without_serializing)
+{
+    const uint8_t request[] = {
+        0x0c, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x10,
+        0x01, 0x00, 0x00, 0x30
+    };
+
+    const uint32_t expected_length = 12 + sizeof(device_info_data);
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        error = mtp_responder_handle_request(mtp, request, sizeof(request));
+        given_data_size = mtp_responder_get_data(mtp);
+        mtp_responder_transaction_reset(mtp);
+
+        assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+        assert_that(given_data_size, is_equal_to(expected_length));
+        assert_that(given->header.type, is_equal_to(MTP_CONTAINER_TYPE_DATA));
+        assert_that(given->header.operation_code, is_equal_to(MTP_OPERATION_GET_DEVICE_INFO));
+        assert_that(given->header.length, is_equal_to(expected_length));
+        assert_that(&given_data[MTP_CONTAINER_HEADER_SIZE], is_equal_to_contents_of(device_info_data, sizeof(device_info_data)));
+    }
+}
+
+Ensure(dataset_cache, serves_props_supported_for_each_format)
+{
+    const uint8_t request[] = {
+        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01, 0x98,
+        0x0F, 0x00, 0x00, 0xF0, 0x01, 0x30, 0x00, 0x00,
+    };
+
+    const uint32_t expected_length = 12 + sizeof(props_supported);
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        expect(is_format_code_supported,
+                will_return(true));
+
+        error = mtp_responder_handle_request(mtp, request, sizeof(request));
+        given_data_size = mtp_responder_get_data(mtp);
+        mtp_responder_transaction_reset(mtp);
+
+        assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+        assert_that(given_data_size, is_equal_to(expected_length));
+        assert_that(given->header.length, is_equal_to(expected_length));
+        assert_that(&given_data[MTP_CONTAINER_HEADER_SIZE], is_equal_to_contents_of(props_supported, sizeof(props_supported)));
+    }
+}
+
+Ensure(dataset_cache, serves_prop_desc_by_property_code)
+{
+    const uint8_t request[] = {
+        0x14, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x98,
+        0x0F, 0x00, 0x00, 0xF0, 0x01, 0xDC, 0x00, 0x00,
+        0x01, 0x30, 0x00, 0x00
+    };
+
+    const uint32_t expected_length = 12 + sizeof(prop_desc_data);
+
+    expect(is_format_code_supported,
+            will_return(true));
+
+    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    given_data_size = mtp_responder_get_data(mtp);
+
+    assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+    assert_that(given_data_size, is_equal_to(expected_length));
+    assert_that(given->header.operation_code, is_equal_to(MTP_OPERATION_GET_OBJECT_PROP_DESC));
+    assert_that(&given_data[MTP_CONTAINER_HEADER_SIZE], is_equal_to_contents_of(prop_desc_data, sizeof(prop_desc_data)));
+}
+
+Ensure(dataset_cache, falls_back_to_serializing_not_cached_prop_desc)
+{
+    const uint8_t request[] = {
+        0x14, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x98,
+        0x0F, 0x00, 0x00, 0xF0, 0x07, 0xDC, 0x00, 0x00,
+        0x01, 0x30, 0x00, 0x00
+    };
+
+    expect(is_format_code_supported,
+            will_return(true));
+    expect(is_object_prop_supported,
+            when(prop_code, is_equal_to(MTP_PROPERTY_OBJECT_FILE_NAME)),
+            will_return(true));
+    expect(serialize_object_prop_desc,
+            when(prop_code, is_equal_to(MTP_PROPERTY_OBJECT_FILE_NAME)),
+            will_set_contents_of_parameter(data, prop_desc_data, sizeof(prop_desc_data)),
+            will_return(sizeof(prop_desc_data)));
+
+    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+
+    assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+}
+
+Ensure(dataset_cache, rejects_unknown_prop_desc)
+{
+    const uint8_t request[] = {
+        0x14, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x98,
+        0x0F, 0x00, 0x00, 0xF0, 0x99, 0xDC, 0x00, 0x00,
+        0x01, 0x30, 0x00, 0x00
+    };
+
+    expect(is_format_code_supported,
+            will_return(true));
+    expect(is_object_prop_supported,
+            when(prop_code, is_equal_to(0xDC99)),
+            will_return(false));
+
+    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+
+    assert_that(error, is_equal_to(MTP_RESPONSE_INVALID_OBJECT_PROP_CODE));
+}
+
+Ensure(dataset_cache, reports_general_error_if_prop_desc_does_not_fit)
+{
+    const uint8_t request[] = {
+        0x14, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x98,
+        0x0F, 0x00, 0x00, 0xF0, 0x07, 0xDC, 0x00, 0x00,
+        0x01, 0x30, 0x00, 0x00
+    };
+
+    expect(is_format_code_supported,
+            will_return(true));
+    expect(is_object_prop_supported,
+            when(prop_code, is_equal_to(MTP_PROPERTY_OBJECT_FILE_NAME)),
+            will_return(true));
+    expect(serialize_object_prop_desc,
+            when(prop_code, is_equal_to(MTP_PROPERTY_OBJECT_FILE_NAME)),
+            will_return(0));
+
+    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+
+    assert_that(error, is_equal_to(MTP_RESPONSE_GENERAL_ERROR));
+}
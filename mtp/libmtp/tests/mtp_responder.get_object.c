@@ -14,6 +14,33 @@ static uint8_t given_data[512];
 static size_t given_data_size;
 static const mtp_op_cntr_t *given = (mtp_op_cntr_t*)given_data;
 
+/* GetObject of handle 0x01000001 */
+static const uint8_t get_object_request[] = {
+    0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x09, 0x10,
+    0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x00, 0x01,
+};
+
+static mtp_object_info_t opened_file;
+
+static void expect_object_opened(uint64_t size)
+{
+    opened_file = (mtp_object_info_t) {
+      .filename = "welcome.txt",
+      .created = 1580371617,
+      .modified = 1580371617,
+      .format_code = MTP_FORMAT_TEXT,
+      .parent = 0,
+      .size = size,
+    };
+
+    expect(mock_stat,
+            when(info, is_not_equal_to(NULL)),
+            will_set_contents_of_parameter(info, &opened_file, sizeof(mtp_object_info_t)),
+            will_return(0));
+    expect(mock_open,
+            will_return(0));
+}
+
 Describe(get_object);
 
 BeforeEach(get_object)
@@ -46,15 +73,10 @@ Ensure(get_object, returns_error_when_object_handle_is_invalid)
 
 Ensure(get_object, returns_error_when_file_doesnt_exists)
 {
-    const uint8_t request[] = {
-        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x09, 0x10,
-        0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x00, 0x01,
-    };
-
     expect(mock_stat,
             when(info, is_not_equal_to(NULL)),
             will_return(-1));
-    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
     given_data_size = mtp_responder_get_data(mtp);
     assert_that(error, is_equal_to(MTP_RESPONSE_INVALID_OBJECT_HANDLE));
     assert_that(given_data_size, is_equal_to(0));
@@ -62,11 +84,6 @@ Ensure(get_object, returns_error_when_file_doesnt_exists)
 
 Ensure(get_object, returns_error_when_unable_open_the_file)
 {
-    const uint8_t request[] = {
-        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x09, 0x10,
-        0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x00, 0x01,
-    };
-
     mtp_object_info_t dummy_file = {
       .filename = "welcome.txt",
       .created = 1580371617,
@@ -82,7 +99,7 @@ Ensure(get_object, returns_error_when_unable_open_the_file)
             will_return(0));
     expect(mock_open,
             will_return(-1));
-    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
     given_data_size = mtp_responder_get_data(mtp);
     assert_that(error, is_equal_to(MTP_RESPONSE_INVALID_OBJECT_HANDLE));
     assert_that(given_data_size, is_equal_to(0));
@@ -90,31 +107,12 @@ Ensure(get_object, returns_error_when_unable_open_the_file)
 
 Ensure(get_object, returns_error_when_read_from_file_failed)
 {
-    const uint8_t request[] = {
-        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x09, 0x10,
-        0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x00, 0x01,
-    };
-
-    mtp_object_info_t dummy_file = {
-      .filename = "welcome.txt",
-      .created = 1580371617,
-      .modified = 1580371617,
-      .format_code = MTP_FORMAT_TEXT,
-      .parent = 0,
-      .size = 35,
-    };
-
-    expect(mock_stat,
-            when(info, is_not_equal_to(NULL)),
-            will_set_contents_of_parameter(info, &dummy_file, sizeof(mtp_object_info_t)),
-            will_return(0));
-    expect(mock_open,
-            will_return(0));
+    expect_object_opened(35);
     expect(mock_read,
             when(count, is_greater_than(35)),
             will_return(-1));
     expect(mock_close);
-    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
     given_data_size = mtp_responder_get_data(mtp);
     assert_that(error, is_equal_to(MTP_RESPONSE_INCOMPLETE_TRANSFER));
     assert_that(given_data_size, is_equal_to(0));
@@ -122,30 +120,11 @@ Ensure(get_object, returns_error_when_read_from_file_failed)
 
 Ensure(get_object, returns_data_when_file_content_fits_in_one_frame)
 {
-    const uint8_t request[] = {
-        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x09, 0x10,
-        0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x00, 0x01,
-    };
-
-    mtp_object_info_t dummy_file = {
-      .filename = "welcome.txt",
-      .created = 1580371617,
-      .modified = 1580371617,
-      .format_code = MTP_FORMAT_TEXT,
-      .parent = 0,
-      .size = 200,
-    };
-
-    expect(mock_stat,
-            when(info, is_not_equal_to(NULL)),
-            will_set_contents_of_parameter(info, &dummy_file, sizeof(mtp_object_info_t)),
-            will_return(0));
-    expect(mock_open,
-            will_return(0));
+    expect_object_opened(200);
     expect(mock_read,
             when(count, is_equal_to(500)),
             will_return(200));
-    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
     given_data_size = mtp_responder_get_data(mtp);
     assert_that(error, is_equal_to(MTP_RESPONSE_OK));
     assert_that(given_data_size, is_equal_to(212));
@@ -153,26 +132,7 @@ Ensure(get_object, returns_data_when_file_content_fits_in_one_frame)
 
 Ensure(get_object, returns_data_when_file_content_exceeds_one_frame)
 {
-    const uint8_t request[] = {
-        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x09, 0x10,
-        0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x00, 0x01,
-    };
-
-    mtp_object_info_t dummy_file = {
-      .filename = "welcome.txt",
-      .created = 1580371617,
-      .modified = 1580371617,
-      .format_code = MTP_FORMAT_TEXT,
-      .parent = 0,
-      .size = 1024,
-    };
-
-    expect(mock_stat,
-            when(info, is_not_equal_to(NULL)),
-            will_set_contents_of_parameter(info, &dummy_file, sizeof(mtp_object_info_t)),
-            will_return(0));
-    expect(mock_open,
-            will_return(0));
+    expect_object_opened(1024);
     expect(mock_read,
             when(count, is_equal_to(500)),
             will_return(500));
@@ -184,7 +144,7 @@ Ensure(get_object, returns_data_when_file_content_exceeds_one_frame)
             will_return(12));
     expect(mock_close);
 
-    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
     assert_that(error, is_equal_to(MTP_RESPONSE_OK));
 
     given_data_size = mtp_responder_get_data(mtp);
@@ -199,3 +159,136 @@ Ensure(get_object, returns_data_when_file_content_exceeds_one_frame)
 
 }
 
+
+Ensure(get_object, fills_whole_buffer_when_storage_reads_less)
+{
+    expect_object_opened(1024);
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[12])),
+            when(count, is_equal_to(500)),
+            will_return(100));
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[112])),
+            when(count, is_equal_to(400)),
+            will_return(400));
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[0])),
+            when(count, is_equal_to(512)),
+            will_return(200));
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[200])),
+            when(count, is_equal_to(312)),
+            will_return(312));
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[0])),
+            when(count, is_equal_to(512)),
+            will_return(12));
+    expect(mock_close);
+
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
+    assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(512));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(512));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(12));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(0));
+}
+
+Ensure(get_object, returns_error_when_read_fails_after_partial_data)
+{
+    expect_object_opened(1024);
+    expect(mock_read,
+            when(count, is_equal_to(500)),
+            will_return(100));
+    expect(mock_read,
+            when(count, is_equal_to(400)),
+            will_return(-1));
+    expect(mock_close);
+
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(error, is_equal_to(MTP_RESPONSE_INCOMPLETE_TRANSFER));
+    assert_that(given_data_size, is_equal_to(0));
+}
+
+Ensure(get_object, reports_error_when_read_fails_during_data_phase)
+{
+    expect_object_opened(1024);
+    expect(mock_read,
+            when(count, is_equal_to(500)),
+            will_return(500));
+    expect(mock_read,
+            when(count, is_equal_to(512)),
+            will_return(200));
+    expect(mock_read,
+            when(count, is_equal_to(312)),
+            will_return(-1));
+    expect(mock_close);
+
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
+    assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(512));
+    assert_that(mtp_responder_get_data_status(mtp), is_equal_to(MTP_RESPONSE_OK));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(0));
+    assert_that(mtp_responder_get_data_status(mtp), is_equal_to(MTP_RESPONSE_INCOMPLETE_TRANSFER));
+}
+
+Ensure(get_object, puts_header_into_header_buffer_when_set)
+{
+    uint8_t header[MTP_CONTAINER_HEADER_SIZE];
+    const mtp_cntr_hdr_t *given_header = (mtp_cntr_hdr_t*)header;
+
+    mtp_responder_set_header_buffer(mtp, header);
+    expect_object_opened(200);
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[0])),
+            when(count, is_equal_to(512)),
+            will_return(200));
+
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+    assert_that(given_data_size, is_equal_to(200));
+    assert_that(mtp_responder_get_data_header_size(mtp), is_equal_to(MTP_CONTAINER_HEADER_SIZE));
+    assert_that(given_header->type, is_equal_to(MTP_CONTAINER_TYPE_DATA));
+    assert_that(given_header->operation_code, is_equal_to(MTP_OPERATION_GET_OBJECT));
+    assert_that(given_header->transaction_id, is_equal_to(0x30000006));
+    assert_that(given_header->length, is_equal_to(200+12));
+}
+
+Ensure(get_object, sends_header_only_in_front_of_first_chunk)
+{
+    uint8_t header[MTP_CONTAINER_HEADER_SIZE];
+
+    mtp_responder_set_header_buffer(mtp, header);
+    expect_object_opened(1024);
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[0])),
+            when(count, is_equal_to(512)),
+            will_return(512));
+    expect(mock_read,
+            when(buffer, is_equal_to(&given_data[0])),
+            when(count, is_equal_to(512)),
+            will_return(512));
+    expect(mock_close);
+
+    error = mtp_responder_handle_request(mtp, get_object_request, sizeof(get_object_request));
+    assert_that(error, is_equal_to(MTP_RESPONSE_OK));
+
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(512));
+    assert_that(mtp_responder_get_data_header_size(mtp), is_equal_to(MTP_CONTAINER_HEADER_SIZE));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(512));
+    assert_that(mtp_responder_get_data_header_size(mtp), is_equal_to(0));
+    given_data_size = mtp_responder_get_data(mtp);
+    assert_that(given_data_size, is_equal_to(0));
+    assert_that(mtp_responder_get_data_header_size(mtp), is_equal_to(0));
+}
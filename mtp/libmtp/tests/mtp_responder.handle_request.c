@@ -121,6 +121,7 @@ Ensure(mtp_responder_handle_request, get_storage_info)
 
     expect(serialize_storage_info,
             when(data, is_equal_to(&given_data[MTP_CONTAINER_HEADER_SIZE])),
+            when(size, is_equal_to(sizeof(given_data) - MTP_CONTAINER_HEADER_SIZE)),
             will_return(46));
 
     error = mtp_responder_handle_request(mtp, request, sizeof(request));
@@ -134,4 +135,18 @@ Ensure(mtp_responder_handle_request, get_storage_info)
     assert_that(given->header.length, is_equal_to(expected_length));
 }
 
+Ensure(mtp_responder_handle_request, get_storage_info_too_large_for_buffer)
+{
+    const uint8_t request[] = {
+        0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x05, 0x10,
+        0x06, 0x00, 0x00, 0x30, 0x01, 0x00, 0x01, 0x00,
+    };
+
+    expect(serialize_storage_info,
+            will_return(0));
+
+    error = mtp_responder_handle_request(mtp, request, sizeof(request));
+    assert_that(error, is_equal_to(MTP_RESPONSE_GENERAL_ERROR));
+}
+
 
@@ -5,6 +5,7 @@
 #include "mtp_container.h"
 #include "mtp_storage.h"
 #include "mtp_util.h"
+#include "mtp_schema.h"
 
 #include "mock_mtp_storage_api.h"
 
@@ -40,7 +41,7 @@ Ensure(mtp_storage, list_serialize_empty_array_if_no_files)
     expect(mock_find_first,
             when(parent, is_equal_to(0)),
             will_return(0));
-    given_length = serialize_storage_list(&storage, 0, given);
+    given_length = serialize_storage_list(&storage, 0, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -60,11 +61,27 @@ Ensure(mtp_storage, list_serialize_exactly_into_array)
     expect(mock_find_next,
             will_return(0));
 
-    given_length = serialize_storage_list(&storage, 0, given);
+    given_length = serialize_storage_list(&storage, 0, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
 
+Ensure(mtp_storage, list_fails_when_buffer_too_small)
+{
+    uint32_t COUNT = 2;
+    expect(mock_find_first,
+            when(parent, is_equal_to(0)),
+            will_set_contents_of_parameter(count, &COUNT, sizeof(uint32_t)),
+            will_return(0x81000000));
+    expect(mock_find_next,
+            will_return(0x82000000));
+    expect(mock_find_next,
+            will_return(0));
+
+    given_length = serialize_storage_list(&storage, 0, given, 8);
+    assert_that(given_length, is_equal_to(0));
+}
+
 Ensure(mtp_storage, storage_info)
 {
     expect(mock_get_properties,
@@ -73,21 +90,48 @@ Ensure(mtp_storage, storage_info)
     expect(mock_free_space,
             will_return(1024));
 
-    expect(put_16, when(value, is_equal_to(MTP_STORAGE_FIXED_ROM)), will_return(2));          /* Storage Type */
-    expect(put_16, when(value, is_equal_to(MTP_STORAGE_FILESYSTEM_FLAT)), will_return(2));    /* Filesystem Type */
-    expect(put_16, when(value, is_equal_to(0xaabb)), will_return(2));                         /* Access Capability */
-    expect(put_64, when(value, is_equal_to(0x55aadeadbeefaa55)), will_return(8));             /* Max Capacity, can't be 0! */
-    expect(put_64, when(value, is_equal_to(1024)), will_return(8));                           /* Free Space In Bytes */
-    expect(put_32, when(value, is_equal_to(0xFFFFFFFF)), will_return(4));                     /* Free Space In Objects */
+    const uint8_t expected[] = {
+        0x01, 0x00,                                     /* Storage Type */
+        0x01, 0x00,                                     /* Filesystem Type */
+        0xbb, 0xaa,                                     /* Access Capability */
+        0x55, 0xaa, 0xef, 0xbe, 0xad, 0xde, 0xaa, 0x55, /* Max Capacity, can't be 0! */
+        0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, /* Free Space In Bytes */
+        0xff, 0xff, 0xff, 0xff,                         /* Free Space In Objects */
+    };
+
+    expect(string_size,
+            when(text, is_equal_to_contents_of("Volume 1", 8)),
+            will_return(1+9*2));
     expect(put_string,
+            when(buffer, is_equal_to(&given[26])),
             when(text, is_equal_to_contents_of("Volume 1", 8)),
             will_return(1+9*2));                                                              /* Storage Description */
+    expect(string_size,
+            when(text, is_equal_to(NULL)),
+            will_return(1));
     expect(put_string,
             when(text, is_equal_to(NULL)),
             will_return(1));                                                                  /* Volume Identifier */
 
-    given_length = serialize_storage_info(&storage, given);
+    given_length = serialize_storage_info(&storage, given, sizeof(given));
     assert_that(given_length, is_equal_to(46));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+}
+
+Ensure(mtp_storage, storage_info_fails_when_buffer_too_small)
+{
+    expect(mock_get_properties,
+            will_return(&props));
+
+    expect(mock_free_space,
+            will_return(1024));
+
+    /* Fixed fields fit, but Storage Description doesn't */
+    expect(string_size,
+            when(text, is_equal_to_contents_of("Volume 1", 8)),
+            will_return(1+9*2));
+    given_length = serialize_storage_info(&storage, given, 40);
+    assert_that(given_length, is_equal_to(0));
 }
 
 Ensure(mtp_storage, storage_ids)
@@ -97,7 +141,7 @@ Ensure(mtp_storage, storage_ids)
         0xef, 0xbe, 0xcd, 0xab
     };
 
-    given_length = serialize_storage_ids(&storage, 1, given);
+    given_length = serialize_storage_ids(&storage, 1, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -117,23 +161,30 @@ Ensure(mtp_storage, object_info)
         .size = 0xabcdbeef,
     };
 
+    const uint8_t expected[] = {
+        0xef, 0xbe, 0xcd, 0xab, /* Storage ID*/
+        0x01, 0x80,             /* Object Format */
+        0xff, 0xff,             /* Protection Status*/
+        0xef, 0xbe, 0xcd, 0xab, /* Object Compressed Size*/
+        0x00, 0x00,             /* Thumb Format */
+        0x00, 0x00, 0x00, 0x00, /* Thumb Compressed Size */
+        0x00, 0x00, 0x00, 0x00, /* Thumb Pix Width */
+        0x00, 0x00, 0x00, 0x00, /* Thumb Pix Height */
+        0x00, 0x00, 0x00, 0x00, /* Image Pix Width */
+        0x00, 0x00, 0x00, 0x00, /* Image Pix Height */
+        0x00, 0x00, 0x00, 0x00, /* Image Bit Depth */
+        0x03, 0x00, 0x00, 0xe0, /* Parent Object */
+        0x03, 0xe0,             /* Association Type */
+        0x07, 0x00, 0x00, 0xc0, /* Association Descritpion */
+        0x00, 0x00, 0x00, 0x00, /* Sequence Number */
+    };
+
     /* YYYYMMDDThhmmss */
-    expect(put_32, when(value, is_equal_to(storage.id)), will_return(4)); /* Storage ID*/
-    expect(put_16, when(value, is_equal_to(0x8001)), will_return(2));     /* Object Format */
-    expect(put_16, when(value, is_equal_to(0xFFFF)), will_return(2));     /* Protection Status*/
-    expect(put_32, when(value, is_equal_to(0xabcdbeef)), will_return(4)); /* Object Compressed Size*/
-    expect(put_16, when(value, is_equal_to(0)), will_return(2));          /* Thumb Format */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Thumb Compressed Size */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Thumb Pix Width */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Thumb Pix Height */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Image Pix Width */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Image Pix Height */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Image Bit Depth */
-    expect(put_32, when(value, is_equal_to(0xE0000003)), will_return(4)); /* Parent Object */
-    expect(put_16, when(value, is_equal_to(0xE003)), will_return(2));     /* Association Type */
-    expect(put_32, when(value, is_equal_to(0xC0000007)), will_return(4)); /* Association Descritpion */
-    expect(put_32, when(value, is_equal_to(0)), will_return(4));          /* Sequence Number */
+    expect(string_size,
+            when(text, is_equal_to_contents_of("file.name.txt", 13)),
+            will_return(1+14*2));
     expect(put_string,
+            when(buffer, is_equal_to(&given[52])),
             when(text, is_equal_to_contents_of("file.name.txt", 13)),
             will_return(1+14*2));                                         /* Filename */
     expect(put_date,
@@ -142,12 +193,60 @@ Ensure(mtp_storage, object_info)
     expect(put_date,
             when(time, is_equal_to(1580323100)),
             will_return(1+16*2));                                         /* Date modified */
+    expect(string_size,
+            when(text, is_equal_to(NULL)),
+            will_return(3));
     expect(put_string,
             when(text, is_equal_to(NULL)),
             will_return(3));
 
-    given_length = serialize_object_info(&info, given);
+    given_length = serialize_object_info(&info, given, sizeof(given));
     assert_that(given_length, is_equal_to(150));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+}
+
+Ensure(mtp_storage, object_info_fails_when_buffer_too_small)
+{
+    mtp_object_info_t info = {
+        .storage_id = storage.id,
+        .filename = "file.name.txt",
+    };
+
+    given_length = serialize_object_info(&info, given, 40);
+    assert_that(given_length, is_equal_to(0));
+}
+
+static uint8_t chunks[64];
+static uint32_t chunks_length;
+
+static int flush_chunk(void *arg, const uint8_t *data, uint32_t length)
+{
+    (void)arg;
+    memcpy(chunks + chunks_length, data, length);
+    chunks_length += length;
+    return 0;
+}
+
+Ensure(mtp_storage, writer_flushes_full_buffer_in_chunks)
+{
+    const uint8_t expected[] = {
+        0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x03, 0x00, 0x04, 0x00,
+        0x00, 0x00, 0x00
+    };
+    const uint16_t codes[] = { 0x0002, 0x0003, 0x0004 };
+    mtp_writer_t writer;
+
+    chunks_length = 0;
+    mtp_writer_init(&writer, given, 4);
+    mtp_writer_set_flush(&writer, flush_chunk, NULL);
+    mtp_writer_put_array(&writer, codes, 1, sizeof(uint16_t));
+    mtp_writer_put(&writer, &codes[1], 2 * sizeof(uint16_t));
+    mtp_writer_put_zero(&writer, 3);
+
+    given_length = mtp_writer_finish(&writer);
+    assert_that(given_length, is_equal_to(sizeof(expected)));
+    memcpy(chunks + chunks_length, given, writer.length);
+    assert_that(chunks, is_equal_to_contents_of(expected, sizeof(expected)));
 }
 
 Ensure(mtp_storage, serialize_supported_object_properties)
@@ -165,8 +264,14 @@ Ensure(mtp_storage, serialize_supported_object_properties)
     };
     const int number_items = sizeof(expected_list)/sizeof(uint16_t);
 
-    given_length = serialize_object_props_supported(given);
+    given_length = serialize_object_props_supported(given, sizeof(given));
     assert_that(given_length, is_equal_to(4+sizeof(expected_list)));
     assert_that(*(uint32_t*)given, is_equal_to(number_items));
     assert_that(&given[4], is_equal_to_contents_of(expected_list, number_items));
 }
+
+Ensure(mtp_storage, supported_object_properties_fail_when_buffer_too_small)
+{
+    given_length = serialize_object_props_supported(given, 8);
+    assert_that(given_length, is_equal_to(0));
+}
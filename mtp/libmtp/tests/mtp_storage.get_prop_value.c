@@ -40,7 +40,7 @@ Ensure(get_obj_prop_value, storage_id)
     uint8_t expected[] = {
         0xef, 0xbe, 0xad, 0xde,
     };
-    given_length = serialize_object_prop_value(MTP_PROPERTY_STORAGE_ID, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_STORAGE_ID, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -50,7 +50,7 @@ Ensure(get_obj_prop_value, format_code)
     uint8_t expected[] = {
         0x01, 0x80,
     };
-    given_length = serialize_object_prop_value(MTP_PROPERTY_OBJECT_FORMAT, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_OBJECT_FORMAT, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -60,7 +60,7 @@ Ensure(get_obj_prop_value, size)
     uint8_t expected[] = {
         0xef, 0xbe, 0xcd, 0xab, 0x00, 0x00, 0x00, 0x00,
     };
-    given_length = serialize_object_prop_value(MTP_PROPERTY_OBJECT_SIZE, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_OBJECT_SIZE, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -73,17 +73,20 @@ Ensure(get_obj_prop_value, uid)
         0x01, 0x02, 0x03, 0x04,
         0x01, 0x02, 0x03, 0x04
     };
-    given_length = serialize_object_prop_value(MTP_PROPERTY_PERSISTENT_UID, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_PERSISTENT_UID, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
 
 Ensure(get_obj_prop_value, name)
 {
+    expect(string_size,
+            when(text, is_equal_to_contents_of("file", 5)),
+            will_return(5));
     expect(put_string,
             when(text, is_equal_to_contents_of("file", 5)),
             will_return(5));
-    given_length = serialize_object_prop_value(MTP_PROPERTY_NAME, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_NAME, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(5));
 }
 
@@ -92,7 +95,7 @@ Ensure(get_obj_prop_value, date_created)
     expect(put_date,
             when(time, is_equal_to(1580322989)),
             will_return(11));
-    given_length = serialize_object_prop_value(MTP_PROPERTY_DATE_CREATED, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_DATE_CREATED, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(11));
 }
 
@@ -101,7 +104,7 @@ Ensure(get_obj_prop_value, date_modified)
     expect(put_date,
             when(time, is_equal_to(1580323100)),
             will_return(11));
-    given_length = serialize_object_prop_value(MTP_PROPERTY_DATE_MODIFIED, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_DATE_MODIFIED, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(11));
 }
 
@@ -110,7 +113,7 @@ Ensure(get_obj_prop_value, parent)
     uint8_t expected[] = {
         0x03, 0x00, 0x00, 0xE0
     };
-    given_length = serialize_object_prop_value(MTP_PROPERTY_PARENT_OBJECT, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_PARENT_OBJECT, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 
@@ -118,10 +121,13 @@ Ensure(get_obj_prop_value, parent)
 
 Ensure(get_obj_prop_value, file_name)
 {
+    expect(string_size,
+            when(text, is_equal_to_contents_of("file", 5)),
+            will_return(5));
     expect(put_string,
             when(text, is_equal_to_contents_of("file", 5)),
             will_return(5));
-    given_length = serialize_object_prop_value(MTP_PROPERTY_OBJECT_FILE_NAME, &info, given);
+    given_length = serialize_object_prop_value(MTP_PROPERTY_OBJECT_FILE_NAME, &info, given, sizeof(given));
     assert_that(given_length, is_equal_to(5));
 }
 
@@ -29,7 +29,7 @@ Ensure(obj_prop_desc, storage_id_property)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_STORAGE_ID, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_STORAGE_ID, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -44,7 +44,7 @@ Ensure(obj_prop_desc, object_format_code_property)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_OBJECT_FORMAT, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_OBJECT_FORMAT, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -59,7 +59,7 @@ Ensure(obj_prop_desc, object_size_property)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_OBJECT_SIZE, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_OBJECT_SIZE, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -74,7 +74,7 @@ Ensure(obj_prop_desc, object_file_name_property)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_OBJECT_FILE_NAME, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_OBJECT_FILE_NAME, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -89,7 +89,7 @@ Ensure(obj_prop_desc, object_date_created_property)
         0x00, 0x00, 0x00, 0x00,
         0x03
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_DATE_CREATED, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_DATE_CREATED, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -104,7 +104,7 @@ Ensure(obj_prop_desc, object_date_modified_property)
         0x00, 0x00, 0x00, 0x00,
         0x03
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_DATE_MODIFIED, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_DATE_MODIFIED, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -119,7 +119,7 @@ Ensure(obj_prop_desc, object_parent_property)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_PARENT_OBJECT, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_PARENT_OBJECT, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -135,7 +135,7 @@ Ensure(obj_prop_desc, object_uid)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_PERSISTENT_UID, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_PERSISTENT_UID, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -150,7 +150,7 @@ Ensure(obj_prop_desc, object_name_property)
         0x00, 0x00, 0x00, 0x00,
         0x00
     };
-    given_length = serialize_object_prop_desc(MTP_PROPERTY_NAME, given);
+    given_length = serialize_object_prop_desc(MTP_PROPERTY_NAME, given, sizeof(given));
     assert_that(given_length, is_equal_to(sizeof(expected)));
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
@@ -99,6 +99,29 @@ Ensure(mtp_util, puts_string_as_utf16_with_length_and_null_char_at_the_end)
     assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
 }
 
+Ensure(mtp_util, string_size_is_length_put_string_writes)
+{
+    const char *texts[] = {
+        NULL, "", "test", "za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87", "a\xf0\x9f\x98\x80", "\xc5" "a\xff",
+    };
+    uint8_t given[64];
+    for (unsigned i = 0; i < sizeof(texts) / sizeof(texts[0]); i++)
+    {
+        assert_that(string_size(texts[i]), is_equal_to(put_string(given, texts[i])));
+    }
+}
+
+Ensure(mtp_util, string_size_follows_length_limit)
+{
+    char text[300 + 1];
+    uint8_t given[1 + 2 * 300];
+    memset(text, 'a', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    assert_that(string_size(text), is_equal_to(1 + 2 * 255));
+    memcpy(text + 253, "\xf0\x9f\x98\x80", 5);
+    assert_that(string_size(text), is_equal_to(put_string(given, text)));
+}
+
 Ensure(mtp_util, get_string_parse_correctly)
 {
     char expected[] = "test test test";
@@ -112,6 +135,114 @@ Ensure(mtp_util, get_string_parse_correctly)
     assert_that(length, is_equal_to(1 + 2*(strlen(expected) + 1)));
 }
 
+Ensure(mtp_util, puts_utf8_string_as_utf16)
+{
+    /* "zażółć" */
+    const uint8_t expected[] = {7, 'z', 0x00, 'a', 0x00, 0x7c, 0x01, 0xf3, 0x00, 0x42, 0x01, 0x07, 0x01, 0x00, 0x00};
+    uint8_t given[32];
+    int given_len = -1;
+    given_len = put_string(given, "za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87");
+    assert_that(given_len, is_equal_to(sizeof(expected)));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+}
+
+Ensure(mtp_util, puts_supplementary_character_as_surrogate_pair)
+{
+    const uint8_t expected[] = {4, 'a', 0x00, 0x3d, 0xd8, 0x00, 0xde, 0x00, 0x00};
+    uint8_t given[16];
+    int given_len = -1;
+    given_len = put_string(given, "a\xf0\x9f\x98\x80");
+    assert_that(given_len, is_equal_to(sizeof(expected)));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+}
+
+Ensure(mtp_util, puts_replacement_character_for_malformed_utf8)
+{
+    const uint8_t expected[] = {4, 0xfd, 0xff, 'a', 0x00, 0xfd, 0xff, 0x00, 0x00};
+    uint8_t given[16];
+    int given_len = -1;
+    given_len = put_string(given, "\xc5" "a\xff");
+    assert_that(given_len, is_equal_to(sizeof(expected)));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+}
+
+Ensure(mtp_util, truncates_string_to_255_characters)
+{
+    char text[300 + 1];
+    uint8_t given[1 + 2 * 300];
+    int given_len = -1;
+    memset(text, 'a', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    given_len = put_string(given, text);
+    assert_that(given[0], is_equal_to(255));
+    assert_that(given_len, is_equal_to(1 + 2 * 255));
+    assert_that(given[1 + 2 * 253], is_equal_to('a'));
+    assert_that(given[1 + 2 * 254], is_equal_to(0));
+}
+
+Ensure(mtp_util, does_not_split_surrogate_pair_at_length_limit)
+{
+    char text[253 + 4 + 1];
+    uint8_t given[1 + 2 * 256];
+    int given_len = -1;
+    memset(text, 'a', 253);
+    memcpy(text + 253, "\xf0\x9f\x98\x80", 5);
+    given_len = put_string(given, text);
+    assert_that(given[0], is_equal_to(254));
+    assert_that(given_len, is_equal_to(1 + 2 * 254));
+}
+
+Ensure(mtp_util, get_string_parse_utf16_to_utf8)
+{
+    char expected[] = "za\xc5\xbc\xc3\xb3\xc5\x82\xc4\x87 \xf0\x9f\x98\x80";
+    uint8_t unicode[64];
+    char given[64];
+    int length;
+    put_string(unicode, expected);
+    length = get_string(unicode, given, sizeof(given));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+    assert_that(length, is_equal_to(1 + 2 * (unicode[0])));
+}
+
+Ensure(mtp_util, get_string_parse_long_ascii_string)
+{
+    char expected[200 + 1];
+    uint8_t unicode[1 + 2 * 201];
+    char given[sizeof(expected)];
+    int length;
+    int i;
+    for (i = 0; i < 200; i++)
+        expected[i] = 'a' + i % 26;
+    expected[200] = '\0';
+    put_string(unicode, expected);
+    length = get_string(unicode, given, sizeof(given));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+    assert_that(length, is_equal_to(1 + 2 * 201));
+}
+
+Ensure(mtp_util, get_string_replaces_lone_surrogate)
+{
+    const uint8_t unicode[] = {3, 0x00, 0xdc, 'a', 0x00, 0x00, 0x00};
+    char expected[] = "\xef\xbf\xbd" "a";
+    char given[16];
+    int length;
+    length = get_string(unicode, given, sizeof(given));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+    assert_that(length, is_equal_to(sizeof(unicode)));
+}
+
+Ensure(mtp_util, get_string_fails_if_text_does_not_fit)
+{
+    uint8_t unicode[32];
+    char given[8];
+    put_string(unicode, "abcdefgh");
+    assert_that(get_string(unicode, given, sizeof(given)), is_equal_to(-1));
+    put_string(unicode, "abcdef\xc5\xbc");
+    assert_that(get_string(unicode, given, sizeof(given)), is_equal_to(-1));
+    put_string(unicode, "abcde\xc5\xbc");
+    assert_that(get_string(unicode, given, sizeof(given)), is_not_equal_to(-1));
+}
+
 Ensure(mtp_util, puts_single_zero_if_text_is_null)
 {
     const uint8_t expected[] = { 0x01, 0x00, 0x00 };
@@ -157,3 +288,127 @@ Ensure(mtp_util, get_date_is_revers_to_put_date)
     assert_that(length, is_equal_to(1+16*2));
     assert_that(given, is_equal_to(expected));
 }
+
+Ensure(mtp_util, get_date_accepts_utc_suffix)
+{
+    time_t given = 123;
+    uint8_t encoded[64];
+    int length = put_string(encoded, "20200129T183629Z");
+    assert_that(get_date(encoded, &given), is_equal_to(length));
+    assert_that(given, is_equal_to(1580322989));
+}
+
+Ensure(mtp_util, get_date_applies_offset_suffix)
+{
+    time_t given = 123;
+    uint8_t encoded[64];
+    put_string(encoded, "20200129T193629+0100");
+    assert_that(get_date(encoded, &given), is_greater_than(0));
+    assert_that(given, is_equal_to(1580322989));
+    put_string(encoded, "20200129T150629-03:30");
+    assert_that(get_date(encoded, &given), is_equal_to(-1));
+    put_string(encoded, "20200129T150629-0330");
+    assert_that(get_date(encoded, &given), is_greater_than(0));
+    assert_that(given, is_equal_to(1580322989));
+    put_string(encoded, "20200129T173629-01");
+    assert_that(get_date(encoded, &given), is_greater_than(0));
+    assert_that(given, is_equal_to(1580322989));
+}
+
+Ensure(mtp_util, get_date_ignores_tenths_of_second)
+{
+    time_t given = 123;
+    uint8_t encoded[64];
+    int length = put_string(encoded, "20200129T183629.7");
+    assert_that(get_date(encoded, &given), is_equal_to(length));
+    assert_that(given, is_equal_to(1580322989));
+    put_string(encoded, "20200129T183629.7Z");
+    assert_that(get_date(encoded, &given), is_greater_than(0));
+    assert_that(given, is_equal_to(1580322989));
+}
+
+Ensure(mtp_util, get_date_rejects_malformed_dates)
+{
+    const char *dates[] = {
+        "", "2020", "20200129 183629", "2020012aT183629", "20201329T183629",
+        "20200100T183629", "20200129T243629", "20200129T186029", "20200129T183629.",
+        "20200129T183629X", "20200129T183629Z0", "20200129T183629+1", "20230231T000000",
+        "20210229T000000", "19000229T000000", "20200431T000000",
+    };
+    time_t given = 123;
+    uint8_t encoded[64];
+    for (unsigned i = 0; i < sizeof(dates) / sizeof(dates[0]); i++)
+    {
+        put_string(encoded, dates[i]);
+        assert_that(get_date(encoded, &given), is_equal_to(-1));
+    }
+    assert_that(given, is_equal_to(123));
+}
+
+Ensure(mtp_util, date_round_trips_across_calendar)
+{
+    const time_t dates[] = { 0, 951782400, 951868799, 4107542399, 1580322989 };
+    time_t given;
+    uint8_t encoded[64];
+    for (unsigned i = 0; i < sizeof(dates) / sizeof(dates[0]); i++)
+    {
+        given = 123;
+        put_date(encoded, dates[i]);
+        assert_that(get_date(encoded, &given), is_equal_to(1 + 16 * 2));
+        assert_that(given, is_equal_to(dates[i]));
+    }
+}
+
+Ensure(mtp_util, put_date_formats_leap_day)
+{
+    //2000 02 29 T000000
+    const uint8_t expected[] = { 16,
+         '2', 0x00, '0', 0x00, '0', 0x00, '0', 0x00,
+         '0', 0x00, '2', 0x00, '2', 0x00, '9', 0x00,
+         'T', 0x00,
+         '0', 0x00, '0', 0x00, '0', 0x00, '0', 0x00, '0', 0x00, '0', 0x00,
+         0x00, 0x00};
+    uint8_t given[33] = {0};
+    assert_that(put_date(given, 951782400), is_equal_to(sizeof(expected)));
+    assert_that(given, is_equal_to_contents_of(expected, sizeof(expected)));
+}
+
+Ensure(mtp_util, get_date_accepts_leap_day)
+{
+    time_t given = 123;
+    uint8_t encoded[64];
+    put_string(encoded, "20000229T000000Z");
+    assert_that(get_date(encoded, &given), is_greater_than(0));
+    assert_that(given, is_equal_to(951782400));
+}
+
+static int put_date_as_string(time_t time, char *text, int length)
+{
+    uint8_t encoded[64];
+    put_date(encoded, time);
+    return get_string(encoded, text, length);
+}
+
+Ensure(mtp_util, date_follows_daylight_saving_transitions)
+{
+    char given[32];
+    time_t parsed = 123;
+    uint8_t encoded[64];
+
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    put_date_as_string(1585443599, given, sizeof(given));
+    assert_that(given, is_equal_to_string("20200329T015959"));
+    put_date_as_string(1585443600, given, sizeof(given));
+    assert_that(given, is_equal_to_string("20200329T030000"));
+    put_date_as_string(1603587599, given, sizeof(given));
+    assert_that(given, is_equal_to_string("20201025T025959"));
+    put_date_as_string(1603587600, given, sizeof(given));
+    assert_that(given, is_equal_to_string("20201025T020000"));
+
+    put_string(encoded, "20200701T120000");
+    assert_that(get_date(encoded, &parsed), is_greater_than(0));
+    assert_that(parsed, is_equal_to(1593597600));
+    put_string(encoded, "20200115T120000");
+    assert_that(get_date(encoded, &parsed), is_greater_than(0));
+    assert_that(parsed, is_equal_to(1579086000));
+}
@@ -17,21 +17,50 @@
 #include "mtp_fs.h"
 #include "log.hpp"
 
+#if !(defined(USB_DEVICE_NOTIFICATION_QUEUE_ENABLE) && (USB_DEVICE_NOTIFICATION_QUEUE_ENABLE > 0U))
+#error "MTP waits for transfer completions delivered in task context"
+#endif
+
 #define UNUSED(x) do { (void)(x); } while (0)
 
-/* Number of buffers that fit into input and output stream */
+/* Number of buffers that fit into input stream */
 #define CONFIG_RX_STREAM_SIZE (4)
-#define CONFIG_TX_STREAM_SIZE (1)
 #define CONFIG_MTP_STORAGE_ID (0x00010001)
 
-USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE)
-uint8_t rx_buffer[HS_MTP_BULK_IN_PACKET_SIZE];
-USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE)
-uint8_t tx_buffer[HS_MTP_BULK_OUT_PACKET_SIZE];
-USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE)
-uint8_t event_response[HS_MTP_INTR_IN_PACKET_SIZE];
-USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE) static uint8_t mtp_request[sizeof(rx_buffer)];
-USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE) static uint8_t mtp_response[sizeof(tx_buffer)];
+/* Responder produces datasets and object data in chunks of this size. Each chunk
+ * is sent in one transfer, the controller splits it into packets. */
+#ifndef CONFIG_MTP_RESPONSE_BUFFER_SIZE
+#define CONFIG_MTP_RESPONSE_BUFFER_SIZE (16U * 1024U)
+#endif
+
+/* Transfer timeout slice, task checks for reset and termination in between */
+#define MTP_SEND_WAIT_SLICE_MS (100)
+
+/* Time given to the controller to report a cancelled transfer, together with
+ * the slice it fits into the 150 ms MtpDeinit() waits for the task */
+#define MTP_SEND_CANCEL_WAIT_MS (40)
+
+/* Object data is read into a page aligned buffer and its container header is
+ * kept in the last bytes of the page in front of it. The controller maps both
+ * onto the same transfer descriptors, see USB_DeviceSendRequestV(). The rest
+ * of that page holds the command phase buffers. */
+#define MTP_PAGE_SIZE (4096U)
+
+#define MTP_RX_BUFFER_SIZE    USB_DATA_ALIGN_SIZE_MULTIPLE(HS_MTP_BULK_IN_PACKET_SIZE)
+#define MTP_EVENT_BUFFER_SIZE USB_DATA_ALIGN_SIZE_MULTIPLE(HS_MTP_INTR_IN_PACKET_SIZE)
+
+typedef struct {
+    uint8_t rx[MTP_RX_BUFFER_SIZE];
+    uint8_t event[MTP_EVENT_BUFFER_SIZE];
+    uint8_t request[MTP_RX_BUFFER_SIZE];
+    uint8_t unused[MTP_PAGE_SIZE - 2U * MTP_RX_BUFFER_SIZE - MTP_EVENT_BUFFER_SIZE - MTP_CONTAINER_HEADER_SIZE];
+    uint8_t header[MTP_CONTAINER_HEADER_SIZE];
+    uint8_t response[USB_DATA_ALIGN_SIZE_MULTIPLE(CONFIG_MTP_RESPONSE_BUFFER_SIZE)];
+} mtp_buffers_t;
+
+_Static_assert(offsetof(mtp_buffers_t, response) == MTP_PAGE_SIZE, "Object data has to start on a page boundary");
+
+USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(MTP_PAGE_SIZE) static mtp_buffers_t mtp_buffers;
 USB_GLOBAL USB_RAM_ADDRESS_ALIGNMENT(USB_DATA_ALIGN_SIZE) static char mtpRootPath[256];
 
 #define MTP_TASK_STACK_SIZE (3U * 1024U)
@@ -55,38 +84,53 @@ static usb_status_t RescheduleRecv(usb_mtp_struct_t *mtpApp)
     if (!USB_DeviceClassMtpIsBusy(mtpApp->classHandle, USB_MTP_BULK_OUT_ENDPOINT) && !mtpApp->in_reset) {
         size_t available = xMessageBufferSpaceAvailable(mtpApp->inputBox) - 4;
         if (available >= endpoint_size) {
-            error = USB_DeviceClassMtpRecv(mtpApp->classHandle, USB_MTP_BULK_OUT_ENDPOINT, rx_buffer, endpoint_size);
+            error = USB_DeviceClassMtpRecv(mtpApp->classHandle, USB_MTP_BULK_OUT_ENDPOINT, mtp_buffers.rx, endpoint_size);
         }
     }
     return error;
 }
 
-static size_t SliceToStream(usb_mtp_struct_t *mtpApp, void *buffer, size_t length)
-{
-    size_t total     = 0;
-    size_t remaining = length;
-
-    while (remaining > 0) {
-        size_t to_send  = (remaining < mtpApp->usb_buffer_size) ? remaining : mtpApp->usb_buffer_size;
-        size_t buffered = xMessageBufferSend(mtpApp->outputBox, &((uint8_t *)buffer)[total], to_send, 0);
-        if (buffered <= 0) {
-            break;
-        }
-
-        total += buffered;
-        remaining -= buffered;
-    }
-    return total;
-}
-
-static usb_status_t USBSend(usb_mtp_struct_t *mtpApp, void *buffer, size_t length)
+static usb_status_t USBSend(usb_mtp_struct_t *mtpApp,
+                            const usb_device_transfer_segment_struct_t *segments,
+                            uint32_t count,
+                            uint32_t generation)
 {
     usb_status_t error  = kStatus_USB_Error;
     uint32_t timeout_ms = 1;
     int retries         = 30;
+    USB_OSA_SR_ALLOC();
 
     while (--retries && !mtpApp->in_reset && !mtpApp->is_terminated) {
-        error = USB_DeviceClassMtpSend(mtpApp->classHandle, USB_MTP_BULK_IN_ENDPOINT, buffer, length);
+        uint32_t previous;
+        bool claimed = false;
+
+        /* The pipe is free before its completion reaches OnOutgoingFrameSent(),
+         * wait for it, so it isn't taken for the completion of this transfer */
+        USB_OSA_ENTER_CRITICAL();
+        previous = mtpApp->tx_generation;
+        if (mtpApp->tx_completed == previous) {
+            mtpApp->tx_generation = generation;
+            claimed               = true;
+        }
+        USB_OSA_EXIT_CRITICAL();
+
+        if (claimed) {
+            if (count > 1) {
+                error = USB_DeviceClassMtpSendV(mtpApp->classHandle, USB_MTP_BULK_IN_ENDPOINT, segments, count);
+            }
+            else {
+                error = USB_DeviceClassMtpSend(
+                    mtpApp->classHandle, USB_MTP_BULK_IN_ENDPOINT, segments[0].buffer, segments[0].length);
+            }
+            if (error != kStatus_USB_Success) {
+                /* Nothing queued, no completion will come for it */
+                mtpApp->tx_generation = previous;
+            }
+        }
+        else {
+            error = kStatus_USB_Busy;
+        }
+
         if (error == kStatus_USB_Success) {
             break;
         }
@@ -98,44 +142,60 @@ static usb_status_t USBSend(usb_mtp_struct_t *mtpApp, void *buffer, size_t lengt
     return error;
 }
 
-static size_t Send(usb_mtp_struct_t *mtpApp, void *buffer, size_t length)
+/* Takes the buffer back from the controller, the caller reuses it on return */
+static void CancelSend(usb_mtp_struct_t *mtpApp, uint32_t generation)
 {
-    size_t sent = 0;
-    if (!mtpApp->configured || !length) {
-        return kStatus_USB_InvalidParameter;
+    int slices = MTP_SEND_CANCEL_WAIT_MS / 10;
+
+    if (USB_DeviceClassMtpCancel(mtpApp->classHandle, USB_MTP_BULK_IN_ENDPOINT) != kStatus_USB_Success) {
+        log_debug("[MTP] Unable to cancel transfer");
     }
 
-    log_debug("[MTP] want to send: %dB", (int)length);
+    while (mtpApp->tx_completed != generation && slices--) {
+        xSemaphoreTake(mtpApp->sent, pdMS_TO_TICKS(10));
+    }
 
-    if (xMessageBufferIsEmpty(mtpApp->outputBox)) {
+    if (mtpApp->tx_completed != generation) {
+        log_debug("[MTP] Cancelled transfer not reported by controller");
+    }
+}
 
-        size_t send_now  = (length < mtpApp->usb_buffer_size) ? length : mtpApp->usb_buffer_size;
-        size_t remaining = (length - send_now);
-        size_t buffered;
+/* Header, when given, goes out in front of the buffer in the same transfer */
+static size_t Send(usb_mtp_struct_t *mtpApp, void *header, size_t header_length, void *buffer, size_t length)
+{
+    usb_device_transfer_segment_struct_t segments[] = {
+        {.buffer = (uint8_t *)header, .length = header_length},
+        {.buffer = (uint8_t *)buffer, .length = length},
+    };
+    uint32_t generation;
 
-        if (remaining > 0) {
-            buffered = SliceToStream(mtpApp, &((uint8_t *)buffer)[mtpApp->usb_buffer_size], remaining);
-            sent     = send_now + buffered;
-        }
-        else {
-            sent = send_now;
-        }
+    if (!mtpApp->configured || !length) {
+        return kStatus_USB_InvalidParameter;
+    }
 
-        memcpy(tx_buffer, buffer, send_now);
+    length += header_length;
+    log_debug("[MTP] want to send: %dB", (int)length);
 
-        if (USBSend(mtpApp, tx_buffer, send_now) != kStatus_USB_Success) {
-            xMessageBufferReset(mtpApp->outputBox);
-            log_debug("[MTP] FATAL: Couldn't send data");
-            sent = 0;
-        }
+    generation = mtpApp->tx_generation + 1;
+    if (USBSend(mtpApp, header_length ? &segments[0] : &segments[1], header_length ? 2U : 1U, generation) !=
+        kStatus_USB_Success) {
+        log_debug("[MTP] FATAL: Couldn't send data");
+        return 0;
     }
-    else {
-        // fill buffer up
-        log_debug("[MTP] TX is busy and we want to queue more data");
+
+    /* Responder refills the buffer as soon as this returns. The semaphore may
+     * still hold the wakeup of an earlier transfer, so the generation decides. */
+    while (mtpApp->tx_completed != generation) {
+        if (mtpApp->in_reset || mtpApp->is_terminated) {
+            log_debug("[MTP] Send interrupted");
+            CancelSend(mtpApp, generation);
+            return 0;
+        }
+        xSemaphoreTake(mtpApp->sent, pdMS_TO_TICKS(MTP_SEND_WAIT_SLICE_MS));
     }
 
-    log_debug("[MTP] accepted to send: %dB", (int)sent);
-    return sent;
+    log_debug("[MTP] accepted to send: %dB", (int)length);
+    return length;
 }
 
 static usb_status_t OnConfigurationComplete(usb_mtp_struct_t *mtpApp, void *param)
@@ -178,23 +238,23 @@ static usb_status_t OnOutgoingFrameSent(usb_mtp_struct_t *mtpApp, void *param)
 {
     UNUSED(param);
 
-    if (mtpApp->configured) {
-        log_debug("[MTP] already sent");
-        if (mtpApp->outputBox == NULL) {
-            log_error("[MTP] output stream buffer is NULL!");
-            return kStatus_USB_Error;
-        }
-        size_t length = xMessageBufferReceiveFromISR(mtpApp->outputBox, tx_buffer, sizeof(tx_buffer), NULL);
-        if (length && USB_DeviceClassMtpSend(mtpApp->classHandle, USB_MTP_BULK_IN_ENDPOINT, tx_buffer, length) !=
-                          kStatus_USB_Success) {
-            log_debug("[MTP] Dropped outgoing bytes: 0x%X:", (int)length);
-            return kStatus_USB_Error;
-        }
-    }
-    else {
+    if (!mtpApp->configured) {
         log_debug("[MTP] Tx notification from controller - not configured");
     }
 
+    /* One transfer is in flight at a time, so this completes the last one
+     * started. Cancelled transfers are reported too, Send() waits for them. */
+    if (mtpApp->tx_completed == mtpApp->tx_generation) {
+        log_debug("[MTP] Tx notification without transfer");
+        return kStatus_USB_Success;
+    }
+    mtpApp->tx_completed = mtpApp->tx_generation;
+
+    log_debug("[MTP] already sent");
+    if (mtpApp->sent != NULL) {
+        xSemaphoreGive(mtpApp->sent);
+    }
+
     return kStatus_USB_Success;
 }
 
@@ -214,8 +274,8 @@ static usb_status_t OnGetStatus(usb_mtp_struct_t *mtpApp, void *param)
     if (mtpApp->in_reset || mtp_responder_data_transaction_open(mtpApp->responder)) {
         status = MTP_RESPONSE_DEVICE_BUSY;
     }
-    mtp_responder_get_event(mtpApp->responder, status, event_response, &event_length);
-    request->buffer = event_response;
+    mtp_responder_get_event(mtpApp->responder, status, mtp_buffers.event, &event_length);
+    request->buffer = mtp_buffers.event;
     request->length = event_length;
     log_debug("[MTP] Control Device Status Response: 0x%04x", status);
     return kStatus_USB_Success;
@@ -254,20 +314,22 @@ static void send_response(usb_mtp_struct_t *mtpApp, uint16_t status)
     size_t result_len          = 0;
     mtp_responder_t *responder = mtpApp->responder;
 
-    mtp_responder_get_response(responder, status, mtp_response, &result_len);
+    mtp_responder_get_response(responder, status, mtp_buffers.response, &result_len);
 
-    if (!Send(mtpApp, mtp_response, result_len)) {
+    if (!Send(mtpApp, NULL, 0, mtp_buffers.response, result_len)) {
         log_debug("[MTP] Transfer failed");
     }
 }
 
 static void poll_new_data(usb_mtp_struct_t *mtpApp, size_t *request_len)
 {
+    USB_OSA_SR_ALLOC();
+
     do {
-        taskENTER_CRITICAL();
+        USB_OSA_ENTER_CRITICAL();
         RescheduleRecv(mtpApp);
-        taskEXIT_CRITICAL();
-        *request_len = xMessageBufferReceive(mtpApp->inputBox, mtp_request, sizeof(mtp_request), pdMS_TO_TICKS(100));
+        USB_OSA_EXIT_CRITICAL();
+        *request_len = xMessageBufferReceive(mtpApp->inputBox, mtp_buffers.request, sizeof(mtp_buffers.request), pdMS_TO_TICKS(100));
     } while (*request_len == 0 && !mtpApp->in_reset);
 }
 
@@ -290,7 +352,8 @@ static void MtpTask(void *handle)
         mtpApp->mtp_fs = NULL;
         return;
     }
-    mtp_responder_set_data_buffer(mtpApp->responder, mtp_response, sizeof(mtp_response));
+    mtp_responder_set_data_buffer(mtpApp->responder, mtp_buffers.response, sizeof(mtp_buffers.response));
+    mtp_responder_set_header_buffer(mtpApp->responder, mtp_buffers.header);
     mtp_responder_set_storage(mtpApp->responder, CONFIG_MTP_STORAGE_ID, &simple_fs_api, mtpApp->mtp_fs);
     mtp_responder_bind_storage_lock(mtpApp->responder, &mtpApp->is_storage_locked);
 
@@ -304,7 +367,6 @@ static void MtpTask(void *handle)
         }
 
         xMessageBufferReset(mtpApp->inputBox);
-        xMessageBufferReset(mtpApp->outputBox);
         mtp_responder_transaction_reset(mtpApp->responder);
 
         log_debug("[MTP] Ready");
@@ -325,7 +387,7 @@ static void MtpTask(void *handle)
 
             // Incoming data transaction open:
             if (mtp_responder_data_transaction_open(responder)) {
-                status = mtp_responder_set_data(responder, mtp_request, request_len);
+                status = mtp_responder_set_data(responder, mtp_buffers.request, request_len);
                 if (status == MTP_RESPONSE_INCOMPLETE_TRANSFER) {
                     // This happens with Linux (Nautilus) client. Cancelation procedure
                     // is to just stop sending data in this transaction.
@@ -349,7 +411,7 @@ static void MtpTask(void *handle)
                 }
             }
 
-            status = mtp_responder_handle_request(responder, mtp_request, request_len);
+            status = mtp_responder_handle_request(responder, mtp_buffers.request, request_len);
 
             if (status != MTP_RESPONSE_UNDEFINED) {
                 while ((result_len = mtp_responder_get_data(responder)) && !mtpApp->in_reset) {
@@ -364,13 +426,22 @@ static void MtpTask(void *handle)
                         break;
                     }
 
-                    if (!Send(mtpApp, mtp_response, result_len)) {
+                    if (!Send(mtpApp,
+                              mtp_buffers.header,
+                              mtp_responder_get_data_header_size(responder),
+                              mtp_buffers.response,
+                              result_len)) {
                         log_debug("[MTP] Outgoing data canceled (unable to send)");
                         mtpApp->in_reset = true;
                         break;
                     }
                 }
 
+                /* Data phase cut short by a read error */
+                if (status == MTP_RESPONSE_OK) {
+                    status = mtp_responder_get_data_status(responder);
+                }
+
                 if (status && !mtpApp->in_reset) {
                     send_response(mtpApp, status);
                 }
@@ -390,6 +461,8 @@ usb_status_t MtpInit(usb_mtp_struct_t *mtpApp, class_handle_t classHandle, const
     mtpApp->is_terminated       = false;
     mtpApp->is_storage_locked   = mtpLockedAtInit;
     mtpApp->classHandle         = classHandle;
+    mtpApp->tx_generation       = 0;
+    mtpApp->tx_completed        = 0;
 
     if ((mtpApp->join = xSemaphoreCreateBinary()) == NULL) {
         return kStatus_USB_AllocFail;
@@ -399,13 +472,11 @@ usb_status_t MtpInit(usb_mtp_struct_t *mtpApp, class_handle_t classHandle, const
         return kStatus_USB_AllocFail;
     }
 
-    if ((mtpApp->inputBox = xMessageBufferCreate(CONFIG_RX_STREAM_SIZE * sizeof(rx_buffer))) == NULL) {
+    if ((mtpApp->inputBox = xMessageBufferCreate(CONFIG_RX_STREAM_SIZE * sizeof(mtp_buffers.rx))) == NULL) {
         return kStatus_USB_AllocFail;
     }
 
-    /* sizeof(uint32_t) additional bytes to store number of bytes in the stream */
-    if ((mtpApp->outputBox = xMessageBufferCreate(sizeof(uint32_t) + CONFIG_TX_STREAM_SIZE * sizeof(tx_buffer))) ==
-        NULL) {
+    if ((mtpApp->sent = xSemaphoreCreateBinary()) == NULL) {
         return kStatus_USB_AllocFail;
     }
 
@@ -446,13 +517,13 @@ void MtpDeinit(usb_mtp_struct_t *mtpApp)
     }
 
     mtp_responder_free(mtpApp->responder);
-    vStreamBufferDelete(mtpApp->outputBox);
     vStreamBufferDelete(mtpApp->inputBox);
+    vSemaphoreDelete(mtpApp->sent);
     vSemaphoreDelete(mtpApp->join);
     vSemaphoreDelete(mtpApp->configuring);
     mtpApp->responder   = NULL;
-    mtpApp->outputBox   = NULL;
-    mtpApp->outputBox   = NULL;
+    mtpApp->inputBox    = NULL;
+    mtpApp->sent        = NULL;
     mtpApp->join        = NULL;
     mtpApp->configuring = NULL;
     mtpRootPath[0]      = '\0';
@@ -21,7 +21,9 @@ typedef struct {
     bool is_storage_locked;
     size_t usb_buffer_size;
     MessageBufferHandle_t inputBox;
-    MessageBufferHandle_t outputBox;
+    SemaphoreHandle_t sent;
+    volatile uint32_t tx_generation; /* last transfer handed to the controller */
+    volatile uint32_t tx_completed;  /* last transfer the controller completed or cancelled */
     SemaphoreHandle_t join;
     SemaphoreHandle_t configuring;
     TaskHandle_t mtp_task_handle; /* USB MTP task handle */
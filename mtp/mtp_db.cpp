@@ -18,7 +18,7 @@ namespace mtp
     {
         inline auto &getIter(HandleToInteratorMap::iterator iter)
         {
-            return iter->second;
+            return iter->second.filename;
         }
         inline const Handle &getHandle(HandleToInteratorMap::const_iterator iter)
         {
@@ -26,7 +26,7 @@ namespace mtp
         }
         inline const std::filesystem::path &getFilename(HandleToInteratorMap::const_iterator iter)
         {
-            return iter->second->first;
+            return iter->second.filename->first;
         }
 
     } // namespace handle_to_filename
@@ -53,7 +53,7 @@ namespace mtp
     {
         const auto entry = filenameToHandle.emplace(filename, handle_idx);
         if (entry.second) {
-            handleToFilename.emplace(handle_idx, entry.first);
+            handleToFilename.emplace(handle_idx, HandleEntry{entry.first});
             ++handle_idx;
         }
         return filename_to_handle::getHandle(entry.first);
@@ -68,7 +68,7 @@ namespace mtp
         if (!entry.second) {
             return 0;
         }
-        handleToFilename.emplace(handle_idx, entry.first);
+        handleToFilename.emplace(handle_idx, HandleEntry{entry.first});
         ++handle_idx;
         return filename_to_handle::getHandle(entry.first);
     }
@@ -84,6 +84,22 @@ namespace mtp
             filename_to_handle::getHandle(entry.first) = handle_to_filename::getHandle(handleToFilenameIter);
         }
         handle_to_filename::getIter(handleToFilenameIter) = entry.first;
+        handleToFilenameIter->second.format_code          = 0;
         return true;
     }
+    std::uint16_t FileDatabase::get_format_code(const Handle handle) const
+    {
+        const auto handleToFilenameIter = handleToFilename.find(handle);
+        if (handleToFilenameIter != handleToFilename.end()) {
+            return handleToFilenameIter->second.format_code;
+        }
+        return 0;
+    }
+    void FileDatabase::set_format_code(const Handle handle, const std::uint16_t format_code)
+    {
+        const auto handleToFilenameIter = handleToFilename.find(handle);
+        if (handleToFilenameIter != handleToFilename.end()) {
+            handleToFilenameIter->second.format_code = format_code;
+        }
+    }
 } // namespace mtp
@@ -3,15 +3,22 @@
 
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <filesystem>
 #include <optional>
 
 namespace mtp
 {
-    using Handle               = std::uint32_t;
-    using PathToHandleMap      = std::map<std::filesystem::path, Handle>;
-    using HandleToInteratorMap = std::map<Handle, std::map<std::filesystem::path, Handle>::iterator>;
+    using Handle          = std::uint32_t;
+    using PathToHandleMap = std::map<std::filesystem::path, Handle>;
+
+    struct HandleEntry
+    {
+        PathToHandleMap::iterator filename;
+        std::uint16_t format_code = 0;
+    };
+    using HandleToInteratorMap = std::map<Handle, HandleEntry>;
 
     /// FileDatabase is a container used to store MTP object handles and corresponding data
     class FileDatabase
@@ -33,6 +40,12 @@ namespace mtp
         /// Try to update specific entry by unique handle. Returns false in case of failure
         bool update(Handle handle, const char *filename);
 
+        /// Fetch cached object format code of the entry. Returns 0 if it is not cached or the entry doesn't exist.
+        std::uint16_t get_format_code(Handle handle) const;
+
+        /// Cache object format code of the entry. It is dropped when the entry is renamed.
+        void set_format_code(Handle handle, std::uint16_t format_code);
+
       private:
         Handle handle_idx = 1;
         PathToHandleMap filenameToHandle;
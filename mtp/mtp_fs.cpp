@@ -12,7 +12,7 @@
 #include "log.hpp"
 #include "mtp_db.hpp"
 #include "mtp_fs.h"
-#include <Utils.hpp>
+#include <array>
 #include <filesystem>
 
 extern "C"
@@ -156,27 +156,183 @@ namespace
         return 0;
     }
 
-    uint16_t ext_to_format_code(const char *name)
+    struct ExtensionFormat
     {
-        const auto extension          = std::filesystem::path(name).extension();
-        const auto extensionLowercase = utils::stringToLowercase(extension);
+        const char *extension;
+        std::uint16_t format_code;
+    };
 
-        if (extensionLowercase == ".jpg" || extensionLowercase == ".jpeg") {
-            return MTP_FORMAT_EXIF_JPEG;
+    // Lowercase, at most 8 characters. Formats without a common file extension (abstract objects, firmware,
+    // ambiguous TIFF flavours) are left out and reported as MTP_FORMAT_UNDEFINED.
+    constexpr ExtensionFormat extension_formats[] = {
+        {"txt", MTP_FORMAT_TEXT},
+        {"log", MTP_FORMAT_TEXT},
+        {"htm", MTP_FORMAT_HTML},
+        {"html", MTP_FORMAT_HTML},
+        {"mrk", MTP_FORMAT_DPOF},
+        {"exe", MTP_FORMAT_EXECUTABLE},
+        {"sh", MTP_FORMAT_SCRIPT},
+        {"aif", MTP_FORMAT_AIFF},
+        {"aiff", MTP_FORMAT_AIFF},
+        {"wav", MTP_FORMAT_WAV},
+        {"mp3", MTP_FORMAT_MP3},
+        {"avi", MTP_FORMAT_AVI},
+        {"mpg", MTP_FORMAT_MPEG},
+        {"mpeg", MTP_FORMAT_MPEG},
+        {"asf", MTP_FORMAT_ASF},
+        {"jpg", MTP_FORMAT_EXIF_JPEG},
+        {"jpeg", MTP_FORMAT_EXIF_JPEG},
+        {"jpe", MTP_FORMAT_EXIF_JPEG},
+        {"jfif", MTP_FORMAT_JFIF},
+        {"tif", MTP_FORMAT_TIFF},
+        {"tiff", MTP_FORMAT_TIFF},
+        {"fpx", MTP_FORMAT_FLASHPIX},
+        {"bmp", MTP_FORMAT_BMP},
+        {"crw", MTP_FORMAT_CIFF},
+        {"gif", MTP_FORMAT_GIF},
+        {"pcd", MTP_FORMAT_CD},
+        {"pct", MTP_FORMAT_PICT},
+        {"pict", MTP_FORMAT_PICT},
+        {"png", MTP_FORMAT_PNG},
+        {"jp2", MTP_FORMAT_JP2},
+        {"jpx", MTP_FORMAT_JPX},
+        {"dng", MTP_FORMAT_DNG},
+        {"heif", MTP_FORMAT_HEIF},
+        {"heic", MTP_FORMAT_HEIF},
+        {"wim", MTP_FORMAT_WINDOWS_IMAGE_FORMAT},
+        {"wma", MTP_FORMAT_WMA},
+        {"ogg", MTP_FORMAT_OGG},
+        {"oga", MTP_FORMAT_OGG},
+        {"opus", MTP_FORMAT_OGG},
+        {"aac", MTP_FORMAT_AAC},
+        {"aa", MTP_FORMAT_AUDIBLE},
+        {"aax", MTP_FORMAT_AUDIBLE},
+        {"flac", MTP_FORMAT_FLAC},
+        {"wmv", MTP_FORMAT_WMV},
+        {"mp4", MTP_FORMAT_MP4_CONTAINER},
+        {"m4a", MTP_FORMAT_MP4_CONTAINER},
+        {"m4v", MTP_FORMAT_MP4_CONTAINER},
+        {"mp2", MTP_FORMAT_MP2},
+        {"3gp", MTP_FORMAT_3GP_CONTAINER},
+        {"3gpp", MTP_FORMAT_3GP_CONTAINER},
+        {"3g2", MTP_FORMAT_3GP_CONTAINER},
+        {"wpl", MTP_FORMAT_WPL_PLAYLIST},
+        {"m3u", MTP_FORMAT_M3U_PLAYLIST},
+        {"m3u8", MTP_FORMAT_M3U_PLAYLIST},
+        {"mpl", MTP_FORMAT_MPL_PLAYLIST},
+        {"asx", MTP_FORMAT_ASX_PLAYLIST},
+        {"pls", MTP_FORMAT_PLS_PLAYLIST},
+        {"xml", MTP_FORMAT_XML_DOCUMENT},
+        {"doc", MTP_FORMAT_MS_WORD_DOCUMENT},
+        {"docx", MTP_FORMAT_MS_WORD_DOCUMENT},
+        {"mht", MTP_FORMAT_MHT_COMPILED_HTML_DOCUMENT},
+        {"mhtml", MTP_FORMAT_MHT_COMPILED_HTML_DOCUMENT},
+        {"xls", MTP_FORMAT_MS_EXCEL_SPREADSHEET},
+        {"xlsx", MTP_FORMAT_MS_EXCEL_SPREADSHEET},
+        {"ppt", MTP_FORMAT_MS_POWERPOINT_PRESENTATION},
+        {"pptx", MTP_FORMAT_MS_POWERPOINT_PRESENTATION},
+        {"vcf", MTP_FORMAT_VCARD_2},
+    };
+
+    // Extension packed little endian into an integer is the hash key, so lookup needs no string compare
+    constexpr std::uint64_t pack_extension(const char *extension)
+    {
+        std::uint64_t key = 0;
+        for (std::size_t i = 0; extension[i] != '\0'; i++) {
+            key |= static_cast<std::uint64_t>(static_cast<unsigned char>(extension[i])) << (8U * i);
         }
-        if (extensionLowercase == ".txt") {
-            return MTP_FORMAT_TEXT;
+        return key;
+    }
+
+    constexpr auto extension_hash_bits = 8U;
+
+    constexpr std::size_t extension_hash(std::uint64_t key, std::uint64_t seed)
+    {
+        return static_cast<std::size_t>((key * seed) >> (64U - extension_hash_bits));
+    }
+
+    constexpr auto extension_table_size = std::size_t{1} << extension_hash_bits;
+
+    // Keys and codes are kept apart so the slots are not padded
+    struct ExtensionTable
+    {
+        std::array<std::uint64_t, extension_table_size> keys;
+        std::array<std::uint16_t, extension_table_size> format_codes;
+    };
+
+    // Multiplier for which no two extensions share a slot, 0 if none was found
+    constexpr std::uint64_t find_extension_seed()
+    {
+        std::uint64_t seed = 0x9E3779B97F4A7C15ULL;
+        for (auto attempt = 0U; attempt < 10000U; attempt++, seed += 0xBF58476D1CE4E5B9ULL) {
+            bool used[extension_table_size]{};
+            bool perfect = true;
+            for (const auto &entry : extension_formats) {
+                const auto slot = extension_hash(pack_extension(entry.extension), seed | 1U);
+                if (used[slot]) {
+                    perfect = false;
+                    break;
+                }
+                used[slot] = true;
+            }
+            if (perfect) {
+                return seed | 1U;
+            }
         }
-        if (extensionLowercase == ".wav") {
-            return MTP_FORMAT_WAV;
+        return 0;
+    }
+
+    constexpr auto extension_seed = find_extension_seed();
+    static_assert(extension_seed != 0, "extension_formats has duplicates or needs more hash bits");
+
+    constexpr ExtensionTable build_extension_table()
+    {
+        ExtensionTable table{};
+        for (const auto &entry : extension_formats) {
+            const auto key           = pack_extension(entry.extension);
+            const auto slot          = extension_hash(key, extension_seed);
+            table.keys[slot]         = key;
+            table.format_codes[slot] = entry.format_code;
+        }
+        return table;
+    }
+
+    constexpr auto extension_table = build_extension_table();
+
+    uint16_t ext_to_format_code(const char *name)
+    {
+        const auto dot = strrchr(name, '.');
+        if (dot == nullptr || dot == name) {
+            return MTP_FORMAT_UNDEFINED;
         }
-        if (extensionLowercase == ".mp3") {
-            return MTP_FORMAT_MP3;
+
+        std::uint64_t key  = 0;
+        std::size_t length = 0;
+        for (auto c = dot + 1; *c != '\0'; c++, length++) {
+            if (length == sizeof(key)) {
+                return MTP_FORMAT_UNDEFINED;
+            }
+            auto ch = static_cast<unsigned char>(*c);
+            if (ch >= 'A' && ch <= 'Z') {
+                ch += 'a' - 'A';
+            }
+            key |= static_cast<std::uint64_t>(ch) << (8U * length);
         }
-        if (extensionLowercase == ".flac") {
-            return MTP_FORMAT_FLAC;
+
+        const auto slot = extension_hash(key, extension_seed);
+        return (key != 0 && extension_table.keys[slot] == key) ? extension_table.format_codes[slot]
+                                                                 : MTP_FORMAT_UNDEFINED;
+    }
+
+    uint16_t get_format_code(struct mtp_fs *fs, uint32_t handle, const char *name)
+    {
+        auto &db = from_raw(fs->db);
+        if (const auto cached = db.get_format_code(handle); cached != 0) {
+            return cached;
         }
-        return MTP_FORMAT_UNDEFINED;
+        const auto format_code = ext_to_format_code(name);
+        db.set_format_code(handle, format_code);
+        return format_code;
     }
 
     int fs_stat(void *arg, uint32_t handle, mtp_object_info_t *info)
@@ -198,7 +354,7 @@ namespace
             info->storage_id                          = 0x00010001;
             info->created                             = statbuf.st_ctim.tv_sec;
             info->modified                            = statbuf.st_mtim.tv_sec;
-            info->format_code                         = ext_to_format_code(filename->c_str());
+            info->format_code                         = get_format_code(fs, handle, filename->c_str());
             info->size                                = statbuf.st_size;
             *reinterpret_cast<uint32_t *>(info->uuid) = handle;
 
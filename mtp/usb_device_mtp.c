@@ -486,6 +486,72 @@ usb_status_t USB_DeviceClassMtpSend(class_handle_t handle, uint8_t ep, uint8_t *
     return error;
 }
 
+/* Sends the segments in one transfer on the bulk in pipe, see USB_DeviceSendRequestV() */
+usb_status_t USB_DeviceClassMtpSendV(class_handle_t handle,
+                                     uint8_t ep,
+                                     const usb_device_transfer_segment_struct_t *segments,
+                                     uint32_t segmentCount)
+{
+    usb_status_t error = kStatus_USB_Error;
+    usb_device_mtp_struct_t *mtpHandle;
+    usb_device_mtp_pipe_t *mtpPipe;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    mtpHandle = (usb_device_mtp_struct_t *)handle;
+
+    if ((mtpHandle->bulkIn.ep != ep) || (NULL == segments) || (0U == segmentCount))
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+    mtpPipe = &(mtpHandle->bulkIn);
+
+    if (1U == mtpPipe->isBusy)
+    {
+        return kStatus_USB_Busy;
+    }
+    mtpPipe->isBusy = 1U;
+
+    if (mtpPipe->pipeStall)
+    {
+        mtpPipe->pipeDataBuffer = segments[0].buffer;
+        mtpPipe->pipeDataLen    = 0U;
+        for (uint32_t index = 0U; index < segmentCount; index++)
+        {
+            mtpPipe->pipeDataLen += segments[index].length;
+        }
+        return kStatus_USB_Success;
+    }
+
+    error = USB_DeviceSendRequestV(mtpHandle->handle, ep, segments, segmentCount);
+    if (kStatus_USB_Success != error)
+    {
+        mtpPipe->isBusy = 0U;
+    }
+    return error;
+}
+
+usb_status_t USB_DeviceClassMtpCancel(class_handle_t handle, uint8_t ep)
+{
+    usb_device_mtp_struct_t *mtpHandle;
+
+    if (!handle)
+    {
+        return kStatus_USB_InvalidHandle;
+    }
+    mtpHandle = (usb_device_mtp_struct_t *)handle;
+
+    if ((mtpHandle->bulkIn.ep != ep) && (mtpHandle->interruptIn.ep != ep))
+    {
+        return kStatus_USB_InvalidParameter;
+    }
+
+    /* The controller reports the cancelled transfer through the endpoint callback */
+    return USB_DeviceCancel(mtpHandle->handle, ep | (USB_IN << USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_SHIFT));
+}
+
 usb_status_t USB_DeviceClassMtpRecv(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length)
 {
     usb_status_t error = kStatus_USB_Error;
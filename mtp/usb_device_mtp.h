@@ -54,6 +54,11 @@ extern usb_status_t USB_DeviceClassMtpInit(uint8_t controllerId,
 extern usb_status_t USB_DeviceClassMtpDeinit(class_handle_t handle);
 extern usb_status_t USB_DeviceClassMtpEvent(void *handle, uint32_t event, void *param);
 extern usb_status_t USB_DeviceClassMtpSend(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length);
+extern usb_status_t USB_DeviceClassMtpSendV(class_handle_t handle,
+                                            uint8_t ep,
+                                            const usb_device_transfer_segment_struct_t *segments,
+                                            uint32_t segmentCount);
+extern usb_status_t USB_DeviceClassMtpCancel(class_handle_t handle, uint8_t ep);
 extern usb_status_t USB_DeviceClassMtpRecv(class_handle_t handle, uint8_t ep, uint8_t *buffer, uint32_t length);
 extern int USB_DeviceClassMtpIsBusy(class_handle_t handle, uint8_t ep);
 
@@ -11,6 +11,11 @@
         entry(SERIAL_NUMBER, "00000000000000"), \
         entry(DEF_CONFIGURATION, "Mudita Pure Default"), \
         entry(MTP_INTERFACE, "MTP"), \
+        entry(MSC_INTERFACE, "Mass Storage"), \
+        entry(DFU_INTERFACE, "Firmware Update"), \
         entry(CDC_ACM_CLASS, "CDC ACM Device Class - Serial Port"), \
         entry(CDC_ACM_CIC, "CDC ACM Control interface"), \
-        entry(CDC_ACM_DIC, "CDC ACM Data interface")
+        entry(CDC_ACM_DIC, "CDC ACM Data interface"), \
+        entry(CDC_ACM_DATA_CLASS, "CDC ACM Device Class - Data Port"), \
+        entry(CDC_NCM_CLASS, "CDC NCM Device Class - Network"), \
+        entry(CDC_NCM_MAC_ADDRESS, "020000000001")
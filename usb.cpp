@@ -4,6 +4,7 @@
 #include "log.hpp"
 
 #include <module-bsp/bsp/usb/usb.hpp>
+#include "usb_cdc.hpp"
 
 extern "C"
 {
@@ -13,16 +14,23 @@ extern "C"
 #include "usb_phy.h"
 }
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
+#include <iterator>
+#include <string>
 
 namespace bsp
 {
     namespace
     {
         usb_device_composite_struct_t *usbDeviceComposite = nullptr;
-        xQueueHandle USBReceiveQueue;
+        xQueueHandle USBReceiveQueue[USB_DEVICE_CONFIG_CDC_ACM];
         xQueueHandle USBIrqQueue;
 
+        /// Ports with unread data. The IRQ queue is overwritten, so the notification itself can't tell them apart.
+        std::atomic<std::uint32_t> usbPendingPorts{0};
+
         char usbSerialBuffer[constants::serial::bufferLength];
 
 #if USBCDC_ECHO_ENABLED
@@ -35,6 +43,34 @@ namespace bsp
         constexpr auto usbCDCEchoOffCmdLength = usbCDCEchoOffCmd.length();
 #endif
 
+        /// Buffer sizing of every virtual com port. Port 0 carries latency sensitive control messages, the optional
+        /// port 1 bulk data and logs, so it gets deeper streams to absorb dumps without stalling the sender.
+        constexpr usb_cdc_vcom_config_t usbVcomConfig[USB_DEVICE_CONFIG_CDC_ACM] = {
+            {0, 0, 0},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+            {4096, 8192, 0},
+#endif
+        };
+
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+        /// Disk image exposed by mass storage function, kept next to the files otherwise shared over MTP.
+        constexpr auto usbMscImageName = "usb_disk.img";
+#endif
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+        /// Firmware image downloaded over DFU, picked up by the updater after validation.
+        constexpr auto usbDfuImageName = "dfu_update.bin";
+        constexpr std::uint32_t usbDfuImageSize = 32U * 1024U * 1024U;
+#endif
+
+        usb_cdc_vcom_struct_t *usbGetVcom(std::uint8_t port)
+        {
+            if ((usbDeviceComposite == nullptr) || (port >= USB_DEVICE_CONFIG_CDC_ACM)) {
+                return nullptr;
+            }
+            return &usbDeviceComposite->cdcVcom[port];
+        }
+
         TimerHandle_t usbTickTimer;
         constexpr auto usbTickTimerName = "usbHWTick";
         constexpr auto usbTickTimerInterval = pdMS_TO_TICKS(10);
@@ -51,7 +87,7 @@ namespace bsp
 #endif
         }
 
-        void usbDeviceStateCB(void *const /*unused*/, const usb_events_t event)
+        void usbDeviceStateCB(void *const userArg, const usb_events_t event)
         {
             USBDeviceStatus notification;
             switch (event) {
@@ -68,6 +104,8 @@ namespace bsp
                 notification = USBDeviceStatus::Reset;
                 break;
             case USB_EVENT_DATA_RECEIVED:
+                // Virtual com ports raise their events with the port structure as userArg
+                usbPendingPorts.fetch_or(1U << static_cast<const usb_cdc_vcom_struct_t *>(userArg)->instance);
                 notification = USBDeviceStatus::DataReceived;
                 break;
             default:
@@ -97,15 +135,36 @@ namespace bsp
             return -ENOMEM;
         }
 
-        USBReceiveQueue = initParams.queueHandle;
-        USBIrqQueue     = initParams.irqQueueHandle;
+        std::fill(std::begin(USBReceiveQueue), std::end(USBReceiveQueue), nullptr);
+        USBReceiveQueue[0] = initParams.queueHandle;
+        USBIrqQueue        = initParams.irqQueueHandle;
+        usbPendingPorts    = 0;
+
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+        const std::string mscImagePath = initParams.rootPath + "/" + usbMscImageName;
+        const usb_msc_config_t mscConfig{mscImagePath.c_str(), false, MSC_CACHE_WRITE_BACK | MSC_CACHE_READ_AHEAD};
+        const usb_msc_config_t *usbMscConfig = &mscConfig;
+#else
+        const struct _usb_msc_config *usbMscConfig = nullptr;
+#endif
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+        const std::string dfuImagePath = initParams.rootPath + "/" + usbDfuImageName;
+        const usb_dfu_config_t dfuConfig{dfuImagePath.c_str(), usbDfuImageSize, nullptr, nullptr};
+        const usb_dfu_config_t *usbDfuConfig = &dfuConfig;
+#else
+        const struct _usb_dfu_config *usbDfuConfig = nullptr;
+#endif
 
         usbDeviceComposite = composite_init(
                 usbDeviceStateCB,
                 initParams.serialNumber.c_str(),
                 initParams.deviceVersion,
                 initParams.rootPath.c_str(),
-                initParams.mtpLockedAtInit
+                initParams.mtpLockedAtInit,
+                usbVcomConfig,
+                usbMscConfig,
+                usbDfuConfig
         );
         if (usbDeviceComposite == nullptr) {
             xTimerDelete(usbTickTimer, usbTickTimerCommandTimeout);
@@ -133,69 +192,102 @@ namespace bsp
 #endif
     }
 
-    ssize_t usbCDCReceive(void *buffer)
+    ssize_t usbCDCReceive(std::uint8_t port, void *buffer)
     {
-        if (usbDeviceComposite->cdcVcom.inputStream == nullptr) {
+        auto vcom = usbGetVcom(port);
+        if (vcom == nullptr) {
+            return -EINVAL;
+        }
+
+        if (vcom->inputStream == nullptr) {
             return 0;
         }
 
         std::memset(buffer, 0, constants::serial::bufferLength);
 
-        return VirtualComRecv(&usbDeviceComposite->cdcVcom, buffer, constants::serial::bufferLength);
+        return VirtualComRecv(vcom, buffer, constants::serial::bufferLength);
     }
 
-    void usbHandleDataReceived()
+    ssize_t usbCDCReceive(void *buffer)
     {
-        const auto dataReceivedLength = usbCDCReceive(&usbSerialBuffer);
-        if (dataReceivedLength == 0) {
-            log_error("No data received!");
-            return;
-        }
+        return usbCDCReceive(0, buffer);
+    }
 
-        if (dataReceivedLength < 0) {
-            log_error("Error in usbCDCReceive, retcode %zd", dataReceivedLength);
-            return;
+    int usbCDCSetReceiveQueue(std::uint8_t port, xQueueHandle queue)
+    {
+        if (port >= USB_DEVICE_CONFIG_CDC_ACM) {
+            return -EINVAL;
         }
+        USBReceiveQueue[port] = queue;
+        return 0;
+    }
+
+    void usbHandleDataReceived()
+    {
+        auto pendingPorts = usbPendingPorts.exchange(0);
+
+        for (std::uint8_t port = 0; pendingPorts != 0; port++, pendingPorts >>= 1U) {
+            if (((pendingPorts & 1U) == 0) || (USBReceiveQueue[port] == nullptr)) {
+                continue;
+            }
+
+            const auto dataReceivedLength = usbCDCReceive(port, &usbSerialBuffer);
+            if (dataReceivedLength == 0) {
+                log_error("No data received on port %u!", static_cast<unsigned>(port));
+                continue;
+            }
+
+            if (dataReceivedLength < 0) {
+                log_error("Error in usbCDCReceive, retcode %zd", dataReceivedLength);
+                continue;
+            }
 
 #if USBCDC_ECHO_ENABLED
-        bool usbCdcEchoEnabledPrev = usbCdcEchoEnabled;
+            bool usbCdcEchoEnabledPrev = usbCdcEchoEnabled;
 
-        auto usbEchoCmd = std::string_view{usbSerialBuffer, static_cast<std::size_t>(dataReceivedLength)};
+            auto usbEchoCmd = std::string_view{usbSerialBuffer, static_cast<std::size_t>(dataReceivedLength)};
 
-        if ((dataReceivedLength == usbCDCEchoOnCmdLength) && (usbCDCEchoOnCmd == usbEchoCmd)) {
-            usbCdcEchoEnabled = true;
-        }
-        else if ((dataReceivedLength == usbCDCEchoOffCmdLength) && (usbCDCEchoOffCmd == usbEchoCmd)) {
-            usbCdcEchoEnabled = false;
-        }
+            if ((dataReceivedLength == usbCDCEchoOnCmdLength) && (usbCDCEchoOnCmd == usbEchoCmd)) {
+                usbCdcEchoEnabled = true;
+            }
+            else if ((dataReceivedLength == usbCDCEchoOffCmdLength) && (usbCDCEchoOffCmd == usbEchoCmd)) {
+                usbCdcEchoEnabled = false;
+            }
 
-        if (usbCdcEchoEnabled || usbCdcEchoEnabledPrev) {
-            usbCDCSendRaw(usbSerialBuffer, dataReceivedLength);
-            log_debug(
-                "usbDeviceTask echoed: %d signs: [%s]", static_cast<int>(dataReceivedLength), usbSerialBuffer);
-            continue;
-        }
+            if (usbCdcEchoEnabled || usbCdcEchoEnabledPrev) {
+                usbCDCSendRaw(port, usbSerialBuffer, dataReceivedLength);
+                log_debug(
+                    "usbDeviceTask echoed: %d signs: [%s]", static_cast<int>(dataReceivedLength), usbSerialBuffer);
+                continue;
+            }
 #endif
 
-        if (uxQueueSpacesAvailable(USBReceiveQueue) == 0) {
-            log_error("USB receive queue is full!");
-        }
+            if (uxQueueSpacesAvailable(USBReceiveQueue[port]) == 0) {
+                log_error("USB receive queue is full!");
+            }
 
-        auto receiveMessage = new std::string(usbSerialBuffer, dataReceivedLength);
-        if (xQueueSend(USBReceiveQueue, &receiveMessage, portMAX_DELAY) == errQUEUE_FULL) {
-            log_error("usbDeviceTask can't send data to receiveQueue");
+            auto receiveMessage = new std::string(usbSerialBuffer, dataReceivedLength);
+            if (xQueueSend(USBReceiveQueue[port], &receiveMessage, portMAX_DELAY) == errQUEUE_FULL) {
+                log_error("usbDeviceTask can't send data to receiveQueue");
+            }
         }
     }
 
-    std::size_t usbCDCSendRaw(const char *dataPtr, std::size_t dataLen)
+    std::size_t usbCDCSendRaw(std::uint8_t port, const char *dataPtr, std::size_t dataLen)
     {
         constexpr std::uint32_t maxRetryDelayMs = 10;
         constexpr std::uint32_t maxRetriesCount = 250;
         std::uint32_t retriesCounter = 0;
         std::size_t dataSent = 0;
 
+        auto vcom = usbGetVcom(port);
+        if (vcom == nullptr) {
+            log_error("Invalid VCOM port %u", static_cast<unsigned>(port));
+            return 0;
+        }
+
         do {
-            const auto bytesSent = VirtualComSend(&usbDeviceComposite->cdcVcom, &dataPtr[dataSent], dataLen - dataSent);
+            const auto bytesSent = VirtualComSend(vcom, &dataPtr[dataSent], dataLen - dataSent);
             if (bytesSent < 0) {
                 log_error("VCOM already deinitialized!");
                 break;
@@ -213,8 +305,18 @@ namespace bsp
         return dataSent;
     }
 
+    std::size_t usbCDCSendRaw(const char *dataPtr, std::size_t dataLen)
+    {
+        return usbCDCSendRaw(0, dataPtr, dataLen);
+    }
+
+    std::size_t usbCDCSend(std::uint8_t port, std::string *message)
+    {
+        return usbCDCSendRaw(port, message->c_str(), message->length());
+    }
+
     std::size_t usbCDCSend(std::string *message)
     {
-        return usbCDCSendRaw(message->c_str(), message->length());
+        return usbCDCSend(0, message);
     }
 } // namespace bsp
@@ -0,0 +1,31 @@
+// Copyright (c) 2017-2023, Mudita Sp. z.o.o. All rights reserved.
+// For licensing, see https://github.com/mudita/MuditaOS/LICENSE.md
+
+#pragma once
+
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+/// Port indexed access to the virtual com ports, port 0 to USB_DEVICE_CONFIG_CDC_ACM - 1. The overloads without port
+/// in bsp/usb/usb.hpp address port 0.
+namespace bsp
+{
+    /// Reads whatever the port has received, up to constants::serial::bufferLength bytes.
+    /// @return number of bytes read or -EINVAL for a port not built in
+    ssize_t usbCDCReceive(std::uint8_t port, void *buffer);
+
+    /// Sends the data, retrying while the output stream is full.
+    /// @return number of bytes queued for host
+    std::size_t usbCDCSendRaw(std::uint8_t port, const char *dataPtr, std::size_t dataLen);
+    std::size_t usbCDCSend(std::uint8_t port, std::string *message);
+
+    /// Queue usbHandleDataReceived() posts the messages of the port to, as std::string pointers. Port 0 uses the
+    /// queue given at init. Data of a port without queue stays in its input stream for usbCDCReceive().
+    /// @return 0 or -EINVAL for a port not built in
+    int usbCDCSetReceiveQueue(std::uint8_t port, xQueueHandle queue);
+} // namespace bsp
@@ -48,11 +48,15 @@
 /*! @brief HID instance count */
 #define USB_DEVICE_CONFIG_HID (0U)
 
-/*! @brief CDC ACM instance count */
+/*! @brief CDC ACM instance count, each instance takes one interrupt IN and two bulk endpoints */
+#ifndef USB_DEVICE_CONFIG_CDC_ACM
 #define USB_DEVICE_CONFIG_CDC_ACM (1U)
+#endif
 
-/*! @brief MSC instance count */
+/*! @brief MSC instance count, alternative to MTP as both use the same bulk endpoints */
+#ifndef USB_DEVICE_CONFIG_MSC
 #define USB_DEVICE_CONFIG_MSC (0U)
+#endif
 
 /*! @brief Audio instance count */
 #define USB_DEVICE_CONFIG_AUDIO (0U)
@@ -69,12 +73,19 @@
 /*! @brief Printer instance count */
 #define USB_DEVICE_CONFIG_PRINTER (0U)
 
-/*! @brief DFU instance count */
+/*! @brief DFU instance count, firmware upgrade interface uses control endpoint only */
+#ifndef USB_DEVICE_CONFIG_DFU
 #define USB_DEVICE_CONFIG_DFU (0U)
+#endif
 
 #ifndef USB_DEVICE_CONFIG_MTP
 #   define USB_DEVICE_CONFIG_MTP (1U)
 #endif
+
+/*! @brief CDC NCM instance count, takes one interrupt IN and two bulk endpoints */
+#ifndef USB_DEVICE_CONFIG_CDC_NCM
+#define USB_DEVICE_CONFIG_CDC_NCM (0U)
+#endif
 /* @} */
 
 /*! @brief Whether device is self power. 1U supported, 0U not supported */
@@ -83,13 +94,41 @@
 /*! @brief How many endpoints are supported in the stack. */
 #define USB_DEVICE_CONFIG_ENDPOINTS (8U)
 
+/*! @brief How many interfaces are supported in the stack, it bounds the interface numbers and the number of classes
+ * the class driver routes the events to. */
+#ifndef USB_DEVICE_CONFIG_INTERFACES
+#define USB_DEVICE_CONFIG_INTERFACES (8U)
+#endif
+
 /*! @brief Whether the device task is enabled. */
 #ifndef USB_DEVICE_CONFIG_USE_TASK
 #define USB_DEVICE_CONFIG_USE_TASK (0U)
 #endif
 
-/*! @brief How many the notification message are supported when the device task is enabled. */
-#define USB_DEVICE_CONFIG_MAX_MESSAGES (8U)
+/*! @brief How many bus and control endpoint notifications can wait for the device task or the deferred callback
+ * task, power of two. */
+#ifndef USB_DEVICE_CONFIG_CONTROL_MESSAGES
+#define USB_DEVICE_CONFIG_CONTROL_MESSAGES (16U)
+#endif
+
+/*! @brief How many completions of the other endpoints can wait for the device task or the deferred callback task,
+ * power of two. Every transfer owned by the controller holds a DTD, so it is sized to USB_DEVICE_CONFIG_EHCI_MAX_DTD
+ * to keep all of them. */
+#ifndef USB_DEVICE_CONFIG_MAX_MESSAGES
+#define USB_DEVICE_CONFIG_MAX_MESSAGES (32U)
+#endif
+
+/*! @brief Whether the endpoint callbacks are deferred to USB_DeviceDeferredTaskFunction when the device task is
+ * disabled. The ISR only retires the transfers and queues their completions, the endpoints selected by
+ * USB_DeviceSetEndpointCallbackInIsr still call back from the ISR. */
+#ifndef USB_DEVICE_CONFIG_DEFERRED_CALLBACK
+#define USB_DEVICE_CONFIG_DEFERRED_CALLBACK (1U)
+#endif
+
+/*! @brief Whether several transfers can be queued on one endpoint by USB_DeviceQueueRequest. */
+#ifndef USB_DEVICE_CONFIG_REQUEST_QUEUE
+#define USB_DEVICE_CONFIG_REQUEST_QUEUE (1U)
+#endif
 
 /*! @brief Whether test mode enabled. */
 #define USB_DEVICE_CONFIG_USB20_TEST_MODE (0U)
@@ -123,17 +162,96 @@
 #endif
 
 #if ((defined(USB_DEVICE_CONFIG_EHCI)) && (USB_DEVICE_CONFIG_EHCI > 0U))
-/*! @brief How many the DTD are supported. */
-#define USB_DEVICE_CONFIG_EHCI_MAX_DTD (16U)
+/*! @brief How many the DTD are supported, reserved ones included. */
+#ifndef USB_DEVICE_CONFIG_EHCI_MAX_DTD
+#define USB_DEVICE_CONFIG_EHCI_MAX_DTD (32U)
+#endif
+
+/* DTDs reserved for the endpoints of optional functions, none when the function is not built in */
+#if (USB_DEVICE_CONFIG_MTP > 0U) || (USB_DEVICE_CONFIG_MSC > 0U)
+#define USB_DEVICE_EHCI_DTD_STORAGE_BULK (2U)
+#else
+#define USB_DEVICE_EHCI_DTD_STORAGE_BULK (0U)
+#endif
+#if (USB_DEVICE_CONFIG_MTP > 0U)
+#define USB_DEVICE_EHCI_DTD_MTP_EVENT (1U)
+#else
+#define USB_DEVICE_EHCI_DTD_MTP_EVENT (0U)
+#endif
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+#define USB_DEVICE_EHCI_DTD_VCOM1_NOTIFICATION (1U)
+#define USB_DEVICE_EHCI_DTD_VCOM1_BULK (2U)
+#else
+#define USB_DEVICE_EHCI_DTD_VCOM1_NOTIFICATION (0U)
+#define USB_DEVICE_EHCI_DTD_VCOM1_BULK (0U)
+#endif
+#if (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+#define USB_DEVICE_EHCI_DTD_NCM_NOTIFICATION (1U)
+#define USB_DEVICE_EHCI_DTD_NCM_BULK (2U)
+#else
+#define USB_DEVICE_EHCI_DTD_NCM_NOTIFICATION (0U)
+#define USB_DEVICE_EHCI_DTD_NCM_BULK (0U)
+#endif
+
+/*! @brief DTDs reserved for each endpoint, indexed by endpoint number * 2 + direction (0 OUT, 1 IN).
+ * Reserved DTDs are never taken by other endpoints, DTDs left over form a pool shared by all of them,
+ * so long transfers on one function can not starve control or other functions. Bulk endpoints get two,
+ * so the next transfer can be primed while one completes. The second virtual com port and NCM share
+ * EP6 IN and EP7 and are never built in together. */
+#ifndef USB_DEVICE_CONFIG_EHCI_DTD_RESERVATION
+#define USB_DEVICE_CONFIG_EHCI_DTD_RESERVATION                                                                         \
+    {                                                                                                                  \
+        /* EP0 OUT: control, IN: control */                                                                            \
+        2U, 2U,                                                                                                        \
+        /* EP1 OUT: unused, IN: MTP/MSC bulk */                                                                        \
+        0U, USB_DEVICE_EHCI_DTD_STORAGE_BULK,                                                                          \
+        /* EP2 OUT: MTP/MSC bulk, IN: NCM notification */                                                              \
+        USB_DEVICE_EHCI_DTD_STORAGE_BULK, USB_DEVICE_EHCI_DTD_NCM_NOTIFICATION,                                        \
+        /* EP3 OUT: unused, IN: MTP event */                                                                           \
+        0U, USB_DEVICE_EHCI_DTD_MTP_EVENT,                                                                             \
+        /* EP4 OUT: unused, IN: first virtual com notification */                                                      \
+        0U, 1U,                                                                                                        \
+        /* EP5 OUT: second virtual com bulk, IN: first virtual com bulk */                                             \
+        USB_DEVICE_EHCI_DTD_VCOM1_BULK, 2U,                                                                            \
+        /* EP6 OUT: first virtual com bulk, IN: second virtual com or NCM bulk */                                      \
+        2U, USB_DEVICE_EHCI_DTD_VCOM1_BULK + USB_DEVICE_EHCI_DTD_NCM_BULK,                                             \
+        /* EP7 OUT: NCM bulk, IN: second virtual com notification */                                                   \
+        USB_DEVICE_EHCI_DTD_NCM_BULK, USB_DEVICE_EHCI_DTD_VCOM1_NOTIFICATION,                                          \
+    }
+#endif
+
+/*! @brief Default interrupt threshold in micro-frames (0, 1, 2, 4, 8, 16, 32 or 64), the controller delays the
+ * transfer complete interrupts up to this many micro-frames so several of them are handled in one pass.
+ * 0 interrupts immediately, which keeps the latency low. It can be changed at run time through
+ * kUSB_DeviceStatusInterruptThreshold. */
+#ifndef USB_DEVICE_CONFIG_EHCI_INTERRUPT_THRESHOLD
+#define USB_DEVICE_CONFIG_EHCI_INTERRUPT_THRESHOLD (0U)
+#endif
+
+/*! @brief Whether the cycles the EHCI transfer path runs with interrupts masked are measured with the DWT cycle
+ * counter. The last and the longest section are read through kUSB_DeviceStatusCriticalSection. */
+#ifndef USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS
+#define USB_DEVICE_CONFIG_EHCI_CRITICAL_SECTION_STATS (0U)
+#endif
 
 /*! @brief Whether the EHCI ID pin detect feature enabled. */
 #define USB_DEVICE_CONFIG_EHCI_ID_PIN_DETECT (0U)
 #endif
 
+/*! @brief NVIC priority of the USB interrupt, also the level USB_OSA_ENTER_CRITICAL masks up to. The ISR uses
+ * FreeRTOS, so it can not be above configMAX_SYSCALL_INTERRUPT_PRIORITY. */
+#ifndef USB_DEVICE_INTERRUPT_PRIORITY
+#define USB_DEVICE_INTERRUPT_PRIORITY (3U)
+#endif
+
 /*! @brief Whether the keep alive feature enabled. */
 #define USB_DEVICE_CONFIG_KEEP_ALIVE_MODE (0U)
 
-/*! @brief Whether the transfer buffer is cache-enabled or not. */
+/*! @brief Whether the transfer buffer is cache-enabled or not.
+ * When enabled the data buffers are placed in m_usb_dma_noninit_data and m_usb_dma_init_data, which the linker
+ * script may map to cacheable RAM, the dQH and dTD stay in NonCacheable. The stack cleans and invalidates the buffers
+ * around every transfer, receive buffers have to start on a cache line and be sized with
+ * USB_DATA_ALIGN_SIZE_MULTIPLE. */
 #ifndef USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE
 #define USB_DEVICE_CONFIG_BUFFER_PROPERTY_CACHEABLE (0U)
 #endif
@@ -151,6 +269,13 @@
 #define USB_DEVICE_CONFIG_REMOTE_WAKEUP (0U)
 #endif
 
+/*! @brief Whether the BOS descriptor announces the Microsoft OS 2.0 descriptor set. Windows 8.1 and later read it on
+ * the first plug and bind the in-box drivers from the compatible IDs it declares instead of running the class matching
+ * heuristics. The device reports USB 2.1 when enabled. */
+#ifndef USB_DEVICE_CONFIG_MS_OS_20
+#define USB_DEVICE_CONFIG_MS_OS_20 (1U)
+#endif
+
 /*! @brief Whether the device detached feature is enabled or not. */
 #define USB_DEVICE_CONFIG_DETACH_ENABLE (1U)
 
@@ -15,18 +15,56 @@
 
 #include "usb_device_descriptor.h"
 
+/* Descriptor sets, the one matching the bus speed is selected in USB_DeviceSetSpeed */
+#define USB_DESCRIPTOR_SET_FS (0U)
+#define USB_DESCRIPTOR_SET_HS (1U)
+#define USB_DESCRIPTOR_SET_COUNT (2U)
+
+/*
+ * Endpoint lists of the functions. Every list is expanded twice for each speed, into the endpoint templates used by
+ * the class drivers and into the configuration descriptor, so both always describe the same endpoints.
+ */
+#define USB_ENDPOINT_TEMPLATE(address, type, packetSize, interval) {(address), (type), (packetSize), (interval)},
+
+#define USB_ENDPOINT_DESCRIPTOR(address, type, packetSize, interval)                                           \
+    USB_DESCRIPTOR_LENGTH_ENDPOINT, USB_DESCRIPTOR_TYPE_ENDPOINT, (address), (type), USB_SHORT_GET_LOW(packetSize), \
+        USB_SHORT_GET_HIGH(packetSize), (interval),
+
+#define USB_MTP_ENDPOINTS(speed, X)                                                                            \
+    X(USB_MTP_BULK_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_BULK, speed##_MTP_BULK_IN_PACKET_SIZE, 0U)       \
+    X(USB_MTP_BULK_OUT_ENDPOINT | (USB_OUT << 7U), USB_ENDPOINT_BULK, speed##_MTP_BULK_OUT_PACKET_SIZE, 0U)    \
+    X(USB_MTP_INTR_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_INTERRUPT, speed##_MTP_INTR_IN_PACKET_SIZE, \
+      speed##_MTP_INTR_IN_INTERVAL)
+
+#define USB_MSC_ENDPOINTS(speed, X)                                                                         \
+    X(USB_MSC_BULK_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_BULK, speed##_MSC_BULK_IN_PACKET_SIZE, 0U)    \
+    X(USB_MSC_BULK_OUT_ENDPOINT | (USB_OUT << 7U), USB_ENDPOINT_BULK, speed##_MSC_BULK_OUT_PACKET_SIZE, 0U)
+
+/* instance is VCOM for the first virtual com port and VCOM1 for the second one */
+#define USB_CDC_VCOM_CIC_ENDPOINTS(speed, instance, X)                                                   \
+    X(USB_CDC_##instance##_CIC_INTERRUPT_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_INTERRUPT,         \
+      speed##_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE, speed##_CDC_VCOM_INTERRUPT_IN_INTERVAL)
+
+#define USB_CDC_VCOM_DIC_ENDPOINTS(speed, instance, X)                                                   \
+    X(USB_CDC_##instance##_DIC_BULK_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_BULK,                   \
+      speed##_CDC_VCOM_BULK_IN_PACKET_SIZE, 0U)                                                          \
+    X(USB_CDC_##instance##_DIC_BULK_OUT_ENDPOINT | (USB_OUT << 7U), USB_ENDPOINT_BULK,                 \
+      speed##_CDC_VCOM_BULK_OUT_PACKET_SIZE, 0U)
+
+#define USB_CDC_NCM_CIC_ENDPOINTS(speed, X)                                                                  \
+    X(USB_CDC_NCM_CIC_INTERRUPT_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_INTERRUPT,                      \
+      speed##_CDC_NCM_INTERRUPT_IN_PACKET_SIZE, speed##_CDC_NCM_INTERRUPT_IN_INTERVAL)
+
+#define USB_CDC_NCM_DIC_ENDPOINTS(speed, X)                                                                  \
+    X(USB_CDC_NCM_DIC_BULK_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_BULK, speed##_CDC_NCM_BULK_IN_PACKET_SIZE, \
+      0U)                                                                                                    \
+    X(USB_CDC_NCM_DIC_BULK_OUT_ENDPOINT | (USB_OUT << 7U), USB_ENDPOINT_BULK,                              \
+      speed##_CDC_NCM_BULK_OUT_PACKET_SIZE, 0U)
+
 #if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-usb_device_endpoint_struct_t g_UsbMtpEndpoints[USB_MTP_ENDPOINT_COUNT] =
-{
-    {
-        USB_MTP_BULK_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_BULK, HS_MTP_BULK_IN_PACKET_SIZE, 0U,
-    },
-    {
-        USB_MTP_BULK_OUT_ENDPOINT | (USB_OUT << 7U), USB_ENDPOINT_BULK, HS_MTP_BULK_OUT_PACKET_SIZE, 0U,
-    },
-    {
-        USB_MTP_INTR_IN_ENDPOINT | (USB_IN << 7U), USB_ENDPOINT_INTERRUPT, HS_MTP_INTR_IN_PACKET_SIZE, 0U,
-    }
+usb_device_endpoint_struct_t g_UsbMtpEndpoints[USB_DESCRIPTOR_SET_COUNT][USB_MTP_ENDPOINT_COUNT] = {
+    {USB_MTP_ENDPOINTS(FS, USB_ENDPOINT_TEMPLATE)},
+    {USB_MTP_ENDPOINTS(HS, USB_ENDPOINT_TEMPLATE)},
 };
 
 usb_device_interface_struct_t g_UsbDeviceMtpInterface[] =
@@ -34,7 +72,7 @@ usb_device_interface_struct_t g_UsbDeviceMtpInterface[] =
     {
         0,
         {
-            USB_MTP_ENDPOINT_COUNT, g_UsbMtpEndpoints,
+            USB_MTP_ENDPOINT_COUNT, g_UsbMtpEndpoints[USB_DESCRIPTOR_SET_FS],
         },
         NULL
     }
@@ -64,71 +102,263 @@ usb_device_class_struct_t g_MtpClass = {
 };
 #endif // #if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
 
+#if defined (USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+usb_device_endpoint_struct_t g_UsbMscEndpoints[USB_DESCRIPTOR_SET_COUNT][USB_MSC_ENDPOINT_COUNT] = {
+    {USB_MSC_ENDPOINTS(FS, USB_ENDPOINT_TEMPLATE)},
+    {USB_MSC_ENDPOINTS(HS, USB_ENDPOINT_TEMPLATE)},
+};
+
+usb_device_interface_struct_t g_UsbDeviceMscInterface[] =
+{
+    {
+        0,
+        {
+            USB_MSC_ENDPOINT_COUNT, g_UsbMscEndpoints[USB_DESCRIPTOR_SET_FS],
+        },
+        NULL
+    }
+};
+
+usb_device_interfaces_struct_t g_UsbDeviceMscInterfaces[USB_MSC_INTERFACE_COUNT] = {{
+    USB_MSC_CLASS,
+    USB_MSC_SUBCLASS,
+    USB_MSC_PROTOCOL,
+    USB_MSC_INTERFACE_INDEX,
+    g_UsbDeviceMscInterface,
+    sizeof(g_UsbDeviceMscInterface) / sizeof(usb_device_interface_struct_t),
+}};
+
+usb_device_interface_list_t g_UsbDeviceMscInterfaceList[USB_DEVICE_CONFIGURATION_COUNT] = {
+    {
+        USB_MSC_INTERFACE_COUNT,
+        g_UsbDeviceMscInterfaces,
+    },
+};
+
+/* Define class information for mass storage */
+usb_device_class_struct_t g_MscClass = {
+    g_UsbDeviceMscInterfaceList,
+    kUSB_DeviceClassTypeMsc,
+    USB_DEVICE_CONFIGURATION_COUNT,
+};
+#endif // #if defined (USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+
 /* cdc virtual com information */
 /* Define endpoint for communication class */
-usb_device_endpoint_struct_t g_cdcVcomCicEndpoints[USB_CDC_VCOM_CIC_ENDPOINT_COUNT] = {
+usb_device_endpoint_struct_t
+    g_cdcVcomCicEndpoints[USB_DESCRIPTOR_SET_COUNT][USB_DEVICE_CONFIG_CDC_ACM][USB_CDC_VCOM_CIC_ENDPOINT_COUNT] = {
+        {
+            {USB_CDC_VCOM_CIC_ENDPOINTS(FS, VCOM, USB_ENDPOINT_TEMPLATE)},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+            {USB_CDC_VCOM_CIC_ENDPOINTS(FS, VCOM1, USB_ENDPOINT_TEMPLATE)},
+#endif
+        },
+        {
+            {USB_CDC_VCOM_CIC_ENDPOINTS(HS, VCOM, USB_ENDPOINT_TEMPLATE)},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+            {USB_CDC_VCOM_CIC_ENDPOINTS(HS, VCOM1, USB_ENDPOINT_TEMPLATE)},
+#endif
+        },
+};
+
+/* Define endpoint for data class */
+usb_device_endpoint_struct_t
+    g_cdcVcomDicEndpoints[USB_DESCRIPTOR_SET_COUNT][USB_DEVICE_CONFIG_CDC_ACM][USB_CDC_VCOM_DIC_ENDPOINT_COUNT] = {
+        {
+            {USB_CDC_VCOM_DIC_ENDPOINTS(FS, VCOM, USB_ENDPOINT_TEMPLATE)},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+            {USB_CDC_VCOM_DIC_ENDPOINTS(FS, VCOM1, USB_ENDPOINT_TEMPLATE)},
+#endif
+        },
+        {
+            {USB_CDC_VCOM_DIC_ENDPOINTS(HS, VCOM, USB_ENDPOINT_TEMPLATE)},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+            {USB_CDC_VCOM_DIC_ENDPOINTS(HS, VCOM1, USB_ENDPOINT_TEMPLATE)},
+#endif
+        },
+};
+
+/* Define interface for communication class */
+usb_device_interface_struct_t g_cdcVcomCicInterface[USB_DEVICE_CONFIG_CDC_ACM][1] = {
+    {{0,
+      {
+          USB_CDC_VCOM_CIC_ENDPOINT_COUNT,
+          g_cdcVcomCicEndpoints[USB_DESCRIPTOR_SET_FS][0],
+      },
+      NULL}},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    {{0,
+      {
+          USB_CDC_VCOM_CIC_ENDPOINT_COUNT,
+          g_cdcVcomCicEndpoints[USB_DESCRIPTOR_SET_FS][1],
+      },
+      NULL}},
+#endif
+};
+
+/* Define interface for data class */
+usb_device_interface_struct_t g_cdcVcomDicInterface[USB_DEVICE_CONFIG_CDC_ACM][1] = {
+    {{0,
+      {
+          USB_CDC_VCOM_DIC_ENDPOINT_COUNT,
+          g_cdcVcomDicEndpoints[USB_DESCRIPTOR_SET_FS][0],
+      },
+      NULL}},
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    {{0,
+      {
+          USB_CDC_VCOM_DIC_ENDPOINT_COUNT,
+          g_cdcVcomDicEndpoints[USB_DESCRIPTOR_SET_FS][1],
+      },
+      NULL}},
+#endif
+};
+
+/* Define interfaces for virtual com */
+usb_device_interfaces_struct_t g_cdcVcomInterfaces[USB_DEVICE_CONFIG_CDC_ACM][USB_CDC_VCOM_INTERFACE_COUNT] = {
     {
-        USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT | (USB_IN << 7U),
-        USB_ENDPOINT_INTERRUPT,
-        FS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE,
-        FS_CDC_VCOM_INTERRUPT_IN_INTERVAL,
+        {USB_CDC_VCOM_CIC_CLASS, USB_CDC_VCOM_CIC_SUBCLASS, USB_CDC_VCOM_CIC_PROTOCOL, USB_CDC_VCOM_CIC_INTERFACE_INDEX,
+         g_cdcVcomCicInterface[0], 1},
+        {USB_CDC_VCOM_DIC_CLASS, USB_CDC_VCOM_DIC_SUBCLASS, USB_CDC_VCOM_DIC_PROTOCOL, USB_CDC_VCOM_DIC_INTERFACE_INDEX,
+         g_cdcVcomDicInterface[0], 1},
     },
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    {
+        {USB_CDC_VCOM_CIC_CLASS, USB_CDC_VCOM_CIC_SUBCLASS, USB_CDC_VCOM_CIC_PROTOCOL, USB_CDC_VCOM1_CIC_INTERFACE_INDEX,
+         g_cdcVcomCicInterface[1], 1},
+        {USB_CDC_VCOM_DIC_CLASS, USB_CDC_VCOM_DIC_SUBCLASS, USB_CDC_VCOM_DIC_PROTOCOL, USB_CDC_VCOM1_DIC_INTERFACE_INDEX,
+         g_cdcVcomDicInterface[1], 1},
+    },
+#endif
 };
 
-/* Define endpoint for data class */
-usb_device_endpoint_struct_t g_cdcVcomDicEndpoints[USB_CDC_VCOM_DIC_ENDPOINT_COUNT] = {
+/* Define configurations for virtual com */
+usb_device_interface_list_t g_UsbDeviceCdcVcomInterfaceList[USB_DEVICE_CONFIG_CDC_ACM][USB_DEVICE_CONFIGURATION_COUNT] = {
     {
-        USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT | (USB_IN << 7U),
-        USB_ENDPOINT_BULK,
-        FS_CDC_VCOM_BULK_IN_PACKET_SIZE,
-        0U,
+        {
+            USB_CDC_VCOM_INTERFACE_COUNT,
+            g_cdcVcomInterfaces[0],
+        },
     },
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
     {
-        USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT | (USB_OUT << 7U),
-        USB_ENDPOINT_BULK,
-        FS_CDC_VCOM_BULK_OUT_PACKET_SIZE,
-        0U,
+        {
+            USB_CDC_VCOM_INTERFACE_COUNT,
+            g_cdcVcomInterfaces[1],
+        },
     },
+#endif
 };
 
-/* Define interface for communication class */
-usb_device_interface_struct_t g_cdcVcomCicInterface[] = {{0,
-                                                          {
-                                                              USB_CDC_VCOM_CIC_ENDPOINT_COUNT,
-                                                              g_cdcVcomCicEndpoints,
-                                                          },
-                                                          NULL}};
+/* Define class information for virtual com, one entry per CDC ACM instance */
+usb_device_class_struct_t g_UsbDeviceCdcVcomConfig[USB_DEVICE_CONFIG_CDC_ACM] = {
+    {
+        g_UsbDeviceCdcVcomInterfaceList[0],
+        kUSB_DeviceClassTypeCdc,
+        USB_DEVICE_CONFIGURATION_COUNT,
+    },
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+    {
+        g_UsbDeviceCdcVcomInterfaceList[1],
+        kUSB_DeviceClassTypeCdc,
+        USB_DEVICE_CONFIGURATION_COUNT,
+    },
+#endif
+};
 
-/* Define interface for data class */
-usb_device_interface_struct_t g_cdcVcomDicInterface[] = {{0,
-                                                          {
-                                                              USB_CDC_VCOM_DIC_ENDPOINT_COUNT,
-                                                              g_cdcVcomDicEndpoints,
-                                                          },
-                                                          NULL}};
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+/* cdc network function information */
+usb_device_endpoint_struct_t g_cdcNcmCicEndpoints[USB_DESCRIPTOR_SET_COUNT][USB_CDC_NCM_CIC_ENDPOINT_COUNT] = {
+    {USB_CDC_NCM_CIC_ENDPOINTS(FS, USB_ENDPOINT_TEMPLATE)},
+    {USB_CDC_NCM_CIC_ENDPOINTS(HS, USB_ENDPOINT_TEMPLATE)},
+};
 
-/* Define interfaces for virtual com */
-usb_device_interfaces_struct_t g_cdcVcomInterfaces[USB_CDC_VCOM_INTERFACE_COUNT] = {
-    {USB_CDC_VCOM_CIC_CLASS, USB_CDC_VCOM_CIC_SUBCLASS, USB_CDC_VCOM_CIC_PROTOCOL, USB_CDC_VCOM_CIC_INTERFACE_INDEX,
-     g_cdcVcomCicInterface, sizeof(g_cdcVcomCicInterface) / sizeof(usb_device_interface_struct_t)},
-    {USB_CDC_VCOM_DIC_CLASS, USB_CDC_VCOM_DIC_SUBCLASS, USB_CDC_VCOM_DIC_PROTOCOL, USB_CDC_VCOM_DIC_INTERFACE_INDEX,
-     g_cdcVcomDicInterface, sizeof(g_cdcVcomDicInterface) / sizeof(usb_device_interface_struct_t)},
+usb_device_endpoint_struct_t g_cdcNcmDicEndpoints[USB_DESCRIPTOR_SET_COUNT][USB_CDC_NCM_DIC_ENDPOINT_COUNT] = {
+    {USB_CDC_NCM_DIC_ENDPOINTS(FS, USB_ENDPOINT_TEMPLATE)},
+    {USB_CDC_NCM_DIC_ENDPOINTS(HS, USB_ENDPOINT_TEMPLATE)},
 };
 
-/* Define configurations for virtual com */
-usb_device_interface_list_t g_UsbDeviceCdcVcomInterfaceList[USB_DEVICE_CONFIGURATION_COUNT] = {
+usb_device_interface_struct_t g_cdcNcmCicInterface[] = {
+    {0,
+     {
+         USB_CDC_NCM_CIC_ENDPOINT_COUNT,
+         g_cdcNcmCicEndpoints[USB_DESCRIPTOR_SET_FS],
+     },
+     NULL},
+};
+
+/* Host selects alternate setting 1 to start data transfers */
+usb_device_interface_struct_t g_cdcNcmDicInterface[] = {
+    {0,
+     {
+         0,
+         NULL,
+     },
+     NULL},
+    {1,
+     {
+         USB_CDC_NCM_DIC_ENDPOINT_COUNT,
+         g_cdcNcmDicEndpoints[USB_DESCRIPTOR_SET_FS],
+     },
+     NULL},
+};
+
+usb_device_interfaces_struct_t g_cdcNcmInterfaces[USB_CDC_NCM_INTERFACE_COUNT] = {
+    {USB_CDC_NCM_CIC_CLASS, USB_CDC_NCM_CIC_SUBCLASS, USB_CDC_NCM_CIC_PROTOCOL, USB_CDC_NCM_CIC_INTERFACE_INDEX,
+     g_cdcNcmCicInterface, sizeof(g_cdcNcmCicInterface) / sizeof(usb_device_interface_struct_t)},
+    {USB_CDC_NCM_DIC_CLASS, USB_CDC_NCM_DIC_SUBCLASS, USB_CDC_NCM_DIC_PROTOCOL, USB_CDC_NCM_DIC_INTERFACE_INDEX,
+     g_cdcNcmDicInterface, sizeof(g_cdcNcmDicInterface) / sizeof(usb_device_interface_struct_t)},
+};
+
+usb_device_interface_list_t g_UsbDeviceCdcNcmInterfaceList[USB_DEVICE_CONFIGURATION_COUNT] = {
     {
-        USB_CDC_VCOM_INTERFACE_COUNT,
-        g_cdcVcomInterfaces,
+        USB_CDC_NCM_INTERFACE_COUNT,
+        g_cdcNcmInterfaces,
     },
 };
 
-/* Define class information for virtual com */
-usb_device_class_struct_t g_UsbDeviceCdcVcomConfig = {
-    g_UsbDeviceCdcVcomInterfaceList,
-    kUSB_DeviceClassTypeCdc,
+/* Define class information for network function */
+usb_device_class_struct_t g_UsbDeviceCdcNcmConfig = {
+    g_UsbDeviceCdcNcmInterfaceList,
+    kUSB_DeviceClassTypeCdcNcm,
     USB_DEVICE_CONFIGURATION_COUNT,
 };
+#endif // #if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+/* DFU interface has no endpoints, requests come through control endpoint */
+usb_device_interface_struct_t g_UsbDeviceDfuInterface[] = {
+    {0,
+     {
+         0,
+         NULL,
+     },
+     NULL},
+};
+
+usb_device_interfaces_struct_t g_UsbDeviceDfuInterfaces[USB_DFU_INTERFACE_COUNT] = {{
+    USB_DFU_CLASS,
+    USB_DFU_SUBCLASS,
+    USB_DFU_PROTOCOL,
+    USB_DFU_INTERFACE_INDEX,
+    g_UsbDeviceDfuInterface,
+    sizeof(g_UsbDeviceDfuInterface) / sizeof(usb_device_interface_struct_t),
+}};
+
+usb_device_interface_list_t g_UsbDeviceDfuInterfaceList[USB_DEVICE_CONFIGURATION_COUNT] = {
+    {
+        USB_DFU_INTERFACE_COUNT,
+        g_UsbDeviceDfuInterfaces,
+    },
+};
+
+/* Define class information for firmware upgrade */
+usb_device_class_struct_t g_DfuClass = {
+    g_UsbDeviceDfuInterfaceList,
+    kUSB_DeviceClassTypeDfu,
+    USB_DEVICE_CONFIGURATION_COUNT,
+};
+#endif // #if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
 
 /* Define device descriptor */
 USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
@@ -167,163 +397,167 @@ uint8_t g_UsbDeviceDescriptor[] = {
     USB_DEVICE_CONFIGURATION_COUNT,
 };
 
-/* Define configuration descriptor */
+/*
+ * Configuration descriptor fragments of the functions. A disabled function expands to nothing, every fragment ends
+ * with a comma so the fragments can follow each other.
+ */
+#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
+#define USB_MTP_FUNCTION_DESCRIPTOR(speed)                                                                   \
+    /***** MTP Device Class *****/                                                                           \
+    USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_MTP_INTERFACE_INDEX, 0x00,           \
+        USB_MTP_ENDPOINT_COUNT, USB_MTP_DEVICE_CLASS, USB_MTP_DEVICE_SUBCLASS, USB_MTP_DEVICE_PROTOCOL,      \
+        USB_STRING_MTP_INTERFACE,                                                                            \
+        USB_MTP_ENDPOINTS(speed, USB_ENDPOINT_DESCRIPTOR)
+#else
+#define USB_MTP_FUNCTION_DESCRIPTOR(speed)
+#endif
+
+#if defined (USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+#define USB_MSC_FUNCTION_DESCRIPTOR(speed)                                                                   \
+    /***** Mass Storage Device Class *****/                                                                  \
+    USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_MSC_INTERFACE_INDEX, 0x00,           \
+        USB_MSC_ENDPOINT_COUNT, USB_MSC_CLASS, USB_MSC_SUBCLASS, USB_MSC_PROTOCOL, USB_STRING_MSC_INTERFACE, \
+        USB_MSC_ENDPOINTS(speed, USB_ENDPOINT_DESCRIPTOR)
+#else
+#define USB_MSC_FUNCTION_DESCRIPTOR(speed)
+#endif
+
+#define USB_CDC_VCOM_FUNCTION_DESCRIPTOR(speed, instance, functionString)                                     \
+    /* Interface Association Descriptor (IAD) */                                                               \
+    USB_IAD_DESC_SIZE, USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION, USB_CDC_##instance##_CIC_INTERFACE_INDEX,    \
+        USB_CDC_VCOM_INTERFACE_COUNT, USB_CDC_VCOM_CIC_CLASS, USB_CDC_VCOM_CIC_SUBCLASS,                       \
+        USB_CDC_VCOM_CIC_PROTOCOL, (functionString),                                                           \
+        /***** CDC ACM Device Class *****/                                                                     \
+        USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_CDC_##instance##_CIC_INTERFACE_INDEX, \
+        0x00, USB_CDC_VCOM_CIC_ENDPOINT_COUNT, USB_CDC_VCOM_CIC_CLASS, USB_CDC_VCOM_CIC_SUBCLASS,              \
+        USB_CDC_VCOM_CIC_PROTOCOL, USB_STRING_CDC_ACM_CIC,                                                     \
+        /* Header, communication specification version 1.10 */                                                \
+        USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE, USB_CDC_HEADER_FUNC_DESC, \
+        0x10, 0x01,                                                                                            \
+        /* Call management done by device, call management information is multiplexed over data interface */ \
+        USB_DESCRIPTOR_LENGTH_CDC_CALL_MANAG, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE,                            \
+        USB_CDC_CALL_MANAGEMENT_FUNC_DESC, 0x01, 0x01,                                                         \
+        /* Line coding, control line state and serial state notification are supported */                     \
+        USB_DESCRIPTOR_LENGTH_CDC_ABSTRACT, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE,                              \
+        USB_CDC_ABSTRACT_CONTROL_FUNC_DESC, 0x06,                                                              \
+        /* Union Communication Descriptor */                                                                   \
+        USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE, USB_CDC_UNION_FUNC_DESC,   \
+        USB_CDC_##instance##_CIC_INTERFACE_INDEX, USB_CDC_##instance##_DIC_INTERFACE_INDEX,                    \
+        USB_CDC_VCOM_CIC_ENDPOINTS(speed, instance, USB_ENDPOINT_DESCRIPTOR)                                   \
+        /* Data Interface Descriptor */                                                                        \
+        USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_CDC_##instance##_DIC_INTERFACE_INDEX, \
+        0x00, USB_CDC_VCOM_DIC_ENDPOINT_COUNT, USB_CDC_VCOM_DIC_CLASS, USB_CDC_VCOM_DIC_SUBCLASS,              \
+        USB_CDC_VCOM_DIC_PROTOCOL, USB_STRING_CDC_ACM_DIC,                                                     \
+        USB_CDC_VCOM_DIC_ENDPOINTS(speed, instance, USB_ENDPOINT_DESCRIPTOR)
+
+#if (USB_DEVICE_CONFIG_CDC_ACM > 1U)
+#define USB_CDC_VCOM1_FUNCTION_DESCRIPTOR(speed) \
+    USB_CDC_VCOM_FUNCTION_DESCRIPTOR(speed, VCOM1, USB_STRING_CDC_ACM_DATA_CLASS)
+#else
+#define USB_CDC_VCOM1_FUNCTION_DESCRIPTOR(speed)
+#endif
+
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+#define USB_CDC_NCM_FUNCTION_DESCRIPTOR(speed)                                                                \
+    /* Interface Association Descriptor (IAD) */                                                               \
+    USB_IAD_DESC_SIZE, USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION, USB_CDC_NCM_CIC_INTERFACE_INDEX,             \
+        USB_CDC_NCM_INTERFACE_COUNT, USB_CDC_NCM_CIC_CLASS, USB_CDC_NCM_CIC_SUBCLASS, USB_CDC_NCM_CIC_PROTOCOL, \
+        USB_STRING_CDC_NCM_CLASS,                                                                              \
+        /* Communication Interface Descriptor */                                                               \
+        USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_CDC_NCM_CIC_INTERFACE_INDEX, 0x00, \
+        USB_CDC_NCM_CIC_ENDPOINT_COUNT, USB_CDC_NCM_CIC_CLASS, USB_CDC_NCM_CIC_SUBCLASS,                       \
+        USB_CDC_NCM_CIC_PROTOCOL, USB_STRING_CDC_NCM_CLASS,                                                    \
+        /* Header, communication specification version 1.10 */                                                \
+        USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE, USB_CDC_HEADER_FUNC_DESC, \
+        0x10, 0x01,                                                                                            \
+        /* Union Communication Descriptor */                                                                   \
+        USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE, USB_CDC_UNION_FUNC_DESC,   \
+        USB_CDC_NCM_CIC_INTERFACE_INDEX, USB_CDC_NCM_DIC_INTERFACE_INDEX,                                      \
+        /* Ethernet Networking Functional Descriptor, no statistics and no multicast or power filters */       \
+        USB_DESCRIPTOR_LENGTH_CDC_ETHERNET_NETWORKING, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE,                   \
+        USB_CDC_ETHERNET_NETWORKING_FUNC_DESC, USB_STRING_CDC_NCM_MAC_ADDRESS, 0x00, 0x00, 0x00, 0x00,         \
+        USB_SHORT_GET_LOW(USB_CDC_NCM_MAX_SEGMENT_SIZE), USB_SHORT_GET_HIGH(USB_CDC_NCM_MAX_SEGMENT_SIZE),     \
+        0x00, 0x00, 0x00,                                                                                      \
+        /* NCM Functional Descriptor, version 1.00 without optional requests */                                \
+        USB_DESCRIPTOR_LENGTH_CDC_NCM_FUNC, USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE, USB_CDC_NCM_FUNC_DESC, 0x00,  \
+        0x01, 0x00,                                                                                            \
+        USB_CDC_NCM_CIC_ENDPOINTS(speed, USB_ENDPOINT_DESCRIPTOR)                                              \
+        /* Data Interface Descriptor, alternate setting 0 without endpoints */                                 \
+        USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_CDC_NCM_DIC_INTERFACE_INDEX, 0x00, \
+        0x00, USB_CDC_NCM_DIC_CLASS, USB_CDC_NCM_DIC_SUBCLASS, USB_CDC_NCM_DIC_PROTOCOL, 0x00,                 \
+        /* Data Interface Descriptor, alternate setting 1 */                                                   \
+        USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_CDC_NCM_DIC_INTERFACE_INDEX, 0x01, \
+        USB_CDC_NCM_DIC_ENDPOINT_COUNT, USB_CDC_NCM_DIC_CLASS, USB_CDC_NCM_DIC_SUBCLASS,                       \
+        USB_CDC_NCM_DIC_PROTOCOL, 0x00,                                                                        \
+        USB_CDC_NCM_DIC_ENDPOINTS(speed, USB_ENDPOINT_DESCRIPTOR)
+#else
+#define USB_CDC_NCM_FUNCTION_DESCRIPTOR(speed)
+#endif
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+#define USB_DFU_FUNCTION_DESCRIPTOR                                                                          \
+    /***** Device Firmware Upgrade, no endpoints besides control *****/                                      \
+    USB_DESCRIPTOR_LENGTH_INTERFACE, USB_DESCRIPTOR_TYPE_INTERFACE, USB_DFU_INTERFACE_INDEX, 0x00, 0x00,     \
+        USB_DFU_CLASS, USB_DFU_SUBCLASS, USB_DFU_PROTOCOL, USB_STRING_DFU_INTERFACE,                         \
+        /* DFU Functional Descriptor */                                                                      \
+        USB_DESCRIPTOR_LENGTH_DFU_FUNC, USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL, USB_DFU_ATTRIBUTES,              \
+        USB_SHORT_GET_LOW(USB_DFU_DETACH_TIMEOUT), USB_SHORT_GET_HIGH(USB_DFU_DETACH_TIMEOUT),               \
+        USB_SHORT_GET_LOW(USB_DFU_TRANSFER_SIZE), USB_SHORT_GET_HIGH(USB_DFU_TRANSFER_SIZE),                 \
+        USB_SHORT_GET_LOW(USB_DFU_VERSION), USB_SHORT_GET_HIGH(USB_DFU_VERSION),
+#else
+#define USB_DFU_FUNCTION_DESCRIPTOR
+#endif
+
+/*
+ * Whole configuration of the composite device at one speed. descriptorType is USB_DESCRIPTOR_TYPE_CONFIGURE for the
+ * configuration of the current speed, USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION for the other one.
+ */
+#define USB_COMPOSITE_CONFIGURATION_DESCRIPTOR(speed, descriptorType)                                         \
+    USB_DESCRIPTOR_LENGTH_CONFIGURE, (descriptorType),                                                         \
+        /* Total length of data returned for this configuration. */                                            \
+        USB_SHORT_GET_LOW(USB_DECRIPTOR_CONFIGURATION_LENGTH), USB_SHORT_GET_HIGH(USB_DECRIPTOR_CONFIGURATION_LENGTH), \
+        USB_INTERFACE_COUNT,                                                                                   \
+        /* Value to use as an argument to the SetConfiguration() request to select this configuration */      \
+        USB_COMPOSITE_CONFIGURE_INDEX,                                                                         \
+        /* Index of string descriptor describing this configuration */                                         \
+        USB_STRING_DEF_CONFIGURATION,                                                                          \
+        /* Configuration characteristics D7: Reserved (set to one) D6: Self-powered D5: Remote Wakeup */       \
+        (USB_DESCRIPTOR_CONFIGURE_ATTRIBUTE_D7_MASK) |                                                         \
+            (USB_DEVICE_CONFIG_SELF_POWER << USB_DESCRIPTOR_CONFIGURE_ATTRIBUTE_SELF_POWERED_SHIFT) |          \
+            (USB_DEVICE_CONFIG_REMOTE_WAKEUP << USB_DESCRIPTOR_CONFIGURE_ATTRIBUTE_REMOTE_WAKEUP_SHIFT),       \
+        /* Maximum power consumption from the bus, expressed in 2 mA units */                                  \
+        USB_DEVICE_MAX_POWER,                                                                                  \
+        USB_MTP_FUNCTION_DESCRIPTOR(speed)                                                                     \
+        USB_MSC_FUNCTION_DESCRIPTOR(speed)                                                                     \
+        USB_CDC_VCOM_FUNCTION_DESCRIPTOR(speed, VCOM, USB_STRING_CDC_ACM_CLASS)                                \
+        USB_CDC_VCOM1_FUNCTION_DESCRIPTOR(speed)                                                               \
+        USB_CDC_NCM_FUNCTION_DESCRIPTOR(speed)                                                                 \
+        USB_DFU_FUNCTION_DESCRIPTOR
+
+/* Define configuration descriptors, they are never modified at run time */
 USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
-uint8_t g_UsbDeviceConfigurationDescriptor[] = {
-    /* Configuration 1 Descriptor */
-    USB_DESCRIPTOR_LENGTH_CONFIGURE,
-    USB_DESCRIPTOR_TYPE_CONFIGURE,
-    /* Total length of data returned for this configuration. */
-    USB_SHORT_GET_LOW(USB_DECRIPTOR_CONFIGURATION_LENGTH),
-    USB_SHORT_GET_HIGH(USB_DECRIPTOR_CONFIGURATION_LENGTH),
-    USB_INTERFACE_COUNT,
-    /* Value to use as an argument to the SetConfiguration() request to select this configuration */
-    USB_COMPOSITE_CONFIGURE_INDEX,
-    /* Index of string descriptor describing this configuration */
-    USB_STRING_DEF_CONFIGURATION,
-    /* Configuration characteristics D7: Reserved (set to one) D6: Self-powered D5: Remote Wakeup D4...0: Reserved
-       (reset to zero) */
-    (USB_DESCRIPTOR_CONFIGURE_ATTRIBUTE_D7_MASK) |
-        (USB_DEVICE_CONFIG_SELF_POWER << USB_DESCRIPTOR_CONFIGURE_ATTRIBUTE_SELF_POWERED_SHIFT) |
-        (USB_DEVICE_CONFIG_REMOTE_WAKEUP << USB_DESCRIPTOR_CONFIGURE_ATTRIBUTE_REMOTE_WAKEUP_SHIFT),
-    /* Maximum power consumption of the USB * device from the bus in this specific * configuration when the device is
-       fully * operational. Expressed in 2 mA units *  (i.e., 50 = 100 mA).  */
-    USB_DEVICE_MAX_POWER,
+uint8_t g_UsbDeviceConfigurationDescriptorFs[] = {
+    USB_COMPOSITE_CONFIGURATION_DESCRIPTOR(FS, USB_DESCRIPTOR_TYPE_CONFIGURE)};
 
-#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-    /***** MTP Device Class *****/
-    /* Interface Descriptors */
-    USB_DESCRIPTOR_LENGTH_INTERFACE,
-    USB_DESCRIPTOR_TYPE_INTERFACE,
-    USB_MTP_INTERFACE_INDEX,
-    0x00,
-    USB_MTP_ENDPOINT_COUNT,
-    USB_MTP_DEVICE_CLASS,
-    USB_MTP_DEVICE_SUBCLASS,
-    USB_MTP_DEVICE_PROTOCOL,
-    USB_STRING_MTP_INTERFACE,
-    /* Endpoint Descriptors */
-        USB_DESCRIPTOR_LENGTH_ENDPOINT,
-        USB_DESCRIPTOR_TYPE_ENDPOINT,
-        USB_MTP_BULK_IN_ENDPOINT  | (USB_IN << 7U),
-        USB_ENDPOINT_BULK,
-        USB_SHORT_GET_LOW(HS_MTP_BULK_IN_PACKET_SIZE),
-        USB_SHORT_GET_HIGH(HS_MTP_BULK_IN_PACKET_SIZE),
-        0x00,
-
-        USB_DESCRIPTOR_LENGTH_ENDPOINT,
-        USB_DESCRIPTOR_TYPE_ENDPOINT,
-        USB_MTP_BULK_OUT_ENDPOINT  | (USB_OUT << 7U),
-        USB_ENDPOINT_BULK,
-        USB_SHORT_GET_LOW(HS_MTP_BULK_IN_PACKET_SIZE),
-        USB_SHORT_GET_HIGH(HS_MTP_BULK_IN_PACKET_SIZE),
-        0x00,
-
-        USB_DESCRIPTOR_LENGTH_ENDPOINT,
-        USB_DESCRIPTOR_TYPE_ENDPOINT,
-        USB_MTP_INTR_IN_ENDPOINT  | (USB_IN << 7U),
-        USB_ENDPOINT_INTERRUPT,
-        USB_SHORT_GET_LOW(HS_MTP_INTR_IN_PACKET_SIZE),
-        USB_SHORT_GET_HIGH(HS_MTP_INTR_IN_PACKET_SIZE),
-        FS_MTP_INTR_IN_INTERVAL,
-#endif // #if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+uint8_t g_UsbDeviceConfigurationDescriptorHs[] = {
+    USB_COMPOSITE_CONFIGURATION_DESCRIPTOR(HS, USB_DESCRIPTOR_TYPE_CONFIGURE)};
 
-    /* Interface Association Descriptor (IAD) */
-    /* Size of this descriptor in bytes */
-    USB_IAD_DESC_SIZE,
-    /* INTERFACE_ASSOCIATION Descriptor Type  */
-    USB_DESCRIPTOR_TYPE_INTERFACE_ASSOCIATION,
-    /* The first interface number associated with this function */
-    USB_CDC_VCOM_CIC_INTERFACE_INDEX,
-    /* The number of contiguous interfaces associated with this function */
-    0x02,
-    /* The function belongs to the Communication Device/Interface Class  */
-    USB_CDC_VCOM_CIC_CLASS,
-    USB_CDC_VCOM_CIC_SUBCLASS,
-    /* The function uses the No class specific protocol required Protocol  */
-    USB_CDC_VCOM_CIC_PROTOCOL,
-    /* The Function string descriptor index */
-    USB_STRING_CDC_ACM_CLASS,
-
-    /***** CDC ACM Devic Class *****/
-    /* Interface Descriptor */
-    USB_DESCRIPTOR_LENGTH_INTERFACE,
-    USB_DESCRIPTOR_TYPE_INTERFACE,
-    USB_CDC_VCOM_CIC_INTERFACE_INDEX,
-    0x00,
-    USB_CDC_VCOM_CIC_ENDPOINT_COUNT,
-    USB_CDC_VCOM_CIC_CLASS,
-    USB_CDC_VCOM_CIC_SUBCLASS,
-    USB_CDC_VCOM_CIC_PROTOCOL,
-    USB_STRING_CDC_ACM_CIC,
-
-    /* CDC Class-Specific descriptor */
-    USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC, /* Size of this descriptor in bytes */
-    USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE,  /* CS_INTERFACE Descriptor Type */
-    USB_CDC_HEADER_FUNC_DESC,
-    0x10,
-    0x01, /* USB Class Definitions for Communications the Communication specification version 1.10 */
-
-    USB_DESCRIPTOR_LENGTH_CDC_CALL_MANAG, /* Size of this descriptor in bytes */
-    USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE, /* CS_INTERFACE Descriptor Type */
-    USB_CDC_CALL_MANAGEMENT_FUNC_DESC,
-    0x01, /*Bit 0: Whether device handle call management itself 1, Bit 1: Whether device can send/receive call
-             management information over a Data Class Interface 0 */
-    0x01, /* Indicates multiplexed commands are handled via data interface */
-
-    USB_DESCRIPTOR_LENGTH_CDC_ABSTRACT,
-    USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE,
-    USB_CDC_ABSTRACT_CONTROL_FUNC_DESC,
-    0x06, /* Bit 0: Whether device supports the request combination of Set_Comm_Feature, Clear_Comm_Feature, and
-             Get_Comm_Feature 0, Bit 1: Whether device supports the request combination of Set_Line_Coding,
-             Set_Control_Line_State, Get_Line_Coding, and the notification Serial_State 1, Bit ...  */
-
-    /* Union Communication Descriptor */
-    USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC,
-    USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE,
-    USB_CDC_UNION_FUNC_DESC,
-    USB_CDC_VCOM_CIC_INTERFACE_INDEX,
-    USB_CDC_VCOM_DIC_INTERFACE_INDEX,
-
-    /*Notification Endpoint descriptor */
-    USB_DESCRIPTOR_LENGTH_ENDPOINT,
-    USB_DESCRIPTOR_TYPE_ENDPOINT,
-    USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT | (USB_IN << 7U),
-    USB_ENDPOINT_INTERRUPT,
-    USB_SHORT_GET_LOW(FS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE),
-    USB_SHORT_GET_HIGH(FS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE),
-    FS_CDC_VCOM_INTERRUPT_IN_INTERVAL,
-
-    /* Data Interface Descriptor */
-    USB_DESCRIPTOR_LENGTH_INTERFACE,
-    USB_DESCRIPTOR_TYPE_INTERFACE,
-    USB_CDC_VCOM_DIC_INTERFACE_INDEX,
-    0x00,
-    USB_CDC_VCOM_DIC_ENDPOINT_COUNT,
-    USB_CDC_VCOM_DIC_CLASS,
-    USB_CDC_VCOM_DIC_SUBCLASS,
-    USB_CDC_VCOM_DIC_PROTOCOL,
-    USB_STRING_CDC_ACM_DIC,
-    /* Endpoint Descriptors */
-        USB_DESCRIPTOR_LENGTH_ENDPOINT,
-        USB_DESCRIPTOR_TYPE_ENDPOINT,
-        USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT | (USB_IN << 7U),
-        USB_ENDPOINT_BULK,
-        USB_SHORT_GET_LOW(FS_CDC_VCOM_BULK_IN_PACKET_SIZE),
-        USB_SHORT_GET_HIGH(FS_CDC_VCOM_BULK_IN_PACKET_SIZE),
-        0x00, /* The polling interval value is every 0 Frames */
-
-        /*Bulk OUT Endpoint descriptor */
-        USB_DESCRIPTOR_LENGTH_ENDPOINT,
-        USB_DESCRIPTOR_TYPE_ENDPOINT,
-        USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT | (USB_OUT << 7U),
-        USB_ENDPOINT_BULK,
-        USB_SHORT_GET_LOW(FS_CDC_VCOM_BULK_OUT_PACKET_SIZE),
-        USB_SHORT_GET_HIGH(FS_CDC_VCOM_BULK_OUT_PACKET_SIZE),
-        0x00, /* The polling interval value is every 0 Frames */
-};
+_Static_assert(sizeof(g_UsbDeviceConfigurationDescriptorFs) == USB_DECRIPTOR_CONFIGURATION_LENGTH,
+               "USB_DECRIPTOR_CONFIGURATION_LENGTH does not match full speed configuration descriptor");
+_Static_assert(sizeof(g_UsbDeviceConfigurationDescriptorHs) == USB_DECRIPTOR_CONFIGURATION_LENGTH,
+               "USB_DECRIPTOR_CONFIGURATION_LENGTH does not match high speed configuration descriptor");
 
 #if (defined(USB_DEVICE_CONFIG_CV_TEST) && (USB_DEVICE_CONFIG_CV_TEST > 0U))
+/* The configurations as reported by GET_DESCRIPTOR(OTHER_SPEED_CONFIGURATION) at the other speed */
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+uint8_t g_UsbDeviceOtherSpeedConfigurationDescriptorFs[] = {
+    USB_COMPOSITE_CONFIGURATION_DESCRIPTOR(FS, USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION)};
+
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+uint8_t g_UsbDeviceOtherSpeedConfigurationDescriptorHs[] = {
+    USB_COMPOSITE_CONFIGURATION_DESCRIPTOR(HS, USB_DESCRIPTOR_TYPE_OTHER_SPEED_CONFIGURATION)};
+
 USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
 uint8_t g_UsbDeviceQualifierDescriptor[] = {
     USB_DESCRIPTOR_LENGTH_DEVICE_QUALITIER, /* Size of this descriptor in bytes */
@@ -336,11 +570,127 @@ uint8_t g_UsbDeviceQualifierDescriptor[] = {
     USB_DEVICE_PROTOCOL,                                 /* Protocol code (assigned by the USB-IF). */
     USB_CONTROL_MAX_PACKET_SIZE,                         /* Maximum packet size for endpoint zero
                                                             (only 8, 16, 32, or 64 are valid) */
-    0x00U,                                               /* Number of Other-speed Configurations */
+    USB_DEVICE_CONFIGURATION_COUNT,                      /* Number of Other-speed Configurations */
     0x00U,                                               /* Reserved for future use, must be zero */
 };
 #endif
 
+#if (defined(USB_DEVICE_CONFIG_MS_OS_20) && (USB_DEVICE_CONFIG_MS_OS_20 > 0U))
+/* Define BOS descriptor, it points Windows to the Microsoft OS 2.0 descriptor set */
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+uint8_t g_UsbDeviceBosDescriptor[] = {
+    USB_DESCRIPTOR_LENGTH_BOS_DESCRIPTOR, USB_DESCRIPTOR_TYPE_BOS,
+    USB_SHORT_GET_LOW(USB_DESCRIPTOR_LENGTH_BOS_ALL), USB_SHORT_GET_HIGH(USB_DESCRIPTOR_LENGTH_BOS_ALL),
+    0x02U, /* Number of device capabilities */
+
+    /* USB 2.0 extension, mandatory for USB 2.1 devices */
+    USB_DESCRIPTOR_LENGTH_DEVICE_CAPABILITY_USB20_EXTENSION, USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY,
+    USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY_USB20_EXTENSION,
+#if (defined(USB_DEVICE_CONFIG_LPM_L1) && (USB_DEVICE_CONFIG_LPM_L1 > 0U))
+    USB_DESCRIPTOR_DEVICE_CAPABILITY_USB20_EXTENSION_LPM_MASK, 0x00U, 0x00U, 0x00U,
+#else
+    0x00U, 0x00U, 0x00U, 0x00U,
+#endif
+
+    /* Microsoft OS 2.0 platform capability */
+    USB_DESCRIPTOR_LENGTH_DEVICE_CAPABILITY_PLATFORM_MS_OS_20, USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY,
+    USB_DESCRIPTOR_TYPE_DEVICE_CAPABILITY_PLATFORM, 0x00U,
+    /* Platform capability UUID D8DD60DF-4589-4CC7-9CD2-659D9E648A9F */
+    0xDFU, 0x60U, 0xDDU, 0xD8U, 0x89U, 0x45U, 0xC7U, 0x4CU, 0x9CU, 0xD2U, 0x65U, 0x9DU, 0x9EU, 0x64U, 0x8AU, 0x9FU,
+    USB_LONG_GET_BYTE0(USB_MS_OS_20_WINDOWS_VERSION), USB_LONG_GET_BYTE1(USB_MS_OS_20_WINDOWS_VERSION),
+    USB_LONG_GET_BYTE2(USB_MS_OS_20_WINDOWS_VERSION), USB_LONG_GET_BYTE3(USB_MS_OS_20_WINDOWS_VERSION),
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_SET), USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_SET),
+    USB_MS_OS_20_VENDOR_CODE,
+    0x00U, /* No alternate enumeration */
+};
+
+_Static_assert(sizeof(g_UsbDeviceBosDescriptor) == USB_DESCRIPTOR_LENGTH_BOS_ALL,
+               "USB_DESCRIPTOR_LENGTH_BOS_ALL does not match BOS descriptor");
+
+/*
+ * Function subsets of the Microsoft OS 2.0 descriptor set. Like the configuration fragments, a disabled function
+ * expands to nothing. Functions without a subset are bound by their class codes.
+ */
+#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
+#define USB_MTP_MS_OS_20_FUNCTION                                                                             \
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION),                                             \
+        USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION),                                        \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_SUBSET_HEADER_FUNCTION), USB_SHORT_GET_HIGH(USB_MS_OS_20_SUBSET_HEADER_FUNCTION), \
+        USB_MTP_INTERFACE_INDEX, 0x00U,                                                                        \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_MTP_FUNCTION), USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_MTP_FUNCTION), \
+        /* Compatible ID MTP, no sub-compatible ID */                                                          \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID),                                          \
+        USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID),                                         \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_FEATURE_COMPATIBLE_ID), USB_SHORT_GET_HIGH(USB_MS_OS_20_FEATURE_COMPATIBLE_ID), \
+        'M', 'T', 'P', 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,                                                      \
+        0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+#else
+#define USB_MTP_MS_OS_20_FUNCTION
+#endif
+
+#if defined(USB_DEVICE_CONFIG_DFU) && (USB_DEVICE_CONFIG_DFU > 0U)
+#define USB_DFU_MS_OS_20_FUNCTION                                                                             \
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION),                                             \
+        USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION),                                        \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_SUBSET_HEADER_FUNCTION), USB_SHORT_GET_HIGH(USB_MS_OS_20_SUBSET_HEADER_FUNCTION), \
+        USB_DFU_INTERFACE_INDEX, 0x00U,                                                                        \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_DFU_FUNCTION), USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_DFU_FUNCTION), \
+        /* Compatible ID WINUSB, no sub-compatible ID */                                                       \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID),                                          \
+        USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID),                                         \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_FEATURE_COMPATIBLE_ID), USB_SHORT_GET_HIGH(USB_MS_OS_20_FEATURE_COMPATIBLE_ID), \
+        'W', 'I', 'N', 'U', 'S', 'B', 0x00U, 0x00U,                                                            \
+        0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,                                                \
+        /* Registry property DeviceInterfaceGUIDs, REG_MULTI_SZ */                                             \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_FEATURE_REG_PROPERTY_GUIDS),                                     \
+        USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_FEATURE_REG_PROPERTY_GUIDS),                                    \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_FEATURE_REG_PROPERTY), USB_SHORT_GET_HIGH(USB_MS_OS_20_FEATURE_REG_PROPERTY), \
+        USB_SHORT_GET_LOW(USB_MS_OS_20_REG_MULTI_SZ), USB_SHORT_GET_HIGH(USB_MS_OS_20_REG_MULTI_SZ),           \
+        USB_SHORT_GET_LOW(2 * 21), USB_SHORT_GET_HIGH(2 * 21),                                                 \
+        'D', 0x00U, 'e', 0x00U, 'v', 0x00U, 'i', 0x00U, 'c', 0x00U, 'e', 0x00U, 'I', 0x00U, 'n', 0x00U,        \
+        't', 0x00U, 'e', 0x00U, 'r', 0x00U, 'f', 0x00U, 'a', 0x00U, 'c', 0x00U, 'e', 0x00U, 'G', 0x00U,        \
+        'U', 0x00U, 'I', 0x00U, 'D', 0x00U, 's', 0x00U, 0x00U, 0x00U,                                          \
+        USB_SHORT_GET_LOW(2 * 40), USB_SHORT_GET_HIGH(2 * 40),                                                 \
+        '{', 0x00U, '5', 0x00U, 'B', 0x00U, 'C', 0x00U, '7', 0x00U, '9', 0x00U, '8', 0x00U, '0', 0x00U,        \
+        '4', 0x00U, '-', 0x00U, '2', 0x00U, 'C', 0x00U, '9', 0x00U, 'D', 0x00U, '-', 0x00U, '4', 0x00U,        \
+        '7', 0x00U, '8', 0x00U, 'D', 0x00U, '-', 0x00U, 'A', 0x00U, '8', 0x00U, '5', 0x00U, '7', 0x00U,        \
+        '-', 0x00U, 'A', 0x00U, '7', 0x00U, '3', 0x00U, 'F', 0x00U, '5', 0x00U, '0', 0x00U, '3', 0x00U,        \
+        'A', 0x00U, '6', 0x00U, '8', 0x00U, '5', 0x00U, '9', 0x00U, '}', 0x00U, 0x00U, 0x00U, 0x00U, 0x00U,
+#else
+#define USB_DFU_MS_OS_20_FUNCTION
+#endif
+
+/* Define Microsoft OS 2.0 descriptor set, read by the vendor request announced in the BOS descriptor */
+USB_DMA_INIT_DATA_ALIGN(USB_DATA_ALIGN_SIZE)
+uint8_t g_UsbDeviceMsOs20DescriptorSet[] = {
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_SET_HEADER), USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_SET_HEADER),
+    USB_SHORT_GET_LOW(USB_MS_OS_20_SET_HEADER_DESCRIPTOR), USB_SHORT_GET_HIGH(USB_MS_OS_20_SET_HEADER_DESCRIPTOR),
+    USB_LONG_GET_BYTE0(USB_MS_OS_20_WINDOWS_VERSION), USB_LONG_GET_BYTE1(USB_MS_OS_20_WINDOWS_VERSION),
+    USB_LONG_GET_BYTE2(USB_MS_OS_20_WINDOWS_VERSION), USB_LONG_GET_BYTE3(USB_MS_OS_20_WINDOWS_VERSION),
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_SET), USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_SET),
+
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_SUBSET_HEADER_CONFIGURATION),
+    USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_SUBSET_HEADER_CONFIGURATION),
+    USB_SHORT_GET_LOW(USB_MS_OS_20_SUBSET_HEADER_CONFIGURATION),
+    USB_SHORT_GET_HIGH(USB_MS_OS_20_SUBSET_HEADER_CONFIGURATION),
+    /* Windows takes the configuration index here, not bConfigurationValue */
+    USB_COMPOSITE_CONFIGURE_INDEX - 1, 0x00U,
+    USB_SHORT_GET_LOW(USB_MS_OS_20_LENGTH_CONFIGURATION), USB_SHORT_GET_HIGH(USB_MS_OS_20_LENGTH_CONFIGURATION),
+
+    USB_MTP_MS_OS_20_FUNCTION
+    USB_DFU_MS_OS_20_FUNCTION
+};
+
+_Static_assert(sizeof(g_UsbDeviceMsOs20DescriptorSet) == USB_MS_OS_20_LENGTH_SET,
+               "USB_MS_OS_20_LENGTH_SET does not match Microsoft OS 2.0 descriptor set");
+#endif
+
+/* Descriptors of the current speed, swapped by USB_DeviceSetSpeed */
+static uint8_t *s_UsbDeviceConfigurationDescriptor = g_UsbDeviceConfigurationDescriptorFs;
+#if (defined(USB_DEVICE_CONFIG_CV_TEST) && (USB_DEVICE_CONFIG_CV_TEST > 0U))
+static uint8_t *s_UsbDeviceOtherSpeedConfigurationDescriptor = g_UsbDeviceOtherSpeedConfigurationDescriptorHs;
+#endif
+
 /*!
  * @brief USB device get device descriptor function.
  *
@@ -368,6 +718,19 @@ usb_status_t USB_DeviceGetDeviceQualifierDescriptor(
     deviceQualifierDescriptor->length = USB_DESCRIPTOR_LENGTH_DEVICE_QUALITIER;
     return kStatus_USB_Success;
 }
+
+/* Get other speed configuration descriptor request */
+usb_status_t USB_DeviceGetOtherSpeedConfigurationDescriptor(
+    usb_device_handle handle, usb_device_get_configuration_descriptor_struct_t *configurationDescriptor)
+{
+    if (USB_COMPOSITE_CONFIGURE_INDEX > configurationDescriptor->configuration)
+    {
+        configurationDescriptor->buffer = s_UsbDeviceOtherSpeedConfigurationDescriptor;
+        configurationDescriptor->length = USB_DESCRIPTOR_LENGTH_CONFIGURATION_ALL;
+        return kStatus_USB_Success;
+    }
+    return kStatus_USB_InvalidRequest;
+}
 #endif
 /*!
  * @brief USB device get configuration descriptor function.
@@ -384,13 +747,60 @@ usb_status_t USB_DeviceGetConfigurationDescriptor(
 {
     if (USB_COMPOSITE_CONFIGURE_INDEX > configurationDescriptor->configuration)
     {
-        configurationDescriptor->buffer = g_UsbDeviceConfigurationDescriptor;
+        configurationDescriptor->buffer = s_UsbDeviceConfigurationDescriptor;
         configurationDescriptor->length = USB_DESCRIPTOR_LENGTH_CONFIGURATION_ALL;
         return kStatus_USB_Success;
     }
     return kStatus_USB_InvalidRequest;
 }
 
+#if (defined(USB_DEVICE_CONFIG_MS_OS_20) && (USB_DEVICE_CONFIG_MS_OS_20 > 0U))
+/*!
+ * @brief USB device get BOS descriptor function.
+ *
+ * This function gets the BOS descriptor announcing the Microsoft OS 2.0 descriptor set.
+ *
+ * @param handle The USB device handle.
+ * @param bosDescriptor The pointer to the BOS descriptor structure.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceGetBosDescriptor(usb_device_handle handle, usb_device_get_bos_descriptor_struct_t *bosDescriptor)
+{
+    bosDescriptor->buffer = g_UsbDeviceBosDescriptor;
+    bosDescriptor->length = USB_DESCRIPTOR_LENGTH_BOS_ALL;
+    return kStatus_USB_Success;
+}
+
+/*!
+ * @brief USB device get Microsoft OS 2.0 descriptor set function.
+ *
+ * This function answers the vendor request reading the Microsoft OS 2.0 descriptor set, any other vendor request is
+ * rejected.
+ *
+ * @param handle The USB device handle.
+ * @param controlRequest The pointer to the control request structure.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceGetMsOs20DescriptorSet(usb_device_handle handle,
+                                              usb_device_control_request_struct_t *controlRequest)
+{
+    usb_setup_struct_t *setup = controlRequest->setup;
+
+    if ((controlRequest->isSetup) &&
+        ((setup->bmRequestType & USB_REQUEST_TYPE_DIR_MASK) == USB_REQUEST_TYPE_DIR_IN) &&
+        ((setup->bmRequestType & USB_REQUEST_TYPE_RECIPIENT_MASK) == USB_REQUEST_TYPE_RECIPIENT_DEVICE) &&
+        (USB_MS_OS_20_VENDOR_CODE == setup->bRequest) && (USB_MS_OS_20_DESCRIPTOR_INDEX == setup->wIndex))
+    {
+        controlRequest->buffer = g_UsbDeviceMsOs20DescriptorSet;
+        controlRequest->length = USB_MS_OS_20_LENGTH_SET;
+        return kStatus_USB_Success;
+    }
+    return kStatus_USB_InvalidRequest;
+}
+#endif
+
 /*!
  * @brief USB device get string descriptor function.
  *
@@ -404,9 +814,10 @@ usb_status_t USB_DeviceGetConfigurationDescriptor(
 usb_status_t USB_DeviceGetStringDescriptor(usb_device_handle handle,
                                            usb_device_get_string_descriptor_struct_t *stringDescriptor)
 {
-    const uint16_t length = USB_GetStringDescriptor(USB_StringDescriptorBuffer, stringDescriptor->stringIndex);
+    uint8_t *descriptor;
+    const uint16_t length = USB_GetStringDescriptor(stringDescriptor->stringIndex, &descriptor);
     if (length > 0) {
-        stringDescriptor->buffer = USB_StringDescriptorBuffer;
+        stringDescriptor->buffer = descriptor;
         stringDescriptor->length = length;
         return kStatus_USB_Success;
     }
@@ -418,12 +829,9 @@ usb_status_t USB_DeviceGetStringDescriptor(usb_device_handle handle,
  *
  * This function sets the speed of the USB device.
  *
- * Due to the difference of HS and FS descriptors, the device descriptors and configurations need to be updated to match
- * current speed.
- * As the default, the device descriptors and configurations are configured by using FS parameters for both EHCI and
- * KHCI.
- * When the EHCI is enabled, the application needs to call this function to update device by using current speed.
- * The updated information includes endpoint max packet size, endpoint interval, etc.
+ * The descriptors and endpoint templates of both speeds are built at compile time, the function selects the set
+ * matching the current speed. It is called on every bus reset when the EHCI is enabled, the other controllers keep
+ * the FS set selected by default.
  *
  * @param handle The USB device handle.
  * @param speed Speed type. USB_SPEED_HIGH/USB_SPEED_FULL/USB_SPEED_LOW.
@@ -432,175 +840,37 @@ usb_status_t USB_DeviceGetStringDescriptor(usb_device_handle handle,
  */
 usb_status_t USB_DeviceSetSpeed(usb_device_handle handle, uint8_t speed)
 {
-    usb_descriptor_union_t *ptr1;
-    usb_descriptor_union_t *ptr2;
-
-    ptr1 = (usb_descriptor_union_t *)(&g_UsbDeviceConfigurationDescriptor[0]);
-    ptr2 = (usb_descriptor_union_t *)(&g_UsbDeviceConfigurationDescriptor[USB_DESCRIPTOR_LENGTH_CONFIGURATION_ALL - 1]);
+    uint8_t set = (USB_SPEED_HIGH == speed) ? USB_DESCRIPTOR_SET_HS : USB_DESCRIPTOR_SET_FS;
 
-    while (ptr1 < ptr2)
+    if (USB_SPEED_HIGH == speed)
     {
-        if (ptr1->common.bDescriptorType == USB_DESCRIPTOR_TYPE_ENDPOINT)
-        {
-            if (USB_SPEED_HIGH == speed)
-            {
-                if ((USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT ==
-                     (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                    ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                     USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_IN))
-                {
-                    ptr1->endpoint.bInterval = HS_CDC_VCOM_INTERRUPT_IN_INTERVAL;
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(HS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE,
-                                                       ptr1->endpoint.wMaxPacketSize);
-                }
-                else if ((USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_IN))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(HS_CDC_VCOM_BULK_IN_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-                else if ((USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_OUT))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(HS_CDC_VCOM_BULK_OUT_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-                else if ((USB_MTP_BULK_IN_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_IN))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(HS_MTP_BULK_IN_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-                else if ((USB_MTP_BULK_OUT_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_OUT))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(HS_MTP_BULK_OUT_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-#endif
-                else
-                {
-                }
-            }
-            else
-            {
-                if ((USB_CDC_VCOM_CIC_INTERRUPT_IN_ENDPOINT ==
-                     (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                    ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                     USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_IN))
-                {
-                    ptr1->endpoint.bInterval = FS_CDC_VCOM_INTERRUPT_IN_INTERVAL;
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(FS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE,
-                                                       ptr1->endpoint.wMaxPacketSize);
-                }
-                else if ((USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_IN))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(FS_CDC_VCOM_BULK_IN_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-                else if ((USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_OUT))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(FS_CDC_VCOM_BULK_OUT_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-                else if ((USB_MTP_BULK_IN_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_IN))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(FS_MTP_BULK_IN_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
-                else if ((USB_MTP_BULK_OUT_ENDPOINT ==
-                          (ptr1->endpoint.bEndpointAddress & USB_ENDPOINT_NUMBER_MASK)) &&
-                         ((ptr1->endpoint.bEndpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK) ==
-                          USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_OUT))
-                {
-                    USB_SHORT_TO_LITTLE_ENDIAN_ADDRESS(FS_MTP_BULK_OUT_PACKET_SIZE, ptr1->endpoint.wMaxPacketSize);
-                }
+        s_UsbDeviceConfigurationDescriptor = g_UsbDeviceConfigurationDescriptorHs;
+#if (defined(USB_DEVICE_CONFIG_CV_TEST) && (USB_DEVICE_CONFIG_CV_TEST > 0U))
+        s_UsbDeviceOtherSpeedConfigurationDescriptor = g_UsbDeviceOtherSpeedConfigurationDescriptorFs;
 #endif
-                else
-                {
-                }
-            }
-        }
-        ptr1 = (usb_descriptor_union_t *)((uint8_t *)ptr1 + ptr1->common.bLength);
     }
-
-    for (int i = 0; i < USB_CDC_VCOM_CIC_ENDPOINT_COUNT; i++)
+    else
     {
-        if (USB_SPEED_HIGH == speed)
-        {
-            g_cdcVcomCicEndpoints[i].maxPacketSize = HS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE;
-            g_cdcVcomCicEndpoints[i].interval      = HS_CDC_VCOM_INTERRUPT_IN_INTERVAL;
-        }
-        else
-        {
-            g_cdcVcomCicEndpoints[i].maxPacketSize = FS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE;
-            g_cdcVcomCicEndpoints[i].interval      = FS_CDC_VCOM_INTERRUPT_IN_INTERVAL;
-        }
+        s_UsbDeviceConfigurationDescriptor = g_UsbDeviceConfigurationDescriptorFs;
+#if (defined(USB_DEVICE_CONFIG_CV_TEST) && (USB_DEVICE_CONFIG_CV_TEST > 0U))
+        s_UsbDeviceOtherSpeedConfigurationDescriptor = g_UsbDeviceOtherSpeedConfigurationDescriptorHs;
+#endif
     }
 
-    for (int i = 0; i < USB_CDC_VCOM_DIC_ENDPOINT_COUNT; i++)
+    for (uint8_t n = 0U; n < USB_DEVICE_CONFIG_CDC_ACM; n++)
     {
-        if (USB_SPEED_HIGH == speed)
-        {
-            if (g_cdcVcomDicEndpoints[i].endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK)
-            {
-                g_cdcVcomDicEndpoints[i].maxPacketSize = HS_CDC_VCOM_BULK_IN_PACKET_SIZE;
-            }
-            else
-            {
-                g_cdcVcomDicEndpoints[i].maxPacketSize = HS_CDC_VCOM_BULK_OUT_PACKET_SIZE;
-            }
-        }
-        else
-        {
-            if (g_cdcVcomDicEndpoints[i].endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK)
-            {
-                g_cdcVcomDicEndpoints[i].maxPacketSize = FS_CDC_VCOM_BULK_IN_PACKET_SIZE;
-            }
-            else
-            {
-                g_cdcVcomDicEndpoints[i].maxPacketSize = FS_CDC_VCOM_BULK_OUT_PACKET_SIZE;
-            }
-        }
+        g_cdcVcomCicInterface[n][0].endpointList.endpoint = g_cdcVcomCicEndpoints[set][n];
+        g_cdcVcomDicInterface[n][0].endpointList.endpoint = g_cdcVcomDicEndpoints[set][n];
     }
+#if defined(USB_DEVICE_CONFIG_CDC_NCM) && (USB_DEVICE_CONFIG_CDC_NCM > 0U)
+    g_cdcNcmCicInterface[0].endpointList.endpoint = g_cdcNcmCicEndpoints[set];
+    g_cdcNcmDicInterface[1].endpointList.endpoint = g_cdcNcmDicEndpoints[set];
+#endif
+#if defined(USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+    g_UsbDeviceMscInterface[0].endpointList.endpoint = g_UsbMscEndpoints[set];
+#endif
 #if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-    for (int i = 0; i < USB_MTP_ENDPOINT_COUNT; i++)
-    {
-        if (USB_SPEED_HIGH == speed)
-        {
-            if (g_UsbMtpEndpoints[i].endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK)
-            {
-                g_UsbMtpEndpoints[i].maxPacketSize = HS_MTP_BULK_IN_PACKET_SIZE;
-            }
-            else
-            {
-                g_UsbMtpEndpoints[i].maxPacketSize = HS_MTP_BULK_OUT_PACKET_SIZE;
-            }
-        }
-        else
-        {
-            if (g_UsbMtpEndpoints[i].endpointAddress & USB_DESCRIPTOR_ENDPOINT_ADDRESS_DIRECTION_MASK)
-            {
-                g_UsbMtpEndpoints[i].maxPacketSize = FS_MTP_BULK_IN_PACKET_SIZE;
-            }
-            else
-            {
-                g_UsbMtpEndpoints[i].maxPacketSize = FS_MTP_BULK_OUT_PACKET_SIZE;
-            }
-        }
-    }
+    g_UsbDeviceMtpInterface[0].endpointList.endpoint = g_UsbMtpEndpoints[set];
 #endif
 
     return kStatus_USB_Success;
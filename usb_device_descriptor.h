@@ -9,10 +9,17 @@
 #ifndef _USB_DEVICE_DESCRIPTOR_H_
 #define _USB_DEVICE_DESCRIPTOR_H_ 1
 
+#include "usb_device_config.h"
+
 /*******************************************************************************
 * Definitions
 ******************************************************************************/
+#if (defined(USB_DEVICE_CONFIG_MS_OS_20) && (USB_DEVICE_CONFIG_MS_OS_20 > 0U))
+/* Hosts read the BOS descriptor of USB 2.1 devices only */
+#define USB_DEVICE_SPECIFIC_BCD_VERSION (0x0210)
+#else
 #define USB_DEVICE_SPECIFIC_BCD_VERSION (0x0200)
+#endif
 #define USB_DEVICE_DEMO_BCD_VERSION (0x0101U)
 
 /* Communication Class SubClass Codes */
@@ -28,6 +35,7 @@
 #define USB_CDC_MOBILE_DIRECT_LINE_MODEL (0x0A)
 #define USB_CDC_OBEX (0x0B)
 #define USB_CDC_ETHERNET_EMULATION_MODEL (0x0C)
+#define USB_CDC_NETWORK_CONTROL_MODEL (0x0D)
 
 /* Communication Class Protocol Codes */
 #define USB_CDC_NO_CLASS_SPECIFIC_PROTOCOL (0x00) /*also for Data Class Protocol Code */
@@ -54,6 +62,7 @@
 #define USB_CDC_CAPI_COMMANDS (0x93)
 #define USB_CDC_HOST_BASED_DRIVER (0xFD)
 #define USB_CDC_UNIT_FUNCTIONAL (0xFE)
+#define USB_CDC_NCM_DATA_PROTOCOL (0x01) /* Network Transfer Block */
 
 /* Descriptor SubType in Communications Class Functional Descriptors */
 #define USB_CDC_HEADER_FUNC_DESC (0x00)
@@ -82,49 +91,105 @@
 #define USB_CDC_COMMAND_SET_DETAIL_FUNC_DESC (0x17)
 #define USB_CDC_TELEPHONE_CONTROL_FUNC_DESC (0x18)
 #define USB_CDC_OBEX_SERVICE_ID_FUNC_DESC (0x19)
+#define USB_CDC_NCM_FUNC_DESC (0x1A)
 
 /* usb descriptor length */
-#define USB_DESCRIPTOR_LENGTH_CONFIGURATION_ALL (sizeof(g_UsbDeviceConfigurationDescriptor))
+#define USB_DESCRIPTOR_LENGTH_CONFIGURATION_ALL (USB_DECRIPTOR_CONFIGURATION_LENGTH)
 #define USB_CDC_VCOM_REPORT_DESCRIPTOR_LENGTH (33)
 #define USB_IAD_DESC_SIZE (8)
 #define USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC (5)
 #define USB_DESCRIPTOR_LENGTH_CDC_CALL_MANAG (5)
 #define USB_DESCRIPTOR_LENGTH_CDC_ABSTRACT (4)
 #define USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC (5)
+#define USB_DESCRIPTOR_LENGTH_CDC_ETHERNET_NETWORKING (13)
+#define USB_DESCRIPTOR_LENGTH_CDC_NCM_FUNC (6)
+#define USB_DESCRIPTOR_LENGTH_DFU_FUNC (9)
 
 #define USB_DEVICE_CONFIGURATION_COUNT (1)
 #define USB_DEVICE_STRING_COUNT (5)
 #define USB_DEVICE_LANGUAGE_COUNT (1)
 
-#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
-#   define USB_INTERFACE_COUNT (3)
+#if (USB_DEVICE_CONFIG_CDC_ACM < 1U) || (USB_DEVICE_CONFIG_CDC_ACM > 2U)
+#error "Endpoint budget allows one or two CDC ACM instances"
+#endif
 
-#   define USB_MTP_INTERFACE_INDEX (0)
-#   define USB_CDC_VCOM_CIC_INTERFACE_INDEX (1)
-#   define USB_CDC_VCOM_DIC_INTERFACE_INDEX (2)
+#if (USB_DEVICE_CONFIG_CDC_NCM > 1U) || ((USB_DEVICE_CONFIG_CDC_NCM > 0U) && (USB_DEVICE_CONFIG_CDC_ACM > 1U))
+#error "CDC NCM takes endpoints of second CDC ACM instance, only one of them may be enabled"
+#endif
 
-#   define USB_DECRIPTOR_CONFIGURATION_LENGTH  \
-    (USB_DESCRIPTOR_LENGTH_CONFIGURE + \
-    USB_IAD_DESC_SIZE + \
+#define USB_CDC_VCOM_DESCRIPTOR_LENGTH \
+    (USB_IAD_DESC_SIZE + \
     USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC + USB_DESCRIPTOR_LENGTH_CDC_CALL_MANAG + \
     USB_DESCRIPTOR_LENGTH_CDC_ABSTRACT + USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC + USB_DESCRIPTOR_LENGTH_ENDPOINT + \
-    USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_ENDPOINT + USB_DESCRIPTOR_LENGTH_ENDPOINT + \
-    USB_DESCRIPTOR_LENGTH_INTERFACE + 3 * USB_DESCRIPTOR_LENGTH_ENDPOINT)
-#else
+    USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_ENDPOINT + USB_DESCRIPTOR_LENGTH_ENDPOINT)
+
+#if (USB_DEVICE_CONFIG_MSC > 1U) || ((USB_DEVICE_CONFIG_MSC > 0U) && (USB_DEVICE_CONFIG_MTP > 0U))
+#error "Mass storage takes bulk endpoints of MTP, only one of them may be enabled"
+#endif
 
-#   define USB_INTERFACE_COUNT (2)
+#define USB_MTP_DESCRIPTOR_LENGTH (USB_DESCRIPTOR_LENGTH_INTERFACE + 3 * USB_DESCRIPTOR_LENGTH_ENDPOINT)
 
-#   define USB_CDC_VCOM_CIC_INTERFACE_INDEX (0)
-#   define USB_CDC_VCOM_DIC_INTERFACE_INDEX (1)
+#define USB_MSC_DESCRIPTOR_LENGTH (USB_DESCRIPTOR_LENGTH_INTERFACE + 2 * USB_DESCRIPTOR_LENGTH_ENDPOINT)
+
+/* Data interface is described twice: alternate setting 0 without endpoints and 1 with bulk pair */
+#define USB_CDC_NCM_DESCRIPTOR_LENGTH \
+    (USB_IAD_DESC_SIZE + \
+    USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC + USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC + \
+    USB_DESCRIPTOR_LENGTH_CDC_ETHERNET_NETWORKING + USB_DESCRIPTOR_LENGTH_CDC_NCM_FUNC + USB_DESCRIPTOR_LENGTH_ENDPOINT + \
+    USB_DESCRIPTOR_LENGTH_INTERFACE + \
+    USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_ENDPOINT + USB_DESCRIPTOR_LENGTH_ENDPOINT)
+
+/* Firmware upgrade uses control endpoint only */
+#define USB_DFU_DESCRIPTOR_LENGTH (USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_DFU_FUNC)
+
+#if defined (USB_DEVICE_CONFIG_MTP) && (USB_DEVICE_CONFIG_MTP > 0U)
+#   define USB_MTP_INTERFACE_INDEX (0)
+#   define USB_CDC_VCOM_FIRST_INTERFACE_INDEX (1)
 
 #   define USB_DECRIPTOR_CONFIGURATION_LENGTH  \
     (USB_DESCRIPTOR_LENGTH_CONFIGURE + \
-    USB_IAD_DESC_SIZE + \
-    USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_CDC_HEADER_FUNC + USB_DESCRIPTOR_LENGTH_CDC_CALL_MANAG + \
-    USB_DESCRIPTOR_LENGTH_CDC_ABSTRACT + USB_DESCRIPTOR_LENGTH_CDC_UNION_FUNC + USB_DESCRIPTOR_LENGTH_ENDPOINT + \
-    USB_DESCRIPTOR_LENGTH_INTERFACE + USB_DESCRIPTOR_LENGTH_ENDPOINT + USB_DESCRIPTOR_LENGTH_ENDPOINT)
+    USB_DEVICE_CONFIG_CDC_ACM * USB_CDC_VCOM_DESCRIPTOR_LENGTH + \
+    USB_DEVICE_CONFIG_CDC_NCM * USB_CDC_NCM_DESCRIPTOR_LENGTH + \
+    USB_DEVICE_CONFIG_DFU * USB_DFU_DESCRIPTOR_LENGTH + \
+    USB_MTP_DESCRIPTOR_LENGTH)
+#elif defined (USB_DEVICE_CONFIG_MSC) && (USB_DEVICE_CONFIG_MSC > 0U)
+#   define USB_MSC_INTERFACE_INDEX (0)
+#   define USB_CDC_VCOM_FIRST_INTERFACE_INDEX (1)
+
+#   define USB_DECRIPTOR_CONFIGURATION_LENGTH  \
+    (USB_DESCRIPTOR_LENGTH_CONFIGURE + \
+    USB_DEVICE_CONFIG_CDC_ACM * USB_CDC_VCOM_DESCRIPTOR_LENGTH + \
+    USB_DEVICE_CONFIG_CDC_NCM * USB_CDC_NCM_DESCRIPTOR_LENGTH + \
+    USB_DEVICE_CONFIG_DFU * USB_DFU_DESCRIPTOR_LENGTH + \
+    USB_MSC_DESCRIPTOR_LENGTH)
+#else
+#   define USB_CDC_VCOM_FIRST_INTERFACE_INDEX (0)
+
+#   define USB_DECRIPTOR_CONFIGURATION_LENGTH  \
+    (USB_DESCRIPTOR_LENGTH_CONFIGURE + \
+    USB_DEVICE_CONFIG_CDC_ACM * USB_CDC_VCOM_DESCRIPTOR_LENGTH + \
+    USB_DEVICE_CONFIG_CDC_NCM * USB_CDC_NCM_DESCRIPTOR_LENGTH + \
+    USB_DEVICE_CONFIG_DFU * USB_DFU_DESCRIPTOR_LENGTH)
 #endif
 
+#define USB_INTERFACE_COUNT                                                                                            \
+    (USB_CDC_VCOM_FIRST_INTERFACE_INDEX + USB_DEVICE_CONFIG_CDC_ACM * USB_CDC_VCOM_INTERFACE_COUNT +                   \
+     USB_DEVICE_CONFIG_CDC_NCM * USB_CDC_NCM_INTERFACE_COUNT + USB_DEVICE_CONFIG_DFU * USB_DFU_INTERFACE_COUNT)
+
+#define USB_CDC_VCOM_CIC_INTERFACE_INDEX (USB_CDC_VCOM_FIRST_INTERFACE_INDEX)
+#define USB_CDC_VCOM_DIC_INTERFACE_INDEX (USB_CDC_VCOM_FIRST_INTERFACE_INDEX + 1)
+#define USB_CDC_VCOM1_CIC_INTERFACE_INDEX (USB_CDC_VCOM_FIRST_INTERFACE_INDEX + 2)
+#define USB_CDC_VCOM1_DIC_INTERFACE_INDEX (USB_CDC_VCOM_FIRST_INTERFACE_INDEX + 3)
+
+/* Network function follows all virtual com ports */
+#define USB_CDC_NCM_CIC_INTERFACE_INDEX \
+    (USB_CDC_VCOM_FIRST_INTERFACE_INDEX + USB_DEVICE_CONFIG_CDC_ACM * USB_CDC_VCOM_INTERFACE_COUNT)
+#define USB_CDC_NCM_DIC_INTERFACE_INDEX (USB_CDC_NCM_CIC_INTERFACE_INDEX + 1)
+
+/* Firmware upgrade is the last function */
+#define USB_DFU_INTERFACE_INDEX \
+    (USB_CDC_NCM_CIC_INTERFACE_INDEX + USB_DEVICE_CONFIG_CDC_NCM * USB_CDC_NCM_INTERFACE_COUNT)
+
 #define USB_COMPOSITE_CONFIGURE_INDEX (1)
 
 /* Configuration, interface and endpoint. */
@@ -143,6 +208,11 @@
 #define USB_CDC_VCOM_DIC_BULK_IN_ENDPOINT (5)
 #define USB_CDC_VCOM_DIC_BULK_OUT_ENDPOINT (6)
 
+/* Second instance reuses the free directions of endpoint numbers taken by the first one */
+#define USB_CDC_VCOM1_CIC_INTERRUPT_IN_ENDPOINT (7)
+#define USB_CDC_VCOM1_DIC_BULK_IN_ENDPOINT (6)
+#define USB_CDC_VCOM1_DIC_BULK_OUT_ENDPOINT (5)
+
 /* Packet size. */
 #define HS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE (16)
 #define FS_CDC_VCOM_INTERRUPT_IN_PACKET_SIZE (16)
@@ -154,6 +224,34 @@
 #define HS_CDC_VCOM_BULK_OUT_PACKET_SIZE (512)
 #define FS_CDC_VCOM_BULK_OUT_PACKET_SIZE (64)
 
+#define USB_CDC_NCM_CIC_CLASS (0x02)
+#define USB_CDC_NCM_CIC_SUBCLASS (USB_CDC_NETWORK_CONTROL_MODEL)
+#define USB_CDC_NCM_CIC_PROTOCOL (USB_CDC_NO_CLASS_SPECIFIC_PROTOCOL)
+#define USB_CDC_NCM_DIC_CLASS (0x0A)
+#define USB_CDC_NCM_DIC_SUBCLASS (0x00)
+#define USB_CDC_NCM_DIC_PROTOCOL (USB_CDC_NCM_DATA_PROTOCOL)
+
+#define USB_CDC_NCM_INTERFACE_COUNT (2)
+
+/* Network function reuses free directions left by MTP and the first virtual com port */
+#define USB_CDC_NCM_CIC_ENDPOINT_COUNT (1)
+#define USB_CDC_NCM_CIC_INTERRUPT_IN_ENDPOINT (2)
+#define USB_CDC_NCM_DIC_ENDPOINT_COUNT (2)
+#define USB_CDC_NCM_DIC_BULK_IN_ENDPOINT (6)
+#define USB_CDC_NCM_DIC_BULK_OUT_ENDPOINT (7)
+
+#define HS_CDC_NCM_INTERRUPT_IN_PACKET_SIZE (16)
+#define FS_CDC_NCM_INTERRUPT_IN_PACKET_SIZE (16)
+#define HS_CDC_NCM_INTERRUPT_IN_INTERVAL (0x07) /* 2^(7-1) = 8ms */
+#define FS_CDC_NCM_INTERRUPT_IN_INTERVAL (0x08)
+#define HS_CDC_NCM_BULK_IN_PACKET_SIZE (512)
+#define FS_CDC_NCM_BULK_IN_PACKET_SIZE (64)
+#define HS_CDC_NCM_BULK_OUT_PACKET_SIZE (512)
+#define FS_CDC_NCM_BULK_OUT_PACKET_SIZE (64)
+
+/* Ethernet frame without CRC */
+#define USB_CDC_NCM_MAX_SEGMENT_SIZE (1514)
+
 #define USB_DESCRIPTOR_TYPE_CDC_CS_INTERFACE (0x24)
 #define USB_DESCRIPTOR_TYPE_CDC_CS_ENDPOINT (0x25)
 
@@ -178,6 +276,82 @@
 #define HS_MTP_INTR_IN_INTERVAL (0x07) /* 2^(7-1) = 8ms */
 #define FS_MTP_INTR_IN_INTERVAL (0x08)
 
+#define USB_MSC_CLASS (0x08)    /* Mass Storage */
+#define USB_MSC_SUBCLASS (0x06) /* SCSI transparent command set */
+#define USB_MSC_PROTOCOL (0x50) /* Bulk-Only Transport */
+
+#define USB_MSC_ENDPOINT_COUNT (2)
+#define USB_MSC_INTERFACE_COUNT (1)
+
+/* Mass storage replaces MTP and takes over its bulk endpoints */
+#define USB_MSC_BULK_IN_ENDPOINT (1)
+#define USB_MSC_BULK_OUT_ENDPOINT (2)
+
+#define HS_MSC_BULK_IN_PACKET_SIZE (512)
+#define FS_MSC_BULK_IN_PACKET_SIZE (64)
+#define HS_MSC_BULK_OUT_PACKET_SIZE (512)
+#define FS_MSC_BULK_OUT_PACKET_SIZE (64)
+
+/* Interface in DFU mode, firmware is downloaded while application keeps running */
+#define USB_DFU_CLASS (0xFE)    /* Application Specific */
+#define USB_DFU_SUBCLASS (0x01) /* Device Firmware Upgrade */
+#define USB_DFU_PROTOCOL (0x02) /* DFU mode */
+
+#define USB_DFU_INTERFACE_COUNT (1)
+
+#define USB_DESCRIPTOR_TYPE_DFU_FUNCTIONAL (0x21)
+/* bitCanDnload | bitManifestationTolerant, upload would read update image from interrupt context */
+#define USB_DFU_ATTRIBUTES (0x05)
+#define USB_DFU_VERSION (0x0110)
+
+/*! @brief Largest DFU_DNLOAD data stage, announced as wTransferSize. Multiple of max packet size. */
+#ifndef USB_DFU_TRANSFER_SIZE
+#define USB_DFU_TRANSFER_SIZE (4096U)
+#endif
+
+/* Host gives up on DFU_DETACH after this time, device never expects the request in DFU mode */
+#define USB_DFU_DETACH_TIMEOUT (1000U)
+
+/* Microsoft OS 2.0 descriptors */
+#define USB_DESCRIPTOR_LENGTH_DEVICE_CAPABILITY_PLATFORM_MS_OS_20 (28)
+#define USB_MS_OS_20_DESCRIPTOR_INDEX (0x07)
+#define USB_MS_OS_20_SET_HEADER_DESCRIPTOR (0x00)
+#define USB_MS_OS_20_SUBSET_HEADER_CONFIGURATION (0x01)
+#define USB_MS_OS_20_SUBSET_HEADER_FUNCTION (0x02)
+#define USB_MS_OS_20_FEATURE_COMPATIBLE_ID (0x03)
+#define USB_MS_OS_20_FEATURE_REG_PROPERTY (0x04)
+#define USB_MS_OS_20_REG_MULTI_SZ (0x07)
+#define USB_MS_OS_20_WINDOWS_VERSION (0x06030000U) /* Windows 8.1 */
+
+#define USB_MS_OS_20_LENGTH_SET_HEADER (10)
+#define USB_MS_OS_20_LENGTH_SUBSET_HEADER_CONFIGURATION (8)
+#define USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION (8)
+#define USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID (20)
+/* DeviceInterfaceGUIDs, one GUID in braces, UTF-16 with terminators */
+#define USB_MS_OS_20_LENGTH_FEATURE_REG_PROPERTY_GUIDS (10 + 2 * 21 + 2 * 40)
+
+/*! @brief bRequest of the vendor request reading the descriptor set, it must not be used by other vendor requests. */
+#ifndef USB_MS_OS_20_VENDOR_CODE
+#define USB_MS_OS_20_VENDOR_CODE (0x20)
+#endif
+
+/* MTP is bound to the in-box WPD driver */
+#define USB_MS_OS_20_LENGTH_MTP_FUNCTION \
+    (USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION + USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID)
+/* DFU is bound to WinUSB, so DFU tools open it by the interface GUID without installing a driver */
+#define USB_MS_OS_20_LENGTH_DFU_FUNCTION \
+    (USB_MS_OS_20_LENGTH_SUBSET_HEADER_FUNCTION + USB_MS_OS_20_LENGTH_FEATURE_COMPATIBLE_ID + \
+    USB_MS_OS_20_LENGTH_FEATURE_REG_PROPERTY_GUIDS)
+
+#define USB_MS_OS_20_LENGTH_CONFIGURATION \
+    (USB_MS_OS_20_LENGTH_SUBSET_HEADER_CONFIGURATION + USB_DEVICE_CONFIG_MTP * USB_MS_OS_20_LENGTH_MTP_FUNCTION + \
+    USB_DEVICE_CONFIG_DFU * USB_MS_OS_20_LENGTH_DFU_FUNCTION)
+#define USB_MS_OS_20_LENGTH_SET (USB_MS_OS_20_LENGTH_SET_HEADER + USB_MS_OS_20_LENGTH_CONFIGURATION)
+
+#define USB_DESCRIPTOR_LENGTH_BOS_ALL \
+    (USB_DESCRIPTOR_LENGTH_BOS_DESCRIPTOR + USB_DESCRIPTOR_LENGTH_DEVICE_CAPABILITY_USB20_EXTENSION + \
+    USB_DESCRIPTOR_LENGTH_DEVICE_CAPABILITY_PLATFORM_MS_OS_20)
+
 /* Class code. */
 #define USB_DEVICE_CLASS    (0x00)
 #define USB_DEVICE_SUBCLASS (0x00)
@@ -193,12 +367,9 @@
  *
  * This function sets the speed of the USB device.
  *
- * Due to the difference of HS and FS descriptors, the device descriptors and configurations need to be updated to match
- * current speed.
- * As the default, the device descriptors and configurations are configured by using FS parameters for both EHCI and
- * KHCI.
- * When the EHCI is enabled, the application needs to call this function to update device by using current speed.
- * The updated information includes endpoint max packet size, endpoint interval, etc.
+ * The descriptors and endpoint templates of both speeds are built at compile time, the function selects the set
+ * matching the current speed. It is called on every bus reset when the EHCI is enabled, the other controllers keep
+ * the FS set selected by default.
  *
  * @param handle The USB device handle.
  * @param speed Speed type. USB_SPEED_HIGH/USB_SPEED_FULL/USB_SPEED_LOW.
@@ -210,6 +381,36 @@ extern usb_status_t USB_DeviceSetSpeed(usb_device_handle handle, uint8_t speed);
 /* Get device qualifier descriptor request */
 usb_status_t USB_DeviceGetDeviceQualifierDescriptor(
     usb_device_handle handle, usb_device_get_device_qualifier_descriptor_struct_t *deviceQualifierDescriptor);
+/* Get other speed configuration descriptor request */
+usb_status_t USB_DeviceGetOtherSpeedConfigurationDescriptor(
+    usb_device_handle handle, usb_device_get_configuration_descriptor_struct_t *configurationDescriptor);
+#endif
+#if (defined(USB_DEVICE_CONFIG_MS_OS_20) && (USB_DEVICE_CONFIG_MS_OS_20 > 0U))
+/*!
+ * @brief USB device get BOS descriptor function.
+ *
+ * This function gets the BOS descriptor announcing the Microsoft OS 2.0 descriptor set.
+ *
+ * @param handle The USB device handle.
+ * @param bosDescriptor The pointer to the BOS descriptor structure.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceGetBosDescriptor(usb_device_handle handle, usb_device_get_bos_descriptor_struct_t *bosDescriptor);
+
+/*!
+ * @brief USB device get Microsoft OS 2.0 descriptor set function.
+ *
+ * This function answers the vendor request reading the Microsoft OS 2.0 descriptor set, any other vendor request is
+ * rejected.
+ *
+ * @param handle The USB device handle.
+ * @param controlRequest The pointer to the control request structure.
+ *
+ * @return A USB error code or kStatus_USB_Success.
+ */
+usb_status_t USB_DeviceGetMsOs20DescriptorSet(usb_device_handle handle,
+                                              usb_device_control_request_struct_t *controlRequest);
 #endif
 /*!
  * @brief USB device get device descriptor function.